@@ -30,6 +30,9 @@ fn main() {
         // --- Allowlist your C helper function(s) ---
         .allowlist_function("rust_harmonize_sets") // Original function
         .allowlist_function("rust_harmonize_sets_with_mapping") // New improved function
+        .allowlist_function("rust_harmonize_sets_n") // N-ary harmonization
+        .allowlist_function("rust_set_from_constraints") // Direct set construction
+        .allowlist_function("rust_set_normalize_disjuncts") // Disjunct normalization
         // --- End allowlist ---
         .parse_callbacks(Box::new(bindgen::CargoCallbacks::new()))
         .generate()
@@ -72,16 +72,28 @@ def generate_comprehensive_table(stats: List[Dict[str, Any]]) -> str:
         if trans_before > 0:
             pruning_pct = (total_trans_removed / trans_before) * 100
 
+        # Disjuncts checked, and how many there were before normalization if it dropped any
+        disjuncts = str(row['num_disjuncts'])
+        before_normalization = row['petri_net'].get('disjuncts_before_normalization', 0)
+        if before_normalization > row['petri_net'].get('disjuncts_after_normalization', 0):
+            disjuncts += f" ({before_normalization})"
+
+        # SMPT calls/timeouts, plus the queries the in-process pre-checks refuted
+        smpt = f"{row['smpt_calls']}/{row['smpt_timeouts']}"
+        prechecked = row.get('precheck_invariant_refuted', 0) + row.get('precheck_state_equation_refuted', 0)
+        if prechecked > 0:
+            smpt += f" (+{prechecked})"
+
         rows.append({
             'Example': f"\\texttt{{{example_name}}}",
             'Opts': opts,
             'Result': 'S' if row['result'] == 'serializable' else ('T' if row['result'] == 'timeout' else 'NS'),
-            'Disjuncts': str(row['num_disjuncts']),
+            'Disjuncts': disjuncts,
             'SL Size': str(row['semilinear_set']['num_components']),
             'PN Size': f"{places_before}/{trans_before}",
             'Pruned': f"{pruning_pct:.0f}\\%",
             'Time': format_time(row['total_time_ms']),
-            'SMPT': f"{row['smpt_calls']}/{row['smpt_timeouts']}"
+            'SMPT': smpt
         })
 
     # Convert to LaTeX
@@ -98,6 +110,8 @@ def generate_comprehensive_table(stats: List[Dict[str, Any]]) -> str:
     latex += "\\end{tabular}\n"
     latex += "\n% Legend: S = Serializable, NS = Not Serializable, T = Timeout\n"
     latex += "% Opts: B = Bidirectional Pruning, R = Remove Redundant, G = Generate Less, S = Smart Kleene Order\n"
+    latex += "% Disj.: disjuncts checked (before normalization, if it dropped any)\n"
+    latex += "% SMPT: calls/timeouts (+ queries refuted by the pre-checks without SMPT)\n"
 
     return latex
 
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Long-lived SMPT worker, used by `ser --smpt-server` (see src/smpt_server.rs).
+
+SMPT (and z3) are imported once. Each request is one JSON line on stdin:
+
+    {"args": ["-n", "net.net", "--xml", "query.xml", ...],
+     "stdout": "/path/to/out.stdout", "stderr": "/path/to/out.stderr"}
+
+The worker runs `python3 -m smpt <args>` in-process with file descriptors 1 and 2
+redirected to the given files, and answers with one JSON line on its original stdout:
+
+    {"status": <exit code>}
+
+A line {"ready": true} is written once SMPT has been imported. The worker exits when
+stdin is closed.
+"""
+
+import importlib
+import json
+import os
+import runpy
+import sys
+import traceback
+
+
+def run_request(request):
+    sys.stdout.flush()
+    sys.stderr.flush()
+    saved_stdout, saved_stderr = os.dup(1), os.dup(2)
+    flags = os.O_WRONLY | os.O_CREAT | os.O_TRUNC
+    out_fd = os.open(request["stdout"], flags, 0o644)
+    err_fd = os.open(request["stderr"], flags, 0o644)
+    os.dup2(out_fd, 1)
+    os.dup2(err_fd, 2)
+
+    status = 0
+    sys.argv = ["smpt"] + list(request["args"])
+    try:
+        runpy.run_module("smpt", run_name="__main__", alter_sys=True)
+    except SystemExit as e:
+        if e.code is None:
+            status = 0
+        elif isinstance(e.code, int):
+            status = e.code
+        else:
+            print(e.code, file=sys.stderr)
+            status = 1
+    except BaseException:
+        traceback.print_exc()
+        status = 1
+    finally:
+        sys.modules.pop("smpt.__main__", None)
+        sys.stdout.flush()
+        sys.stderr.flush()
+        os.dup2(saved_stdout, 1)
+        os.dup2(saved_stderr, 2)
+        for fd in (out_fd, err_fd, saved_stdout, saved_stderr):
+            os.close(fd)
+    return status
+
+
+def main():
+    # Keep the protocol channel away from anything SMPT prints
+    protocol = os.fdopen(os.dup(1), "w", buffering=1)
+    devnull = os.open(os.devnull, os.O_WRONLY)
+    os.dup2(devnull, 1)
+    os.close(devnull)
+
+    # Pay the import cost once; the main guard keeps this from running SMPT.
+    # Only the modules it imports stay cached, runpy re-executes __main__ itself.
+    importlib.import_module("smpt.__main__")
+    sys.modules.pop("smpt.__main__", None)
+    protocol.write(json.dumps({"ready": True}) + "\n")
+
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            status = run_request(json.loads(line))
+        except Exception:
+            traceback.print_exc()
+            status = 1
+        protocol.write(json.dumps({"status": status}) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,329 @@
+//! Batch mode (`--batch`): analyse many files in one process.
+//!
+//! The files come from a directory (recursively, in path order) or from a manifest that
+//! lists one path per line. They run on `--batch-jobs` worker threads. Each file gets its
+//! own stats collector and debug logger. Everything else stays warm from file to file:
+//! the SMPT result cache and pooled SMPT workers are shared by all threads, and each
+//! thread keeps its ISL context and formula cache (unless `--isl-reset-ctx`).
+//!
+//! The stats records go to the usual JSONL file, in input order and in the same format
+//! as single-file runs, through one handle opened for the whole batch.
+//!
+//! `--batch-timeout` gives each file a deadline (see `parallel::with_deadline`). Once it
+//! passes, running SMPT queries are killed and the file is recorded as a timeout. ISL
+//! computations cannot be interrupted; `--isl-max-ops` bounds those.
+
+use crate::debug_report::DebugLogger;
+use crate::stats::SerializabilityStats;
+use colored::*;
+use std::collections::BTreeMap;
+use std::io::LineWriter;
+use std::panic::{self, AssertUnwindSafe};
+use std::path::{Path, PathBuf};
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::{Duration, Instant};
+
+/// Stack size of the batch worker threads, as the analysis recurses deeply on large
+/// programs (like the main thread's default)
+const WORKER_STACK_SIZE: usize = 8 << 20;
+
+/// How the files of a batch went
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct BatchSummary {
+    pub processed: usize,
+    pub failed: usize,
+    pub timed_out: usize,
+}
+
+enum FileOutcome {
+    Done,
+    TimedOut,
+    Failed(String),
+}
+
+/// The `.ser` and `.json` files below a directory in path order, or the files listed in
+/// a manifest
+pub fn collect_inputs(path: &Path) -> Result<Vec<PathBuf>, String> {
+    if path.is_dir() {
+        let mut files = Vec::new();
+        collect_directory(path, &mut files)?;
+        files.sort();
+        return Ok(files);
+    }
+    let content = std::fs::read_to_string(path).map_err(|err| {
+        format!(
+            "{} manifest '{}': {}",
+            "Error reading".red().bold(),
+            path.display(),
+            err
+        )
+    })?;
+    Ok(parse_manifest(&content))
+}
+
+fn collect_directory(dir: &Path, files: &mut Vec<PathBuf>) -> Result<(), String> {
+    let entries = std::fs::read_dir(dir).map_err(|err| {
+        format!(
+            "{} directory '{}': {}",
+            "Error reading".red().bold(),
+            dir.display(),
+            err
+        )
+    })?;
+    for entry in entries {
+        let path = match entry {
+            Ok(entry) => entry.path(),
+            Err(err) => {
+                eprintln!(
+                    "{}: Error accessing entry: {}",
+                    "Warning".yellow().bold(),
+                    err
+                );
+                continue;
+            }
+        };
+        if path.is_dir() {
+            if let Err(err) = collect_directory(&path, files) {
+                eprintln!("{}: {}", "Warning".yellow().bold(), err);
+            }
+        } else if matches!(
+            path.extension().and_then(|ext| ext.to_str()),
+            Some("ser" | "json")
+        ) {
+            files.push(path);
+        }
+    }
+    Ok(())
+}
+
+/// One path per line, relative to the working directory; blank lines and lines
+/// starting with `#` are skipped
+fn parse_manifest(content: &str) -> Vec<PathBuf> {
+    content
+        .lines()
+        .map(str::trim)
+        .filter(|line| !line.is_empty() && !line.starts_with('#'))
+        .map(PathBuf::from)
+        .collect()
+}
+
+/// Hands out results in index order, holding back those that finish early
+struct InOrder<T> {
+    next: usize,
+    pending: BTreeMap<usize, T>,
+}
+
+impl<T> InOrder<T> {
+    fn new() -> Self {
+        InOrder {
+            next: 0,
+            pending: BTreeMap::new(),
+        }
+    }
+
+    /// Add the result of `index`, returning the results that are now next in line
+    fn push(&mut self, index: usize, result: T) -> Vec<T> {
+        self.pending.insert(index, result);
+        let mut ready = Vec::new();
+        while let Some(result) = self.pending.remove(&self.next) {
+            ready.push(result);
+            self.next += 1;
+        }
+        ready
+    }
+}
+
+/// The JSONL stats file of a batch, written in input order
+struct StatsStream {
+    in_order: InOrder<Option<SerializabilityStats>>,
+    out: LineWriter<std::fs::File>,
+}
+
+impl StatsStream {
+    fn push(&mut self, index: usize, record: Option<SerializabilityStats>) {
+        for record in self.in_order.push(index, record).into_iter().flatten() {
+            if let Err(e) = crate::stats::write_stats_line(&mut self.out, &record) {
+                eprintln!("Failed to save statistics: {}", e);
+            }
+        }
+    }
+}
+
+/// Analyse `files` with `analyze` on `jobs` threads, giving each file `timeout`.
+///
+/// `analyze` reports files it cannot read or parse as errors; a panic counts as an
+/// error too. Either way the batch carries on, and the file's record says `error`.
+pub fn run_batch<F>(
+    files: &[PathBuf],
+    jobs: usize,
+    timeout: Option<Duration>,
+    analyze: F,
+) -> std::io::Result<BatchSummary>
+where
+    F: Fn(&Path) -> Result<(), String> + Sync,
+{
+    let stats_stream = Mutex::new(StatsStream {
+        in_order: InOrder::new(),
+        out: LineWriter::new(crate::stats::open_stats_file()?),
+    });
+    let summary = Mutex::new(BatchSummary::default());
+    let next = AtomicUsize::new(0);
+
+    std::thread::scope(|scope| -> std::io::Result<()> {
+        for _ in 0..jobs.clamp(1, files.len().max(1)) {
+            std::thread::Builder::new()
+                .stack_size(WORKER_STACK_SIZE)
+                .spawn_scoped(scope, || {
+                    loop {
+                        let i = next.fetch_add(1, Ordering::SeqCst);
+                        if i >= files.len() {
+                            break;
+                        }
+
+                        let start = Instant::now();
+                        let (outcome, record) = run_file(&files[i], timeout, &analyze);
+                        report_file(i, files, &outcome, start.elapsed());
+                        {
+                            let mut summary = summary.lock().unwrap();
+                            match outcome {
+                                FileOutcome::Done => summary.processed += 1,
+                                FileOutcome::TimedOut => summary.timed_out += 1,
+                                FileOutcome::Failed(_) => summary.failed += 1,
+                            }
+                        }
+
+                        stats_stream.lock().unwrap().push(i, record);
+
+                        if crate::isl::reset_per_file() {
+                            crate::isl::reset_thread_ctx();
+                        }
+                    }
+
+                    // Release ISL objects cached on this thread, then the thread's ctx itself
+                    crate::isl::reset_thread_ctx();
+                })?;
+        }
+        Ok(())
+    })?;
+
+    Ok(summary.into_inner().unwrap())
+}
+
+/// Analyse one file with its own stats collector, debug logger and deadline
+fn run_file<F>(
+    file: &Path,
+    timeout: Option<Duration>,
+    analyze: &F,
+) -> (FileOutcome, Option<SerializabilityStats>)
+where
+    F: Fn(&Path) -> Result<(), String>,
+{
+    let deadline = timeout.map(|timeout| Instant::now() + timeout);
+    let logger = DebugLogger::new(file.display().to_string(), String::new());
+    let (outcome, mut record) = crate::stats::collect_analysis_stats(|| {
+        crate::parallel::with_deadline(deadline, || {
+            crate::debug_report::with_task_logger(&logger, || {
+                let failure = match panic::catch_unwind(AssertUnwindSafe(|| analyze(file))) {
+                    Ok(Ok(())) => None,
+                    Ok(Err(err)) => Some(err),
+                    Err(payload) => Some(panic_message(payload.as_ref())),
+                };
+                match failure {
+                    Some(err) => {
+                        crate::stats::set_analysis_result("error");
+                        crate::stats::finalize_stats();
+                        FileOutcome::Failed(err)
+                    }
+                    None if crate::parallel::deadline_passed() => FileOutcome::TimedOut,
+                    None => FileOutcome::Done,
+                }
+            })
+        })
+    });
+
+    // Past the deadline the answer, if any, came too late to count
+    if let (FileOutcome::TimedOut, Some(record)) = (&outcome, record.as_mut()) {
+        record.result = "timeout".to_string();
+    }
+    (outcome, record)
+}
+
+fn panic_message(payload: &(dyn std::any::Any + Send)) -> String {
+    let message = payload
+        .downcast_ref::<&str>()
+        .map(|message| message.to_string())
+        .or_else(|| payload.downcast_ref::<String>().cloned())
+        .unwrap_or_else(|| "unknown panic".to_string());
+    format!("{}: {}", "Analysis panicked".red().bold(), message)
+}
+
+fn report_file(index: usize, files: &[PathBuf], outcome: &FileOutcome, elapsed: Duration) {
+    let status = match outcome {
+        FileOutcome::Done => "done".green().bold(),
+        FileOutcome::TimedOut => "timeout".yellow().bold(),
+        FileOutcome::Failed(_) => "error".red().bold(),
+    };
+    println!(
+        "{} [{}/{}] {}: {} ({} ms)",
+        "Batch".blue().bold(),
+        index + 1,
+        files.len(),
+        files[index].display(),
+        status,
+        elapsed.as_millis()
+    );
+    if let FileOutcome::Failed(err) = outcome {
+        eprintln!("{}", err);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_parse_manifest() {
+        let manifest = "# examples\nexamples/a.ser\n\n  examples/b.json  \n#examples/c.ser\n";
+        assert_eq!(
+            parse_manifest(manifest),
+            vec![
+                PathBuf::from("examples/a.ser"),
+                PathBuf::from("examples/b.json")
+            ]
+        );
+    }
+
+    #[test]
+    fn test_collect_inputs_from_directory() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let root = temp_dir.path();
+        std::fs::create_dir(root.join("sub")).unwrap();
+        for file in ["b.ser", "a.json", "notes.txt", "sub/c.ser"] {
+            std::fs::write(root.join(file), "").unwrap();
+        }
+
+        let files = collect_inputs(root).unwrap();
+        let names: Vec<_> = files
+            .iter()
+            .map(|file| file.strip_prefix(root).unwrap().to_path_buf())
+            .collect();
+        assert_eq!(
+            names,
+            vec![
+                PathBuf::from("a.json"),
+                PathBuf::from("b.ser"),
+                PathBuf::from("sub/c.ser")
+            ]
+        );
+    }
+
+    #[test]
+    fn test_in_order_holds_back_early_results() {
+        let mut in_order = InOrder::new();
+        assert_eq!(in_order.push(2, 'c'), vec![]);
+        assert_eq!(in_order.push(1, 'b'), vec![]);
+        assert_eq!(in_order.push(0, 'a'), vec!['a', 'b', 'c']);
+        assert_eq!(in_order.push(3, 'd'), vec!['d']);
+    }
+}
@@ -0,0 +1,460 @@
+//! Benchmarks (`--bench`): time the in-process kernels on example inputs.
+//!
+//! Whole runs are dominated by SMPT, so they cannot show regressions in our own code.
+//! For every input file (a directory or manifest, as for `--batch`) this times the
+//! kernels in isolation, each on inputs built from that file:
+//!
+//! - `program_to_ns` (`.ser` files only), `nfa_to_kleene` on regexes, and the
+//!   `SemilinearSet` star and times that Kleene's algorithm runs on the semilinear sets;
+//! - `PresburgerSet::from_semilinear_set`, `harmonize` and `difference` on the set of
+//!   serialized executions;
+//! - `Petri::filter_bidirectional_reachable` on the net with requests;
+//! - `NSInvariant::check_proof` on the certificate in the file's output directory, if an
+//!   earlier run left one there.
+//!
+//! With `--bench-replay` each file also runs end to end, with SMPT answered from the
+//! result cache only (`smpt::set_smpt_replay`), so the timings do not depend on SMPT.
+//! Fill the cache with a normal `--use-cache` run first; a query it misses fails the file.
+//!
+//! Each benchmark reports the median of several samples. `--bench-save` writes the
+//! results as JSON, and `--bench-baseline` compares them against such a file, flagging
+//! benchmarks that got slower by more than `REGRESSION_THRESHOLD`.
+
+use crate::expr_to_ns::program_to_ns;
+use crate::kleene::{Kleene, Regex, nfa_to_kleene};
+use crate::ns::NS;
+use crate::parser::{ExprHc, Program, Request, parse, parse_program};
+use crate::presburger::PresburgerSet;
+use crate::semilinear::SemilinearSet;
+use colored::*;
+use serde::de::DeserializeOwned;
+use serde::{Deserialize, Serialize};
+use std::fmt::{Debug, Display};
+use std::hash::Hash;
+use std::hint::black_box;
+use std::panic::{self, AssertUnwindSafe};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+/// Samples per benchmark, and the time after which a benchmark stops sampling once it
+/// has `MIN_SAMPLES`
+const MIN_SAMPLES: usize = 3;
+const MAX_SAMPLES: usize = 20;
+const SAMPLE_BUDGET: Duration = Duration::from_secs(2);
+
+/// A benchmark regressed if its median grew by more than this fraction of the baseline,
+/// and by more than `NOISE_FLOOR` (timer noise dominates below that)
+const REGRESSION_THRESHOLD: f64 = 0.10;
+const NOISE_FLOOR: Duration = Duration::from_micros(50);
+
+/// Semilinear sets with more components are too large for the star and times kernels
+const MAX_COMPONENTS_FOR_ALGEBRA: usize = 32;
+
+#[derive(Debug, Default, Clone)]
+pub struct BenchOptions {
+    pub baseline: Option<PathBuf>,
+    pub save: Option<PathBuf>,
+    pub replay: bool,
+}
+
+/// The timing of one benchmark on one input, named `<kernel>/<file>`
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Measurement {
+    pub name: String,
+    pub samples: usize,
+    pub median_ns: u64,
+    pub min_ns: u64,
+}
+
+/// Time `run` on fresh inputs from `setup`, which is not timed; neither is dropping the
+/// result
+fn measure<S, R>(
+    name: String,
+    mut setup: impl FnMut() -> S,
+    mut run: impl FnMut(S) -> R,
+) -> Measurement {
+    let started = Instant::now();
+    let mut times = Vec::new();
+    while times.len() < MAX_SAMPLES
+        && (times.len() < MIN_SAMPLES || started.elapsed() < SAMPLE_BUDGET)
+    {
+        let input = setup();
+        let start = Instant::now();
+        let result = black_box(run(black_box(input)));
+        times.push(start.elapsed());
+        drop(result);
+    }
+    times.sort();
+    let measurement = Measurement {
+        name,
+        samples: times.len(),
+        median_ns: times[times.len() / 2].as_nanos() as u64,
+        min_ns: times[0].as_nanos() as u64,
+    };
+    println!(
+        "  {:<60} {:>12} (min {}, {} samples)",
+        measurement.name,
+        format_ns(measurement.median_ns),
+        format_ns(measurement.min_ns),
+        measurement.samples
+    );
+    measurement
+}
+
+fn format_ns(ns: u64) -> String {
+    match ns {
+        0..1_000 => format!("{} ns", ns),
+        1_000..1_000_000 => format!("{:.1} µs", ns as f64 / 1e3),
+        1_000_000..1_000_000_000 => format!("{:.1} ms", ns as f64 / 1e6),
+        _ => format!("{:.2} s", ns as f64 / 1e9),
+    }
+}
+
+/// Run the benchmarks on `files`, returning the number of regressions against the
+/// baseline (0 without one). `analyze` is the end-to-end analysis of one file for
+/// `--bench-replay`.
+pub fn run_bench<F>(files: &[PathBuf], options: &BenchOptions, analyze: F) -> Result<usize, String>
+where
+    F: Fn(&Path) -> Result<(), String>,
+{
+    if options.replay {
+        crate::smpt::set_use_cache(true);
+        crate::smpt::set_smpt_replay(true);
+    }
+
+    let mut results = Vec::new();
+    for file in files {
+        println!("{} {}", "Bench".blue().bold(), file.display());
+        if let Err(err) = bench_file(file, &mut results) {
+            eprintln!(
+                "{}: Skipping '{}': {}",
+                "Warning".yellow().bold(),
+                file.display(),
+                err
+            );
+            continue;
+        }
+
+        if options.replay {
+            let file_stem = file.file_stem().and_then(|s| s.to_str()).unwrap_or("input");
+            // A first run that fails (say, on a cache miss) is not worth timing
+            if let Err(err) = run_analysis(file, &analyze) {
+                eprintln!(
+                    "{}: No end-to-end timing for '{}': {}",
+                    "Warning".yellow().bold(),
+                    file.display(),
+                    err
+                );
+                continue;
+            }
+            results.push(measure(
+                format!("end_to_end/{}", file_stem),
+                || (),
+                |_| run_analysis(file, &analyze),
+            ));
+        }
+    }
+
+    if let Some(path) = &options.save {
+        let json = serde_json::to_string_pretty(&results)
+            .map_err(|err| format!("{} results: {}", "Error serializing".red().bold(), err))?;
+        std::fs::write(path, json).map_err(|err| {
+            format!(
+                "{} '{}': {}",
+                "Error writing".red().bold(),
+                path.display(),
+                err
+            )
+        })?;
+        println!(
+            "{} {}",
+            "Saved benchmark results to".green().bold(),
+            path.display()
+        );
+    }
+
+    let Some(path) = &options.baseline else {
+        return Ok(0);
+    };
+    let content = std::fs::read_to_string(path).map_err(|err| {
+        format!(
+            "{} baseline '{}': {}",
+            "Error reading".red().bold(),
+            path.display(),
+            err
+        )
+    })?;
+    let baseline: Vec<Measurement> = serde_json::from_str(&content).map_err(|err| {
+        format!(
+            "{} baseline '{}': {}",
+            "Error parsing".red().bold(),
+            path.display(),
+            err
+        )
+    })?;
+    Ok(report_comparison(&baseline, &results))
+}
+
+/// The kernel benchmarks of one file
+fn bench_file(file: &Path, results: &mut Vec<Measurement>) -> Result<(), String> {
+    let file_stem = file.file_stem().and_then(|s| s.to_str()).unwrap_or("input");
+    let out_dir = format!("out/{}", file_stem);
+    let content = std::fs::read_to_string(file)
+        .map_err(|err| format!("{} file: {}", "Error reading".red().bold(), err))?;
+
+    match file.extension().and_then(|ext| ext.to_str()) {
+        Some("json") => {
+            let ns = NS::<String, String, String, String>::from_json(&content)
+                .map_err(|err| format!("{} JSON: {}", "Error parsing".red().bold(), err))?;
+            bench_ns(file_stem, &ns, &out_dir, results);
+        }
+        Some("ser") => {
+            let program = parse_ser(&content, &mut ExprHc::new())
+                .map_err(|err| format!("{} SER file: {}", "Error parsing".red().bold(), err))?;
+            results.push(measure(
+                format!("program_to_ns/{}", file_stem),
+                || {
+                    // A fresh hash-consing table each time, as in a real run
+                    let mut table = ExprHc::new();
+                    let program = parse_ser(&content, &mut table).unwrap();
+                    (table, program)
+                },
+                |(mut table, program)| program_to_ns(&mut table, &program),
+            ));
+            let ns = program_to_ns(&mut ExprHc::new(), &program);
+            bench_ns(file_stem, &ns, &out_dir, results);
+        }
+        _ => return Err("not a .ser or .json file".to_string()),
+    }
+    Ok(())
+}
+
+/// One end-to-end analysis with its own stats collector, with a panic as an error
+fn run_analysis<F>(file: &Path, analyze: &F) -> Result<(), String>
+where
+    F: Fn(&Path) -> Result<(), String>,
+{
+    let (outcome, _) = crate::stats::collect_analysis_stats(|| {
+        panic::catch_unwind(AssertUnwindSafe(|| analyze(file)))
+    });
+    outcome.unwrap_or_else(|payload| {
+        Err(payload
+            .downcast_ref::<&str>()
+            .map(|message| message.to_string())
+            .or_else(|| payload.downcast_ref::<String>().cloned())
+            .unwrap_or_else(|| "unknown panic".to_string()))
+    })
+}
+
+/// A `.ser` file as a program, or as a single request if it is just an expression
+fn parse_ser(content: &str, table: &mut ExprHc) -> Result<Program, String> {
+    parse_program(content, table).or_else(|_| {
+        let expr = parse(content, table)?;
+        Ok(Program {
+            requests: vec![Request {
+                name: "request".to_string(),
+                body: expr,
+            }],
+        })
+    })
+}
+
+/// The kernels that work on the network system of a file
+fn bench_ns<G, L, Req, Resp>(
+    file_stem: &str,
+    ns: &NS<G, L, Req, Resp>,
+    out_dir: &str,
+    results: &mut Vec<Measurement>,
+) where
+    G: Clone + Ord + Hash + Display + Debug + DeserializeOwned,
+    L: Clone + Ord + Hash + Display + Debug + DeserializeOwned,
+    Req: Clone + Ord + Hash + Display + Debug + DeserializeOwned,
+    Resp: Clone + Ord + Hash + Display + Debug + DeserializeOwned,
+{
+    let automaton = ns.serialized_automaton();
+    let atom = |req: &Req, resp: &Resp| format!("{req}/{resp}");
+
+    // State elimination itself, on cheap regexes
+    let regex_nfa: Vec<(G, Regex<String>, G)> = automaton
+        .iter()
+        .map(|(g, req, resp, g2)| (g.clone(), Regex::Atom(atom(req, resp)), g2.clone()))
+        .collect();
+    results.push(measure(
+        format!("nfa_to_kleene/{}", file_stem),
+        || (),
+        |_| nfa_to_kleene(&regex_nfa, ns.initial_global.clone()),
+    ));
+
+    // The semilinear set algebra Kleene's algorithm runs
+    let semilinear_nfa: Vec<(G, SemilinearSet<String>, G)> = automaton
+        .iter()
+        .map(|(g, req, resp, g2)| (g.clone(), SemilinearSet::atom(atom(req, resp)), g2.clone()))
+        .collect();
+    results.push(measure(
+        format!("semilinear_kleene/{}", file_stem),
+        || (),
+        |_| nfa_to_kleene(&semilinear_nfa, ns.initial_global.clone()),
+    ));
+    let semilinear: SemilinearSet<String> =
+        nfa_to_kleene(&semilinear_nfa, ns.initial_global.clone());
+    if semilinear.components.len() <= MAX_COMPONENTS_FOR_ALGEBRA {
+        results.push(measure(
+            format!("SemilinearSet::star/{}", file_stem),
+            || semilinear.clone(),
+            |set| set.star(),
+        ));
+        results.push(measure(
+            format!("SemilinearSet::times/{}", file_stem),
+            || (semilinear.clone(), semilinear.clone()),
+            |(a, b)| a.times(b),
+        ));
+    }
+
+    results.push(measure(
+        format!("from_semilinear_set/{}", file_stem),
+        || (),
+        |_| PresburgerSet::from_semilinear_set(&semilinear),
+    ));
+    let presburger = PresburgerSet::from_semilinear_set(&semilinear);
+    let mut atoms: Vec<String> = automaton
+        .iter()
+        .map(|(_, req, resp, _)| atom(req, resp))
+        .collect();
+    atoms.sort();
+    atoms.dedup();
+    let universe = PresburgerSet::universe(atoms.clone());
+    // Reversed, so that harmonizing has to reorder dimensions
+    let reversed = PresburgerSet::universe(atoms.into_iter().rev().collect());
+    results.push(measure(
+        format!("PresburgerSet::harmonize/{}", file_stem),
+        || (presburger.clone(), reversed.clone()),
+        |(mut a, mut b)| {
+            a.harmonize(&mut b);
+            (a, b)
+        },
+    ));
+    results.push(measure(
+        format!("PresburgerSet::difference/{}", file_stem),
+        || (),
+        |_| universe.difference(&presburger),
+    ));
+
+    let petri = crate::ns_to_petri::ns_to_petri_with_requests(ns);
+    let targets = petri.get_places();
+    results.push(measure(
+        format!("filter_bidirectional_reachable/{}", file_stem),
+        || petri.clone(),
+        |mut petri| {
+            petri.filter_bidirectional_reachable(&targets);
+            petri
+        },
+    ));
+
+    if let Some((path, format)) = crate::certificate::find(out_dir) {
+        match crate::certificate::load::<G, L, Req, Resp>(&path, format) {
+            Ok(crate::ns_decision::NSDecision::Serializable { invariant }) => {
+                results.push(measure(
+                    format!("check_proof/{}", file_stem),
+                    || (),
+                    |_| invariant.check_proof(ns),
+                ));
+            }
+            Ok(_) => {}
+            Err(err) => eprintln!(
+                "{}: Failed to load certificate '{}': {}",
+                "Warning".yellow().bold(),
+                path,
+                err
+            ),
+        }
+    }
+}
+
+/// Whether `current` is a regression against `baseline`
+fn is_regression(baseline: &Measurement, current: &Measurement) -> bool {
+    let (before, after) = (baseline.median_ns as f64, current.median_ns as f64);
+    after > before * (1.0 + REGRESSION_THRESHOLD) && after - before > NOISE_FLOOR.as_nanos() as f64
+}
+
+/// Print the change of every benchmark the baseline has too, returning the number of
+/// regressions
+fn report_comparison(baseline: &[Measurement], results: &[Measurement]) -> usize {
+    println!();
+    println!("{}", "Comparison with baseline:".bold());
+    let mut regressions = 0;
+    for current in results {
+        let Some(before) = baseline.iter().find(|m| m.name == current.name) else {
+            println!("  {:<60} {}", current.name, "new".cyan());
+            continue;
+        };
+        let change = (current.median_ns as f64 / before.median_ns.max(1) as f64 - 1.0) * 100.0;
+        let status = if is_regression(before, current) {
+            regressions += 1;
+            "regression".red().bold()
+        } else if change < -REGRESSION_THRESHOLD * 100.0 {
+            "faster".green()
+        } else {
+            "ok".normal()
+        };
+        println!(
+            "  {:<60} {:>12} -> {:>12} ({:+.1}%) {}",
+            current.name,
+            format_ns(before.median_ns),
+            format_ns(current.median_ns),
+            change,
+            status
+        );
+    }
+    if regressions > 0 {
+        println!(
+            "{} {} benchmarks regressed by more than {:.0}%",
+            "Warning:".yellow().bold(),
+            regressions,
+            REGRESSION_THRESHOLD * 100.0
+        );
+    }
+    regressions
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn measurement(name: &str, median_ns: u64) -> Measurement {
+        Measurement {
+            name: name.to_string(),
+            samples: MIN_SAMPLES,
+            median_ns,
+            min_ns: median_ns,
+        }
+    }
+
+    #[test]
+    fn test_is_regression() {
+        let baseline = measurement("kernel/a", 1_000_000);
+        // 20% slower
+        assert!(is_regression(
+            &baseline,
+            &measurement("kernel/a", 1_200_000)
+        ));
+        // Within the threshold
+        assert!(!is_regression(
+            &baseline,
+            &measurement("kernel/a", 1_050_000)
+        ));
+        // Twice as slow, but only by timer noise
+        let tiny = measurement("kernel/b", 10_000);
+        assert!(!is_regression(&tiny, &measurement("kernel/b", 20_000)));
+    }
+
+    #[test]
+    fn test_report_comparison_counts_regressions() {
+        let baseline = vec![measurement("a", 1_000_000), measurement("b", 1_000_000)];
+        let results = vec![
+            measurement("a", 2_000_000),
+            measurement("b", 900_000),
+            measurement("c", 5_000_000),
+        ];
+        assert_eq!(report_comparison(&baseline, &results), 1);
+    }
+}
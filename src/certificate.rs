@@ -0,0 +1,808 @@
+//! Certificate files: `certificate.bin`, a compact binary encoding of an `NSDecision`
+//! (the default), or `certificate.json` (`--certificate-format json`).
+//!
+//! Layout of `certificate.bin`. Integers are LEB128 varints (signed ones zigzag encoded),
+//! byte strings are a varint length followed by the bytes:
+//!
+//! - the magic `SERCERT` and a format version byte;
+//! - four tables with the distinct global states, local states, requests and responses,
+//!   each a count followed by the JSON encoding of every value as a byte string;
+//! - the table of invariant variables (request/state pairs), each a request index, a
+//!   state byte (0 in flight, 1 completed) and a local state or response index;
+//! - the decision: a tag byte, then the invariants (global state index, variable indices,
+//!   formula), the trace steps (kind byte and table indices) or the timeout message.
+//!
+//! Everything else refers to the tables by index, so the (often large) states are stored
+//! once however many formulas and steps mention them. Loading reads the file front to
+//! back through a buffer, never holding its text in memory.
+
+use crate::deterministic_map::HashMap;
+use crate::ns_decision::{
+    NSDecision, NSInvariant, NSStep, NSTrace, RequestState, RequestStatePair,
+};
+use crate::presburger::Variable;
+use crate::proof_parser::{AffineExpr, CompOp, Constraint, Formula, ProofInvariant};
+use serde::Serialize;
+use serde::de::DeserializeOwned;
+use std::fs::File;
+use std::hash::Hash;
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, AtomicU8, Ordering};
+
+const MAGIC: &[u8; 7] = b"SERCERT";
+
+/// Bumped whenever the binary layout changes
+const FORMAT_VERSION: u8 = 1;
+
+/// How certificates are written
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CertificateFormat {
+    Json = 0,
+    Binary = 1,
+}
+
+impl CertificateFormat {
+    pub fn name(self) -> &'static str {
+        match self {
+            CertificateFormat::Json => "json",
+            CertificateFormat::Binary => "binary",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Self> {
+        match name {
+            "json" => Some(CertificateFormat::Json),
+            "binary" => Some(CertificateFormat::Binary),
+            _ => None,
+        }
+    }
+
+    fn file_name(self) -> &'static str {
+        match self {
+            CertificateFormat::Json => "certificate.json",
+            CertificateFormat::Binary => "certificate.bin",
+        }
+    }
+
+    fn other(self) -> Self {
+        match self {
+            CertificateFormat::Json => CertificateFormat::Binary,
+            CertificateFormat::Binary => CertificateFormat::Json,
+        }
+    }
+}
+
+/// The format new certificates are written in (`--certificate-format`), binary by default
+static CERTIFICATE_FORMAT: AtomicU8 = AtomicU8::new(CertificateFormat::Binary as u8);
+
+/// Whether the analysis verifies its certificate as read back from disk
+/// (`--certificate-reload`) rather than the decision it holds in memory
+static CERTIFICATE_RELOAD: AtomicBool = AtomicBool::new(false);
+
+pub fn set_certificate_format(format: CertificateFormat) {
+    CERTIFICATE_FORMAT.store(format as u8, Ordering::SeqCst);
+}
+
+pub fn certificate_format() -> CertificateFormat {
+    match CERTIFICATE_FORMAT.load(Ordering::SeqCst) {
+        0 => CertificateFormat::Json,
+        _ => CertificateFormat::Binary,
+    }
+}
+
+pub fn set_certificate_reload(on: bool) {
+    CERTIFICATE_RELOAD.store(on, Ordering::SeqCst);
+}
+
+pub fn certificate_reload() -> bool {
+    CERTIFICATE_RELOAD.load(Ordering::SeqCst)
+}
+
+pub fn certificate_path(out_dir: &str, format: CertificateFormat) -> String {
+    format!("{}/{}", out_dir, format.file_name())
+}
+
+/// Write `decision` to `out_dir` in `format`, returning the path written.
+///
+/// A certificate of the other format left by an earlier run is removed, so that
+/// `find` never picks up a stale one.
+pub fn save<G, L, Req, Resp>(
+    decision: &NSDecision<G, L, Req, Resp>,
+    out_dir: &str,
+    format: CertificateFormat,
+) -> io::Result<String>
+where
+    G: Eq + Hash + Serialize,
+    L: Eq + Hash + Serialize,
+    Req: Eq + Hash + Serialize,
+    Resp: Eq + Hash + Serialize,
+{
+    let path = certificate_path(out_dir, format);
+    match format {
+        CertificateFormat::Json => decision.save_to_file(&path)?,
+        CertificateFormat::Binary => {
+            let mut out = BufWriter::new(File::create(&path)?);
+            write_binary(decision, &mut out)?;
+            out.flush()?;
+        }
+    }
+
+    let stale = certificate_path(out_dir, format.other());
+    match std::fs::remove_file(&stale) {
+        Err(err) if err.kind() != io::ErrorKind::NotFound => return Err(err),
+        _ => {}
+    }
+    Ok(path)
+}
+
+/// The certificate in `out_dir` and its format, if there is one
+pub fn find(out_dir: &str) -> Option<(String, CertificateFormat)> {
+    let preferred = certificate_format();
+    [preferred, preferred.other()]
+        .into_iter()
+        .map(|format| (certificate_path(out_dir, format), format))
+        .find(|(path, _)| Path::new(path).exists())
+}
+
+pub fn load<G, L, Req, Resp>(
+    path: &str,
+    format: CertificateFormat,
+) -> Result<NSDecision<G, L, Req, Resp>, Box<dyn std::error::Error>>
+where
+    G: Clone + Eq + Hash + DeserializeOwned,
+    L: Clone + Eq + Hash + DeserializeOwned,
+    Req: Clone + Eq + Hash + DeserializeOwned,
+    Resp: Clone + Eq + Hash + DeserializeOwned,
+{
+    match format {
+        CertificateFormat::Json => NSDecision::load_from_file(path),
+        CertificateFormat::Binary => Ok(read_binary(BufReader::new(File::open(path)?))?),
+    }
+}
+
+/// Assigns indices to values in order of first appearance
+struct Interner<'a, T> {
+    ids: HashMap<&'a T, u64>,
+    values: Vec<&'a T>,
+}
+
+impl<'a, T: Eq + Hash> Interner<'a, T> {
+    fn new() -> Self {
+        Interner {
+            ids: HashMap::default(),
+            values: Vec::new(),
+        }
+    }
+
+    fn intern(&mut self, value: &'a T) -> u64 {
+        if let Some(&id) = self.ids.get(value) {
+            return id;
+        }
+        let id = self.values.len() as u64;
+        self.ids.insert(value, id);
+        self.values.push(value);
+        id
+    }
+}
+
+fn put_u8(out: &mut Vec<u8>, byte: u8) {
+    out.push(byte);
+}
+
+fn put_varint(out: &mut Vec<u8>, mut value: u64) {
+    while value >= 0x80 {
+        out.push((value as u8) | 0x80);
+        value >>= 7;
+    }
+    out.push(value as u8);
+}
+
+fn put_signed(out: &mut Vec<u8>, value: i64) {
+    put_varint(out, ((value << 1) ^ (value >> 63)) as u64);
+}
+
+fn put_bytes(out: &mut Vec<u8>, bytes: &[u8]) {
+    put_varint(out, bytes.len() as u64);
+    out.extend_from_slice(bytes);
+}
+
+struct Encoder<'a, G, L, Req, Resp> {
+    globals: Interner<'a, G>,
+    locals: Interner<'a, L>,
+    requests: Interner<'a, Req>,
+    responses: Interner<'a, Resp>,
+    variables: Interner<'a, RequestStatePair<Req, L, Resp>>,
+}
+
+impl<'a, G, L, Req, Resp> Encoder<'a, G, L, Req, Resp>
+where
+    G: Eq + Hash + Serialize,
+    L: Eq + Hash + Serialize,
+    Req: Eq + Hash + Serialize,
+    Resp: Eq + Hash + Serialize,
+{
+    fn decision(&mut self, out: &mut Vec<u8>, decision: &'a NSDecision<G, L, Req, Resp>) {
+        match decision {
+            NSDecision::Serializable { invariant } => {
+                put_u8(out, 0);
+                put_varint(out, invariant.global_invariants.len() as u64);
+                for (global, proof) in &invariant.global_invariants {
+                    put_varint(out, self.globals.intern(global));
+                    put_varint(out, proof.variables.len() as u64);
+                    for variable in &proof.variables {
+                        put_varint(out, self.variables.intern(variable));
+                    }
+                    self.formula(out, &proof.formula);
+                }
+            }
+            NSDecision::NotSerializable { trace } => {
+                put_u8(out, 1);
+                put_varint(out, trace.steps.len() as u64);
+                for step in &trace.steps {
+                    self.step(out, step);
+                }
+            }
+            NSDecision::Timeout { message } => {
+                put_u8(out, 2);
+                put_bytes(out, message.as_bytes());
+            }
+        }
+    }
+
+    fn step(&mut self, out: &mut Vec<u8>, step: &'a NSStep<G, L, Req, Resp>) {
+        match step {
+            NSStep::RequestStart {
+                request,
+                initial_local,
+            } => {
+                put_u8(out, 0);
+                put_varint(out, self.requests.intern(request));
+                put_varint(out, self.locals.intern(initial_local));
+            }
+            NSStep::InternalStep {
+                request,
+                from_local,
+                from_global,
+                to_local,
+                to_global,
+            } => {
+                put_u8(out, 1);
+                put_varint(out, self.requests.intern(request));
+                put_varint(out, self.locals.intern(from_local));
+                put_varint(out, self.globals.intern(from_global));
+                put_varint(out, self.locals.intern(to_local));
+                put_varint(out, self.globals.intern(to_global));
+            }
+            NSStep::RequestComplete {
+                request,
+                final_local,
+                response,
+            } => {
+                put_u8(out, 2);
+                put_varint(out, self.requests.intern(request));
+                put_varint(out, self.locals.intern(final_local));
+                put_varint(out, self.responses.intern(response));
+            }
+        }
+    }
+
+    fn formula(&mut self, out: &mut Vec<u8>, formula: &'a Formula<RequestStatePair<Req, L, Resp>>) {
+        match formula {
+            Formula::Constraint(constraint) => {
+                put_u8(out, 0);
+                put_u8(
+                    out,
+                    match constraint.op {
+                        CompOp::Eq => 0,
+                        CompOp::Geq => 1,
+                    },
+                );
+                put_signed(out, constraint.expr.get_constant());
+                put_varint(out, constraint.expr.terms().count() as u64);
+                for (variable, coeff) in constraint.expr.terms() {
+                    match variable {
+                        Variable::Var(variable) => {
+                            put_u8(out, 0);
+                            put_varint(out, self.variables.intern(variable));
+                        }
+                        Variable::Existential(index) => {
+                            put_u8(out, 1);
+                            put_varint(out, *index as u64);
+                        }
+                    }
+                    put_signed(out, coeff);
+                }
+            }
+            Formula::And(formulas) | Formula::Or(formulas) => {
+                put_u8(
+                    out,
+                    if matches!(formula, Formula::And(_)) {
+                        1
+                    } else {
+                        2
+                    },
+                );
+                put_varint(out, formulas.len() as u64);
+                for formula in formulas {
+                    self.formula(out, formula);
+                }
+            }
+            Formula::Exists(index, body) | Formula::Forall(index, body) => {
+                put_u8(
+                    out,
+                    if matches!(formula, Formula::Exists(..)) {
+                        3
+                    } else {
+                        4
+                    },
+                );
+                put_varint(out, *index as u64);
+                self.formula(out, body);
+            }
+        }
+    }
+
+    /// The variable table, interning the states the variables mention
+    fn variable_table(&mut self, out: &mut Vec<u8>) {
+        put_varint(out, self.variables.values.len() as u64);
+        for i in 0..self.variables.values.len() {
+            let variable: &'a RequestStatePair<Req, L, Resp> = self.variables.values[i];
+            let RequestStatePair(request, state) = variable;
+            put_varint(out, self.requests.intern(request));
+            match state {
+                RequestState::InFlight(local) => {
+                    put_u8(out, 0);
+                    put_varint(out, self.locals.intern(local));
+                }
+                RequestState::Completed(response) => {
+                    put_u8(out, 1);
+                    put_varint(out, self.responses.intern(response));
+                }
+            }
+        }
+    }
+}
+
+fn put_table<T: Serialize>(out: &mut Vec<u8>, table: &Interner<'_, T>) -> io::Result<()> {
+    put_varint(out, table.values.len() as u64);
+    for value in &table.values {
+        put_bytes(out, &serde_json::to_vec(value).map_err(io::Error::other)?);
+    }
+    Ok(())
+}
+
+/// Write `decision` in the binary certificate format
+pub fn write_binary<G, L, Req, Resp, W: Write>(
+    decision: &NSDecision<G, L, Req, Resp>,
+    out: &mut W,
+) -> io::Result<()>
+where
+    G: Eq + Hash + Serialize,
+    L: Eq + Hash + Serialize,
+    Req: Eq + Hash + Serialize,
+    Resp: Eq + Hash + Serialize,
+{
+    let mut encoder = Encoder {
+        globals: Interner::new(),
+        locals: Interner::new(),
+        requests: Interner::new(),
+        responses: Interner::new(),
+        variables: Interner::new(),
+    };
+    // The body and variables are encoded first, as that fills the tables written before them
+    let mut body = Vec::new();
+    encoder.decision(&mut body, decision);
+    let mut variables = Vec::new();
+    encoder.variable_table(&mut variables);
+
+    let mut tables = Vec::new();
+    put_table(&mut tables, &encoder.globals)?;
+    put_table(&mut tables, &encoder.locals)?;
+    put_table(&mut tables, &encoder.requests)?;
+    put_table(&mut tables, &encoder.responses)?;
+
+    out.write_all(MAGIC)?;
+    out.write_all(&[FORMAT_VERSION])?;
+    out.write_all(&tables)?;
+    out.write_all(&variables)?;
+    out.write_all(&body)
+}
+
+fn invalid(message: impl Into<String>) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message.into())
+}
+
+struct Decoder<R> {
+    input: R,
+}
+
+impl<R: Read> Decoder<R> {
+    fn u8(&mut self) -> io::Result<u8> {
+        let mut byte = [0];
+        self.input.read_exact(&mut byte)?;
+        Ok(byte[0])
+    }
+
+    fn varint(&mut self) -> io::Result<u64> {
+        let mut value = 0u64;
+        for shift in (0..64).step_by(7) {
+            let byte = self.u8()?;
+            value |= u64::from(byte & 0x7f) << shift;
+            if byte & 0x80 == 0 {
+                return Ok(value);
+            }
+        }
+        Err(invalid("varint too long"))
+    }
+
+    fn signed(&mut self) -> io::Result<i64> {
+        let value = self.varint()?;
+        Ok(((value >> 1) as i64) ^ -((value & 1) as i64))
+    }
+
+    fn len(&mut self) -> io::Result<usize> {
+        usize::try_from(self.varint()?).map_err(|_| invalid("length out of range"))
+    }
+
+    fn bytes(&mut self) -> io::Result<Vec<u8>> {
+        let len = self.len()?;
+        let mut bytes = Vec::new();
+        // `take` keeps a corrupt length from allocating more than the file holds
+        (&mut self.input).take(len as u64).read_to_end(&mut bytes)?;
+        if bytes.len() != len {
+            return Err(io::ErrorKind::UnexpectedEof.into());
+        }
+        Ok(bytes)
+    }
+
+    fn table<T: DeserializeOwned>(&mut self) -> io::Result<Vec<T>> {
+        let count = self.len()?;
+        let mut table = Vec::new();
+        for _ in 0..count {
+            table.push(serde_json::from_slice(&self.bytes()?).map_err(io::Error::other)?);
+        }
+        Ok(table)
+    }
+
+    fn index<'t, T>(&mut self, table: &'t [T], what: &str) -> io::Result<&'t T> {
+        let index = self.len()?;
+        table
+            .get(index)
+            .ok_or_else(|| invalid(format!("{} index {} out of range", what, index)))
+    }
+}
+
+struct Tables<G, L, Req, Resp> {
+    globals: Vec<G>,
+    locals: Vec<L>,
+    requests: Vec<Req>,
+    responses: Vec<Resp>,
+    variables: Vec<RequestStatePair<Req, L, Resp>>,
+}
+
+impl<G, L, Req, Resp> Tables<G, L, Req, Resp>
+where
+    G: Clone + Eq + Hash + DeserializeOwned,
+    L: Clone + Eq + Hash + DeserializeOwned,
+    Req: Clone + Eq + Hash + DeserializeOwned,
+    Resp: Clone + Eq + Hash + DeserializeOwned,
+{
+    fn read<R: Read>(decoder: &mut Decoder<R>) -> io::Result<Self> {
+        let globals = decoder.table()?;
+        let locals: Vec<L> = decoder.table()?;
+        let requests: Vec<Req> = decoder.table()?;
+        let responses: Vec<Resp> = decoder.table()?;
+
+        let count = decoder.len()?;
+        let mut variables = Vec::new();
+        for _ in 0..count {
+            let request = decoder.index(&requests, "request")?.clone();
+            let state = match decoder.u8()? {
+                0 => RequestState::InFlight(decoder.index(&locals, "local state")?.clone()),
+                1 => RequestState::Completed(decoder.index(&responses, "response")?.clone()),
+                tag => return Err(invalid(format!("bad request state tag {}", tag))),
+            };
+            variables.push(RequestStatePair(request, state));
+        }
+
+        Ok(Tables {
+            globals,
+            locals,
+            requests,
+            responses,
+            variables,
+        })
+    }
+
+    fn decision<R: Read>(
+        &self,
+        decoder: &mut Decoder<R>,
+    ) -> io::Result<NSDecision<G, L, Req, Resp>> {
+        match decoder.u8()? {
+            0 => {
+                let count = decoder.len()?;
+                let mut global_invariants = HashMap::default();
+                for _ in 0..count {
+                    let global = decoder.index(&self.globals, "global state")?.clone();
+                    let num_variables = decoder.len()?;
+                    let mut variables = Vec::new();
+                    for _ in 0..num_variables {
+                        variables.push(decoder.index(&self.variables, "variable")?.clone());
+                    }
+                    let formula = self.formula(decoder)?;
+                    global_invariants.insert(global, ProofInvariant { variables, formula });
+                }
+                Ok(NSDecision::Serializable {
+                    invariant: NSInvariant { global_invariants },
+                })
+            }
+            1 => {
+                let count = decoder.len()?;
+                let mut steps = Vec::new();
+                for _ in 0..count {
+                    steps.push(self.step(decoder)?);
+                }
+                Ok(NSDecision::NotSerializable {
+                    trace: NSTrace { steps },
+                })
+            }
+            2 => {
+                let message = String::from_utf8(decoder.bytes()?).map_err(io::Error::other)?;
+                Ok(NSDecision::Timeout { message })
+            }
+            tag => Err(invalid(format!("bad decision tag {}", tag))),
+        }
+    }
+
+    fn step<R: Read>(&self, decoder: &mut Decoder<R>) -> io::Result<NSStep<G, L, Req, Resp>> {
+        match decoder.u8()? {
+            0 => Ok(NSStep::RequestStart {
+                request: decoder.index(&self.requests, "request")?.clone(),
+                initial_local: decoder.index(&self.locals, "local state")?.clone(),
+            }),
+            1 => Ok(NSStep::InternalStep {
+                request: decoder.index(&self.requests, "request")?.clone(),
+                from_local: decoder.index(&self.locals, "local state")?.clone(),
+                from_global: decoder.index(&self.globals, "global state")?.clone(),
+                to_local: decoder.index(&self.locals, "local state")?.clone(),
+                to_global: decoder.index(&self.globals, "global state")?.clone(),
+            }),
+            2 => Ok(NSStep::RequestComplete {
+                request: decoder.index(&self.requests, "request")?.clone(),
+                final_local: decoder.index(&self.locals, "local state")?.clone(),
+                response: decoder.index(&self.responses, "response")?.clone(),
+            }),
+            tag => Err(invalid(format!("bad step tag {}", tag))),
+        }
+    }
+
+    fn formula<R: Read>(
+        &self,
+        decoder: &mut Decoder<R>,
+    ) -> io::Result<Formula<RequestStatePair<Req, L, Resp>>> {
+        match decoder.u8()? {
+            0 => {
+                let op = match decoder.u8()? {
+                    0 => CompOp::Eq,
+                    1 => CompOp::Geq,
+                    op => return Err(invalid(format!("bad comparison {}", op))),
+                };
+                let constant = decoder.signed()?;
+                let count = decoder.len()?;
+                let mut terms = Vec::new();
+                for _ in 0..count {
+                    let variable = match decoder.u8()? {
+                        0 => Variable::Var(decoder.index(&self.variables, "variable")?.clone()),
+                        1 => Variable::Existential(decoder.len()?),
+                        tag => return Err(invalid(format!("bad term tag {}", tag))),
+                    };
+                    terms.push((variable, decoder.signed()?));
+                }
+                Ok(Formula::Constraint(Constraint {
+                    expr: AffineExpr::from_terms(terms, constant),
+                    op,
+                }))
+            }
+            tag @ (1 | 2) => {
+                let count = decoder.len()?;
+                let mut formulas = Vec::new();
+                for _ in 0..count {
+                    formulas.push(self.formula(decoder)?);
+                }
+                Ok(if tag == 1 {
+                    Formula::And(formulas)
+                } else {
+                    Formula::Or(formulas)
+                })
+            }
+            tag @ (3 | 4) => {
+                let index = decoder.len()?;
+                let body = Box::new(self.formula(decoder)?);
+                Ok(if tag == 3 {
+                    Formula::Exists(index, body)
+                } else {
+                    Formula::Forall(index, body)
+                })
+            }
+            tag => Err(invalid(format!("bad formula tag {}", tag))),
+        }
+    }
+}
+
+/// Read a decision written by `write_binary`
+pub fn read_binary<G, L, Req, Resp, R: Read>(input: R) -> io::Result<NSDecision<G, L, Req, Resp>>
+where
+    G: Clone + Eq + Hash + DeserializeOwned,
+    L: Clone + Eq + Hash + DeserializeOwned,
+    Req: Clone + Eq + Hash + DeserializeOwned,
+    Resp: Clone + Eq + Hash + DeserializeOwned,
+{
+    let mut decoder = Decoder { input };
+    let mut magic = [0; MAGIC.len()];
+    decoder.input.read_exact(&mut magic)?;
+    if &magic != MAGIC {
+        return Err(invalid("not a binary certificate"));
+    }
+    let version = decoder.u8()?;
+    if version != FORMAT_VERSION {
+        return Err(invalid(format!(
+            "unsupported certificate version {} (expected {})",
+            version, FORMAT_VERSION
+        )));
+    }
+
+    let tables = Tables::read(&mut decoder)?;
+    tables.decision(&mut decoder)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    type Decision = NSDecision<String, String, String, String>;
+
+    fn var(request: &str, local: &str) -> RequestStatePair<String, String, String> {
+        RequestStatePair(
+            request.to_string(),
+            RequestState::InFlight(local.to_string()),
+        )
+    }
+
+    fn round_trip(decision: &Decision) -> Decision {
+        let mut bytes = Vec::new();
+        write_binary(decision, &mut bytes).unwrap();
+        read_binary(bytes.as_slice()).unwrap()
+    }
+
+    #[test]
+    fn test_binary_round_trip_invariant() {
+        // a@L1 - 2 a/done >= -3 and, under an existential, E0 = a@L1
+        let a = var("a", "L1");
+        let done = RequestStatePair("a".to_string(), RequestState::Completed("done".to_string()));
+        let expr = AffineExpr::from_var(a.clone())
+            .sub(&AffineExpr::from_var(done.clone()).mul_by_const(2))
+            .add(&AffineExpr::from_const(3));
+        let bound = AffineExpr::from_terms(
+            vec![
+                (Variable::Existential(0), 1),
+                (Variable::Var(a.clone()), -1),
+            ],
+            0,
+        );
+        let formula = Formula::Or(vec![
+            Formula::Constraint(Constraint::new(expr, CompOp::Geq)),
+            Formula::Exists(
+                0,
+                Box::new(Formula::And(vec![Formula::Constraint(Constraint::new(
+                    bound,
+                    CompOp::Eq,
+                ))])),
+            ),
+        ]);
+        let mut global_invariants = HashMap::default();
+        global_invariants.insert(
+            "G0".to_string(),
+            ProofInvariant {
+                variables: vec![a.clone(), done],
+                formula: formula.clone(),
+            },
+        );
+        global_invariants.insert(
+            "G1".to_string(),
+            ProofInvariant {
+                variables: vec![a],
+                formula: Formula::And(vec![]),
+            },
+        );
+        let decision = Decision::Serializable {
+            invariant: NSInvariant {
+                global_invariants: global_invariants.clone(),
+            },
+        };
+
+        let Decision::Serializable { invariant } = round_trip(&decision) else {
+            panic!("Expected a serializable decision");
+        };
+        assert_eq!(invariant.global_invariants.len(), 2);
+        for (global, proof) in &global_invariants {
+            assert_eq!(invariant.global_invariants.get(global), Some(proof));
+        }
+    }
+
+    #[test]
+    fn test_binary_round_trip_trace_and_timeout() {
+        let steps = vec![
+            NSStep::RequestStart {
+                request: "a".to_string(),
+                initial_local: "L0".to_string(),
+            },
+            NSStep::InternalStep {
+                request: "a".to_string(),
+                from_local: "L0".to_string(),
+                from_global: "G0".to_string(),
+                to_local: "L1".to_string(),
+                to_global: "G1".to_string(),
+            },
+            NSStep::RequestComplete {
+                request: "a".to_string(),
+                final_local: "L1".to_string(),
+                response: "-1".to_string(),
+            },
+        ];
+        let decision = Decision::NotSerializable {
+            trace: NSTrace { steps },
+        };
+        assert_eq!(
+            serde_json::to_string(&round_trip(&decision)).unwrap(),
+            serde_json::to_string(&decision).unwrap()
+        );
+
+        let decision = Decision::Timeout {
+            message: "ISL operation budget exhausted".to_string(),
+        };
+        assert_eq!(
+            serde_json::to_string(&round_trip(&decision)).unwrap(),
+            serde_json::to_string(&decision).unwrap()
+        );
+    }
+
+    #[test]
+    fn test_binary_rejects_other_files() {
+        let json = br#"{"Timeout":{"message":"x"}}"#;
+        assert!(read_binary::<String, String, String, String, _>(&json[..]).is_err());
+
+        let mut bytes = Vec::new();
+        write_binary(
+            &Decision::Timeout {
+                message: "x".to_string(),
+            },
+            &mut bytes,
+        )
+        .unwrap();
+        bytes.truncate(bytes.len() - 1);
+        assert!(read_binary::<String, String, String, String, _>(bytes.as_slice()).is_err());
+    }
+
+    #[test]
+    fn test_save_replaces_certificate_of_other_format() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let out_dir = temp_dir.path().to_str().unwrap();
+        let decision = Decision::Timeout {
+            message: "x".to_string(),
+        };
+
+        save(&decision, out_dir, CertificateFormat::Json).unwrap();
+        let path = save(&decision, out_dir, CertificateFormat::Binary).unwrap();
+        assert_eq!(path, certificate_path(out_dir, CertificateFormat::Binary));
+        assert!(!Path::new(&certificate_path(out_dir, CertificateFormat::Json)).exists());
+
+        let (found, format) = find(out_dir).unwrap();
+        assert_eq!(
+            (found.as_str(), format),
+            (path.as_str(), CertificateFormat::Binary)
+        );
+        let loaded: Decision = load(&found, format).unwrap();
+        assert!(matches!(loaded, Decision::Timeout { message } if message == "x"));
+    }
+}
@@ -3,8 +3,76 @@
 use crate::presburger::Constraint;
 use crate::size_logger::{SemilinearStats, log_semilinear_size_csv};
 use std::fmt::{Debug, Display};
+use std::fs::File;
 use std::hash::Hash;
+use std::io::{BufWriter, Seek, SeekFrom, Write};
 use std::path::Path;
+use std::sync::atomic::{AtomicBool, AtomicU8, Ordering};
+
+/// How much of the analysis is recorded in the debug report
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+pub enum LogLevel {
+    /// Nothing is recorded, and no step details are formatted
+    Off = 0,
+    /// Algorithm steps, disjuncts and SMPT calls
+    Info = 1,
+    /// Additionally the full Petri nets, constraints and sets
+    Debug = 2,
+}
+
+impl LogLevel {
+    pub fn name(self) -> &'static str {
+        match self {
+            LogLevel::Off => "off",
+            LogLevel::Info => "info",
+            LogLevel::Debug => "debug",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Self> {
+        match name {
+            "off" => Some(LogLevel::Off),
+            "info" => Some(LogLevel::Info),
+            "debug" => Some(LogLevel::Debug),
+            _ => None,
+        }
+    }
+
+    fn from_u8(level: u8) -> Self {
+        match level {
+            0 => LogLevel::Off,
+            1 => LogLevel::Info,
+            _ => LogLevel::Debug,
+        }
+    }
+}
+
+/// The debug report level (`--log-level`), off by default
+static LOG_LEVEL: AtomicU8 = AtomicU8::new(LogLevel::Off as u8);
+
+/// Whether the debug report is written while the analysis runs (`--log-stream`)
+static LOG_STREAM: AtomicBool = AtomicBool::new(false);
+
+pub fn set_log_level(level: LogLevel) {
+    LOG_LEVEL.store(level as u8, Ordering::SeqCst);
+}
+
+pub fn log_level() -> LogLevel {
+    LogLevel::from_u8(LOG_LEVEL.load(Ordering::Relaxed))
+}
+
+/// Whether records at `level` end up in the report
+pub fn log_enabled(level: LogLevel) -> bool {
+    level != LogLevel::Off && level <= log_level()
+}
+
+pub fn set_log_stream(on: bool) {
+    LOG_STREAM.store(on, Ordering::SeqCst);
+}
+
+pub fn log_stream() -> bool {
+    LOG_STREAM.load(Ordering::SeqCst)
+}
 
 #[derive(Debug, Clone)]
 pub struct SmptCall {
@@ -32,6 +100,59 @@ pub struct DebugReport {
     pub smpt_calls: Vec<SmptCall>,
     pub final_result: String,
     pub total_execution_time_ms: u64,
+    /// Open report file when streaming; steps and calls are written to it as they arrive
+    /// instead of being kept in `algorithm_steps` and `smpt_calls`
+    stream: Option<ReportStream>,
+}
+
+#[derive(Debug)]
+struct ReportStream {
+    path: String,
+    writer: BufWriter<File>,
+    steps_written: usize,
+    /// Rendered SMPT calls, in a temporary file until `generate_html` splices them in
+    calls: BufWriter<File>,
+    calls_written: usize,
+    /// The first failed write, returned by `generate_html`
+    error: Option<std::io::Error>,
+}
+
+impl ReportStream {
+    fn record(&mut self, result: std::io::Result<()>) {
+        if let Err(e) = result {
+            self.error.get_or_insert(e);
+        }
+    }
+
+    /// Write the SMPT calls and the summary, and flush the report
+    fn finish(mut self, summary: &str) -> std::io::Result<()> {
+        if let Some(e) = self.error {
+            return Err(e);
+        }
+        write!(
+            self.writer,
+            r#"        </div>
+
+        <div class="section">
+            <h2>🤖 SMPT Verification Calls</h2>
+            "#
+        )?;
+        let mut calls = self.calls.into_inner().map_err(|e| e.into_error())?;
+        calls.seek(SeekFrom::Start(0))?;
+        std::io::copy(&mut calls, &mut self.writer)?;
+        write!(
+            self.writer,
+            r#"
+        </div>
+
+{}
+    </div>
+</body>
+</html>"#,
+            summary
+        )?;
+        self.writer.flush()
+    }
 }
 
 impl DebugReport {
@@ -43,12 +164,55 @@ impl DebugReport {
             smpt_calls: Vec::new(),
             final_result: String::new(),
             total_execution_time_ms: 0,
+            stream: None,
         }
     }
 
+    /// Create a report that writes its steps to `output_path` as they are added.
+    ///
+    /// The rendered SMPT calls belong to a later section of the page, so they go to a
+    /// temporary file until `generate_html`. The summary goes last and the timeline is
+    /// left out.
+    pub fn streaming(
+        program_name: String,
+        program_content: String,
+        output_path: &str,
+    ) -> Result<Self, std::io::Error> {
+        let mut report = Self::new(program_name, program_content);
+        let mut writer = BufWriter::new(File::create(output_path)?);
+        write!(
+            writer,
+            r#"{}
+<body>
+    <div class="container">
+        <h1>🔍 Serializability Analysis Debug Report</h1>
+
+        <div class="section">
+            <h2>📄 Program Source</h2>
+            <div class="code-block">{}</div>
+        </div>
+
+        <div class="section">
+            <h2>🔄 Algorithm Execution Steps</h2>
+"#,
+            report.render_head(),
+            html_escape(&report.program_content)
+        )?;
+        report.program_content = String::new();
+        report.stream = Some(ReportStream {
+            path: output_path.to_string(),
+            writer,
+            steps_written: 0,
+            calls: BufWriter::new(tempfile::tempfile()?),
+            calls_written: 0,
+            error: None,
+        });
+        Ok(report)
+    }
+
     pub fn add_step(&mut self, step_name: String, description: String, details: String) {
         let timestamp = chrono::Local::now().format("%H:%M:%S%.3f").to_string();
-        self.algorithm_steps.push(AlgorithmStep {
+        self.push_step(AlgorithmStep {
             step_name,
             description,
             details,
@@ -56,8 +220,29 @@ impl DebugReport {
         });
     }
 
+    fn push_step(&mut self, step: AlgorithmStep) {
+        match &mut self.stream {
+            Some(stream) => {
+                stream.steps_written += 1;
+                let rendered = render_step(stream.steps_written, &step);
+                let result = writeln!(stream.writer, "{}", rendered);
+                stream.record(result);
+            }
+            None => self.algorithm_steps.push(step),
+        }
+    }
+
     pub fn add_smpt_call(&mut self, call: SmptCall) {
-        self.smpt_calls.push(call);
+        match &mut self.stream {
+            Some(stream) => {
+                stream.calls_written += 1;
+                let rendered = render_smpt_call(stream.calls_written, &call);
+                let separator = if stream.calls_written > 1 { "\n" } else { "" };
+                let result = write!(stream.calls, "{}{}", separator, rendered);
+                stream.record(result);
+            }
+            None => self.smpt_calls.push(call),
+        }
     }
 
     pub fn set_final_result(&mut self, result: String, total_time_ms: u64) {
@@ -65,7 +250,16 @@ impl DebugReport {
         self.total_execution_time_ms = total_time_ms;
     }
 
-    pub fn generate_html(&self, output_path: &str) -> Result<(), std::io::Error> {
+    /// Write the report to `output_path`; a streaming report completes its own file
+    /// instead and can only be generated once
+    pub fn generate_html(&mut self, output_path: &str) -> Result<(), std::io::Error> {
+        if let Some(stream) = self.stream.take() {
+            let summary = self.render_summary(stream.steps_written, stream.calls_written);
+            let path = stream.path.clone();
+            stream.finish(&summary)?;
+            println!("Debug report generated: {}", path);
+            return Ok(());
+        }
         let html = self.render_html();
         std::fs::write(output_path, html)?;
         println!("Debug report generated: {}", output_path);
@@ -73,6 +267,49 @@ impl DebugReport {
     }
 
     fn render_html(&self) -> String {
+        format!(
+            r#"{}
+<body>
+    <div class="container">
+        <h1>🔍 Serializability Analysis Debug Report</h1>
+        
+{}
+
+        <div class="section">
+            <h2>📄 Program Source</h2>
+            <div class="code-block">{}</div>
+        </div>
+
+        <div class="section">
+            <h2>🔄 Algorithm Execution Steps</h2>
+            {}
+        </div>
+
+        <div class="section">
+            <h2>🤖 SMPT Verification Calls</h2>
+            {}
+        </div>
+
+        <div class="section">
+            <h2>📈 Analysis Timeline</h2>
+            <table>
+                <tr><th>Time</th><th>Event</th><th>Description</th></tr>
+                {}
+            </table>
+        </div>
+    </div>
+</body>
+</html>"#,
+            self.render_head(),
+            self.render_summary(self.algorithm_steps.len(), self.smpt_calls.len()),
+            html_escape(&self.program_content),
+            self.render_algorithm_steps(),
+            self.render_smpt_calls(),
+            self.render_timeline()
+        )
+    }
+
+    fn render_head(&self) -> String {
         format!(
             r#"<!DOCTYPE html>
 <html>
@@ -117,12 +354,14 @@ impl DebugReport {
             }}
         }}
     </script>
-</head>
-<body>
-    <div class="container">
-        <h1>🔍 Serializability Analysis Debug Report</h1>
-        
-        <div class="summary">
+</head>"#,
+            self.program_name
+        )
+    }
+
+    fn render_summary(&self, steps: usize, smpt_calls: usize) -> String {
+        format!(
+            r#"        <div class="summary">
             <h2>📋 Analysis Summary</h2>
             <p><strong>Program:</strong> {}</p>
             <p><strong>Final Result:</strong> <span class="{}">{}</span></p>
@@ -148,34 +387,7 @@ impl DebugReport {
                 <h3>📊 Steps</h3>
                 <p>{}</p>
             </div>
-        </div>
-
-        <div class="section">
-            <h2>📄 Program Source</h2>
-            <div class="code-block">{}</div>
-        </div>
-
-        <div class="section">
-            <h2>🔄 Algorithm Execution Steps</h2>
-            {}
-        </div>
-
-        <div class="section">
-            <h2>🤖 SMPT Verification Calls</h2>
-            {}
-        </div>
-
-        <div class="section">
-            <h2>📈 Analysis Timeline</h2>
-            <table>
-                <tr><th>Time</th><th>Event</th><th>Description</th></tr>
-                {}
-            </table>
-        </div>
-    </div>
-</body>
-</html>"#,
-            self.program_name,
+        </div>"#,
             self.program_name,
             if self.final_result.contains("serializable") && !self.final_result.contains("Not") {
                 "result-success"
@@ -184,16 +396,12 @@ impl DebugReport {
             },
             self.final_result,
             self.total_execution_time_ms,
-            self.smpt_calls.len(),
-            self.algorithm_steps.len(),
+            smpt_calls,
+            steps,
             self.program_name,
             self.total_execution_time_ms,
-            self.smpt_calls.len(),
-            self.algorithm_steps.len(),
-            html_escape(&self.program_content),
-            self.render_algorithm_steps(),
-            self.render_smpt_calls(),
-            self.render_timeline()
+            smpt_calls,
+            steps
         )
     }
 
@@ -201,20 +409,7 @@ impl DebugReport {
         self.algorithm_steps
             .iter()
             .enumerate()
-            .map(|(i, step)| {
-                format!(
-                    r#"<div class="step">
-                        <h3>Step {}: {} <span class="timestamp">[{}]</span></h3>
-                        <p><strong>Description:</strong> {}</p>
-                        <div class="code-block">{}</div>
-                    </div>"#,
-                    i + 1,
-                    html_escape(&step.step_name),
-                    step.timestamp,
-                    html_escape(&step.description),
-                    html_escape(&step.details)
-                )
-            })
+            .map(|(i, step)| render_step(i + 1, step))
             .collect::<Vec<_>>()
             .join("\n")
     }
@@ -223,39 +418,7 @@ impl DebugReport {
         self.smpt_calls
             .iter()
             .enumerate()
-            .map(|(i, call)| {
-                let result_class = match call.result.as_str() {
-                    "REACHABLE" => "result-reachable",
-                    "UNREACHABLE" => "result-success",
-                    _ => "result-failure",
-                };
-
-                let time_info = call
-                    .execution_time_ms
-                    .map(|t| format!(" <span class=\"execution-time\">({} ms)</span>", t))
-                    .unwrap_or_default();
-
-                format!(
-                    r#"<div class="smpt-call">
-                        <h3>🤖 SMPT Call #{} - Disjunct {} <span class="{}">{}</span>{}</h3>
-                        <p><strong>Constraints:</strong> {}</p>
-                        
-                        <h4>📋 Petri Net:</h4>
-                        <div class="code-block petri-content">{}</div>
-                        
-                        <h4>🔧 XML Constraints:</h4>
-                        <div class="code-block xml-content">{}</div>
-                    </div>"#,
-                    i + 1,
-                    call.disjunct_id,
-                    result_class,
-                    call.result,
-                    time_info,
-                    html_escape(&call.constraints_description),
-                    html_escape(&call.petri_net_content),
-                    html_escape(&call.xml_content)
-                )
-            })
+            .map(|(i, call)| render_smpt_call(i + 1, call))
             .collect::<Vec<_>>()
             .join("\n")
     }
@@ -286,6 +449,55 @@ impl DebugReport {
     }
 }
 
+fn render_step(number: usize, step: &AlgorithmStep) -> String {
+    format!(
+        r#"<div class="step">
+                        <h3>Step {}: {} <span class="timestamp">[{}]</span></h3>
+                        <p><strong>Description:</strong> {}</p>
+                        <div class="code-block">{}</div>
+                    </div>"#,
+        number,
+        html_escape(&step.step_name),
+        step.timestamp,
+        html_escape(&step.description),
+        html_escape(&step.details)
+    )
+}
+
+fn render_smpt_call(number: usize, call: &SmptCall) -> String {
+    let result_class = match call.result.as_str() {
+        "REACHABLE" => "result-reachable",
+        "UNREACHABLE" => "result-success",
+        _ => "result-failure",
+    };
+
+    let time_info = call
+        .execution_time_ms
+        .map(|t| format!(" <span class=\"execution-time\">({} ms)</span>", t))
+        .unwrap_or_default();
+
+    format!(
+        r#"<div class="smpt-call">
+                        <h3>🤖 SMPT Call #{} - Disjunct {} <span class="{}">{}</span>{}</h3>
+                        <p><strong>Constraints:</strong> {}</p>
+                        
+                        <h4>📋 Petri Net:</h4>
+                        <div class="code-block petri-content">{}</div>
+                        
+                        <h4>🔧 XML Constraints:</h4>
+                        <div class="code-block xml-content">{}</div>
+                    </div>"#,
+        number,
+        call.disjunct_id,
+        result_class,
+        call.result,
+        time_info,
+        html_escape(&call.constraints_description),
+        html_escape(&call.petri_net_content),
+        html_escape(&call.xml_content)
+    )
+}
+
 fn html_escape(s: &str) -> String {
     s.replace('&', "&amp;")
         .replace('<', "&lt;")
@@ -308,22 +520,70 @@ impl DebugLogger {
         }
     }
 
+    /// Create a logger whose report is streamed to `output_path`
+    pub fn streaming(
+        program_name: String,
+        program_content: String,
+        output_path: &str,
+    ) -> Result<Self, std::io::Error> {
+        let report = DebugReport::streaming(program_name, program_content, output_path)?;
+        Ok(Self {
+            report: std::sync::Arc::new(std::sync::Mutex::new(report)),
+        })
+    }
+
     pub fn step(&self, step_name: &str, description: &str, details: &str) {
+        self.step_with(step_name, description, || details.to_string());
+    }
+
+    /// Record a step whose details are only formatted if the log level asks for it
+    pub fn step_with(&self, step_name: &str, description: &str, details: impl FnOnce() -> String) {
+        if !log_enabled(LogLevel::Info) {
+            return;
+        }
+        let details = details();
         if let Ok(mut report) = self.report.lock() {
-            report.add_step(
-                step_name.to_string(),
-                description.to_string(),
-                details.to_string(),
-            );
+            report.add_step(step_name.to_string(), description.to_string(), details);
         }
     }
 
     pub fn smpt_call(&self, call: SmptCall) {
+        self.smpt_call_with(|| call);
+    }
+
+    /// Record an SMPT call that is only built if the log level asks for it
+    pub fn smpt_call_with(&self, call: impl FnOnce() -> SmptCall) {
+        if !log_enabled(LogLevel::Info) {
+            return;
+        }
+        let call = call();
         if let Ok(mut report) = self.report.lock() {
             report.add_smpt_call(call);
         }
     }
 
+    /// Append the steps and SMPT calls recorded by `other` to this logger
+    pub fn absorb(&self, other: &DebugLogger) {
+        if std::sync::Arc::ptr_eq(&self.report, &other.report) {
+            return;
+        }
+        let (steps, calls) = match other.report.lock() {
+            Ok(mut theirs) => (
+                std::mem::take(&mut theirs.algorithm_steps),
+                std::mem::take(&mut theirs.smpt_calls),
+            ),
+            Err(_) => return,
+        };
+        if let Ok(mut report) = self.report.lock() {
+            for step in steps {
+                report.push_step(step);
+            }
+            for call in calls {
+                report.add_smpt_call(call);
+            }
+        }
+    }
+
     pub fn finalize(
         &self,
         result: String,
@@ -345,6 +605,9 @@ impl DebugLogger {
         description: &str,
         petri: &crate::petri::Petri<P>,
     ) {
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
         let places = petri.get_places();
         let transitions = petri.get_transitions();
         let initial_marking = petri.get_initial_marking();
@@ -426,6 +689,9 @@ impl DebugLogger {
         description: &str,
         set: &crate::semilinear::SemilinearSet<T>,
     ) {
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
         let mut details = String::new();
         details.push_str("🔢 SEMILINEAR SET:\n\n");
 
@@ -472,6 +738,22 @@ impl DebugLogger {
         set: &crate::semilinear::SemilinearSet<T>,
         out_dir: &Path,
     ) {
+        // ##### CSV LOGGING START #####
+        let stats = SemilinearStats {
+            program_name,
+            num_components: set.components.len(),
+            periods_per_component: set.components.iter().map(|ls| ls.periods.len()).collect(),
+        };
+        // Write to <out_dir>/semilinear_size_stats.csv
+        let csv_path = out_dir.join("semilinear_size_stats.csv"); // #### UPDATE: build path from out_dir
+        log_semilinear_size_csv(&csv_path, &stats).expect("Failed to write semilinear_size_stats.csv"); // #### UPDATE: write stats
+
+        // ##### CSV LOGGING END #####
+
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
+
         let mut details = String::new();
         details.push_str("🔢 SEMILINEAR SET:\n\n");
 
@@ -505,18 +787,6 @@ impl DebugLogger {
             ));
         }
 
-        // ##### CSV LOGGING START #####
-        let stats = SemilinearStats {
-            program_name,
-            num_components: set.components.len(),
-            periods_per_component: set.components.iter().map(|ls| ls.periods.len()).collect(),
-        };
-        // Write to <out_dir>/semilinear_size_stats.csv
-        let csv_path = out_dir.join("semilinear_size_stats.csv"); // #### UPDATE: build path from out_dir
-        log_semilinear_size_csv(&csv_path, &stats).expect("Failed to write semilinear_size_stats.csv"); // #### UPDATE: write stats
-
-        // ##### CSV LOGGING END #####
-
         self.step(name, description, &details);
     }
 
@@ -526,6 +796,9 @@ impl DebugLogger {
         description: &str,
         constraints: &[crate::presburger::Constraint<P>],
     ) {
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
         let mut details = String::new();
         details.push_str(&format!("⚖️ CONSTRAINTS ({}):\n\n", constraints.len()));
 
@@ -603,6 +876,9 @@ impl DebugLogger {
         disjunct_id: usize,
         quantified_set: &crate::presburger::QuantifiedSet<T>,
     ) {
+        if !log_enabled(LogLevel::Info) {
+            return;
+        }
         let mut details = String::new();
         details.push_str(&format!("🎯 DISJUNCT {} ANALYSIS:\n\n", disjunct_id));
 
@@ -648,6 +924,9 @@ impl DebugLogger {
         description: &str,
         pset: &crate::presburger::PresburgerSet<T>,
     ) {
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
         let mut details = String::new();
         details.push_str("🔢 PRESBURGER SET:\n\n");
 
@@ -668,6 +947,9 @@ impl DebugLogger {
         description: &str,
         qset: &crate::presburger::QuantifiedSet<T>,
     ) {
+        if !log_enabled(LogLevel::Debug) {
+            return;
+        }
         let mut details = String::new();
         details.push_str("⚖️ QUANTIFIED SET:\n\n");
 
@@ -690,6 +972,40 @@ impl DebugLogger {
     }
 }
 
+thread_local! {
+    /// Logger that replaces the global one on this thread while a task runs
+    static TASK_LOGGER: std::cell::RefCell<Option<DebugLogger>> = const { std::cell::RefCell::new(None) };
+}
+
+/// Run `f` with `logger` installed as this thread's debug logger.
+///
+/// Parallel tasks log into their own logger, which is merged into the global one in
+/// task order afterwards, so the report reads the same as a sequential run.
+pub fn with_task_logger<R>(logger: &DebugLogger, f: impl FnOnce() -> R) -> R {
+    let previous = TASK_LOGGER.with(|slot| slot.replace(Some(logger.clone())));
+    let result = f();
+    TASK_LOGGER.with(|slot| *slot.borrow_mut() = previous);
+    result
+}
+
+/// The logger installed by `with_task_logger` on this thread, if any
+pub fn task_logger() -> Option<DebugLogger> {
+    TASK_LOGGER.with(|slot| slot.borrow().clone())
+}
+
+/// Replace the logger installed by `with_task_logger` on this thread, giving `logger`
+/// back if there is none. The batch mode runs each file under a task logger, so that
+/// files analysed side by side keep separate reports.
+pub fn replace_task_logger(logger: DebugLogger) -> Result<(), DebugLogger> {
+    TASK_LOGGER.with(|slot| match slot.borrow_mut().as_mut() {
+        Some(current) => {
+            *current = logger;
+            Ok(())
+        }
+        None => Err(logger),
+    })
+}
+
 // Global debug report instance for backward compatibility
 use std::sync::Mutex;
 use std::sync::OnceLock;
@@ -779,3 +1095,59 @@ pub fn format_constraints_description<P: Display>(constraints: &[Constraint<P>])
         .collect::<Vec<_>>()
         .join("; ")
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_log_level_names() {
+        for level in [LogLevel::Off, LogLevel::Info, LogLevel::Debug] {
+            assert_eq!(LogLevel::from_name(level.name()), Some(level));
+            assert_eq!(LogLevel::from_u8(level as u8), level);
+        }
+        assert_eq!(LogLevel::from_name("verbose"), None);
+    }
+
+    #[test]
+    fn test_streaming_report_matches_buffered_content() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let path = temp_dir.path().join("debug_report.html");
+        let path = path.to_str().unwrap();
+
+        let mut report =
+            DebugReport::streaming("prog".to_string(), "a <- b".to_string(), path).unwrap();
+        report.add_step("Step".to_string(), "first".to_string(), "x < y".to_string());
+        report.add_step("Step".to_string(), "second".to_string(), String::new());
+        report.add_smpt_call(SmptCall {
+            disjunct_id: 3,
+            petri_net_content: "net".to_string(),
+            xml_content: "<xml/>".to_string(),
+            result: "UNREACHABLE".to_string(),
+            execution_time_ms: None,
+            constraints_description: "No constraints".to_string(),
+        });
+        assert!(report.algorithm_steps.is_empty() && report.smpt_calls.is_empty());
+        report.set_final_result("serializable".to_string(), 7);
+        report.generate_html(path).unwrap();
+
+        let html = std::fs::read_to_string(path).unwrap();
+        assert!(html.contains("a &lt;- b"));
+        assert!(html.contains("Step 1: Step") && html.contains("Step 2: Step"));
+        assert!(html.contains("x &lt; y"));
+        assert!(html.contains("SMPT Call #1 - Disjunct 3"));
+        assert!(html.contains("<p><strong>Algorithm Steps:</strong> 2</p>"));
+        assert!(html.ends_with("</html>"));
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_streaming_report_returns_write_errors() {
+        // Writes to /dev/full fail once the buffer is flushed
+        let mut report =
+            DebugReport::streaming("prog".to_string(), String::new(), "/dev/full").unwrap();
+        report.add_step("Step".to_string(), "large".to_string(), "x".repeat(1 << 16));
+        report.add_step("Step".to_string(), "small".to_string(), String::new());
+        assert!(report.generate_html("/dev/full").is_err());
+    }
+}
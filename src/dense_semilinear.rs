@@ -0,0 +1,921 @@
+// Dense semi-linear sets
+//
+// An alternate backend for `SemilinearSet` for when the key universe is known up front
+// (e.g. the request/response pairs of `ns.serialized_automaton_semilinear()`).
+// Keys are mapped to dense indices by a shared `KeySpace`, and each linear set stores
+// its base and periods as rows of one contiguous `u32` arena, so that adding, comparing
+// and subtracting vectors are plain loops over slices.
+//
+// The algorithms mirror the ones in `semilinear.rs` step by step and obey the same
+// REMOVE_REDUNDANT / GENERATE_LESS switches and STAR_COMPONENT_BUDGET. A star over the
+// budget continues as an `SPresburgerSet` in `DenseSPresburgerSet`, as it does for
+// `SPresburgerSet` itself. So does a product or star with a count that overflows `u32`,
+// which the sparse backend stores as `usize`.
+
+use crate::deterministic_map::{HashMap, HashSet};
+use crate::kleene::Kleene;
+use crate::semilinear::{
+    GENERATE_LESS, LinearSet, REMOVE_REDUNDANT, STAR_COMPONENT_BUDGET, SemilinearSet, SparseVector,
+};
+use crate::spresburger::SPresburgerSet;
+use std::fmt::Debug;
+use std::hash::Hash;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+/// Compute the serialized automaton's semilinear set with the dense backend
+pub static DENSE_SEMILINEAR: AtomicBool = AtomicBool::new(false);
+
+pub fn set_dense_semilinear(on: bool) {
+    DENSE_SEMILINEAR.store(on, Ordering::SeqCst);
+}
+
+pub fn dense_semilinear_enabled() -> bool {
+    DENSE_SEMILINEAR.load(Ordering::SeqCst)
+}
+
+/// A fixed universe of keys, numbered densely in sorted order
+#[derive(Debug)]
+pub struct KeySpace<K> {
+    keys: Vec<K>,
+    index: HashMap<K, usize>,
+}
+
+impl<K: Eq + Hash + Clone + Ord> KeySpace<K> {
+    pub fn new(keys: impl IntoIterator<Item = K>) -> Arc<Self> {
+        let mut keys: Vec<K> = keys.into_iter().collect();
+        keys.sort();
+        keys.dedup();
+        let index = keys.iter().enumerate().map(|(i, k)| (k.clone(), i)).collect();
+        Arc::new(KeySpace { keys, index })
+    }
+
+    /// Number of keys (the dimension of every vector in this space)
+    pub fn len(&self) -> usize {
+        self.keys.len()
+    }
+
+    /// Dense index of a key; panics if the key is not part of the space
+    pub fn index(&self, key: &K) -> usize {
+        *self
+            .index
+            .get(key)
+            .expect("key is not part of the dense key space")
+    }
+
+    pub fn key(&self, index: usize) -> &K {
+        &self.keys[index]
+    }
+}
+
+// Vector operations on dense slices. All vectors of one set have the same length.
+
+fn is_zero(v: &[u32]) -> bool {
+    v.iter().all(|&x| x == 0)
+}
+
+/// acc += v, or None (leaving `acc` partly added) if an entry overflows
+fn add_assign(acc: &mut [u32], v: &[u32]) -> Option<()> {
+    for (a, &b) in acc.iter_mut().zip(v) {
+        *a = a.checked_add(b)?;
+    }
+    Some(())
+}
+
+/// a - b, or None if that can't be done nonnegatively
+fn sub(a: &[u32], b: &[u32]) -> Option<Vec<u32>> {
+    if a.iter().zip(b).any(|(&x, &y)| y > x) {
+        return None;
+    }
+    Some(a.iter().zip(b).map(|(&x, &y)| x - y).collect())
+}
+
+/// A linear set `base + N*period_1 + ... + N*period_m`.
+///
+/// Row 0 of the arena is the base, rows 1..=m are the periods, each `dim` entries long.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct DenseLinearSet {
+    dim: usize,
+    rows: usize,
+    arena: Vec<u32>,
+}
+
+impl DenseLinearSet {
+    fn new(base: &[u32]) -> Self {
+        DenseLinearSet {
+            dim: base.len(),
+            rows: 1,
+            arena: base.to_vec(),
+        }
+    }
+
+    fn row(&self, i: usize) -> &[u32] {
+        &self.arena[i * self.dim..(i + 1) * self.dim]
+    }
+
+    pub fn base(&self) -> &[u32] {
+        self.row(0)
+    }
+
+    fn base_mut(&mut self) -> &mut [u32] {
+        &mut self.arena[..self.dim]
+    }
+
+    pub fn num_periods(&self) -> usize {
+        self.rows - 1
+    }
+
+    pub fn period(&self, i: usize) -> &[u32] {
+        self.row(i + 1)
+    }
+
+    pub fn periods(&self) -> impl Iterator<Item = &[u32]> {
+        (0..self.num_periods()).map(|i| self.period(i))
+    }
+
+    fn push_period(&mut self, period: &[u32]) {
+        debug_assert_eq!(period.len(), self.dim);
+        self.arena.extend_from_slice(period);
+        self.rows += 1;
+    }
+
+    fn remove_period(&mut self, i: usize) {
+        let start = (i + 1) * self.dim;
+        self.arena.drain(start..start + self.dim);
+        self.rows -= 1;
+    }
+
+    /// Zero-pad every row to `dim` entries
+    fn widen(&mut self, dim: usize) {
+        if dim == self.dim {
+            return;
+        }
+        let mut arena = vec![0; self.rows * dim];
+        for i in 0..self.rows {
+            arena[i * dim..i * dim + self.dim].copy_from_slice(self.row(i));
+        }
+        self.dim = dim;
+        self.arena = arena;
+    }
+
+    /// Remove periods that are nonnegative combinations of the other periods
+    fn dedup_periods(&mut self) {
+        'fixpoint: loop {
+            for i in 0..self.num_periods() {
+                let others: Vec<&[u32]> = (0..self.num_periods())
+                    .filter(|&j| j != i)
+                    .map(|j| self.period(j))
+                    .collect();
+                if is_nonnegative_combination(self.period(i), &others) {
+                    self.remove_period(i);
+                    continue 'fixpoint;
+                }
+            }
+            break;
+        }
+    }
+
+    /// Does `vec` lie in this linear set?
+    pub fn contains(&self, vec: &[u32]) -> bool {
+        match sub(vec, self.base()) {
+            Some(diff) => {
+                let periods: Vec<&[u32]> = self.periods().collect();
+                is_nonnegative_combination(&diff, &periods)
+            }
+            None => false,
+        }
+    }
+}
+
+/// Returns true if `target` is a nonnegative integer combination of `periods`
+pub fn is_nonnegative_combination(target: &[u32], periods: &[&[u32]]) -> bool {
+    let mut memo = HashSet::default();
+    dfs(target, 0, periods, &mut memo)
+}
+
+fn dfs(target: &[u32], idx: usize, periods: &[&[u32]], memo: &mut HashSet<(Vec<u32>, usize)>) -> bool {
+    if is_zero(target) {
+        return true;
+    }
+    if idx == periods.len() {
+        return false;
+    }
+    if !memo.insert((target.to_vec(), idx)) {
+        return false;
+    }
+
+    // Largest number of times p can be subtracted while staying nonnegative.
+    // A zero period never helps, so it is only tried with coefficient 0.
+    let p = periods[idx];
+    let max_coeff = p
+        .iter()
+        .zip(target)
+        .filter(|(p_val, _)| **p_val > 0)
+        .map(|(p_val, t_val)| t_val / p_val)
+        .min()
+        .unwrap_or(0);
+
+    if dfs(target, idx + 1, periods, memo) {
+        return true;
+    }
+    let mut new_target = target.to_vec();
+    for _ in 1..=max_coeff {
+        for (t, &p_val) in new_target.iter_mut().zip(p) {
+            *t -= p_val;
+        }
+        if dfs(&new_target, idx + 1, periods, memo) {
+            return true;
+        }
+    }
+    false
+}
+
+/// Check if l1 is contained in l2
+pub fn linear_set_subset(l1: &DenseLinearSet, l2: &DenseLinearSet) -> bool {
+    let Some(diff) = sub(l1.base(), l2.base()) else {
+        return false;
+    };
+    let periods2: Vec<&[u32]> = l2.periods().collect();
+    if !is_nonnegative_combination(&diff, &periods2) {
+        return false;
+    }
+    l1.periods()
+        .all(|p| is_nonnegative_combination(p, &periods2))
+}
+
+/// Attempt to merge two linear sets L1 and L2 into a single linear set L with L1 ∪ L2 = L
+pub fn try_merge_linear_sets(l1: &DenseLinearSet, l2: &DenseLinearSet) -> Option<DenseLinearSet> {
+    if l1 == l2 {
+        return Some(l1.clone());
+    }
+    if linear_set_subset(l1, l2) {
+        return Some(l2.clone());
+    }
+    // Merge aP* and ab(P+b)* into a(P+b)*
+    let diff = sub(l2.base(), l1.base())?;
+    let mut periods1_set: HashSet<&[u32]> = l1.periods().collect();
+    periods1_set.insert(&diff);
+    let periods2_set: HashSet<&[u32]> = l2.periods().collect();
+    if periods1_set == periods2_set {
+        let mut merged = DenseLinearSet::new(l1.base());
+        for p in l2.periods() {
+            merged.push_period(p);
+        }
+        Some(merged)
+    } else {
+        None
+    }
+}
+
+/// A semilinear set over a `KeySpace`: a union of dense linear sets.
+///
+/// `Kleene::zero()` and `Kleene::one()` have no key space yet (dimension 0); they
+/// adopt the space of the first set they are combined with.
+#[derive(Debug, Clone)]
+pub struct DenseSemilinearSet<K> {
+    space: Option<Arc<KeySpace<K>>>,
+    dim: usize,
+    pub components: Vec<DenseLinearSet>,
+}
+
+impl<K: Eq + Hash + Clone + Ord> DenseSemilinearSet<K> {
+    /// Create a semilinear set from components, simplifying as `SemilinearSet::new` does
+    fn new(space: Option<Arc<KeySpace<K>>>, dim: usize, mut components: Vec<DenseLinearSet>) -> Self {
+        if REMOVE_REDUNDANT.load(Ordering::SeqCst) {
+            for lin in &mut components {
+                lin.dedup_periods();
+            }
+
+            'fixpoint: loop {
+                for i in 0..components.len() {
+                    for j in i + 1..components.len() {
+                        if let Some(merged) = try_merge_linear_sets(&components[i], &components[j]) {
+                            components[i] = merged;
+                            components.swap_remove(j);
+                            continue 'fixpoint;
+                        }
+                    }
+                }
+                break;
+            }
+        }
+        DenseSemilinearSet {
+            space,
+            dim,
+            components,
+        }
+    }
+
+    /// Simplify with `new` if GENERATE_LESS is on, as the sparse backend does
+    fn build(space: Option<Arc<KeySpace<K>>>, dim: usize, components: Vec<DenseLinearSet>) -> Self {
+        if GENERATE_LESS.load(Ordering::SeqCst) {
+            Self::new(space, dim, components)
+        } else {
+            DenseSemilinearSet {
+                space,
+                dim,
+                components,
+            }
+        }
+    }
+
+    /// The singleton {unit(key)}
+    pub fn atom(space: &Arc<KeySpace<K>>, key: &K) -> Self {
+        let mut base = vec![0; space.len()];
+        base[space.index(key)] = 1;
+        DenseSemilinearSet {
+            space: Some(space.clone()),
+            dim: space.len(),
+            components: vec![DenseLinearSet::new(&base)],
+        }
+    }
+
+    /// Convert a sparse semilinear set whose keys all belong to `space`
+    pub fn from_sparse(space: &Arc<KeySpace<K>>, set: &SemilinearSet<K>) -> Self {
+        let dense = |v: &SparseVector<K>| {
+            let mut out = vec![0u32; space.len()];
+            for (k, &value) in &v.values {
+                out[space.index(k)] = u32::try_from(value).expect("count overflows u32");
+            }
+            out
+        };
+        let components = set
+            .components
+            .iter()
+            .map(|lin| {
+                let mut dense_lin = DenseLinearSet::new(&dense(&lin.base));
+                for p in &lin.periods {
+                    dense_lin.push_period(&dense(p));
+                }
+                dense_lin
+            })
+            .collect();
+        DenseSemilinearSet {
+            space: Some(space.clone()),
+            dim: space.len(),
+            components,
+        }
+    }
+
+    /// Convert back to the sparse representation, keeping components and periods in order
+    pub fn to_sparse(&self) -> SemilinearSet<K> {
+        let sparse = |v: &[u32]| {
+            let mut out = SparseVector::new();
+            for (i, &value) in v.iter().enumerate() {
+                if value != 0 {
+                    let space = self.space.as_ref().expect("nonzero vector without key space");
+                    out.set(space.key(i).clone(), value as usize);
+                }
+            }
+            out
+        };
+        SemilinearSet {
+            components: self
+                .components
+                .iter()
+                .map(|lin| LinearSet {
+                    base: sparse(lin.base()),
+                    periods: lin.periods().map(sparse).collect(),
+                })
+                .collect(),
+        }
+    }
+
+    /// Does the dense vector `vec` lie in the set?
+    pub fn contains(&self, vec: &[u32]) -> bool {
+        self.components.iter().any(|lin| {
+            let mut lin = lin.clone();
+            lin.widen(vec.len().max(self.dim));
+            let mut vec = vec.to_vec();
+            vec.resize(lin.dim, 0);
+            lin.contains(&vec)
+        })
+    }
+
+    /// Bring both sets into the same key space, padding dimension-0 sets
+    fn unify(&mut self, other: &mut Self) {
+        match (&self.space, &other.space) {
+            (Some(a), Some(b)) => assert!(Arc::ptr_eq(a, b), "mixing dense key spaces"),
+            (None, Some(b)) => {
+                self.space = Some(b.clone());
+                self.widen(other.dim);
+            }
+            (Some(a), None) => {
+                other.space = Some(a.clone());
+                other.widen(self.dim);
+            }
+            (None, None) => {}
+        }
+    }
+
+    fn widen(&mut self, dim: usize) {
+        self.dim = dim;
+        for lin in &mut self.components {
+            lin.widen(dim);
+        }
+    }
+
+    /// Kleene star, built incrementally within `STAR_COMPONENT_BUDGET` linear sets.
+    ///
+    /// Returns `Err(factors)` once the intermediate result exceeds the budget, like
+    /// `SemilinearSet::try_star`, or once a count of it overflows `u32`.
+    pub fn try_star(self) -> Result<Self, Vec<Self>> {
+        let budget = STAR_COMPONENT_BUDGET.load(Ordering::SeqCst);
+        self.try_star_within(budget)
+    }
+
+    /// `try_star` with an explicit component budget.
+    ///
+    /// Same heuristics as `SemilinearSet::try_star_within`:
+    /// 1. pull out linear sets with zero base, 2. remove redundant periods,
+    /// 3. pull out bases with no periods, 4. multiply in (1 + b(b+P)*) per component.
+    pub fn try_star_within(self, budget: usize) -> Result<Self, Vec<Self>> {
+        let dim = self.dim;
+        let mut extra_periods: Vec<Vec<u32>> = Vec::new();
+        let mut extra_set: HashSet<Vec<u32>> = HashSet::default();
+        let mut add_extra = |p: &[u32], extra_periods: &mut Vec<Vec<u32>>| {
+            if extra_set.insert(p.to_vec()) {
+                extra_periods.push(p.to_vec());
+            }
+        };
+
+        let mut components = self.components;
+        if GENERATE_LESS.load(Ordering::SeqCst) {
+            // 1. Pull out linear sets with zero base.
+            components.retain(|comp| {
+                if is_zero(comp.base()) {
+                    for p in comp.periods() {
+                        add_extra(p, &mut extra_periods);
+                    }
+                    false
+                } else {
+                    true
+                }
+            });
+
+            // 2+3. Remove redundant periods, and pull out bases with no periods.
+            loop {
+                let mut modified = false;
+                let mut kept = Vec::with_capacity(components.len());
+                for mut comp in components {
+                    if REMOVE_REDUNDANT.load(Ordering::SeqCst) {
+                        let mut i = 0;
+                        while i < comp.num_periods() {
+                            if extra_periods.iter().any(|e| e.as_slice() == comp.period(i)) {
+                                comp.remove_period(i);
+                            } else {
+                                i += 1;
+                            }
+                        }
+                    }
+                    if comp.num_periods() == 0 {
+                        add_extra(comp.base(), &mut extra_periods);
+                        modified = true;
+                    } else {
+                        kept.push(comp);
+                    }
+                }
+                components = kept;
+                if !modified {
+                    break;
+                }
+            }
+        }
+
+        // 4. Multiply in the factors (1 + b(b+P)*) one by one. Without simplification this
+        //    produces the same components as enumerating all subsets of the components.
+        let mut result_components = vec![DenseLinearSet::new(&vec![0; dim])];
+        let mut remaining = components.into_iter();
+        while let Some(comp) = remaining.next() {
+            let with_comp: Option<Vec<DenseLinearSet>> = result_components
+                .iter()
+                .map(|lin| {
+                    let mut lin = lin.clone();
+                    add_assign(lin.base_mut(), comp.base())?;
+                    lin.push_period(comp.base());
+                    for p in comp.periods() {
+                        lin.push_period(p);
+                    }
+                    Some(lin)
+                })
+                .collect();
+            let Some(with_comp) = with_comp else {
+                // Hand back the factors with `comp` still among the remaining ones
+                let remaining = std::iter::once(comp).chain(remaining);
+                let factors =
+                    Self::star_factors(self.space, dim, result_components, remaining, &extra_periods);
+                return Err(factors);
+            };
+            result_components.extend(with_comp);
+
+            // Prune subsumed and mergeable linear sets so the next step stays small
+            if GENERATE_LESS.load(Ordering::SeqCst) {
+                result_components = Self::new(None, dim, result_components).components;
+            }
+
+            if result_components.len() > budget {
+                let factors =
+                    Self::star_factors(self.space, dim, result_components, remaining, &extra_periods);
+                return Err(factors);
+            }
+        }
+
+        // Add the extra periods to all the components
+        for lin in &mut result_components {
+            for p in &extra_periods {
+                lin.push_period(p);
+            }
+        }
+        Ok(Self::build(self.space, dim, result_components))
+    }
+
+    /// The factors a star hands back: partial result, remaining (1 + b(b+P)*), extra*
+    fn star_factors(
+        space: Option<Arc<KeySpace<K>>>,
+        dim: usize,
+        partial: Vec<DenseLinearSet>,
+        remaining: impl Iterator<Item = DenseLinearSet>,
+        extra_periods: &[Vec<u32>],
+    ) -> Vec<Self> {
+        let mut factors = vec![DenseSemilinearSet {
+            space: space.clone(),
+            dim,
+            components: partial,
+        }];
+        for comp in remaining {
+            let mut lin = DenseLinearSet::new(comp.base());
+            lin.push_period(comp.base());
+            for p in comp.periods() {
+                lin.push_period(p);
+            }
+            factors.push(DenseSemilinearSet {
+                space: space.clone(),
+                dim,
+                components: vec![DenseLinearSet::new(&vec![0; dim]), lin],
+            });
+        }
+        let mut extra = DenseLinearSet::new(&vec![0; dim]);
+        for p in extra_periods {
+            extra.push_period(p);
+        }
+        factors.push(DenseSemilinearSet {
+            space,
+            dim,
+            components: vec![extra],
+        });
+        factors
+    }
+
+    /// The product of two sets, or both of them back if a count of it overflows `u32`
+    pub fn try_times(mut self, mut other: Self) -> Result<Self, (Self, Self)> {
+        self.unify(&mut other);
+        let comps: Option<Vec<DenseLinearSet>> = self
+            .components
+            .iter()
+            .flat_map(|a| other.components.iter().map(move |b| (a, b)))
+            .map(|(a, b)| {
+                let mut lin = a.clone();
+                add_assign(lin.base_mut(), b.base())?;
+                lin.arena.extend_from_slice(&b.arena[b.dim..]);
+                lin.rows += b.num_periods();
+                Some(lin)
+            })
+            .collect();
+        match comps {
+            Some(comps) => Ok(Self::build(self.space, self.dim, comps)),
+            None => Err((self, other)),
+        }
+    }
+}
+
+/// Display via the sparse representation
+impl<K: Eq + Hash + Clone + Ord + std::fmt::Display> std::fmt::Display for DenseSemilinearSet<K> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{}", self.to_sparse())
+    }
+}
+
+impl<K: Eq + Hash + Clone + Ord> Kleene for DenseSemilinearSet<K> {
+    fn zero() -> Self {
+        DenseSemilinearSet {
+            space: None,
+            dim: 0,
+            components: Vec::new(),
+        }
+    }
+
+    fn one() -> Self {
+        DenseSemilinearSet {
+            space: None,
+            dim: 0,
+            components: vec![DenseLinearSet::new(&[])],
+        }
+    }
+
+    fn plus(mut self, mut other: Self) -> Self {
+        self.unify(&mut other);
+        self.components.append(&mut other.components);
+        Self::build(self.space, self.dim, self.components)
+    }
+
+    fn times(self, other: Self) -> Self {
+        match self.try_times(other) {
+            Ok(product) => product,
+            Err(_) => panic!("Count in dense semilinear set overflows u32"),
+        }
+    }
+
+    fn star(self) -> Self {
+        match self.try_star() {
+            Ok(result) => result,
+            Err(_) => {
+                // Log this as a timeout before panicking
+                crate::stats::set_analysis_result("timeout");
+                crate::stats::finalize_stats();
+                panic!("Number of components in semilinear set is too large");
+            }
+        }
+    }
+
+    fn weight(&self) -> usize {
+        self.components.len()
+    }
+}
+
+/// A dense semilinear set, or the `SPresburgerSet` it continues as once a star exceeds
+/// `STAR_COMPONENT_BUDGET` (see `SPresburgerSet::from_star_factors`)
+#[derive(Debug, Clone)]
+pub enum DenseSPresburgerSet<K: Clone + Ord + Debug + ToString + Eq + Hash> {
+    Dense(DenseSemilinearSet<K>),
+    Sparse(SPresburgerSet<K>),
+}
+
+impl<K: Clone + Ord + Debug + ToString + Eq + Hash> DenseSPresburgerSet<K> {
+    pub fn into_spresburger(self) -> SPresburgerSet<K> {
+        match self {
+            DenseSPresburgerSet::Dense(set) => SPresburgerSet::Semilinear(set.to_sparse()),
+            DenseSPresburgerSet::Sparse(set) => set,
+        }
+    }
+}
+
+impl<K: Clone + Ord + Debug + ToString + Eq + Hash> Kleene for DenseSPresburgerSet<K> {
+    fn zero() -> Self {
+        DenseSPresburgerSet::Dense(DenseSemilinearSet::zero())
+    }
+
+    fn one() -> Self {
+        DenseSPresburgerSet::Dense(DenseSemilinearSet::one())
+    }
+
+    fn plus(self, other: Self) -> Self {
+        match (self, other) {
+            (DenseSPresburgerSet::Dense(a), DenseSPresburgerSet::Dense(b)) => {
+                DenseSPresburgerSet::Dense(a.plus(b))
+            }
+            (a, b) => DenseSPresburgerSet::Sparse(a.into_spresburger().plus(b.into_spresburger())),
+        }
+    }
+
+    fn times(self, other: Self) -> Self {
+        match (self, other) {
+            (DenseSPresburgerSet::Dense(a), DenseSPresburgerSet::Dense(b)) => match a.try_times(b) {
+                Ok(product) => DenseSPresburgerSet::Dense(product),
+                // A count overflows `u32`: multiply as sparse sets instead
+                Err((a, b)) => {
+                    let (a, b) = (DenseSPresburgerSet::Dense(a), DenseSPresburgerSet::Dense(b));
+                    DenseSPresburgerSet::Sparse(a.into_spresburger().times(b.into_spresburger()))
+                }
+            },
+            (a, b) => DenseSPresburgerSet::Sparse(a.into_spresburger().times(b.into_spresburger())),
+        }
+    }
+
+    fn star(self) -> Self {
+        match self {
+            DenseSPresburgerSet::Dense(set) => match set.try_star() {
+                Ok(result) => DenseSPresburgerSet::Dense(result),
+                Err(factors) => {
+                    let factors: Vec<_> = factors.iter().map(DenseSemilinearSet::to_sparse).collect();
+                    DenseSPresburgerSet::Sparse(SPresburgerSet::from_star_factors(&factors))
+                }
+            },
+            DenseSPresburgerSet::Sparse(set) => DenseSPresburgerSet::Sparse(set.star()),
+        }
+    }
+
+    fn weight(&self) -> usize {
+        match self {
+            DenseSPresburgerSet::Dense(set) => set.weight(),
+            DenseSPresburgerSet::Sparse(set) => set.weight(),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A small Kleene expression over keys, evaluated in any backend
+    #[derive(Debug, Clone)]
+    enum Expr {
+        Atom(usize),
+        Zero,
+        One,
+        Plus(Box<Expr>, Box<Expr>),
+        Times(Box<Expr>, Box<Expr>),
+        Star(Box<Expr>),
+    }
+
+    fn eval<K: Kleene>(e: &Expr, atom: &impl Fn(usize) -> K) -> K {
+        match e {
+            Expr::Atom(i) => atom(*i),
+            Expr::Zero => K::zero(),
+            Expr::One => K::one(),
+            Expr::Plus(a, b) => eval(a, atom).plus(eval(b, atom)),
+            Expr::Times(a, b) => eval(a, atom).times(eval(b, atom)),
+            Expr::Star(a) => eval(a, atom).star(),
+        }
+    }
+
+    fn random_expr(next: &mut impl FnMut(u64) -> u64, depth: usize) -> Expr {
+        if depth == 0 {
+            return match next(8) {
+                0 => Expr::Zero,
+                1 => Expr::One,
+                i => Expr::Atom(i as usize % 3),
+            };
+        }
+        match next(4) {
+            0 => Expr::Plus(Box::new(random_expr(next, depth - 1)), Box::new(random_expr(next, depth - 1))),
+            1 => Expr::Times(Box::new(random_expr(next, depth - 1)), Box::new(random_expr(next, depth - 1))),
+            2 => Expr::Star(Box::new(random_expr(next, depth - 1))),
+            _ => random_expr(next, 0),
+        }
+    }
+
+    #[test]
+    fn test_dense_linear_set_rows() {
+        let mut lin = DenseLinearSet::new(&[1, 0, 2]);
+        lin.push_period(&[0, 1, 0]);
+        lin.push_period(&[1, 1, 0]);
+        assert_eq!(lin.base(), &[1, 0, 2]);
+        assert_eq!(lin.periods().collect::<Vec<_>>(), vec![&[0, 1, 0][..], &[1, 1, 0][..]]);
+        assert!(lin.contains(&[2, 3, 2]));
+        assert!(!lin.contains(&[0, 3, 2]));
+
+        lin.remove_period(0);
+        lin.widen(4);
+        assert_eq!(lin.base(), &[1, 0, 2, 0]);
+        assert_eq!(lin.period(0), &[1, 1, 0, 0]);
+    }
+
+    #[test]
+    fn test_dense_matches_sparse_backend() {
+        let keys = ["a", "b", "c"];
+        let space = KeySpace::new(keys);
+        let mut state: u64 = 0x9E3779B97F4A7C15;
+        let mut next = |bound: u64| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state % bound
+        };
+
+        for _ in 0..60 {
+            let expr = random_expr(&mut next, 3);
+            let sparse: SemilinearSet<&str> = eval(&expr, &|i| SemilinearSet::atom(keys[i]));
+            let dense: DenseSemilinearSet<&str> =
+                eval(&expr, &|i| DenseSemilinearSet::atom(&space, &keys[i]));
+            let sparse_as_dense = DenseSemilinearSet::from_sparse(&space, &sparse);
+
+            // Representations may order periods differently, so compare membership on a box
+            for a in 0..4 {
+                for b in 0..4 {
+                    for c in 0..4 {
+                        let v = [a, b, c];
+                        assert_eq!(
+                            dense.contains(&v),
+                            sparse_as_dense.contains(&v),
+                            "{:?} at {:?}: dense {} vs sparse {}",
+                            expr,
+                            v,
+                            dense,
+                            sparse
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_star_factors_within_budget() {
+        let space = KeySpace::new(["a", "b", "c"]);
+        let atom = |key| DenseSemilinearSet::atom(&space, &key);
+        let set = atom("a")
+            .times(atom("b").star())
+            .plus(atom("b").times(atom("c").star()))
+            .plus(atom("c").times(atom("a").star()));
+
+        let star = set.clone().try_star_within(usize::MAX).expect("unbounded budget");
+        let factors = set.try_star_within(1).expect_err("budget of one linear set");
+        let product = factors
+            .into_iter()
+            .reduce(|acc, f| acc.times(f))
+            .expect("at least one factor");
+        for a in 0..4 {
+            for b in 0..4 {
+                for c in 0..4 {
+                    let v = [a, b, c];
+                    assert_eq!(star.contains(&v), product.contains(&v), "at {:?}", v);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_overflowing_product_goes_sparse() {
+        let space = KeySpace::new(["a"]);
+        let max = DenseSemilinearSet {
+            space: Some(space.clone()),
+            dim: 1,
+            components: vec![DenseLinearSet::new(&[u32::MAX])],
+        };
+        let (max, one) = max.try_times(DenseSemilinearSet::atom(&space, &"a")).expect_err("u32::MAX + 1");
+
+        let product = DenseSPresburgerSet::Dense(max).times(DenseSPresburgerSet::Dense(one));
+        let DenseSPresburgerSet::Sparse(SPresburgerSet::Semilinear(product)) = product else {
+            panic!("expected a sparse semilinear product");
+        };
+        assert_eq!(product.components.len(), 1);
+        assert_eq!(product.components[0].base.get(&"a"), u32::MAX as usize + 1);
+    }
+
+    #[test]
+    fn test_sparse_round_trip() {
+        let space = KeySpace::new(["x", "y"]);
+        let set = DenseSemilinearSet::atom(&space, &"x")
+            .times(DenseSemilinearSet::atom(&space, &"y").star());
+        let sparse = set.to_sparse();
+        assert_eq!(sparse.to_string(), "x (y)*");
+        let back = DenseSemilinearSet::from_sparse(&space, &sparse);
+        assert_eq!(back.components, set.components);
+    }
+
+    /// Compare both backends on the serialized automata of `examples/ser`.
+    /// Run with `cargo test --release bench_dense_vs_sparse -- --ignored --nocapture`.
+    #[test]
+    #[ignore]
+    fn bench_dense_vs_sparse_examples() {
+        use crate::expr_to_ns::program_to_ns;
+        use crate::parser::{ExprHc, parse_program};
+        use std::time::Instant;
+
+        let mut files: Vec<_> = std::fs::read_dir("examples/ser")
+            .expect("run from the repository root")
+            .filter_map(|entry| entry.ok().map(|e| e.path()))
+            .filter(|path| path.extension().is_some_and(|ext| ext == "ser"))
+            .collect();
+        files.sort();
+
+        let (mut total_sparse, mut total_dense) = (0.0, 0.0);
+        println!("{:<30} {:>12} {:>12} {:>8}", "example", "sparse (ms)", "dense (ms)", "speedup");
+        for path in files {
+            let content = std::fs::read_to_string(&path).unwrap();
+            let mut table = ExprHc::new();
+            let Ok(program) = parse_program(&content, &mut table) else {
+                continue;
+            };
+            let ns = program_to_ns(&mut table, &program);
+
+            let start = Instant::now();
+            let sparse = ns.serialized_automaton_kleene(|req, resp| {
+                SemilinearSet::atom(format!("{req}/{resp}"))
+            });
+            let sparse_ms = start.elapsed().as_secs_f64() * 1000.0;
+
+            let start = Instant::now();
+            let dense = ns.serialized_automaton_dense_semilinear();
+            let dense_ms = start.elapsed().as_secs_f64() * 1000.0;
+
+            assert_eq!(dense.components.is_empty(), sparse.components.is_empty());
+            total_sparse += sparse_ms;
+            total_dense += dense_ms;
+            println!(
+                "{:<30} {:>12.3} {:>12.3} {:>7.2}x",
+                path.file_name().unwrap().to_string_lossy(),
+                sparse_ms,
+                dense_ms,
+                sparse_ms / dense_ms.max(1e-9)
+            );
+        }
+        println!(
+            "{:<30} {:>12.3} {:>12.3} {:>7.2}x",
+            "total",
+            total_sparse,
+            total_dense,
+            total_sparse / total_dense.max(1e-9)
+        );
+    }
+}
@@ -2,14 +2,186 @@ use crate::ns::*;
 use crate::parser::*;
 use hash_cons::Hc;
 
-use crate::deterministic_map::{HashMap, HashSet};
+use crate::deterministic_map::{DeterministicHasher, HashMap, HashSet};
 use std::cmp::Ordering;
-use std::hash::{Hash, Hasher};
+use std::collections::BTreeMap;
+use std::hash::{BuildHasher, Hash, Hasher};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering as AtomicOrdering};
+use std::sync::{Arc, Mutex};
 
-#[derive(Clone, Eq, PartialEq, Debug, serde::Serialize, serde::Deserialize)]
+lazy_static::lazy_static! {
+    static ref VARIABLES: Mutex<HashMap<String, Var>> = Mutex::new(HashMap::default());
+}
+
+/// An interned variable name.
+///
+/// Slots are handed out once per name for the whole run, so environments compare and hash
+/// variables as integers. The name itself is kept (leaked, like the hash-consed
+/// expressions it comes from) for display and ordering.
+#[derive(Clone, Copy)]
+pub struct Var {
+    slot: u32,
+    name: &'static str,
+}
+
+impl Var {
+    pub fn intern(name: &str) -> Self {
+        let mut variables = VARIABLES.lock().unwrap();
+        if let Some(&var) = variables.get(name) {
+            return var;
+        }
+        let var = Var {
+            slot: variables.len() as u32,
+            name: Box::leak(name.to_string().into_boxed_str()),
+        };
+        variables.insert(name.to_string(), var);
+        var
+    }
+
+    pub fn name(&self) -> &'static str {
+        self.name
+    }
+}
+
+impl PartialEq for Var {
+    fn eq(&self, other: &Self) -> bool {
+        self.slot == other.slot
+    }
+}
+impl Eq for Var {}
+
+impl Hash for Var {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        self.slot.hash(state);
+    }
+}
+
+impl PartialOrd for Var {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        Some(self.cmp(other))
+    }
+}
+impl Ord for Var {
+    // By name, so that environments order (and print) the same way however slots were assigned
+    fn cmp(&self, other: &Self) -> Ordering {
+        if self.slot == other.slot {
+            Ordering::Equal
+        } else {
+            self.name.cmp(other.name)
+        }
+    }
+}
+
+impl std::fmt::Debug for Var {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{}", self.name)
+    }
+}
+
+/// The variables of a program, interned once before it is run
+pub struct Vars {
+    vars: HashMap<String, Var>,
+}
+
+impl Vars {
+    pub fn of_program(program: &Program) -> Self {
+        fn collect(expr: &Expr, vars: &mut HashMap<String, Var>) {
+            match expr {
+                Expr::Assign(var, e) => {
+                    if !vars.contains_key(var) {
+                        vars.insert(var.clone(), Var::intern(var));
+                    }
+                    collect(e, vars);
+                }
+                Expr::Variable(var) => {
+                    if !vars.contains_key(var) {
+                        vars.insert(var.clone(), Var::intern(var));
+                    }
+                }
+                Expr::Equal(e1, e2)
+                | Expr::Add(e1, e2)
+                | Expr::Subtract(e1, e2)
+                | Expr::Sequence(e1, e2)
+                | Expr::While(e1, e2)
+                | Expr::And(e1, e2)
+                | Expr::Or(e1, e2) => {
+                    collect(e1, vars);
+                    collect(e2, vars);
+                }
+                Expr::If(cond, then_branch, else_branch) => {
+                    collect(cond, vars);
+                    collect(then_branch, vars);
+                    collect(else_branch, vars);
+                }
+                Expr::Not(e) => collect(e, vars),
+                Expr::Yield | Expr::Exit | Expr::Unknown | Expr::Number(_) => {}
+            }
+        }
+        let mut vars = HashMap::default();
+        for request in &program.requests {
+            collect(&request.body, &mut vars);
+        }
+        Vars { vars }
+    }
+
+    fn get(&self, name: &str) -> Var {
+        match self.vars.get(name) {
+            Some(&var) => var,
+            // Not in the program (e.g. run_expr on a standalone expression)
+            None => Var::intern(name),
+        }
+    }
+}
+
+/// A variable environment.
+///
+/// Only non-zero variables are stored, sorted by name, in a shared slice: cloning an
+/// environment is a reference count increment and assignments copy just the few stored
+/// pairs. The hash is computed once when the environment is built.
+#[derive(Clone, serde::Serialize, serde::Deserialize)]
+#[serde(from = "EnvRepr", into = "EnvRepr")]
 pub struct Env {
-    vars: HashMap<String, i64>,
+    vars: Arc<[(Var, i64)]>,
+    hash: u64,
+}
+
+/// The serialized form of an `Env`, `{"vars": {"x": 1}}`
+#[derive(serde::Serialize, serde::Deserialize)]
+struct EnvRepr {
+    vars: BTreeMap<String, i64>,
+}
+
+impl From<EnvRepr> for Env {
+    fn from(repr: EnvRepr) -> Self {
+        let mut vars: Vec<_> = repr
+            .vars
+            .into_iter()
+            .filter(|&(_, value)| value != 0)
+            .map(|(name, value)| (Var::intern(&name), value))
+            .collect();
+        vars.sort();
+        Env::from_sorted(vars)
+    }
+}
+
+impl From<Env> for EnvRepr {
+    fn from(env: Env) -> Self {
+        EnvRepr {
+            vars: env
+                .vars
+                .iter()
+                .map(|(var, value)| (var.name.to_string(), *value))
+                .collect(),
+        }
+    }
+}
+
+impl PartialEq for Env {
+    fn eq(&self, other: &Self) -> bool {
+        self.hash == other.hash && self.vars == other.vars
+    }
 }
+impl Eq for Env {}
 
 impl PartialOrd for Env {
     fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
@@ -18,24 +190,17 @@ impl PartialOrd for Env {
 }
 impl Ord for Env {
     fn cmp(&self, other: &Self) -> Ordering {
-        let mut a: Vec<_> = self.vars.iter().collect();
-        let mut b: Vec<_> = other.vars.iter().collect();
-        a.sort();
-        b.sort();
-        a.cmp(&b)
+        self.vars.cmp(&other.vars)
     }
 }
 
 impl std::fmt::Display for Env {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
-        // Sort variables for consistent output
-        let mut pairs: Vec<_> = self.vars.iter().collect();
-        pairs.sort_by_key(|(k, _)| *k);
-
-        // Format each variable assignment
-        let formatted = pairs
+        // Variables are stored sorted, which keeps the output consistent
+        let formatted = self
+            .vars
             .iter()
-            .map(|(k, v)| format!("{}={}", k, v))
+            .map(|(var, value)| format!("{}={}", var.name, value))
             .collect::<Vec<_>>()
             .join(",");
 
@@ -43,36 +208,72 @@ impl std::fmt::Display for Env {
     }
 }
 
+impl std::fmt::Debug for Env {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let vars: BTreeMap<_, _> = self.vars.iter().map(|(var, value)| (var.name, value)).collect();
+        f.debug_struct("Env").field("vars", &vars).finish()
+    }
+}
+
 impl Hash for Env {
     fn hash<H: Hasher>(&self, state: &mut H) {
-        // Convert to a sorted list of (key, value) pairs and hash that
-        let mut pairs = self.vars.iter().collect::<Vec<_>>();
-        pairs.sort_by_key(|(key, val)| (*key, *val));
-        for (key, value) in pairs {
-            key.hash(state);
-            value.hash(state);
-        }
+        state.write_u64(self.hash);
     }
 }
 
 impl Env {
     fn new() -> Self {
-        Self {
-            vars: HashMap::default(),
+        Env::from_sorted(Vec::new())
+    }
+
+    /// Build from non-zero pairs sorted by variable name
+    fn from_sorted(vars: Vec<(Var, i64)>) -> Self {
+        // Hash names rather than slots, which depend on the order variables were first seen
+        let mut hasher = DeterministicHasher::default().build_hasher();
+        for (var, value) in &vars {
+            var.name.hash(&mut hasher);
+            value.hash(&mut hasher);
+        }
+        Env {
+            vars: vars.into(),
+            hash: hasher.finish(),
         }
     }
+
     fn insert(self, var: String, value: i64) -> Self {
-        let mut vars = self.vars.clone();
-        if value == 0 {
-            vars.remove(&var);
-        } else {
-            vars.insert(var, value);
+        self.set(Var::intern(&var), value)
+    }
+
+    fn set(&self, var: Var, value: i64) -> Self {
+        let pos = self.vars.partition_point(|(v, _)| *v < var);
+        let present = self.vars.get(pos).is_some_and(|(v, _)| *v == var);
+        if present && self.vars[pos].1 == value || !present && value == 0 {
+            return self.clone();
+        }
+        let mut vars = Vec::with_capacity(self.vars.len() + 1);
+        vars.extend_from_slice(&self.vars[..pos]);
+        if value != 0 {
+            vars.push((var, value));
         }
-        Self { vars }
+        vars.extend_from_slice(&self.vars[pos + present as usize..]);
+        Env::from_sorted(vars)
     }
+
     fn get(&self, var: &str) -> i64 {
         // Variables are initialized to 0
-        *self.vars.get(var).unwrap_or(&0)
+        self.vars
+            .iter()
+            .find(|(v, _)| v.name == var)
+            .map_or(0, |(_, value)| *value)
+    }
+
+    fn value(&self, var: Var) -> i64 {
+        // Variables are initialized to 0
+        let pos = self.vars.partition_point(|(v, _)| *v < var);
+        match self.vars.get(pos) {
+            Some((v, value)) if *v == var => *value,
+            _ => 0,
+        }
     }
 }
 
@@ -90,7 +291,8 @@ fn is_local(var: &str) -> bool {
 }
 
 pub fn run_expr(
-    exprhc: &mut ExprHc,
+    exprhc: &ExprHc,
+    vars: &Vars,
     expr: &Expr,
     local: Local,
     global: Global,
@@ -98,7 +300,7 @@ pub fn run_expr(
     let mut results = Vec::new();
     match expr {
         Expr::Assign(var, e) => {
-            for (expr_result, local, global) in run_expr(exprhc, e, local, global) {
+            for (expr_result, local, global) in run_expr(exprhc, vars, e, local, global) {
                 match expr_result {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -112,14 +314,14 @@ pub fn run_expr(
                         if is_local(var) {
                             results.push((
                                 ExprResult::Returning(n),
-                                local.insert(var.clone(), n),
+                                local.set(vars.get(var), n),
                                 global,
                             ));
                         } else {
                             results.push((
                                 ExprResult::Returning(n),
                                 local,
-                                global.insert(var.clone(), n),
+                                global.set(vars.get(var), n),
                             ));
                         }
                     }
@@ -127,7 +329,7 @@ pub fn run_expr(
             }
         }
         Expr::Equal(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -137,7 +339,7 @@ pub fn run_expr(
                         ));
                     }
                     ExprResult::Returning(n1) => {
-                        for (expr_result2, local2, global2) in run_expr(exprhc, e2, local1, global1)
+                        for (expr_result2, local2, global2) in run_expr(exprhc, vars, e2, local1, global1)
                         {
                             match expr_result2 {
                                 ExprResult::Yielding(e) => {
@@ -156,7 +358,7 @@ pub fn run_expr(
             }
         }
         Expr::Add(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -166,7 +368,7 @@ pub fn run_expr(
                         ));
                     }
                     ExprResult::Returning(n1) => {
-                        for (expr_result2, local2, global2) in run_expr(exprhc, e2, local1, global1)
+                        for (expr_result2, local2, global2) in run_expr(exprhc, vars, e2, local1, global1)
                         {
                             match expr_result2 {
                                 ExprResult::Yielding(e) => {
@@ -185,7 +387,7 @@ pub fn run_expr(
             }
         }
         Expr::Subtract(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -195,7 +397,7 @@ pub fn run_expr(
                         ));
                     }
                     ExprResult::Returning(n1) => {
-                        for (expr_result2, local2, global2) in run_expr(exprhc, e2, local1, global1)
+                        for (expr_result2, local2, global2) in run_expr(exprhc, vars, e2, local1, global1)
                         {
                             match expr_result2 {
                                 ExprResult::Yielding(e) => {
@@ -214,7 +416,7 @@ pub fn run_expr(
             }
         }
         Expr::Sequence(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -225,7 +427,7 @@ pub fn run_expr(
                     }
                     ExprResult::Returning(_) => {
                         // Ignore the result of e1 and continue with e2
-                        for (expr_result2, local2, global2) in run_expr(exprhc, e2, local1, global1)
+                        for (expr_result2, local2, global2) in run_expr(exprhc, vars, e2, local1, global1)
                         {
                             results.push((expr_result2, local2, global2));
                         }
@@ -234,7 +436,7 @@ pub fn run_expr(
             }
         }
         Expr::If(cond, then_branch, else_branch) => {
-            for (expr_result, local1, global1) in run_expr(exprhc, cond, local, global) {
+            for (expr_result, local1, global1) in run_expr(exprhc, vars, cond, local, global) {
                 match expr_result {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -251,14 +453,14 @@ pub fn run_expr(
                         if n != 0 {
                             // Condition is true, execute then branch
                             for (expr_result2, local2, global2) in
-                                run_expr(exprhc, then_branch, local1, global1)
+                                run_expr(exprhc, vars, then_branch, local1, global1)
                             {
                                 results.push((expr_result2, local2, global2));
                             }
                         } else {
                             // Condition is false, execute else branch
                             for (expr_result2, local2, global2) in
-                                run_expr(exprhc, else_branch, local1, global1)
+                                run_expr(exprhc, vars, else_branch, local1, global1)
                             {
                                 results.push((expr_result2, local2, global2));
                             }
@@ -282,7 +484,7 @@ pub fn run_expr(
                 }
 
                 // First, evaluate the condition
-                for (expr_result, local1, global1) in run_expr(exprhc, cond, local, global) {
+                for (expr_result, local1, global1) in run_expr(exprhc, vars, cond, local, global) {
                     match expr_result {
                         ExprResult::Yielding(e) => {
                             // If condition yields, we yield the entire while expression
@@ -296,7 +498,7 @@ pub fn run_expr(
                             if n != 0 {
                                 // Condition is true, execute body
                                 for (expr_result2, local2, global2) in
-                                    run_expr(exprhc, body, local1, global1)
+                                    run_expr(exprhc, vars, body, local1, global1)
                                 {
                                     match expr_result2 {
                                         ExprResult::Yielding(e) => {
@@ -347,13 +549,13 @@ pub fn run_expr(
         Expr::Variable(x) => {
             // Look up the variable in local or global environment
             if is_local(x) {
-                results.push((ExprResult::Returning(local.get(x)), local, global));
+                results.push((ExprResult::Returning(local.value(vars.get(x))), local, global));
             } else {
-                results.push((ExprResult::Returning(global.get(x)), local, global));
+                results.push((ExprResult::Returning(global.value(vars.get(x))), local, global));
             }
         }
         Expr::Not(e) => {
-            for (expr_result, local1, global1) in run_expr(exprhc, e, local, global) {
+            for (expr_result, local1, global1) in run_expr(exprhc, vars, e, local, global) {
                 match expr_result {
                     ExprResult::Yielding(e) => {
                         results.push((ExprResult::Yielding(exprhc.not(e)), local1, global1));
@@ -366,7 +568,7 @@ pub fn run_expr(
             }
         }
         Expr::And(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -382,7 +584,7 @@ pub fn run_expr(
                         } else {
                             // First operand is true, evaluate second operand
                             for (expr_result2, local2, global2) in
-                                run_expr(exprhc, e2, local1, global1)
+                                run_expr(exprhc, vars, e2, local1, global1)
                             {
                                 match expr_result2 {
                                     ExprResult::Yielding(e) => {
@@ -406,7 +608,7 @@ pub fn run_expr(
             }
         }
         Expr::Or(e1, e2) => {
-            for (expr_result1, local1, global1) in run_expr(exprhc, e1, local, global) {
+            for (expr_result1, local1, global1) in run_expr(exprhc, vars, e1, local, global) {
                 match expr_result1 {
                     ExprResult::Yielding(e) => {
                         results.push((
@@ -422,7 +624,7 @@ pub fn run_expr(
                         } else {
                             // First operand is false, evaluate second operand
                             for (expr_result2, local2, global2) in
-                                run_expr(exprhc, e2, local1, global1)
+                                run_expr(exprhc, vars, e2, local1, global1)
                             {
                                 match expr_result2 {
                                     ExprResult::Yielding(e) => {
@@ -471,12 +673,56 @@ impl std::fmt::Display for LocalExpr {
     }
 }
 
+/// Whether `program_to_ns` explores states on `--jobs` worker threads (`--parallel-ns`)
+static PARALLEL_NS: AtomicBool = AtomicBool::new(false);
+
+pub fn set_parallel_ns(on: bool) {
+    PARALLEL_NS.store(on, AtomicOrdering::SeqCst);
+}
+
+pub fn parallel_ns_enabled() -> bool {
+    PARALLEL_NS.load(AtomicOrdering::SeqCst)
+}
+
+/// The packets a packet `(expr, local)` becomes when run against `global`, with the
+/// resulting global state, in the order `run_expr` produces them
+fn step(
+    exprhc: &ExprHc,
+    vars: &Vars,
+    expr: &Hc<Expr>,
+    local: &Local,
+    global: &Global,
+) -> Vec<(LocalExpr, Global)> {
+    run_expr(exprhc, vars, expr, local.clone(), global.clone())
+        .into_iter()
+        .map(|(result, new_local, new_global)| {
+            let e = match result {
+                // Continue with the rest of the expression
+                ExprResult::Yielding(e) => e,
+                ExprResult::Returning(n) => exprhc.number(n),
+            };
+            (LocalExpr(new_local, e), new_global)
+        })
+        .collect()
+}
+
 // Function to convert a program with multiple requests to a network system
 pub fn program_to_ns(
     exprhc: &mut ExprHc,
     program: &Program,
 ) -> NS<Global, LocalExpr, ExprRequest, i64> {
-    let mut ns = NS::new(Global::new());
+    let _span = crate::trace::span("program_to_ns");
+    if crate::incremental::incremental_enabled() {
+        return program_to_ns_incremental(exprhc, program);
+    }
+    let jobs = crate::parallel::jobs();
+    if parallel_ns_enabled() && jobs > 1 {
+        return program_to_ns_parallel(exprhc, program, jobs);
+    }
+
+    // Deduplicate through hash tables; the NS vectors are produced at the end
+    let mut ns = NSBuilder::new(Global::new());
+    let vars = Vars::of_program(program);
 
     // Track seen states to avoid duplication and infinite loops
     let mut seen_packets: HashSet<LocalExpr> = HashSet::default();
@@ -505,61 +751,51 @@ pub fn program_to_ns(
             ExprRequest {
                 name: request_name.to_string(),
             },
-            initial_local_expr.clone(),
+            &initial_local_expr,
         );
         seen_globals.insert(initial_global.clone());
         seen_packets.insert(initial_local_expr.clone());
     }
 
-    // Process states
+    explore(
+        exprhc,
+        &vars,
+        &mut ns,
+        &mut seen_packets,
+        &mut seen_globals,
+        todo,
+    );
+
+    ns.build()
+}
+
+/// Run the packets of `todo` against their globals, and every pair of a seen packet and a
+/// seen global that this reaches
+fn explore(
+    exprhc: &ExprHc,
+    vars: &Vars,
+    ns: &mut NSBuilder<Global, LocalExpr, ExprRequest, i64>,
+    seen_packets: &mut HashSet<LocalExpr>,
+    seen_globals: &mut HashSet<Global>,
+    mut todo: Vec<(Hc<Expr>, Local, Global)>,
+) {
     while let Some((expr, local, global)) = todo.pop() {
         let local_expr = LocalExpr(local.clone(), expr.clone());
         // Check if expr is a constant
         match expr.get() {
             Expr::Number(n) => {
                 // Add a response for this local state
-                ns.add_response(local_expr.clone(), *n);
+                ns.add_response(&local_expr, *n);
             }
             _ => {
                 // Get all possible results of executing this expression
-                let results = run_expr(exprhc, &expr, local.clone(), global.clone());
-
-                let mut new_globals = vec![];
-                let mut new_packets = vec![];
+                let successors = step(exprhc, vars, &expr, &local, &global);
 
-                for (result, new_local, new_global) in results {
-                    match result {
-                        ExprResult::Yielding(e) => {
-                            // Create a new expression to continue with
-                            let new_local_expr = LocalExpr(new_local.clone(), e.clone());
-
-                            // Add a transition from (local_expr, global) to (new_local_expr, new_global)
-                            ns.add_transition(
-                                local_expr.clone(),
-                                global.clone(),
-                                new_local_expr.clone(),
-                                new_global.clone(),
-                            );
-
-                            new_globals.push(new_global.clone());
-                            new_packets.push(new_local_expr.clone());
-                        }
-                        ExprResult::Returning(n) => {
-                            // Add new global state to track if it's new
-                            new_globals.push(new_global.clone());
-                            let new_local_expr = LocalExpr(new_local.clone(), exprhc.number(n));
-                            // Add a transition from (local_expr, global) to (new_local_expr, new_global)
-                            ns.add_transition(
-                                local_expr.clone(),
-                                global.clone(),
-                                new_local_expr.clone(),
-                                new_global.clone(),
-                            );
-                            new_packets.push(new_local_expr.clone());
-                        }
-                    }
+                for (new_local_expr, new_global) in &successors {
+                    // Add a transition from (local_expr, global) to (new_local_expr, new_global)
+                    ns.add_transition(&local_expr, &global, new_local_expr, new_global);
                 }
-                for new_global in new_globals {
+                for (_, new_global) in &successors {
                     if seen_globals.insert(new_global.clone()) {
                         // Add ALL combinations of seen packets and new global
                         for packet in seen_packets.iter() {
@@ -568,7 +804,7 @@ pub fn program_to_ns(
                     }
                 }
 
-                for packet in new_packets {
+                for (packet, _) in successors {
                     if seen_packets.insert(packet.clone()) {
                         // Add ALL combinations of seen globals and new packet
                         for global in seen_globals.iter() {
@@ -580,9 +816,430 @@ pub fn program_to_ns(
         }
     }
 
+}
+
+/// `program_to_ns` starting from the fragments earlier runs stored for the requests (see
+/// `incremental.rs`), and storing those that changed.
+///
+/// The packets of a stored fragment have been run against the globals it lists, so they
+/// start out seen and are only run against the other globals. Stored fragments may bring
+/// globals this program no longer reaches, so the result is cut down to its reachable
+/// part, which is the NS `program_to_ns` builds (up to the order of its vectors).
+fn program_to_ns_incremental(
+    exprhc: &ExprHc,
+    program: &Program,
+) -> NS<Global, LocalExpr, ExprRequest, i64> {
+    let mut ns = NSBuilder::new(Global::new());
+    let vars = Vars::of_program(program);
+    let mut seen_packets: HashSet<LocalExpr> = HashSet::default();
+    let mut seen_globals: HashSet<Global> = HashSet::default();
+    let mut todo = vec![];
+
+    let fragments: Vec<Option<crate::incremental::Fragment>> = program
+        .requests
+        .iter()
+        .map(|request| crate::incremental::load_fragment(exprhc, &request.body))
+        .collect();
+
+    for request in &program.requests {
+        ns.add_request(
+            ExprRequest {
+                name: request.name.to_string(),
+            },
+            &LocalExpr(Local::new(), request.body.clone()),
+        );
+    }
+    seen_globals.insert(Global::new());
+    for fragment in fragments.iter().flatten() {
+        seen_globals.extend(fragment.globals.iter().cloned());
+    }
+    for fragment in fragments.iter().flatten() {
+        let explored: HashSet<&Global> = fragment.globals.iter().collect();
+        for packet in &fragment.packets {
+            if seen_packets.insert(packet.clone()) {
+                for global in seen_globals
+                    .iter()
+                    .filter(|global| !explored.contains(global))
+                {
+                    todo.push((packet.1.clone(), packet.0.clone(), global.clone()));
+                }
+            }
+        }
+        for (local_expr, global, new_local_expr, new_global) in &fragment.transitions {
+            ns.add_transition(local_expr, global, new_local_expr, new_global);
+        }
+        for (local_expr, n) in &fragment.responses {
+            ns.add_response(local_expr, *n);
+        }
+    }
+
+    // The requests without a fragment start like in `program_to_ns`
+    for (request, fragment) in program.requests.iter().zip(&fragments) {
+        let packet = LocalExpr(Local::new(), request.body.clone());
+        if fragment.is_none() && seen_packets.insert(packet.clone()) {
+            for global in seen_globals.iter() {
+                todo.push((packet.1.clone(), packet.0.clone(), global.clone()));
+            }
+        }
+    }
+
+    explore(
+        exprhc,
+        &vars,
+        &mut ns,
+        &mut seen_packets,
+        &mut seen_globals,
+        todo,
+    );
+    let ns = reachable_part(ns.build());
+
+    let reused = fragments
+        .iter()
+        .filter(|fragment| fragment.is_some())
+        .count();
+    println!(
+        "Reused {} of {} request fragments from the incremental store",
+        reused,
+        fragments.len()
+    );
+    crate::stats::record_incremental_fragments(reused);
+    store_fragments(program, &ns, &fragments);
     ns
 }
 
+/// The part of `ns` reachable from its requests and initial global: the packets and globals
+/// a run can reach, with the transitions and responses between them
+fn reachable_part(
+    ns: NS<Global, LocalExpr, ExprRequest, i64>,
+) -> NS<Global, LocalExpr, ExprRequest, i64> {
+    let mut by_packet: HashMap<&LocalExpr, Vec<usize>> = HashMap::default();
+    let mut by_global: HashMap<&Global, Vec<usize>> = HashMap::default();
+    for (i, (local_expr, global, _, _)) in ns.transitions.iter().enumerate() {
+        by_packet.entry(local_expr).or_default().push(i);
+        by_global.entry(global).or_default().push(i);
+    }
+
+    // A transition is live once both its packet and its global are
+    let mut packets: HashSet<&LocalExpr> = HashSet::default();
+    let mut globals: HashSet<&Global> = HashSet::default();
+    let mut live = vec![false; ns.transitions.len()];
+    let mut new_packets: Vec<&LocalExpr> = ns.requests.iter().map(|(_, l)| l).collect();
+    let mut new_globals: Vec<&Global> = vec![&ns.initial_global];
+    while !new_packets.is_empty() || !new_globals.is_empty() {
+        let mut candidates = vec![];
+        for packet in new_packets.drain(..) {
+            if packets.insert(packet) {
+                candidates.extend(by_packet.get(packet).into_iter().flatten().copied());
+            }
+        }
+        for global in new_globals.drain(..) {
+            if globals.insert(global) {
+                candidates.extend(by_global.get(global).into_iter().flatten().copied());
+            }
+        }
+        for i in candidates {
+            let (local_expr, global, new_local_expr, new_global) = &ns.transitions[i];
+            if !live[i] && packets.contains(local_expr) && globals.contains(global) {
+                live[i] = true;
+                new_packets.push(new_local_expr);
+                new_globals.push(new_global);
+            }
+        }
+    }
+
+    NS {
+        initial_global: ns.initial_global.clone(),
+        requests: ns.requests.clone(),
+        responses: ns
+            .responses
+            .iter()
+            .filter(|(local_expr, _)| packets.contains(local_expr))
+            .cloned()
+            .collect(),
+        transitions: ns
+            .transitions
+            .iter()
+            .zip(&live)
+            .filter(|&(_, &live)| live)
+            .map(|(transition, _)| transition.clone())
+            .collect(),
+    }
+}
+
+/// Store the fragment of each request of `ns` whose stored one is missing or was run
+/// against other globals
+fn store_fragments(
+    program: &Program,
+    ns: &NS<Global, LocalExpr, ExprRequest, i64>,
+    stored: &[Option<crate::incremental::Fragment>],
+) {
+    let mut globals: Vec<Global> = ns.get_global_states().into_iter().cloned().collect();
+    globals.sort();
+    let global_set: HashSet<&Global> = globals.iter().collect();
+
+    let mut by_packet: HashMap<&LocalExpr, Vec<usize>> = HashMap::default();
+    for (i, (local_expr, _, _, _)) in ns.transitions.iter().enumerate() {
+        by_packet.entry(local_expr).or_default().push(i);
+    }
+    let mut responses: HashMap<&LocalExpr, Vec<i64>> = HashMap::default();
+    for (local_expr, n) in &ns.responses {
+        responses.entry(local_expr).or_default().push(*n);
+    }
+
+    for (request, stored) in program.requests.iter().zip(stored) {
+        if let Some(stored) = stored {
+            let stored_globals: HashSet<&Global> = stored.globals.iter().collect();
+            if stored_globals == global_set {
+                continue;
+            }
+        }
+
+        // Every live packet has been run against every live global
+        let start = LocalExpr(Local::new(), request.body.clone());
+        let mut fragment = crate::incremental::Fragment {
+            globals: globals.clone(),
+            ..Default::default()
+        };
+        let mut reached: HashSet<&LocalExpr> = HashSet::default();
+        let mut order = vec![&start];
+        reached.insert(&start);
+        let mut i = 0;
+        while i < order.len() {
+            let packet = order[i];
+            for &t in by_packet.get(packet).into_iter().flatten() {
+                let transition = &ns.transitions[t];
+                if reached.insert(&transition.2) {
+                    order.push(&transition.2);
+                }
+                fragment.transitions.push(transition.clone());
+            }
+            for &n in responses.get(packet).into_iter().flatten() {
+                fragment.responses.push((packet.clone(), n));
+            }
+            i += 1;
+        }
+        fragment.packets = order.into_iter().cloned().collect();
+        crate::incremental::store_fragment(&request.body, &fragment);
+    }
+}
+
+/// Work-stealing frontier: each worker pushes to and pops from its own stack, and a worker
+/// whose stack is empty steals the older half of another one.
+struct Frontier<T> {
+    stacks: Vec<Mutex<Vec<T>>>,
+    /// Items pushed but not yet finished
+    pending: AtomicUsize,
+}
+
+impl<T> Frontier<T> {
+    fn new(workers: usize) -> Self {
+        Frontier {
+            stacks: (0..workers).map(|_| Mutex::new(Vec::new())).collect(),
+            pending: AtomicUsize::new(0),
+        }
+    }
+
+    fn push(&self, worker: usize, items: impl IntoIterator<Item = T>) {
+        let mut stack = self.stacks[worker].lock().unwrap();
+        let before = stack.len();
+        stack.extend(items);
+        self.pending
+            .fetch_add(stack.len() - before, AtomicOrdering::SeqCst);
+    }
+
+    /// Next item for `worker`, or `None` once every pushed item has been finished
+    fn pop(&self, worker: usize) -> Option<T> {
+        loop {
+            if let Some(item) = self.stacks[worker].lock().unwrap().pop() {
+                return Some(item);
+            }
+            for offset in 1..self.stacks.len() {
+                let victim = (worker + offset) % self.stacks.len();
+                let stolen: Vec<T> = {
+                    let mut stack = self.stacks[victim].lock().unwrap();
+                    let half = stack.len().div_ceil(2);
+                    stack.drain(..half).collect()
+                };
+                if !stolen.is_empty() {
+                    let mut stack = self.stacks[worker].lock().unwrap();
+                    stack.extend(stolen);
+                    return stack.pop();
+                }
+            }
+            // Others may still push successors of the items they are working on
+            if self.pending.load(AtomicOrdering::SeqCst) == 0 {
+                return None;
+            }
+            std::thread::yield_now();
+        }
+    }
+
+    /// Mark a popped item as done, after its successors have been pushed
+    fn finish(&self) {
+        self.pending.fetch_sub(1, AtomicOrdering::SeqCst);
+    }
+}
+
+/// Hash set split into independently locked shards
+struct ShardedSet<T> {
+    shards: Vec<Mutex<HashSet<T>>>,
+}
+
+impl<T: Eq + Hash> ShardedSet<T> {
+    fn new(shards: usize) -> Self {
+        ShardedSet {
+            shards: (0..shards).map(|_| Mutex::new(HashSet::default())).collect(),
+        }
+    }
+
+    fn shard(&self, item: &T) -> &Mutex<HashSet<T>> {
+        let hash = DeterministicHasher::default().hash_one(item);
+        &self.shards[hash as usize % self.shards.len()]
+    }
+
+    fn contains(&self, item: &T) -> bool {
+        self.shard(item).lock().unwrap().contains(item)
+    }
+
+    fn insert(&self, item: T) -> bool {
+        self.shard(&item).lock().unwrap().insert(item)
+    }
+}
+
+/// Packets and globals seen by the parallel explorer.
+///
+/// Every (packet, global) pair has to be explored, and is pushed by whichever of the two is
+/// registered second. New registrations are therefore serialised by `lists`, while the
+/// common case of an already seen state only touches one shard.
+struct Seen {
+    packets: ShardedSet<LocalExpr>,
+    globals: ShardedSet<Global>,
+    lists: Mutex<(Vec<LocalExpr>, Vec<Global>)>,
+}
+
+impl Seen {
+    /// Register a packet, returning the globals it must be paired with (none if already seen)
+    fn add_packet(&self, packet: &LocalExpr) -> Vec<Global> {
+        if self.packets.contains(packet) {
+            return vec![];
+        }
+        let mut lists = self.lists.lock().unwrap();
+        if !self.packets.insert(packet.clone()) {
+            return vec![];
+        }
+        lists.0.push(packet.clone());
+        lists.1.clone()
+    }
+
+    /// Register a global, returning the packets it must be paired with (none if already seen)
+    fn add_global(&self, global: &Global) -> Vec<LocalExpr> {
+        if self.globals.contains(global) {
+            return vec![];
+        }
+        let mut lists = self.lists.lock().unwrap();
+        if !self.globals.insert(global.clone()) {
+            return vec![];
+        }
+        lists.1.push(global.clone());
+        lists.0.clone()
+    }
+}
+
+/// `program_to_ns` on `jobs` threads sharing one frontier and seen set.
+///
+/// Workers record responses and transitions locally; they are merged in sorted order, so
+/// the NS is the same for any number of threads (though ordered differently from the
+/// sequential exploration).
+fn program_to_ns_parallel(
+    exprhc: &ExprHc,
+    program: &Program,
+    jobs: usize,
+) -> NS<Global, LocalExpr, ExprRequest, i64> {
+    type Transition = (LocalExpr, Global, LocalExpr, Global);
+
+    let vars = Vars::of_program(program);
+    let frontier = Frontier::new(jobs);
+    let seen = Seen {
+        packets: ShardedSet::new(jobs * 4),
+        globals: ShardedSet::new(jobs * 4),
+        lists: Mutex::new((vec![], vec![])),
+    };
+
+    let mut ns = NSBuilder::new(Global::new());
+    for request in &program.requests {
+        let initial_local_expr = LocalExpr(Local::new(), request.body.clone());
+        ns.add_request(
+            ExprRequest {
+                name: request.name.to_string(),
+            },
+            &initial_local_expr,
+        );
+        seen.add_global(&Global::new());
+        seen.add_packet(&initial_local_expr);
+        frontier.push(0, [(request.body.clone(), Local::new(), Global::new())]);
+    }
+
+    let outputs: Vec<(Vec<(LocalExpr, i64)>, Vec<Transition>)> = std::thread::scope(|scope| {
+        let workers: Vec<_> = (0..jobs)
+            .map(|worker| {
+                let (vars, frontier, seen) = (&vars, &frontier, &seen);
+                scope.spawn(move || {
+                    let mut responses = vec![];
+                    let mut transitions = vec![];
+                    while let Some((expr, local, global)) = frontier.pop(worker) {
+                        let local_expr = LocalExpr(local.clone(), expr.clone());
+                        match expr.get() {
+                            Expr::Number(n) => responses.push((local_expr, *n)),
+                            _ => {
+                                let successors = step(exprhc, vars, &expr, &local, &global);
+                                let mut todo = vec![];
+                                for (packet, new_global) in &successors {
+                                    for seen_packet in seen.add_global(new_global) {
+                                        todo.push((seen_packet.1, seen_packet.0, new_global.clone()));
+                                    }
+                                    for global in seen.add_packet(packet) {
+                                        todo.push((packet.1.clone(), packet.0.clone(), global));
+                                    }
+                                }
+                                for (packet, new_global) in successors {
+                                    transitions.push((
+                                        local_expr.clone(),
+                                        global.clone(),
+                                        packet,
+                                        new_global,
+                                    ));
+                                }
+                                frontier.push(worker, todo);
+                            }
+                        }
+                        frontier.finish();
+                    }
+                    (responses, transitions)
+                })
+            })
+            .collect();
+        workers.into_iter().map(|w| w.join().unwrap()).collect()
+    });
+
+    let mut responses = vec![];
+    let mut transitions = vec![];
+    for (worker_responses, worker_transitions) in outputs {
+        responses.extend(worker_responses);
+        transitions.extend(worker_transitions);
+    }
+    responses.sort();
+    responses.dedup();
+    transitions.sort();
+    transitions.dedup();
+    for (local_expr, n) in &responses {
+        ns.add_response(local_expr, *n);
+    }
+    for (from_local, from_global, to_local, to_global) in &transitions {
+        ns.add_transition(from_local, from_global, to_local, to_global);
+    }
+    ns.build()
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -612,6 +1269,72 @@ mod tests {
         assert_eq!(env2.get("nonexistent"), 0); // Default value
     }
     
+    #[test]
+    fn test_env_assignment_order() {
+        let base = Env::new().insert("x".to_string(), 1);
+        let xy = base.clone().insert("y".to_string(), 2);
+        let yx = Env::new()
+            .insert("y".to_string(), 2)
+            .insert("x".to_string(), 1);
+
+        // Assignments leave the original environment untouched
+        assert_eq!(base.get("y"), 0);
+        assert_eq!(xy, yx);
+        assert_eq!(xy.to_string(), "{x=1,y=2}");
+
+        let mut set: HashSet<Env> = HashSet::default();
+        set.insert(xy.clone());
+        assert!(set.contains(&yx));
+
+        // Assigning 0 is the same as never assigning
+        assert_eq!(xy.insert("y".to_string(), 0), base);
+        assert_eq!(
+            serde_json::to_string(&yx).unwrap(),
+            r#"{"vars":{"x":1,"y":2}}"#
+        );
+    }
+
+    #[test]
+    fn test_parallel_program_to_ns_matches_sequential() {
+        let source = "request inc { if (X == 2) { X := 0 } else { X := X + 1 }; yield; X }
+            request flip { y := ?; yield; if (y == 1) { X := 0 } else { 0 }; y }";
+        let mut table = ExprHc::new();
+        let program = parse_program(source, &mut table).unwrap();
+
+        let mut expected = program_to_ns(&mut table, &program);
+        expected.responses.sort();
+        expected.transitions.sort();
+        for jobs in [1, 2, 4] {
+            let ns = program_to_ns_parallel(&table, &program, jobs);
+            assert_eq!(ns, expected, "jobs = {}", jobs);
+        }
+    }
+
+    #[test]
+    fn test_incremental_program_to_ns_matches_plain() {
+        use crate::incremental::with_store;
+
+        let sorted = |mut ns: NS<Global, LocalExpr, ExprRequest, i64>| {
+            ns.responses.sort();
+            ns.transitions.sort();
+            ns
+        };
+        let original = "request inc { if (X == 2) { X := 0 } else { X := X + 1 }; yield; X }
+            request flip { y := ?; yield; if (y == 1) { X := 0 } else { 0 }; y }";
+        // `flip` edited, `inc` unchanged
+        let edited = "request inc { if (X == 2) { X := 0 } else { X := X + 1 }; yield; X }
+            request flip { y := ?; yield; if (y == 1) { X := 1 } else { 0 }; y }";
+
+        let dir = tempfile::tempdir().unwrap();
+        let mut table = ExprHc::new();
+        for source in [original, original, edited, original] {
+            let program = parse_program(source, &mut table).unwrap();
+            let expected = sorted(program_to_ns(&mut table, &program));
+            let ns = with_store(dir.path(), || program_to_ns(&mut table, &program));
+            assert_eq!(sorted(ns.unwrap()), expected, "{}", source);
+        }
+    }
+
     #[test]
     fn test_empty_env_serialization() {
         let env = Env::new();
@@ -0,0 +1,476 @@
+//! On-disk store for incremental re-analysis (`--incremental`).
+//!
+//! Rerunning a program after editing one of its requests should not redo the work for
+//! the others. Two kinds of results are kept in `.ser_incremental`, or the directory
+//! given to `with_store` (a `CacheStore`, like the SMPT cache):
+//!
+//! - Per request, the NS fragment `program_to_ns` explored for it: the packets reachable
+//!   from the request body, their transitions and responses, and the globals they were run
+//!   against. The key is a stable hash of the (hash-consed) body. Running a packet only
+//!   depends on the packet and the global, so a fragment stays valid in any program; only
+//!   the globals it has not been run against are left to explore (see
+//!   `expr_to_ns::program_to_ns_incremental`).
+//! - The Kleene result (the semilinear set) of a serialized automaton, keyed by the
+//!   automaton's edges and the options that shape the result. ISL-backed Presburger
+//!   results are not stored.
+//!
+//! Expressions are stored as a table of nodes referring to their children by index, so a
+//! subexpression shared by many packets is written once. Loading re-interns them in the
+//! program's `ExprHc`. Anything that fails to load is treated as a miss.
+
+use crate::deterministic_map::HashMap;
+use crate::expr_to_ns::{Global, Local, LocalExpr};
+use crate::parser::{Expr, ExprHc};
+use crate::semilinear::{LinearSet, SemilinearSet, SparseVector};
+use crate::smpt_cache::{CacheStore, StableHasher};
+use colored::*;
+use hash_cons::Hc;
+use serde::{Deserialize, Serialize};
+use std::cell::RefCell;
+use std::fmt::Display;
+use std::hash::Hash;
+use std::path::Path;
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+/// Bumped whenever the stored format changes
+const STORE_FORMAT_VERSION: u64 = 1;
+
+const STORE_DIR: &str = ".ser_incremental";
+
+static INCREMENTAL: AtomicBool = AtomicBool::new(false);
+
+static STORE: Mutex<Option<CacheStore>> = Mutex::new(None);
+
+thread_local! {
+    /// Store of the analysis running on this thread, in place of `STORE` (see `with_store`)
+    static THREAD_STORE: RefCell<Option<CacheStore>> = const { RefCell::new(None) };
+}
+
+/// Enable the store, opening (or creating) it in `.ser_incremental`
+pub fn set_incremental(on: bool) {
+    if !on {
+        INCREMENTAL.store(false, Ordering::SeqCst);
+        return;
+    }
+    match CacheStore::open(Path::new(STORE_DIR)) {
+        Ok(store) => {
+            println!(
+                "{} incremental re-analysis ({} stored results)",
+                "Enabled".green().bold(),
+                store.len()
+            );
+            *STORE.lock().unwrap() = Some(store);
+            INCREMENTAL.store(true, Ordering::SeqCst);
+        }
+        Err(e) => {
+            eprintln!(
+                "{}: Failed to open incremental store in {}: {}",
+                "Warning".yellow(),
+                STORE_DIR,
+                e
+            );
+        }
+    }
+}
+
+pub fn incremental_enabled() -> bool {
+    INCREMENTAL.load(Ordering::SeqCst) || THREAD_STORE.with(|store| store.borrow().is_some())
+}
+
+/// Run `f` with incremental re-analysis on this thread only, using the store in `dir`
+/// instead of `.ser_incremental`
+pub fn with_store<R>(dir: &Path, f: impl FnOnce() -> R) -> std::io::Result<R> {
+    let store = CacheStore::open(dir)?;
+    let previous = THREAD_STORE.with(|slot| slot.replace(Some(store)));
+    let result = f();
+    THREAD_STORE.with(|slot| *slot.borrow_mut() = previous);
+    Ok(result)
+}
+
+/// Apply `f` to the store of this thread, or else to the one of `--incremental`
+fn with_active_store<R>(f: impl FnOnce(&mut CacheStore) -> R) -> Option<R> {
+    THREAD_STORE.with(|scoped| match scoped.borrow_mut().as_mut() {
+        Some(store) => Some(f(store)),
+        None => STORE.lock().unwrap().as_mut().map(f),
+    })
+}
+
+fn load(key: (u64, u64)) -> Option<Vec<u8>> {
+    with_active_store(|store| store.get(key.0, key.1)).flatten()
+}
+
+fn save(key: (u64, u64), value: &impl Serialize) {
+    let Ok(bytes) = serde_json::to_vec(value) else {
+        return;
+    };
+    if let Some(Err(e)) = with_active_store(|store| store.put(key.0, key.1, &bytes, None)) {
+        eprintln!(
+            "{}: Failed to write incremental store entry: {}",
+            "Warning".yellow(),
+            e
+        );
+    }
+}
+
+fn hasher(kind: &str) -> StableHasher {
+    let mut hasher = StableHasher::new();
+    hasher.write_u64(STORE_FORMAT_VERSION);
+    hasher.write_str(kind);
+    hasher
+}
+
+/// An `Expr` whose subexpressions are indices into the node table
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+enum Node {
+    Assign(String, u32),
+    Equal(u32, u32),
+    Add(u32, u32),
+    Subtract(u32, u32),
+    Sequence(u32, u32),
+    If(u32, u32, u32),
+    While(u32, u32),
+    Not(u32),
+    And(u32, u32),
+    Or(u32, u32),
+    Yield,
+    Exit,
+    Unknown,
+    Number(i64),
+    Variable(String),
+}
+
+/// Builds a node table, children before parents, one node per hash-consed expression
+#[derive(Default)]
+struct Encoder {
+    nodes: Vec<Node>,
+    ids: HashMap<*const Expr, u32>,
+}
+
+impl Encoder {
+    fn encode(&mut self, expr: &Hc<Expr>) -> u32 {
+        let ptr: *const Expr = &**expr;
+        if let Some(&id) = self.ids.get(&ptr) {
+            return id;
+        }
+        let node = match &**expr {
+            Expr::Assign(var, e) => Node::Assign(var.clone(), self.encode(e)),
+            Expr::Equal(e1, e2) => Node::Equal(self.encode(e1), self.encode(e2)),
+            Expr::Add(e1, e2) => Node::Add(self.encode(e1), self.encode(e2)),
+            Expr::Subtract(e1, e2) => Node::Subtract(self.encode(e1), self.encode(e2)),
+            Expr::Sequence(e1, e2) => Node::Sequence(self.encode(e1), self.encode(e2)),
+            Expr::If(c, t, e) => Node::If(self.encode(c), self.encode(t), self.encode(e)),
+            Expr::While(c, b) => Node::While(self.encode(c), self.encode(b)),
+            Expr::Not(e) => Node::Not(self.encode(e)),
+            Expr::And(e1, e2) => Node::And(self.encode(e1), self.encode(e2)),
+            Expr::Or(e1, e2) => Node::Or(self.encode(e1), self.encode(e2)),
+            Expr::Yield => Node::Yield,
+            Expr::Exit => Node::Exit,
+            Expr::Unknown => Node::Unknown,
+            Expr::Number(n) => Node::Number(*n),
+            Expr::Variable(var) => Node::Variable(var.clone()),
+        };
+        let id = self.nodes.len() as u32;
+        self.nodes.push(node);
+        self.ids.insert(ptr, id);
+        id
+    }
+}
+
+/// Intern a node table in `exprhc`; `None` if a node refers to a later one
+fn decode(exprhc: &ExprHc, nodes: &[Node]) -> Option<Vec<Hc<Expr>>> {
+    let mut exprs: Vec<Hc<Expr>> = Vec::with_capacity(nodes.len());
+    for node in nodes {
+        let e = |id: &u32| exprs.get(*id as usize).cloned();
+        let expr = match node {
+            Node::Assign(var, a) => Expr::Assign(var.clone(), e(a)?),
+            Node::Equal(a, b) => Expr::Equal(e(a)?, e(b)?),
+            Node::Add(a, b) => Expr::Add(e(a)?, e(b)?),
+            Node::Subtract(a, b) => Expr::Subtract(e(a)?, e(b)?),
+            Node::Sequence(a, b) => Expr::Sequence(e(a)?, e(b)?),
+            Node::If(c, t, f) => Expr::If(e(c)?, e(t)?, e(f)?),
+            Node::While(c, b) => Expr::While(e(c)?, e(b)?),
+            Node::Not(a) => Expr::Not(e(a)?),
+            Node::And(a, b) => Expr::And(e(a)?, e(b)?),
+            Node::Or(a, b) => Expr::Or(e(a)?, e(b)?),
+            Node::Yield => Expr::Yield,
+            Node::Exit => Expr::Exit,
+            Node::Unknown => Expr::Unknown,
+            Node::Number(n) => Expr::Number(*n),
+            Node::Variable(var) => Expr::Variable(var.clone()),
+        };
+        exprs.push(exprhc.node(expr));
+    }
+    Some(exprs)
+}
+
+/// What `program_to_ns` explored for one request body
+#[derive(Debug, Clone, Default)]
+pub struct Fragment {
+    /// The globals every packet has been run against
+    pub globals: Vec<Global>,
+    /// The packets reachable from the request body, which comes first
+    pub packets: Vec<LocalExpr>,
+    pub transitions: Vec<(LocalExpr, Global, LocalExpr, Global)>,
+    pub responses: Vec<(LocalExpr, i64)>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct FragmentRepr {
+    nodes: Vec<Node>,
+    globals: Vec<Global>,
+    packets: Vec<(Local, u32)>,
+    transitions: Vec<[u32; 4]>,
+    responses: Vec<(u32, i64)>,
+}
+
+fn fragment_key(body: &Hc<Expr>) -> (u64, u64) {
+    let mut encoder = Encoder::default();
+    encoder.encode(body);
+    let mut hasher = hasher("fragment");
+    hasher.write_str(&serde_json::to_string(&encoder.nodes).unwrap_or_default());
+    hasher.finish()
+}
+
+/// The fragment stored for `body`, with its expressions interned in `exprhc`
+pub fn load_fragment(exprhc: &ExprHc, body: &Hc<Expr>) -> Option<Fragment> {
+    if !incremental_enabled() {
+        return None;
+    }
+    let bytes = load(fragment_key(body))?;
+    let repr: FragmentRepr = serde_json::from_slice(&bytes).ok()?;
+    let exprs = decode(exprhc, &repr.nodes)?;
+
+    let packets = repr
+        .packets
+        .into_iter()
+        .map(|(local, id)| Some(LocalExpr(local, exprs.get(id as usize)?.clone())))
+        .collect::<Option<Vec<_>>>()?;
+    let packet = |id: u32| packets.get(id as usize).cloned();
+    let global = |id: u32| repr.globals.get(id as usize).cloned();
+    let transitions = repr
+        .transitions
+        .iter()
+        .map(|&[l, g, l2, g2]| Some((packet(l)?, global(g)?, packet(l2)?, global(g2)?)))
+        .collect::<Option<Vec<_>>>()?;
+    let responses = repr
+        .responses
+        .iter()
+        .map(|&(l, n)| Some((packet(l)?, n)))
+        .collect::<Option<Vec<_>>>()?;
+    // The body must be the first packet, or the entry belongs to another body
+    if packets.first().is_none_or(|first| first.1 != *body) {
+        return None;
+    }
+    Some(Fragment {
+        globals: repr.globals,
+        packets,
+        transitions,
+        responses,
+    })
+}
+
+/// Store the fragment explored for `body`
+pub fn store_fragment(body: &Hc<Expr>, fragment: &Fragment) {
+    if !incremental_enabled() {
+        return;
+    }
+    let mut encoder = Encoder::default();
+    let packet_ids: HashMap<&LocalExpr, u32> = fragment
+        .packets
+        .iter()
+        .enumerate()
+        .map(|(i, packet)| (packet, i as u32))
+        .collect();
+    let global_ids: HashMap<&Global, u32> = fragment
+        .globals
+        .iter()
+        .enumerate()
+        .map(|(i, global)| (global, i as u32))
+        .collect();
+    let packets = fragment
+        .packets
+        .iter()
+        .map(|packet| (packet.0.clone(), encoder.encode(&packet.1)))
+        .collect();
+    let transitions = fragment
+        .transitions
+        .iter()
+        .filter_map(|(l, g, l2, g2)| {
+            Some([
+                *packet_ids.get(l)?,
+                *global_ids.get(g)?,
+                *packet_ids.get(l2)?,
+                *global_ids.get(g2)?,
+            ])
+        })
+        .collect();
+    let responses = fragment
+        .responses
+        .iter()
+        .filter_map(|(l, n)| Some((*packet_ids.get(l)?, *n)))
+        .collect();
+    let repr = FragmentRepr {
+        nodes: encoder.nodes,
+        globals: fragment.globals.clone(),
+        packets,
+        transitions,
+        responses,
+    };
+    save(fragment_key(body), &repr);
+}
+
+/// A semilinear set over the `Display` of its keys, sorted
+#[derive(Serialize, Deserialize)]
+struct SemilinearRepr {
+    components: Vec<(Vec<(String, usize)>, Vec<Vec<(String, usize)>>)>,
+}
+
+fn vector_repr<K: Eq + Hash + Clone + Ord + Display>(v: &SparseVector<K>) -> Vec<(String, usize)> {
+    let mut entries: Vec<_> = v.values.iter().map(|(k, &n)| (k.to_string(), n)).collect();
+    entries.sort();
+    entries
+}
+
+/// Key of the Kleene result of a serialized automaton with edges `(g, atom, g')` from
+/// `start`, by their `Display` (which, as for the SMPT nets, identifies them)
+pub fn automaton_key<G: Display, A: Display>(
+    kind: &str,
+    edges: &[(G, A, G)],
+    start: &G,
+) -> (u64, u64) {
+    let mut hasher = hasher(kind);
+    hasher.write_str(&start.to_string());
+    // The options that change the representation that is computed
+    hasher.write_str(crate::kleene::elimination_order().name());
+    hasher.write_u64(crate::kleene::SMART_ORDER.load(Ordering::SeqCst) as u64);
+    hasher.write_u64(crate::semilinear::REMOVE_REDUNDANT.load(Ordering::SeqCst) as u64);
+    hasher.write_u64(crate::semilinear::GENERATE_LESS.load(Ordering::SeqCst) as u64);
+    hasher.write_u64(crate::semilinear::STAR_COMPONENT_BUDGET.load(Ordering::SeqCst) as u64);
+    let mut lines: Vec<String> = edges
+        .iter()
+        .map(|(g, atom, g2)| format!("{g}\t{atom}\t{g2}"))
+        .collect();
+    lines.sort();
+    hasher.write_u64(lines.len() as u64);
+    for line in &lines {
+        hasher.write_str(line);
+    }
+    hasher.finish()
+}
+
+/// The semilinear set stored under `key`, with its keys looked up in `atoms` by `Display`
+pub fn load_semilinear<A: Eq + Hash + Clone + Ord>(
+    key: (u64, u64),
+    atoms: &HashMap<String, A>,
+) -> Option<SemilinearSet<A>> {
+    if !incremental_enabled() {
+        return None;
+    }
+    let repr: SemilinearRepr = serde_json::from_slice(&load(key)?).ok()?;
+    let vector = |entries: Vec<(String, usize)>| {
+        let values = entries
+            .into_iter()
+            .map(|(k, n)| Some((atoms.get(&k)?.clone(), n)))
+            .collect::<Option<HashMap<_, _>>>()?;
+        Some(SparseVector { values })
+    };
+    let components = repr
+        .components
+        .into_iter()
+        .map(|(base, periods)| {
+            Some(LinearSet {
+                base: vector(base)?,
+                periods: periods.into_iter().map(vector).collect::<Option<_>>()?,
+            })
+        })
+        .collect::<Option<Vec<_>>>()?;
+    crate::stats::record_incremental_semilinear_reused();
+    Some(SemilinearSet { components })
+}
+
+pub fn store_semilinear<A: Eq + Hash + Clone + Ord + Display>(
+    key: (u64, u64),
+    set: &SemilinearSet<A>,
+) {
+    if !incremental_enabled() {
+        return;
+    }
+    let repr = SemilinearRepr {
+        components: set
+            .components
+            .iter()
+            .map(|c| {
+                (
+                    vector_repr(&c.base),
+                    c.periods.iter().map(vector_repr).collect(),
+                )
+            })
+            .collect(),
+    };
+    save(key, &repr);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::kleene::Kleene;
+    use crate::parser::parse;
+
+    #[test]
+    fn test_node_table_roundtrip() {
+        let source = "x := 1; while(X == 0){ yield }; x + X";
+        let expr = parse(source, &mut ExprHc::new()).unwrap();
+
+        let mut encoder = Encoder::default();
+        let root = encoder.encode(&expr) as usize;
+        assert_eq!(root, encoder.nodes.len() - 1);
+
+        // Decoding into another table gives the node that table has for the expression
+        let mut table = ExprHc::new();
+        let reparsed = parse(source, &mut table).unwrap();
+        let decoded = decode(&table, &encoder.nodes).unwrap();
+        assert_eq!(decoded[root].to_string(), expr.to_string());
+        assert!(std::ptr::eq(&*decoded[root], &*reparsed));
+
+        // Children must come before their parents
+        assert!(decode(&table, &[Node::Not(0)]).is_none());
+    }
+
+    #[test]
+    fn test_semilinear_store_roundtrip() {
+        let atom = |name: &str| SemilinearSet::atom(name.to_string());
+        let set = atom("a").times(atom("b").star());
+        let edges = [(0, "a", 1), (1, "b", 1)];
+        let key = automaton_key("semilinear", &edges, &0);
+        let atoms: HashMap<String, String> = ["a", "b"]
+            .into_iter()
+            .map(|atom| (atom.to_string(), atom.to_string()))
+            .collect();
+
+        let dir = tempfile::tempdir().unwrap();
+        with_store(dir.path(), || {
+            assert!(load_semilinear(key, &atoms).is_none());
+            store_semilinear(key, &set);
+            let loaded = load_semilinear(key, &atoms).unwrap();
+            assert_eq!(loaded.to_string(), set.to_string());
+
+            // Atoms the program no longer has are a miss
+            let fewer: HashMap<String, String> = atoms
+                .iter()
+                .filter(|(k, _)| k.as_str() == "a")
+                .map(|(k, v)| (k.clone(), v.clone()))
+                .collect();
+            assert!(load_semilinear(key, &fewer).is_none());
+        })
+        .unwrap();
+
+        // Reopening the store finds the set, under the same key only
+        with_store(dir.path(), || {
+            assert!(load_semilinear(key, &atoms).is_some());
+            let other = automaton_key("semilinear", &edges[..1], &0);
+            assert!(load_semilinear(other, &atoms).is_none());
+        })
+        .unwrap();
+    }
+}
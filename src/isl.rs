@@ -9,12 +9,146 @@ pub mod bindings {
 }
 pub use bindings::*;
 
+use std::cell::Cell;
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
+/// Maximum number of ISL operations per ctx in a budgeted analysis (0 = unlimited)
+static MAX_OPERATIONS: AtomicU64 = AtomicU64::new(0);
+
+/// Whether directory runs free the ISL ctx after each file (`--isl-reset-ctx`)
+static RESET_PER_FILE: AtomicBool = AtomicBool::new(false);
+
+pub fn set_max_operations(max: u64) {
+    MAX_OPERATIONS.store(max, Ordering::SeqCst);
+}
+
+pub fn max_operations() -> u64 {
+    MAX_OPERATIONS.load(Ordering::SeqCst)
+}
+
+pub fn set_reset_per_file(on: bool) {
+    RESET_PER_FILE.store(on, Ordering::SeqCst);
+}
+
+pub fn reset_per_file() -> bool {
+    RESET_PER_FILE.load(Ordering::SeqCst)
+}
+
+/// Whether the analysis running on this thread is inside `with_operation_budget`
+pub fn budget_active() -> bool {
+    BUDGET_ACTIVE.with(Cell::get)
+}
+
+/// Mark this thread as part of a budgeted analysis, or not.
+///
+/// Called by pool threads (see `parallel.rs`) with the flag of the thread that started
+/// them, so that their ctxs get a budget and running out of it unwinds as
+/// `OperationBudgetExceeded`.
+pub fn set_budget_active(active: bool) {
+    BUDGET_ACTIVE.with(|slot| slot.set(active));
+}
+
+/// Payload of the unwind raised by `check_budget`, caught by `with_operation_budget`
+#[derive(Debug)]
+pub struct OperationBudgetExceeded;
+
 /// Get the (thread-local, unique) ISL ctx.
 ///
 /// This is preferred over manually calling isl_ctx_alloc() to make sure there's only one isl_ctx.
 pub fn get_ctx() -> *mut isl_ctx {
-    thread_local! {
-        static ISL_CTX: *mut isl_ctx = unsafe { isl_ctx_alloc() };
+    ISL_CTX.with(|ctx| {
+        if ctx.get().is_null() {
+            let raw = unsafe { isl_ctx_alloc() };
+            // Worker threads started during a budgeted analysis get their own budget
+            if budget_active() {
+                unsafe { isl_ctx_set_max_operations(raw, max_operations() as _) };
+            }
+            ctx.set(raw);
+        }
+        ctx.get()
+    })
+}
+
+/// Free the current thread's ISL ctx, if it has one.
+///
+/// Called by short-lived worker threads (see `parallel.rs`) before they exit, so that
+/// every worker doesn't leak a ctx. All sets created on this thread must already be
+/// freed; ISL refuses to free a ctx that is still referenced.
+pub fn free_thread_ctx() {
+    ISL_CTX.with(|ctx| {
+        let raw = ctx.replace(std::ptr::null_mut());
+        if !raw.is_null() {
+            unsafe { isl_ctx_free(raw) };
+        }
+    })
+}
+
+/// Fail if the current thread's ctx has run out of its operation budget.
+///
+/// Over budget, ISL operations return NULL (or `isl_bool_error`), so this is called
+/// wherever a NULL result would otherwise be turned into an answer. Inside
+/// `with_operation_budget` it unwinds with `OperationBudgetExceeded`.
+pub fn check_budget() {
+    let ctx = get_ctx();
+    if unsafe { isl_ctx_last_error(ctx) } != isl_error_isl_error_quota {
+        return;
+    }
+    unsafe { isl_ctx_reset_error(ctx) };
+    if budget_active() {
+        panic::resume_unwind(Box::new(OperationBudgetExceeded));
     }
-    ISL_CTX.with(|ctx| *ctx)
+    panic!("ISL operation budget of {} exceeded", max_operations());
+}
+
+/// Run `f` with at most `max_operations()` ISL operations per ctx.
+///
+/// Returns `Err` with a message if a ctx ran out of its budget. Results that were
+/// cached while over budget may be bogus, so the formula cache is cleared in that case.
+pub fn with_operation_budget<R>(f: impl FnOnce() -> R) -> Result<R, String> {
+    let max = max_operations();
+    if max == 0 {
+        return Ok(f());
+    }
+
+    let ctx = get_ctx();
+    unsafe {
+        isl_ctx_reset_operations(ctx);
+        isl_ctx_reset_error(ctx);
+        isl_ctx_set_max_operations(ctx, max as _);
+    }
+    let previous = BUDGET_ACTIVE.with(|slot| slot.replace(true));
+    let result = panic::catch_unwind(AssertUnwindSafe(f));
+    set_budget_active(previous);
+    unsafe {
+        isl_ctx_set_max_operations(ctx, 0);
+        isl_ctx_reset_operations(ctx);
+        isl_ctx_reset_error(ctx);
+    }
+
+    match result {
+        Ok(result) => Ok(result),
+        Err(payload) if payload.is::<OperationBudgetExceeded>() => {
+            crate::proofinvariant_to_presburger::clear_formula_cache();
+            Err(format!(
+                "ISL operation budget exceeded ({} operations, see --isl-max-ops)",
+                max
+            ))
+        }
+        Err(payload) => panic::resume_unwind(payload),
+    }
+}
+
+/// Release the ISL memory of the current thread: the sets cached on it, then its ctx.
+///
+/// The next `get_ctx` allocates a fresh ctx.
+pub fn reset_thread_ctx() {
+    crate::proofinvariant_to_presburger::clear_formula_cache();
+    free_thread_ctx();
+}
+
+thread_local! {
+    static ISL_CTX: std::cell::Cell<*mut isl_ctx> = const { std::cell::Cell::new(std::ptr::null_mut()) };
+    /// Whether a `with_operation_budget` analysis is running on this thread
+    static BUDGET_ACTIVE: Cell<bool> = const { Cell::new(false) };
 }
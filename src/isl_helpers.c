@@ -3,6 +3,11 @@
 #include <isl/set.h>
 #include <isl/aff.h>
 #include <isl/list.h>
+#include <isl/val.h>
+#include <isl/local_space.h>
+#include <isl/constraint.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Define a struct to return the two resulting sets
 typedef struct {
@@ -234,4 +239,221 @@ HarmonizeResult rust_harmonize_sets_with_mapping(
     isl_space_free(space2);
 
     return result;
-}
\ No newline at end of file
+}
+
+// N-ary harmonization: embed every set of an array into one target space of
+// target_dims set dimensions, with a single preimage per set.
+//
+// indices is the concatenation of one index array per set: dimension i of set k
+// goes to target position indices[offset_k + i], where offset_k is the sum of
+// dims[0..k]. Positions may be in any order, so this also reorders dimensions.
+// Target dimensions not hit by a set are fixed to 0 in that set.
+//
+// Consumes every sets[k] and replaces it with the harmonized set.
+// Returns 0 on success; on error all sets are freed, set to NULL, and 1 is returned.
+int rust_harmonize_sets_n(
+    isl_set **sets,
+    int n_sets,
+    int target_dims,
+    const int *indices,
+    const int *dims)
+{
+    if (!sets || n_sets < 0 || target_dims < 0 || (n_sets > 0 && (!indices || !dims))) {
+        return 1;
+    }
+
+    int error = 0;
+    isl_space *target_space = NULL;
+    char *used = NULL;
+
+    for (int k = 0; k < n_sets; ++k) {
+        if (!sets[k]) {
+            error = 1;
+            break;
+        }
+    }
+
+    if (!error && n_sets > 0) {
+        isl_ctx *ctx = isl_set_get_ctx(sets[0]);
+        target_space = isl_space_set_alloc(ctx, 0, target_dims);
+        used = target_dims > 0 ? (char *)malloc(target_dims) : NULL;
+        if (!target_space || (target_dims > 0 && !used)) {
+            error = 1;
+        }
+    }
+
+    int offset = 0;
+    for (int k = 0; k < n_sets && !error; ++k) {
+        const int *set_indices = indices + offset;
+        int set_dims = dims[k];
+        offset += set_dims;
+
+        if (target_dims > 0) {
+            memset(used, 0, target_dims);
+        }
+        for (int i = 0; i < set_dims; ++i) {
+            if (set_indices[i] < 0 || set_indices[i] >= target_dims) {
+                error = 1;
+                break;
+            }
+            used[set_indices[i]] = 1;
+        }
+        if (error) {
+            break;
+        }
+
+        isl_set *aligned = isl_set_align_params(sets[k], isl_space_copy(target_space));
+        sets[k] = NULL;
+        if (!aligned) {
+            error = 1;
+            break;
+        }
+
+        isl_multi_aff *ma = create_preimage_map_with_mapping(
+            target_space, isl_set_get_space(aligned), set_indices, set_dims);
+        if (!ma) {
+            isl_set_free(aligned);
+            error = 1;
+            break;
+        }
+
+        isl_set *result = isl_set_preimage_multi_aff(aligned, ma);
+        for (int pos = 0; pos < target_dims && result; ++pos) {
+            if (!used[pos]) {
+                result = isl_set_fix_si(result, isl_dim_set, pos, 0);
+            }
+        }
+        if (!result) {
+            error = 1;
+            break;
+        }
+        sets[k] = result;
+    }
+
+    if (error) {
+        for (int k = 0; k < n_sets; ++k) {
+            isl_set_free(sets[k]);
+            sets[k] = NULL;
+        }
+    }
+
+    free(used);
+    isl_space_free(target_space);
+    return error;
+}
+
+
+// Build a set over n_dims dimensions directly from a dense constraint matrix,
+// without printing and re-parsing an ISL string.
+// Row k of coeffs holds n_dims + n_exists + 1 entries: the coefficients of the
+// set dimensions, then of the existential variables, then the constant term.
+// is_eq[k] selects "row = 0" (non-zero) or "row >= 0" (zero).
+// The existential variables are projected out at the end, which turns them into
+// divs just like "{ [...] : exists (e0, ... : ...) }" does in the parser.
+// Returns NULL on error.
+isl_set *rust_set_from_constraints(
+    isl_ctx *ctx,
+    int n_dims,
+    int n_exists,
+    int n_constraints,
+    const int *is_eq,
+    const long *coeffs)
+{
+    int n_vars = n_dims + n_exists;
+    isl_space *space = isl_space_set_alloc(ctx, 0, n_vars);
+    isl_local_space *ls = isl_local_space_from_space(isl_space_copy(space));
+    isl_basic_set *bset = isl_basic_set_universe(space);
+
+    for (int k = 0; k < n_constraints && bset; ++k) {
+        const long *row = coeffs + (size_t)k * (n_vars + 1);
+        isl_constraint *c = is_eq[k]
+            ? isl_constraint_alloc_equality(isl_local_space_copy(ls))
+            : isl_constraint_alloc_inequality(isl_local_space_copy(ls));
+
+        for (int j = 0; j < n_vars; ++j) {
+            if (row[j] != 0) {
+                c = isl_constraint_set_coefficient_val(
+                    c, isl_dim_set, j, isl_val_int_from_si(ctx, row[j]));
+            }
+        }
+        c = isl_constraint_set_constant_val(c, isl_val_int_from_si(ctx, row[n_vars]));
+
+        bset = isl_basic_set_add_constraint(bset, c); // Consumes c
+    }
+
+    isl_local_space_free(ls);
+    if (!bset) {
+        return NULL;
+    }
+
+    bset = isl_basic_set_project_out(bset, isl_dim_set, n_dims, n_exists);
+    return isl_set_from_basic_set(bset);
+}
+
+// Normalize a set of place counts before its basic sets become reachability
+// queries, one per basic set:
+// - coalesce, which merges basic sets whose union is convex,
+// - drop every basic set contained in another one (of equal ones, the first stays),
+// - simplify the constraints of the others against the non-negative orthant,
+//   then remove redundant ones.
+// The result agrees with the input on non-negative points only.
+// Consumes set; returns NULL on error.
+isl_set *rust_set_normalize_disjuncts(isl_set *set)
+{
+    if (!set) {
+        return NULL;
+    }
+
+    isl_basic_set *orthant = isl_basic_set_positive_orthant(isl_set_get_space(set));
+    set = isl_set_intersect(set, isl_set_from_basic_set(isl_basic_set_copy(orthant)));
+    set = isl_set_coalesce(set);
+
+    isl_basic_set_list *list = isl_set_get_basic_set_list(set);
+    isl_set_free(set);
+    int n = list ? isl_basic_set_list_n_basic_set(list) : -1;
+    if (n < 0) {
+        isl_basic_set_list_free(list);
+        isl_basic_set_free(orthant);
+        return NULL;
+    }
+
+    isl_set *result = isl_set_empty(isl_basic_set_get_space(orthant));
+    for (int i = 0; i < n && result; ++i) {
+        isl_basic_set *bi = isl_basic_set_list_get_basic_set(list, i);
+        int subsumed = 0;
+        for (int j = 0; j < n && !subsumed; ++j) {
+            if (j == i) {
+                continue;
+            }
+            isl_basic_set *bj = isl_basic_set_list_get_basic_set(list, j);
+            isl_bool sub = isl_basic_set_is_subset(bi, bj);
+            if (sub == isl_bool_true && j > i) {
+                // Equal basic sets subsume each other; keep the first one
+                sub = isl_bool_not(isl_basic_set_is_subset(bj, bi));
+            }
+            isl_basic_set_free(bj);
+            if (sub < 0) {
+                subsumed = -1;
+            } else if (sub) {
+                subsumed = 1;
+            }
+        }
+        if (subsumed < 0) {
+            isl_basic_set_free(bi);
+            result = isl_set_free(result);
+            break;
+        }
+        if (subsumed) {
+            isl_basic_set_free(bi);
+            continue;
+        }
+
+        bi = isl_basic_set_gist(bi, isl_basic_set_copy(orthant));
+        bi = isl_basic_set_remove_redundancies(bi);
+        result = isl_set_union(result, isl_set_from_basic_set(bi));
+    }
+
+    isl_basic_set_list_free(list);
+    isl_basic_set_free(orthant);
+    return result;
+}
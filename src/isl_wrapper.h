@@ -30,4 +30,32 @@ HarmonizeResult rust_harmonize_sets_with_mapping(
     int set1_dims,            // Number of dimensions in set1
     const int *set2_indices,  // Array mapping set2 dimensions to target positions  
     int set2_dims             // Number of dimensions in set2
-);
\ No newline at end of file
+);
+
+// N-ary harmonization: embeds all n_sets sets into one space of target_dims
+// dimensions with one preimage per set (see isl_helpers.c). Consumes and
+// replaces sets[k]; returns 0 on success.
+int rust_harmonize_sets_n(
+    isl_set **sets,
+    int n_sets,
+    int target_dims,
+    const int *indices,       // Concatenated per-set arrays of target positions
+    const int *dims           // Number of dimensions of each set
+);
+
+// Direct construction: builds the set { [x] : exists e : A [x, e, 1] (=|>=) 0 }
+// from a dense row-major matrix with n_dims + n_exists + 1 columns (see
+// isl_helpers.c). is_eq[k] != 0 makes row k an equality. Returns NULL on error.
+isl_set *rust_set_from_constraints(
+    isl_ctx *ctx,
+    int n_dims,
+    int n_exists,
+    int n_constraints,
+    const int *is_eq,
+    const long *coeffs
+);
+
+// Coalesces a set of place counts, drops basic sets contained in others and
+// simplifies the rest against the non-negative orthant (see isl_helpers.c).
+// Consumes set; returns NULL on error.
+isl_set *rust_set_normalize_disjuncts(isl_set *set);
@@ -6,8 +6,13 @@
 // - zero
 
 use crate::deterministic_map::{HashMap, HashSet};
+use crate::stats::KleeneEliminationStats;
 
-use std::sync::atomic::{AtomicBool, Ordering};
+use std::cell::RefCell;
+use std::cmp::Reverse;
+use std::collections::btree_map::Entry;
+use std::collections::{BTreeMap, BTreeSet, BinaryHeap};
+use std::sync::atomic::{AtomicBool, AtomicU8, Ordering};
 
 use crate::semilinear::GENERATE_LESS;
 
@@ -23,6 +28,11 @@ pub trait Kleene {
     fn plus(self, other: Self) -> Self;
     fn times(self, other: Self) -> Self;
     fn star(self) -> Self;
+
+    /// Rough size of an element, used to weigh elimination orders (1 if unknown)
+    fn weight(&self) -> usize {
+        1
+    }
 }
 
 impl Kleene for bool {
@@ -110,110 +120,297 @@ impl<T> Kleene for Regex<T> {
     }
 }
 
-// Kleene's algorithm for converting a NFA to a Kleene algebra
-// Takes a start state and computes the Kleene element for going from the start state to any other state
-pub fn nfa_to_kleene<S: Clone + Eq + std::hash::Hash, K: Kleene + Clone>(
-    nfa_vec: &[(S, K, S)],
-    start: S,
-) -> K {
-    // We add an extra state `None` and eliminate all states except that one
+/// Heuristic choosing the next state `nfa_to_kleene` eliminates (`--kleene-order`)
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum EliminationOrder {
+    /// Iteration order of the states (`--without-smart-kleene-order`)
+    Arbitrary = 0,
+    /// States with a self loop first, then fewest incoming plus outgoing edges
+    Smart = 1,
+    /// Fewest incoming plus outgoing edges
+    MinDegree = 2,
+    /// Fewest shortcut edges that do not exist yet
+    MinFill = 3,
+    /// Smallest product of incoming and outgoing edge weights (`Kleene::weight`),
+    /// e.g. the number of semilinear components a step multiplies
+    MinWeight = 4,
+}
 
-    let mut nfa: HashMap<(Option<&S>, Option<&S>), K> = HashMap::default();
-    for (from, k, to) in nfa_vec.iter() {
-        nfa.entry((Some(from), Some(to)))
-            .and_modify(|e| *e = e.clone().plus(k.clone()))
-            .or_insert(k.clone());
+impl EliminationOrder {
+    const ALL: [EliminationOrder; 5] = [
+        EliminationOrder::Arbitrary,
+        EliminationOrder::Smart,
+        EliminationOrder::MinDegree,
+        EliminationOrder::MinFill,
+        EliminationOrder::MinWeight,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            EliminationOrder::Arbitrary => "arbitrary",
+            EliminationOrder::Smart => "smart",
+            EliminationOrder::MinDegree => "min-degree",
+            EliminationOrder::MinFill => "min-fill",
+            EliminationOrder::MinWeight => "min-weight",
+        }
     }
 
-    // Add epsilon edge from None to start
-    nfa.entry((None, Some(&start)))
-        .and_modify(|e| *e = e.clone().plus(K::one()))
-        .or_insert(K::one());
+    pub fn from_name(name: &str) -> Option<Self> {
+        Self::ALL.into_iter().find(|order| order.name() == name)
+    }
+}
 
-    let mut states_todo = nfa_vec
-        .iter()
-        .flat_map(|(from, _, to)| vec![from, to])
-        .collect::<HashSet<_>>();
+static ELIMINATION_ORDER: AtomicU8 = AtomicU8::new(EliminationOrder::Smart as u8);
 
-    states_todo.insert(&start);
+pub fn set_elimination_order(order: EliminationOrder) {
+    ELIMINATION_ORDER.store(order as u8, Ordering::SeqCst);
+}
 
-    // Insert epsilon edges from all states_todo to None
-    for state in states_todo.iter() {
-        nfa.entry((Some(state), None))
-            .and_modify(|e| *e = e.clone().plus(K::one()))
-            .or_insert(K::one());
+/// The heuristic in use; `--without-smart-kleene-order` overrides `--kleene-order`
+pub fn elimination_order() -> EliminationOrder {
+    if !SMART_ORDER.load(Ordering::SeqCst) {
+        return EliminationOrder::Arbitrary;
     }
+    EliminationOrder::ALL[ELIMINATION_ORDER.load(Ordering::SeqCst) as usize]
+}
 
-    while !states_todo.is_empty() {
-        let state = *states_todo
-            .iter()
-            .min_by_key(|s| {
-                // Optionally, disable the heuristics for picking the next state
-                if !SMART_ORDER.load(Ordering::SeqCst) {
-                    return 0;
-                }
-                let mut count = 0;
-                for ((_, to), _) in nfa.iter() {
-                    if to == &Some(**s) && !nfa.contains_key(&(Some(s), *to)) {
-                        count += 1;
-                    }
-                }
-                for ((from, _), _) in nfa.iter() {
-                    if from == &Some(**s) && !nfa.contains_key(&(*from, Some(s))) {
-                        count += 1;
+thread_local! {
+    /// Steps of the last `nfa_to_kleene` run on this thread
+    static LAST_ELIMINATION: RefCell<Option<KleeneEliminationStats>> = const { RefCell::new(None) };
+}
+
+/// Order and intermediate sizes of the last `nfa_to_kleene` run on this thread
+pub fn take_elimination_stats() -> Option<KleeneEliminationStats> {
+    LAST_ELIMINATION.with(|last| last.borrow_mut().take())
+}
+
+/// Incremental state elimination for `nfa_to_kleene`.
+///
+/// States are numbered `0..n`, with `n` the extra final state. Edges are kept as outgoing
+/// maps plus incoming sets, so eliminating a state only touches its neighbours, and a
+/// priority queue (with lazily discarded stale entries) yields the state with the lowest
+/// key, ties going to the lowest number.
+struct Planner<K> {
+    order: EliminationOrder,
+    out: Vec<BTreeMap<usize, K>>,
+    inc: Vec<BTreeSet<usize>>,
+    keys: Vec<usize>,
+    eliminated: Vec<bool>,
+    queue: BinaryHeap<Reverse<(usize, usize)>>,
+    edges: usize,
+}
+
+impl<K: Kleene + Clone> Planner<K> {
+    fn new(order: EliminationOrder, states: usize) -> Self {
+        Planner {
+            order,
+            out: (0..=states).map(|_| BTreeMap::new()).collect(),
+            inc: (0..=states).map(|_| BTreeSet::new()).collect(),
+            keys: vec![0; states],
+            eliminated: vec![false; states],
+            queue: BinaryHeap::new(),
+            edges: 0,
+        }
+    }
+
+    fn add_edge(&mut self, from: usize, to: usize, k: K) {
+        match self.out[from].entry(to) {
+            Entry::Occupied(mut e) => {
+                let old = std::mem::replace(e.get_mut(), K::zero());
+                *e.get_mut() = old.plus(k);
+            }
+            Entry::Vacant(e) => {
+                e.insert(k);
+                self.inc[to].insert(from);
+                self.edges += 1;
+            }
+        }
+    }
+
+    fn key(&self, s: usize) -> usize {
+        let has_loop = self.out[s].contains_key(&s);
+        let incoming = self.inc[s].len() - has_loop as usize;
+        let outgoing = self.out[s].len() - has_loop as usize;
+        match self.order {
+            EliminationOrder::Arbitrary => 0,
+            EliminationOrder::Smart if has_loop => 0,
+            EliminationOrder::Smart | EliminationOrder::MinDegree => incoming + outgoing,
+            EliminationOrder::MinFill => {
+                let mut fill = 0;
+                for &p in self.inc[s].iter().filter(|&&p| p != s) {
+                    for &q in self.out[s].keys().filter(|&&q| q != s) {
+                        if !self.out[p].contains_key(&q) {
+                            fill += 1;
+                        }
                     }
                 }
-                count
-            })
-            .unwrap();
-        states_todo.remove(&state);
-        let mut new_nfa: Vec<(Option<&S>, Option<&S>, K)> = vec![];
-        let mut incoming: Vec<(Option<&S>, Option<&S>, K)> = vec![];
-        let mut outgoing: Vec<(Option<&S>, Option<&S>, K)> = vec![];
-        let mut self_loops: Vec<(Option<&S>, Option<&S>, K)> = vec![];
-
-        for ((from, to), k) in nfa.iter() {
-            let edge: (Option<&S>, Option<&S>, K) = (*from, *to, k.clone());
-            if from == &Some(state) && to == &Some(state) {
-                self_loops.push(edge);
-            } else if from == &Some(state) {
-                outgoing.push(edge);
-            } else if to == &Some(state) {
-                incoming.push(edge);
-            } else {
-                new_nfa.push(edge);
+                fill
+            }
+            EliminationOrder::MinWeight => {
+                let incoming: usize = self.inc[s]
+                    .iter()
+                    .filter(|&&p| p != s)
+                    .map(|p| self.out[*p][&s].weight())
+                    .sum();
+                let outgoing: usize = self
+                    .out[s]
+                    .iter()
+                    .filter(|(q, _)| **q != s)
+                    .map(|(_, k)| k.weight())
+                    .sum();
+                incoming.saturating_mul(outgoing)
+            }
+        }
+    }
+
+    fn update_key(&mut self, s: usize) {
+        if s >= self.keys.len() || self.eliminated[s] {
+            return;
+        }
+        let key = self.key(s);
+        if key != self.keys[s] {
+            self.keys[s] = key;
+            self.queue.push(Reverse((key, s)));
+        }
+    }
+
+    fn init_queue(&mut self) {
+        for s in 0..self.keys.len() {
+            self.keys[s] = self.key(s);
+            self.queue.push(Reverse((self.keys[s], s)));
+        }
+    }
+
+    fn pop(&mut self) -> Option<usize> {
+        while let Some(Reverse((key, s))) = self.queue.pop() {
+            if !self.eliminated[s] && self.keys[s] == key {
+                return Some(s);
             }
         }
-        // Add up the self loops
+        None
+    }
+
+    /// Replace every path p -> s -> q by a shortcut edge, returning the weight added
+    fn eliminate(&mut self, s: usize) -> (usize, usize, bool, usize) {
+        self.eliminated[s] = true;
+        let self_loops = self.out[s].remove(&s);
+        let has_loop = self_loops.is_some();
+        if has_loop {
+            self.inc[s].remove(&s);
+            self.edges -= 1;
+        }
         let self_loop = self_loops
-            .iter()
-            .map(|(_, _, k)| k)
-            .fold(K::zero(), |acc, k| acc.plus(k.clone()))
+            .into_iter()
+            .fold(K::zero(), |acc, k| acc.plus(k))
             .star();
-        // Insert all the shortcut edges into the new NFA
-        for (from, _, k1) in incoming.iter() {
-            for (_, to, k2) in outgoing.iter() {
-                new_nfa.push((
-                    *from,
-                    *to,
-                    k1.clone().times(self_loop.clone().times(k2.clone())),
-                ));
+
+        let outgoing: Vec<(usize, K)> = std::mem::take(&mut self.out[s]).into_iter().collect();
+        for (q, _) in &outgoing {
+            self.inc[*q].remove(&s);
+        }
+        let incoming: Vec<(usize, K)> = std::mem::take(&mut self.inc[s])
+            .into_iter()
+            .map(|p| (p, self.out[p].remove(&s).unwrap()))
+            .collect();
+        self.edges -= outgoing.len() + incoming.len();
+
+        let mut weight = 0;
+        for (p, k1) in &incoming {
+            for (q, k2) in &outgoing {
+                let k = k1.clone().times(self_loop.clone().times(k2.clone()));
+                weight += k.weight();
+                self.add_edge(*p, *q, k);
             }
         }
-        let mut new_nfa_map: HashMap<(Option<&S>, Option<&S>), K> = HashMap::default();
-        for (from, to, k) in new_nfa.iter() {
-            new_nfa_map
-                .entry((*from, *to))
-                .and_modify(|e| *e = e.clone().plus(k.clone()))
-                .or_insert(k.clone());
+
+        // Keys depend on the neighbours' edges; min-fill also on edges between neighbours
+        let mut touched: BTreeSet<usize> = incoming.iter().chain(&outgoing).map(|(x, _)| *x).collect();
+        if self.order == EliminationOrder::MinFill {
+            for (p, _) in &incoming {
+                for (q, _) in &outgoing {
+                    let (from, to) = (&self.out[*p], &self.inc[*q]);
+                    touched.extend(from.keys().filter(|r| to.contains(r)));
+                }
+            }
         }
-        nfa = new_nfa_map;
+        for r in touched {
+            self.update_key(r);
+        }
+        (incoming.len(), outgoing.len(), has_loop, weight)
+    }
+}
+
+// Kleene's algorithm for converting a NFA to a Kleene algebra
+// Takes a start state and computes the Kleene element for going from the start state to any other state
+pub fn nfa_to_kleene<S: Clone + Eq + std::hash::Hash, K: Kleene + Clone>(
+    nfa_vec: &[(S, K, S)],
+    start: S,
+) -> K {
+    nfa_to_kleene_with(nfa_vec, start, elimination_order())
+}
+
+/// `nfa_to_kleene` eliminating states in the given order
+pub fn nfa_to_kleene_with<S: Clone + Eq + std::hash::Hash, K: Kleene + Clone>(
+    nfa_vec: &[(S, K, S)],
+    start: S,
+    order: EliminationOrder,
+) -> K {
+    let _span = crate::trace::span("nfa_to_kleene");
+    // We add an extra final state and eliminate all states except that one
+    let mut states_todo = nfa_vec
+        .iter()
+        .flat_map(|(from, _, to)| vec![from, to])
+        .collect::<HashSet<_>>();
+    states_todo.insert(&start);
+
+    // States are numbered in set iteration order, which breaks ties between equal keys
+    let states: Vec<&S> = states_todo.into_iter().collect();
+    let index: HashMap<&S, usize> = states.iter().enumerate().map(|(i, s)| (*s, i)).collect();
+    let n = states.len();
+
+    // Number of each state in order of first appearance, for the stats
+    let mut first_seen: HashMap<&S, usize> = HashMap::default();
+    for s in nfa_vec.iter().flat_map(|(from, _, to)| [from, to]).chain([&start]) {
+        let next = first_seen.len();
+        first_seen.entry(s).or_insert(next);
     }
+
+    let mut planner = Planner::new(order, n);
+    for (from, k, to) in nfa_vec.iter() {
+        planner.add_edge(index[from], index[to], k.clone());
+    }
+
+    // Add epsilon edge from the final state to start, and from all states to the final one
+    planner.add_edge(n, index[&start], K::one());
+    for s in 0..n {
+        planner.add_edge(s, n, K::one());
+    }
+
+    planner.init_queue();
+    let mut steps = Vec::with_capacity(n);
+    while let Some(s) = planner.pop() {
+        let (incoming, outgoing, self_loop, weight) = planner.eliminate(s);
+        steps.push(crate::stats::EliminationStep {
+            state: first_seen[states[s]],
+            incoming,
+            outgoing,
+            self_loop,
+            edges: planner.edges,
+            weight,
+        });
+    }
+    LAST_ELIMINATION.with(|last| {
+        *last.borrow_mut() = Some(KleeneEliminationStats {
+            order: order.name().to_string(),
+            steps,
+        })
+    });
+
+    // Only the loop on the final state is left
+    debug_assert_eq!(planner.edges, planner.out[n].len());
     let mut answer = K::zero();
-    for ((from, to), k) in nfa.iter() {
-        assert!(from.is_none());
-        assert!(to.is_none());
-        answer = answer.plus(k.clone());
+    if let Some(k) = planner.out[n].remove(&n) {
+        answer = answer.plus(k);
     }
     answer
 }
@@ -221,6 +418,7 @@ pub fn nfa_to_kleene<S: Clone + Eq + std::hash::Hash, K: Kleene + Clone>(
 #[cfg(test)]
 mod tests {
     use super::*;
+    use std::collections::BTreeSet;
 
     #[test]
     fn test_nfa_to_kleene() {
@@ -247,4 +445,69 @@ mod tests {
         assert!(chars.contains(&'c'));
         assert!(chars.contains(&'d'));
     }
+
+    /// Words of length at most 4, a Kleene algebra that is cheap to compare exactly
+    #[derive(Clone, Debug, PartialEq)]
+    struct Words(BTreeSet<String>);
+
+    impl Kleene for Words {
+        fn zero() -> Self {
+            Words(BTreeSet::new())
+        }
+        fn one() -> Self {
+            Words(BTreeSet::from([String::new()]))
+        }
+        fn plus(mut self, other: Self) -> Self {
+            self.0.extend(other.0);
+            self
+        }
+        fn times(self, other: Self) -> Self {
+            let mut words = BTreeSet::new();
+            for a in &self.0 {
+                for b in other.0.iter().filter(|b| a.len() + b.len() <= 4) {
+                    words.insert(format!("{a}{b}"));
+                }
+            }
+            Words(words)
+        }
+        fn star(self) -> Self {
+            let mut result = Words::one();
+            loop {
+                let next = result.clone().plus(result.clone().times(self.clone()));
+                if next == result {
+                    return result;
+                }
+                result = next;
+            }
+        }
+        fn weight(&self) -> usize {
+            self.0.len()
+        }
+    }
+
+    #[test]
+    fn test_elimination_orders_agree() {
+        let atom = |c: &str| Words(BTreeSet::from([c.to_string()]));
+        let nfa = vec![
+            (0, atom("a"), 1),
+            (1, atom("b"), 2),
+            (2, atom("c"), 0),
+            (1, atom("d"), 1),
+            (2, atom("e"), 3),
+            (3, atom("f"), 1),
+            (0, atom("g"), 3),
+        ];
+
+        let expected = nfa_to_kleene_with(&nfa, 0, EliminationOrder::Smart);
+        assert!(expected.0.contains("adbc"));
+        for order in EliminationOrder::ALL {
+            assert_eq!(nfa_to_kleene_with(&nfa, 0, order), expected, "{}", order.name());
+
+            let stats = take_elimination_stats().unwrap();
+            assert_eq!(stats.order, order.name());
+            assert_eq!(stats.steps.len(), 4);
+            // Only the loop on the final state is left
+            assert_eq!(stats.steps.last().unwrap().edges, 1);
+        }
+    }
 }
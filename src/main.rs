@@ -1,18 +1,25 @@
 #![allow(dead_code)]
 
 // mod affine_constraints;
+mod batch;
+mod bench;
+mod certificate;
 mod debug_report;
+mod dense_semilinear;
 mod deterministic_map;
 mod expr_to_ns;
 mod graphviz;
+mod incremental;
 mod isl;
 
 mod kleene;
 mod ns;
 mod ns_decision;
 mod ns_to_petri;
+mod parallel;
 mod parser;
 mod petri;
+mod precheck;
 mod presburger;
 #[cfg(test)]
 mod presburger_harmonize_tests;
@@ -20,11 +27,15 @@ mod proof_parser;
 mod proofinvariant_to_presburger;
 mod reachability;
 mod reachability_with_proofs;
+mod reduction;
 mod semilinear;
 mod size_logger;
 mod smpt;
+mod smpt_cache;
+mod smpt_server;
 mod spresburger;
 mod stats;
+mod trace;
 mod utils;
 
 use colored::*;
@@ -42,6 +53,14 @@ use parser::{ExprHc, parse, parse_program};
 
 fn print_usage() {
     println!("{}", "Usage: ser [options] <filename or directory>".bold());
+    println!(
+        "{}",
+        "       ser --batch [options] <directory or manifest>".bold()
+    );
+    println!(
+        "{}",
+        "       ser --bench [options] <directory or manifest>".bold()
+    );
     println!("{}", "Options:".bold());
     println!(
         "  {}                  Open generated visualization files",
@@ -67,10 +86,98 @@ fn print_usage() {
         "  {}             Enable SMPT result caching",
         "--use-cache".green()
     );
+    println!(
+        "  {}      Evict least recently used cache entries above N MiB (default: 1024)",
+        "--cache-max-mb <N>".green()
+    );
+    println!(
+        "  {}           Keep SMPT loaded in long-lived worker processes",
+        "--smpt-server".green()
+    );
+    println!(
+        "  {}            Check all disjuncts of a net in one SMPT run",
+        "--smpt-multi".green()
+    );
+    println!(
+        "  {}              Check reachability disjuncts on N worker threads (default: 1)",
+        "--jobs <N>".green()
+    );
+    println!(
+        "  {}           Explore program states on the --jobs threads when building the NS",
+        "--parallel-ns".green()
+    );
+    println!(
+        "  {}           Reuse the NS fragments and Kleene results of earlier runs on unchanged requests",
+        "--incremental".green()
+    );
+    println!(
+        "  {}       Linear sets a Kleene star may build before switching to ISL (default: 4096)",
+        "--star-budget <N>".green()
+    );
+    println!(
+        "  {}      State elimination order: smart, min-degree, min-fill, min-weight, arbitrary (default: smart)",
+        "--kleene-order <H>".green()
+    );
+    println!(
+        "  {}       Give up (timeout) after N ISL operations per thread (default: unlimited)",
+        "--isl-max-ops <N>".green()
+    );
+    println!(
+        "  {}         Free ISL memory after each file of a directory",
+        "--isl-reset-ctx".green()
+    );
+    println!(
+        "  {}         Record debug report steps: off, info, debug (default: off)",
+        "--log-level <L>".green()
+    );
+    println!(
+        "  {}            Write the debug report while the analysis runs instead of at the end",
+        "--log-stream".green()
+    );
+    println!(
+        "  {}        Write a Chrome trace (JSON) of the analysis phases to the file",
+        "--trace <file>".green()
+    );
+    println!(
+        "  {}                 Analyse all files of a directory or manifest (one path per line) in one process",
+        "--batch".green()
+    );
+    println!(
+        "  {}        Analyse N files of a batch at a time (default: 1)",
+        "--batch-jobs <N>".green()
+    );
+    println!(
+        "  {}     Give up (timeout) on a batch file after S seconds (default: none)",
+        "--batch-timeout <S>".green()
+    );
+    println!(
+        "  {}                 Time the in-process kernels on every file of a directory or manifest",
+        "--bench".green()
+    );
+    println!(
+        "  {}          Also time end-to-end runs, answering SMPT queries from the cache only",
+        "--bench-replay".green()
+    );
+    println!(
+        "  {}     Save the benchmark results as JSON",
+        "--bench-save <file>".green()
+    );
+    println!(
+        "  {} Compare against saved results and fail on regressions",
+        "--bench-baseline <file>".green()
+    );
     println!(
         "  {}   Create and save serializability certificate only",
         "--create-certificate".green()
     );
+    println!(
+        "  {} Write certificates as binary (certificate.bin) or json (certificate.json) (default: binary)",
+        "--certificate-format <F>".green()
+    );
+    println!(
+        "  {}    Verify the certificate as read back from disk instead of in memory",
+        "--certificate-reload".green()
+    );
     println!(
         "  {}    Load and verify previously saved certificate",
         "--check-certificate".green()
@@ -112,6 +219,11 @@ fn main() {
     let mut path_str = "";
     let mut create_certificate_mode = false;
     let mut check_certificate_mode = false;
+    let mut batch_mode = false;
+    let mut batch_jobs = 1;
+    let mut batch_timeout = None;
+    let mut bench_mode = false;
+    let mut bench_options = bench::BenchOptions::default();
 
     // Skip the program name (args[0])
     let mut i = 1;
@@ -141,6 +253,78 @@ fn main() {
                 check_certificate_mode = true;
                 i += 1;
             }
+            "--batch" => {
+                batch_mode = true;
+                i += 1;
+            }
+            "--bench" => {
+                bench_mode = true;
+                i += 1;
+            }
+            "--bench-replay" => {
+                bench_options.replay = true;
+                i += 1;
+            }
+            "--bench-save" | "--bench-baseline" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: {} requires a value", "Error".red().bold(), args[i]);
+                    print_usage();
+                    process::exit(1);
+                }
+                let file = Some(std::path::PathBuf::from(&args[i + 1]));
+                if args[i] == "--bench-save" {
+                    bench_options.save = file;
+                } else {
+                    bench_options.baseline = file;
+                }
+                i += 2;
+            }
+            "--batch-jobs" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --batch-jobs requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<usize>() {
+                    Ok(jobs) if jobs > 0 => {
+                        batch_jobs = jobs;
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid number of jobs '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--batch-timeout" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --batch-timeout requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<u64>() {
+                    Ok(seconds) if seconds > 0 => {
+                        batch_timeout = Some(std::time::Duration::from_secs(seconds));
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid batch timeout '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
             "--timeout" => {
                 if i + 1 >= args.len() {
                     eprintln!("{}: --timeout requires a value", "Error".red().bold());
@@ -173,6 +357,34 @@ fn main() {
                 semilinear::set_generate_less(false);
                 i += 1;
             }
+            "--without-disjunct-normalization" => {
+                presburger::set_normalize_disjuncts(false);
+                i += 1;
+            }
+            "--without-precheck" => {
+                precheck::set_precheck(false);
+                i += 1;
+            }
+            "--without-net-reduction" => {
+                reduction::set_net_reduction(false);
+                i += 1;
+            }
+            "--without-lazy-sets" => {
+                spresburger::set_lazy_evaluation(false);
+                i += 1;
+            }
+            "--isl-string-construction" => {
+                presburger::set_direct_isl_construction(false);
+                i += 1;
+            }
+            "--without-linear-pruning" => {
+                petri::set_linear_pruning(false);
+                i += 1;
+            }
+            "--dense-semilinear" => {
+                dense_semilinear::set_dense_semilinear(true);
+                i += 1;
+            }
             "--without-smart-kleene-order" => {
                 kleene::set_smart_kleene_order(false);
                 i += 1;
@@ -181,6 +393,207 @@ fn main() {
                 smpt::set_use_cache(true);
                 i += 1;
             }
+            "--smpt-server" => {
+                smpt_server::set_smpt_server(true);
+                i += 1;
+            }
+            "--smpt-multi" => {
+                smpt::set_smpt_multi(true);
+                i += 1;
+            }
+            "--parallel-ns" => {
+                expr_to_ns::set_parallel_ns(true);
+                i += 1;
+            }
+            "--incremental" => {
+                incremental::set_incremental(true);
+                i += 1;
+            }
+            "--cache-without-raw-output" => {
+                smpt_cache::set_store_raw_output(false);
+                i += 1;
+            }
+            "--cache-max-mb" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --cache-max-mb requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<u64>() {
+                    Ok(mb) if mb > 0 => {
+                        smpt_cache::set_max_cache_bytes(mb << 20);
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid cache size '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--jobs" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --jobs requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<usize>() {
+                    Ok(jobs) if jobs > 0 => {
+                        parallel::set_jobs(jobs);
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid number of jobs '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--star-budget" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --star-budget requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<usize>() {
+                    Ok(budget) if budget > 0 => {
+                        semilinear::set_star_component_budget(budget);
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid star budget '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--isl-max-ops" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --isl-max-ops requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match args[i].parse::<u64>() {
+                    Ok(max) if max > 0 => {
+                        isl::set_max_operations(max);
+                        i += 1;
+                    }
+                    _ => {
+                        eprintln!(
+                            "{}: Invalid ISL operation budget '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--isl-reset-ctx" => {
+                isl::set_reset_per_file(true);
+                i += 1;
+            }
+            "--log-level" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --log-level requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match debug_report::LogLevel::from_name(&args[i]) {
+                    Some(level) => {
+                        debug_report::set_log_level(level);
+                        i += 1;
+                    }
+                    None => {
+                        eprintln!("{}: Unknown log level '{}'", "Error".red().bold(), args[i]);
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--log-stream" => {
+                debug_report::set_log_stream(true);
+                i += 1;
+            }
+            "--trace" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --trace requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                trace::set_trace_output(std::path::PathBuf::from(&args[i + 1]));
+                i += 2;
+            }
+            "--certificate-format" => {
+                if i + 1 >= args.len() {
+                    eprintln!(
+                        "{}: --certificate-format requires a value",
+                        "Error".red().bold()
+                    );
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match certificate::CertificateFormat::from_name(&args[i]) {
+                    Some(format) => {
+                        certificate::set_certificate_format(format);
+                        i += 1;
+                    }
+                    None => {
+                        eprintln!(
+                            "{}: Unknown certificate format '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
+            "--certificate-reload" => {
+                certificate::set_certificate_reload(true);
+                i += 1;
+            }
+            "--kleene-order" => {
+                if i + 1 >= args.len() {
+                    eprintln!("{}: --kleene-order requires a value", "Error".red().bold());
+                    print_usage();
+                    process::exit(1);
+                }
+                i += 1;
+                match kleene::EliminationOrder::from_name(&args[i]) {
+                    Some(order) => {
+                        kleene::set_elimination_order(order);
+                        i += 1;
+                    }
+                    None => {
+                        eprintln!(
+                            "{}: Unknown Kleene elimination order '{}'",
+                            "Error".red().bold(),
+                            args[i]
+                        );
+                        print_usage();
+                        process::exit(1);
+                    }
+                }
+            }
             _ => {
                 // If it's not a recognized flag, it must be the path
                 if path_str.is_empty() {
@@ -227,6 +640,33 @@ fn main() {
         process::exit(1);
     }
 
+    // Every return below writes the trace; the early exits call `trace::export` themselves
+    let _trace_export = trace::ExportOnDrop;
+
+    if batch_mode {
+        if create_certificate_mode || check_certificate_mode {
+            eprintln!(
+                "{}: Certificate operations do not support --batch",
+                "Error".red().bold()
+            );
+            process::exit(1);
+        }
+        run_batch(path, batch_jobs, batch_timeout, open_files);
+        return;
+    }
+
+    if bench_mode {
+        if create_certificate_mode || check_certificate_mode || batch_mode {
+            eprintln!(
+                "{}: --bench cannot be combined with --batch or certificate operations",
+                "Error".red().bold()
+            );
+            process::exit(1);
+        }
+        run_bench(path, &bench_options, open_files);
+        return;
+    }
+
     // Handle certificate modes
     if create_certificate_mode || check_certificate_mode {
         if path.is_dir() {
@@ -279,14 +719,15 @@ fn main() {
             }
             Err(err) => {
                 eprintln!("{} directory: {}", "Error processing".red().bold(), err);
+                trace::export();
                 process::exit(1);
             }
         }
     } else {
         // Process single file
         match path.extension().and_then(|ext| ext.to_str()) {
-            Some("json") => process_json_file(path_str, open_files),
-            Some("ser") => process_ser_file(path_str, open_files),
+            Some("json") => exit_on_error(process_json_file(path_str, open_files)),
+            Some("ser") => exit_on_error(process_ser_file(path_str, open_files)),
             _ => {
                 eprintln!(
                     "{}: Unsupported file extension for '{}'. Please use {} or {}",
@@ -305,10 +746,10 @@ fn main() {
 // Process a Network System: generate visualizations for NS, Petri net, and Petri net with requests
 fn process_ns<G, L, Req, Resp>(ns: &NS<G, L, Req, Resp>, out_dir: &str, open_files: bool)
 where
-    G: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-    L: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-    Req: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-    Resp: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
+    G: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+    L: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+    Req: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+    Resp: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
 {
     // Clear the output directory if it exists
     if Path::new(out_dir).exists() {
@@ -476,10 +917,16 @@ where
     let regex_file = format!("{}/semilinear.txt", out_dir);
     let mut regex_content = String::new();
     regex_content.push_str(&format!("Regex: {}\n", regex));
-    regex_content.push_str(&format!(
-        "Semilinear:\n{}\n",
-        ns.serialized_automaton_semilinear()
-    ));
+    let semilinear = ns.serialized_automaton_semilinear();
+    match &semilinear {
+        spresburger::SPresburgerSet::Semilinear(set) => {
+            regex_content.push_str(&format!("Semilinear:\n{}\n", set))
+        }
+        set => regex_content.push_str(&format!(
+            "Semilinear (star component budget exceeded):\n{}\n",
+            set
+        )),
+    }
     match utils::file::safe_write_file(&regex_file, &regex_content) {
         Ok(_) => println!("- {}", regex_file.green()),
         Err(err) => {
@@ -495,36 +942,30 @@ where
     // Check serializability
     println!();
     // Run serializability analysis (this prints all results internally)
-    let _ = ns.is_serializable(out_dir);
+    let _ = ns.is_serializable(out_dir, &semilinear);
     stats::finalize_stats();
 }
 
-fn process_json_file(file_path: &str, open_files: bool) {
+/// Analyse a JSON file; read and parse errors are returned instead of exiting, so that
+/// the batch mode can carry on with the next file
+fn process_json_file(file_path: &str, open_files: bool) -> Result<(), String> {
+    let _span = trace::span_with("analysis", || file_path.to_string());
     println!("{} {}", "Processing JSON file:".blue().bold(), file_path);
     
     // Initialize stats collection
     stats::start_analysis(file_path.to_string());
 
-    let content = match fs::read_to_string(file_path) {
-        Ok(content) => content,
-        Err(err) => {
-            eprintln!("{} file: {}", "Error reading".red().bold(), err);
-            process::exit(1);
-        }
-    };
+    let content = fs::read_to_string(file_path)
+        .map_err(|err| format!("{} file: {}", "Error reading".red().bold(), err))?;
 
     // Parse the JSON as a Network System
-    let ns = match NS::<String, String, String, String>::from_json(&content) {
-        Ok(ns) => ns,
-        Err(err) => {
-            eprintln!(
-                "{} JSON as Network System: {}",
-                "Error parsing".red().bold(),
-                err
-            );
-            process::exit(1);
-        }
-    };
+    let ns = NS::<String, String, String, String>::from_json(&content).map_err(|err| {
+        format!(
+            "{} JSON as Network System: {}",
+            "Error parsing".red().bold(),
+            err
+        )
+    })?;
 
     // Get the file name without extension to use as the base name for output files
     let path = Path::new(file_path);
@@ -550,9 +991,12 @@ fn process_json_file(file_path: &str, open_files: bool) {
     
     // Finalize stats collection
     stats::finalize_stats();
+    Ok(())
 }
 
-fn process_ser_file(file_path: &str, open_files: bool) {
+/// Analyse a Ser file; read and parse errors are returned like in `process_json_file`
+fn process_ser_file(file_path: &str, open_files: bool) -> Result<(), String> {
+    let _span = trace::span_with("analysis", || file_path.to_string());
     // Initialize stats collection
     stats::start_analysis(file_path.to_string());
     
@@ -570,13 +1014,8 @@ fn process_ser_file(file_path: &str, open_files: bool) {
         file_path.cyan()
     );
 
-    let content = match fs::read_to_string(file_path) {
-        Ok(content) => content,
-        Err(err) => {
-            eprintln!("{} file: {}", "Error reading".red().bold(), err);
-            process::exit(1);
-        }
-    };
+    let content = fs::read_to_string(file_path)
+        .map_err(|err| format!("{} file: {}", "Error reading".red().bold(), err))?;
 
     // Try to parse as a program with multiple requests first
     let mut table = ExprHc::new();
@@ -615,8 +1054,7 @@ fn process_ser_file(file_path: &str, open_files: bool) {
                     )
                 }
                 Err(err) => {
-                    eprintln!("{} SER file: {}", "Error parsing".red().bold(), err);
-                    process::exit(1);
+                    return Err(format!("{} SER file: {}", "Error parsing".red().bold(), err));
                 }
             }
         }
@@ -643,6 +1081,17 @@ fn process_ser_file(file_path: &str, open_files: bool) {
     
     // Finalize stats collection
     stats::finalize_stats();
+    Ok(())
+}
+
+/// Report the error of a file analysis and exit, as the single file and directory modes
+/// stop at the first file that cannot be read or parsed
+fn exit_on_error(processed: Result<(), String>) {
+    if let Err(err) = processed {
+        eprintln!("{}", err);
+        trace::export();
+        process::exit(1);
+    }
 }
 
 // Recursively process all files in a directory and its subdirectories
@@ -689,16 +1138,17 @@ fn process_directory(dir: &Path, open_files: bool) -> Result<usize, String> {
             if let Some(ext) = path.extension().and_then(|ext| ext.to_str()) {
                 let path_str = path.to_string_lossy().to_string();
 
-                match ext {
-                    "json" => {
-                        process_json_file(&path_str, open_files);
-                        processed_count += 1;
-                    }
-                    "ser" => {
-                        process_ser_file(&path_str, open_files);
-                        processed_count += 1;
-                    }
-                    _ => {} // Skip files with unsupported extensions
+                let processed = match ext {
+                    "json" => Some(process_json_file(&path_str, open_files)),
+                    "ser" => Some(process_ser_file(&path_str, open_files)),
+                    _ => None, // Skip files with unsupported extensions
+                };
+                if let Some(processed) = processed {
+                    exit_on_error(processed);
+                    processed_count += 1;
+                }
+                if isl::reset_per_file() {
+                    isl::reset_thread_ctx();
                 }
                 println!();
             }
@@ -708,6 +1158,79 @@ fn process_directory(dir: &Path, open_files: bool) -> Result<usize, String> {
     Ok(processed_count)
 }
 
+/// Analyse a `.json` or `.ser` file of a batch or benchmark
+fn process_file(file: &Path, open_files: bool) -> Result<(), String> {
+    let file_str = file.to_string_lossy();
+    match file.extension().and_then(|ext| ext.to_str()) {
+        Some("json") => process_json_file(&file_str, open_files),
+        Some("ser") => process_ser_file(&file_str, open_files),
+        _ => Err(format!(
+            "{}: Unsupported file extension for '{}'",
+            "Error".red().bold(),
+            file_str
+        )),
+    }
+}
+
+// Analyse the files of a directory or manifest in one process (see `batch.rs`)
+fn run_batch(path: &Path, jobs: usize, timeout: Option<std::time::Duration>, open_files: bool) {
+    let files = match batch::collect_inputs(path) {
+        Ok(files) => files,
+        Err(err) => {
+            eprintln!("{}", err);
+            process::exit(1);
+        }
+    };
+    println!(
+        "{} {} files on {} threads",
+        "Batch:".blue().bold(),
+        files.len(),
+        jobs
+    );
+
+    let summary = batch::run_batch(&files, jobs, timeout, |file| process_file(file, open_files));
+    match summary {
+        Ok(summary) => {
+            println!(
+                "{} {} files ({} timed out, {} failed)",
+                "Successfully processed".green().bold(),
+                summary.processed,
+                summary.timed_out,
+                summary.failed
+            );
+            if smpt::is_cache_enabled() {
+                smpt::print_cache_stats();
+            }
+        }
+        Err(err) => {
+            eprintln!("{} batch: {}", "Error running".red().bold(), err);
+            process::exit(1);
+        }
+    }
+}
+
+fn run_bench(path: &Path, options: &bench::BenchOptions, open_files: bool) {
+    let files = match batch::collect_inputs(path) {
+        Ok(files) => files,
+        Err(err) => {
+            eprintln!("{}", err);
+            process::exit(1);
+        }
+    };
+    println!("{} {} files", "Bench:".blue().bold(), files.len());
+
+    let regressions = bench::run_bench(&files, options, |file| process_file(file, open_files));
+    trace::export();
+    match regressions {
+        Ok(0) => {}
+        Ok(_) => process::exit(1),
+        Err(err) => {
+            eprintln!("{}", err);
+            process::exit(1);
+        }
+    }
+}
+
 // Certificate creation functions
 fn create_certificate_for_ser_file(file_path: &str) {
     println!();
@@ -789,9 +1312,8 @@ fn create_certificate_for_ser_file(file_path: &str) {
     let decision = ns.create_certificate(&out_dir);
 
     // Save the certificate
-    let cert_path = format!("{}/certificate.json", out_dir);
-    match decision.save_to_file(&cert_path) {
-        Ok(_) => {
+    match certificate::save(&decision, &out_dir, certificate::certificate_format()) {
+        Ok(cert_path) => {
             println!(
                 "{} certificate to: {}",
                 "Successfully saved".green().bold(),
@@ -871,9 +1393,8 @@ fn create_certificate_for_json_file(file_path: &str) {
     let decision = ns.create_certificate(&out_dir);
 
     // Save the certificate
-    let cert_path = format!("{}/certificate.json", out_dir);
-    match decision.save_to_file(&cert_path) {
-        Ok(_) => {
+    match certificate::save(&decision, &out_dir, certificate::certificate_format()) {
+        Ok(cert_path) => {
             println!(
                 "{} certificate to: {}",
                 "Successfully saved".green().bold(),
@@ -1040,18 +1561,17 @@ fn check_certificate_for_ser_file(file_path: &str) {
     let path = Path::new(file_path);
     let file_stem = path.file_stem().and_then(|s| s.to_str()).unwrap_or("expr");
     let out_dir = format!("out/{}", file_stem);
-    let cert_path = format!("{}/certificate.json", out_dir);
 
     // Check if certificate exists
-    if !Path::new(&cert_path).exists() {
+    let Some((cert_path, cert_format)) = certificate::find(&out_dir) else {
         eprintln!(
-            "{}: Certificate not found at {}",
+            "{}: Certificate not found in {}",
             "Error".red().bold(),
-            cert_path
+            out_dir
         );
         eprintln!("Run with --create-certificate first to generate the certificate");
         process::exit(1);
-    }
+    };
 
     // Load the certificate with proper types
     println!("Loading certificate from: {}", cert_path.cyan());
@@ -1059,7 +1579,7 @@ fn check_certificate_for_ser_file(file_path: &str) {
     // Import the required types
     use crate::expr_to_ns::{Env, ExprRequest, LocalExpr};
     
-    let decision = match ns_decision::NSDecision::<Env, LocalExpr, ExprRequest, i64>::load_from_file(&cert_path) {
+    let decision = match certificate::load::<Env, LocalExpr, ExprRequest, i64>(&cert_path, cert_format) {
         Ok(decision) => decision,
         Err(err) => {
             eprintln!(
@@ -1142,22 +1662,21 @@ fn check_certificate_for_json_file(file_path: &str) {
         .and_then(|s| s.to_str())
         .unwrap_or("network");
     let out_dir = format!("out/{}", file_stem);
-    let cert_path = format!("{}/certificate.json", out_dir);
 
     // Check if certificate exists
-    if !Path::new(&cert_path).exists() {
+    let Some((cert_path, cert_format)) = certificate::find(&out_dir) else {
         eprintln!(
-            "{}: Certificate not found at {}",
+            "{}: Certificate not found in {}",
             "Error".red().bold(),
-            cert_path
+            out_dir
         );
         eprintln!("Run with --create-certificate first to generate the certificate");
         process::exit(1);
-    }
+    };
 
     // Load the certificate as String-based decision
     println!("Loading certificate from: {}", cert_path.cyan());
-    let string_decision = match ns_decision::NSDecision::<String, String, String, String>::load_from_file(&cert_path) {
+    let string_decision = match certificate::load::<String, String, String, String>(&cert_path, cert_format) {
         Ok(decision) => decision,
         Err(err) => {
             eprintln!(
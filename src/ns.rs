@@ -14,8 +14,12 @@ use serde::{Deserialize, Serialize};
 use std::fmt::{Debug, Display};
 use std::hash::Hash;
 
+use crate::dense_semilinear::{
+    DenseSPresburgerSet, DenseSemilinearSet, KeySpace, dense_semilinear_enabled,
+};
 use crate::kleene::{Kleene, Regex, nfa_to_kleene};
 use crate::semilinear::*;
+use crate::spresburger::SPresburgerSet;
 
 // Use the shared utility function for GraphViz escaping
 use crate::utils::string::escape_for_graphviz_id;
@@ -163,39 +167,39 @@ where
         responses.into_iter().collect()
     }
 
+    /// Build the adjacency index used by `serialized_automaton_with` and `check_trace_with`
+    pub fn index(&self) -> NSIndex<'_, G, L, Req, Resp> {
+        NSIndex::new(self)
+    }
+
     /// Make an automaton corresponding to the serialized executions of the network system
     /// An element (g, req, resp, g') is present if there is a
     /// - request req in the network system that goes to some local state l
     /// - a sequence of transitions from l to l' that transitions from g to g'
     /// - a response from l' to resp
     pub fn serialized_automaton(&self) -> Vec<(G, Req, Resp, G)> {
+        self.serialized_automaton_with(&self.index())
+    }
+
+    /// `serialized_automaton` using a prebuilt index
+    ///
+    /// The reachable (resp, g') pairs only depend on the starting (l, g), so they are
+    /// computed once per pair and shared by all requests that go to l.
+    pub fn serialized_automaton_with<'a>(
+        &'a self,
+        index: &NSIndex<'a, G, L, Req, Resp>,
+    ) -> Vec<(G, Req, Resp, G)> {
         let mut serialized_automaton: Vec<(G, Req, Resp, G)> = Vec::new();
+        let mut closures: HashMap<(&L, &G), Vec<(&Resp, &G)>> = HashMap::default();
         // iterate over all global states
         for g in self.get_global_states() {
             // iterate over all requests
             for (req, l) in &self.requests {
-                // find all reachable states from (l, g)
-                let mut todo = vec![(l, g)];
-                let mut reached = HashSet::default();
-                while let Some((l, g)) = todo.pop() {
-                    reached.insert((l, g));
-                    for (l1, g1, l2, g2) in &self.transitions {
-                        if l == l1 && g == g1 && !reached.contains(&(l2, g2)) {
-                            todo.push((l2, g2));
-                        }
-                    }
-                }
-                // find all reachable responses from (l, g)
-                let mut reached_responses: HashSet<(&Resp, &G)> = HashSet::default();
-                for (l, g) in reached {
-                    for (l2, resp) in &self.responses {
-                        if l == l2 {
-                            reached_responses.insert((resp, g));
-                        }
-                    }
-                }
+                let reached_responses = closures
+                    .entry((l, g))
+                    .or_insert_with(|| index.reachable_responses(l, g));
                 // add all reachable (g, req, resp, g') to the serialized automaton
-                for (resp, g2) in reached_responses {
+                for &(resp, g2) in reached_responses.iter() {
                     serialized_automaton.push((g.clone(), req.clone(), resp.clone(), g2.clone()));
                 }
             }
@@ -219,8 +223,95 @@ where
         self.serialized_automaton_kleene(|req, resp| Regex::Atom(format!("{req}/{resp}")))
     }
 
-    pub fn serialized_automaton_semilinear(&self) -> SemilinearSet<String> {
-        self.serialized_automaton_kleene(|req, resp| SemilinearSet::atom(format!("{req}/{resp}")))
+    /// The serialized automaton as a semilinear set, unless a star exceeds the component
+    /// budget (see `SPresburgerSet::Factored`)
+    pub fn serialized_automaton_semilinear(&self) -> SPresburgerSet<String> {
+        if dense_semilinear_enabled() {
+            return self
+                .serialized_automaton_dense(DenseSPresburgerSet::Dense)
+                .into_spresburger();
+        }
+        self.serialized_automaton_stored(
+            "semilinear",
+            |req, resp| format!("{req}/{resp}"),
+            SPresburgerSet::atom,
+            SPresburgerSet::Semilinear,
+            |set| match set {
+                SPresburgerSet::Semilinear(set) => Some(set),
+                _ => None,
+            },
+        )
+    }
+
+    /// `serialized_automaton_kleene` over `lift(atom(req, resp))`, taken from the
+    /// `--incremental` store when an earlier run computed it for the same automaton.
+    ///
+    /// Results that `as_semilinear` gives a semilinear set for are stored for later runs,
+    /// with their atoms identified by `Display`.
+    fn serialized_automaton_stored<A, K>(
+        &self,
+        kind: &str,
+        atom: impl Fn(Req, Resp) -> A,
+        lift: impl Fn(A) -> K,
+        from_semilinear: impl FnOnce(SemilinearSet<A>) -> K,
+        as_semilinear: impl FnOnce(&K) -> Option<&SemilinearSet<A>>,
+    ) -> K
+    where
+        A: Clone + Eq + Hash + Ord + Display,
+        K: Kleene + Clone,
+    {
+        let edges: Vec<(G, A, G)> = self
+            .serialized_automaton()
+            .into_iter()
+            .map(|(g, req, resp, g2)| (g, atom(req, resp), g2))
+            .collect();
+        let key = crate::incremental::incremental_enabled()
+            .then(|| crate::incremental::automaton_key(kind, &edges, &self.initial_global));
+        if let Some(key) = key {
+            let atoms: HashMap<String, A> = edges
+                .iter()
+                .map(|(_, a, _)| (a.to_string(), a.clone()))
+                .collect();
+            if let Some(set) = crate::incremental::load_semilinear(key, &atoms) {
+                return from_semilinear(set);
+            }
+        }
+        let nfa: Vec<(G, K, G)> = edges
+            .into_iter()
+            .map(|(g, a, g2)| (g, lift(a), g2))
+            .collect();
+        let result = nfa_to_kleene(&nfa, self.initial_global.clone());
+        if let (Some(key), Some(set)) = (key, as_semilinear(&result)) {
+            crate::incremental::store_semilinear(key, set);
+        }
+        result
+    }
+
+    /// `serialized_automaton_semilinear` computed with the dense backend, whose key
+    /// space is the set of request/response pairs of the serialized automaton
+    pub fn serialized_automaton_dense_semilinear(&self) -> DenseSemilinearSet<String> {
+        self.serialized_automaton_dense(|set| set)
+    }
+
+    /// `serialized_automaton_kleene` over `lift` of the dense atoms
+    fn serialized_automaton_dense<K: Kleene + Clone>(
+        &self,
+        lift: impl Fn(DenseSemilinearSet<String>) -> K,
+    ) -> K {
+        let automaton = self.serialized_automaton();
+        let space = KeySpace::new(
+            automaton
+                .iter()
+                .map(|(_, req, resp, _)| format!("{req}/{resp}")),
+        );
+        let nfa: Vec<(G, K, G)> = automaton
+            .into_iter()
+            .map(|(g, req, resp, g2)| {
+                let atom = DenseSemilinearSet::atom(&space, &format!("{req}/{resp}"));
+                (g, lift(atom), g2)
+            })
+            .collect();
+        nfa_to_kleene(&nfa, self.initial_global.clone())
     }
 
     /// Serialize the network system to a JSON string
@@ -242,6 +333,7 @@ where
         for<'de> Req: Deserialize<'de>,
         for<'de> Resp: Deserialize<'de>,
     {
+        let _span = crate::trace::span("parse");
         serde_json::from_str(json)
     }
 
@@ -461,6 +553,15 @@ where
     pub fn check_trace(
         &self,
         trace: &crate::ns_decision::NSTrace<G, L, Req, Resp>,
+    ) -> Result<Vec<(Req, Resp)>, String> {
+        self.check_trace_with(&self.index(), trace)
+    }
+
+    /// `check_trace` using a prebuilt index
+    pub fn check_trace_with(
+        &self,
+        index: &NSIndex<'_, G, L, Req, Resp>,
+        trace: &crate::ns_decision::NSTrace<G, L, Req, Resp>,
     ) -> Result<Vec<(Req, Resp)>, String> {
         use crate::ns_decision::NSStep;
 
@@ -477,10 +578,7 @@ where
                     initial_local,
                 } => {
                     // Verify this request type exists with the given initial local state
-                    if !self
-                        .requests
-                        .contains(&(request.clone(), initial_local.clone()))
-                    {
+                    if !index.has_request(request, initial_local) {
                         return Err(format!(
                             "Step {}: Unknown request type or wrong initial state: ({}, {})",
                             step_idx, request, initial_local
@@ -507,13 +605,7 @@ where
                     }
 
                     // Verify transition exists
-                    let transition = (
-                        from_local.clone(),
-                        from_global.clone(),
-                        to_local.clone(),
-                        to_global.clone(),
-                    );
-                    if !self.transitions.contains(&transition) {
+                    if !index.has_transition(from_local, from_global, to_local, to_global) {
                         return Err(format!(
                             "Step {}: Transition not found in NS: ({}, {}, {}, {})",
                             step_idx, from_local, from_global, to_local, to_global
@@ -544,10 +636,7 @@ where
                     response,
                 } => {
                     // Verify response exists
-                    if !self
-                        .responses
-                        .contains(&(final_local.clone(), response.clone()))
-                    {
+                    if !index.has_response(final_local, response) {
                         return Err(format!(
                             "Step {}: Response not found in NS: ({}, {})",
                             step_idx, final_local, response
@@ -587,6 +676,218 @@ where
     }
 }
 
+
+/// Hash index over the requests, responses and transitions of an `NS`.
+///
+/// Transitions are grouped by their source `(l, g)` and responses by their local state,
+/// both in the order of the `NS` vectors, so walks over the index visit edges in the same
+/// order as a scan of the vectors would.
+pub struct NSIndex<'a, G, L, Req, Resp> {
+    successors: HashMap<(&'a L, &'a G), Vec<(&'a L, &'a G)>>,
+    responses_by_local: HashMap<&'a L, Vec<&'a Resp>>,
+    requests: HashSet<(&'a Req, &'a L)>,
+    responses: HashSet<(&'a L, &'a Resp)>,
+    transitions: HashSet<(&'a L, &'a G, &'a L, &'a G)>,
+}
+
+impl<'a, G, L, Req, Resp> NSIndex<'a, G, L, Req, Resp>
+where
+    G: Eq + Hash,
+    L: Eq + Hash,
+    Req: Eq + Hash,
+    Resp: Eq + Hash,
+{
+    pub fn new(ns: &'a NS<G, L, Req, Resp>) -> Self {
+        let mut successors: HashMap<_, Vec<_>> = HashMap::default();
+        for (l1, g1, l2, g2) in &ns.transitions {
+            successors.entry((l1, g1)).or_default().push((l2, g2));
+        }
+        let mut responses_by_local: HashMap<_, Vec<_>> = HashMap::default();
+        for (l, resp) in &ns.responses {
+            responses_by_local.entry(l).or_default().push(resp);
+        }
+        NSIndex {
+            successors,
+            responses_by_local,
+            requests: ns.requests.iter().map(|(req, l)| (req, l)).collect(),
+            responses: ns.responses.iter().map(|(l, resp)| (l, resp)).collect(),
+            transitions: ns
+                .transitions
+                .iter()
+                .map(|(l1, g1, l2, g2)| (l1, g1, l2, g2))
+                .collect(),
+        }
+    }
+
+    /// Targets of the transitions leaving `(l, g)`
+    pub fn successors(&self, l: &'a L, g: &'a G) -> &[(&'a L, &'a G)] {
+        self.successors.get(&(l, g)).map_or(&[], Vec::as_slice)
+    }
+
+    /// Responses available from local state `l`
+    pub fn responses(&self, l: &'a L) -> &[&'a Resp] {
+        self.responses_by_local.get(l).map_or(&[], Vec::as_slice)
+    }
+
+    pub fn has_request(&self, req: &Req, l: &L) -> bool {
+        self.requests.contains(&(req, l))
+    }
+
+    pub fn has_response(&self, l: &L, resp: &Resp) -> bool {
+        self.responses.contains(&(l, resp))
+    }
+
+    pub fn has_transition(&self, l1: &L, g1: &G, l2: &L, g2: &G) -> bool {
+        self.transitions.contains(&(l1, g1, l2, g2))
+    }
+
+    /// All (resp, g') such that some (l', g') reachable from `(l, g)` has response resp
+    pub fn reachable_responses(&self, l: &'a L, g: &'a G) -> Vec<(&'a Resp, &'a G)> {
+        // find all reachable states from (l, g)
+        let mut todo = vec![(l, g)];
+        let mut reached = HashSet::default();
+        while let Some((l, g)) = todo.pop() {
+            reached.insert((l, g));
+            for &(l2, g2) in self.successors(l, g) {
+                if !reached.contains(&(l2, g2)) {
+                    todo.push((l2, g2));
+                }
+            }
+        }
+        // find all reachable responses from (l, g)
+        let mut reached_responses: HashSet<(&Resp, &G)> = HashSet::default();
+        for (l, g) in reached {
+            for &resp in self.responses(l) {
+                reached_responses.insert((resp, g));
+            }
+        }
+        reached_responses.into_iter().collect()
+    }
+}
+
+/// Incremental builder for an `NS` with hash-indexed deduplication.
+///
+/// `NS::add_*` deduplicate with a linear scan, which makes building a large NS quadratic.
+/// Here local and global states are interned to `u32` IDs and the requests, responses and
+/// transitions are deduplicated through hash sets over those IDs. `build` produces exactly
+/// the `NS` (same vectors, same order) that the same sequence of `NS::add_*` calls would.
+pub struct NSBuilder<G, L, Req, Resp> {
+    initial_global: G,
+    locals: Vec<L>,
+    local_ids: HashMap<L, u32>,
+    globals: Vec<G>,
+    global_ids: HashMap<G, u32>,
+    requests: Vec<(Req, u32)>,
+    request_set: HashSet<(Req, u32)>,
+    responses: Vec<(u32, Resp)>,
+    response_set: HashSet<(u32, Resp)>,
+    transitions: Vec<[u32; 4]>,
+    transition_set: HashSet<[u32; 4]>,
+}
+
+impl<G, L, Req, Resp> NSBuilder<G, L, Req, Resp>
+where
+    G: Clone + Eq + Hash,
+    L: Clone + Eq + Hash,
+    Req: Clone + Eq + Hash,
+    Resp: Clone + Eq + Hash,
+{
+    pub fn new(initial_global: G) -> Self {
+        NSBuilder {
+            initial_global,
+            locals: Vec::new(),
+            local_ids: HashMap::default(),
+            globals: Vec::new(),
+            global_ids: HashMap::default(),
+            requests: Vec::new(),
+            request_set: HashSet::default(),
+            responses: Vec::new(),
+            response_set: HashSet::default(),
+            transitions: Vec::new(),
+            transition_set: HashSet::default(),
+        }
+    }
+
+    /// ID of a local state, cloning it only the first time it is seen
+    pub fn local_id(&mut self, local: &L) -> u32 {
+        if let Some(&id) = self.local_ids.get(local) {
+            return id;
+        }
+        let id = self.locals.len() as u32;
+        self.locals.push(local.clone());
+        self.local_ids.insert(local.clone(), id);
+        id
+    }
+
+    /// ID of a global state, cloning it only the first time it is seen
+    pub fn global_id(&mut self, global: &G) -> u32 {
+        if let Some(&id) = self.global_ids.get(global) {
+            return id;
+        }
+        let id = self.globals.len() as u32;
+        self.globals.push(global.clone());
+        self.global_ids.insert(global.clone(), id);
+        id
+    }
+
+    pub fn add_request(&mut self, request: Req, local_state: &L) {
+        let local = self.local_id(local_state);
+        if self.request_set.insert((request.clone(), local)) {
+            self.requests.push((request, local));
+        }
+    }
+
+    pub fn add_response(&mut self, local_state: &L, response: Resp) {
+        let local = self.local_id(local_state);
+        if self.response_set.insert((local, response.clone())) {
+            self.responses.push((local, response));
+        }
+    }
+
+    pub fn add_transition(&mut self, from_local: &L, from_global: &G, to_local: &L, to_global: &G) {
+        let transition = [
+            self.local_id(from_local),
+            self.global_id(from_global),
+            self.local_id(to_local),
+            self.global_id(to_global),
+        ];
+        if self.transition_set.insert(transition) {
+            self.transitions.push(transition);
+        }
+    }
+
+    /// Resolve the IDs into the `Vec` views of an `NS`
+    pub fn build(self) -> NS<G, L, Req, Resp> {
+        let locals = &self.locals;
+        let globals = &self.globals;
+        NS {
+            initial_global: self.initial_global,
+            requests: self
+                .requests
+                .into_iter()
+                .map(|(req, l)| (req, locals[l as usize].clone()))
+                .collect(),
+            responses: self
+                .responses
+                .into_iter()
+                .map(|(l, resp)| (locals[l as usize].clone(), resp))
+                .collect(),
+            transitions: self
+                .transitions
+                .into_iter()
+                .map(|[l1, g1, l2, g2]| {
+                    (
+                        locals[l1 as usize].clone(),
+                        globals[g1 as usize].clone(),
+                        locals[l2 as usize].clone(),
+                        globals[g2 as usize].clone(),
+                    )
+                })
+                .collect(),
+        }
+    }
+}
+
 impl<G, L, Req, Resp> NS<G, L, Req, Resp>
 where
     G: Clone + Ord + Hash + Display + Debug,
@@ -595,40 +896,69 @@ where
     Resp: Clone + Ord + Hash + Display + Debug,
 {
     /// Check if the network system is serializable using both methods and report results
+    ///
+    /// `semilinear` is the caller's `serialized_automaton_semilinear()`, printed with the
+    /// results instead of being computed a second time.
+    ///
+    /// The certificate is written to `out_dir` on another thread while the decision in
+    /// memory is verified; with `--certificate-reload` the copy read back from disk is
+    /// verified instead.
     #[must_use]
-    pub fn is_serializable(&self, out_dir: &str) -> bool 
+    pub fn is_serializable(&self, out_dir: &str, semilinear: &SPresburgerSet<String>) -> bool 
     where
-        G: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-        L: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-        Req: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
-        Resp: Clone + Ord + Hash + Display + std::fmt::Debug + serde::Serialize + for<'de> serde::Deserialize<'de>,
+        G: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+        L: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+        Req: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
+        Resp: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync + serde::Serialize + for<'de> serde::Deserialize<'de>,
     {
         // Create certificate with timing
         let decision = crate::stats::record_certificate_creation_time(|| {
             self.create_certificate(out_dir)
         });
         
-        // Save certificate to standard location
-        let cert_path = format!("{}/certificate.json", out_dir);
-        if let Err(err) = decision.save_to_file(&cert_path) {
-            eprintln!("Warning: Failed to save certificate: {}", err);
-            // Continue with the in-memory decision
-        }
-        
-        // Load certificate from file
-        let loaded_decision = match crate::ns_decision::NSDecision::load_from_file(&cert_path) {
-            Ok(d) => d,
-            Err(err) => {
-                eprintln!("Warning: Failed to load certificate: {}. Using in-memory decision.", err);
-                decision
+        let format = crate::certificate::certificate_format();
+        let (decision, result) = if crate::certificate::certificate_reload() {
+            // Save certificate to standard location
+            if let Err(err) = crate::certificate::save(&decision, out_dir, format) {
+                eprintln!("Warning: Failed to save certificate: {}", err);
+                // Continue with the in-memory decision
             }
+
+            // Load certificate from file
+            let cert_path = crate::certificate::certificate_path(out_dir, format);
+            let loaded_decision = match crate::certificate::load(&cert_path, format) {
+                Ok(d) => d,
+                Err(err) => {
+                    eprintln!(
+                        "Warning: Failed to load certificate: {}. Using in-memory decision.",
+                        err
+                    );
+                    decision
+                }
+            };
+
+            // Verify and return result with timing
+            let result = crate::stats::record_certificate_checking_time(|| {
+                self.verify_ns_decision(&loaded_decision)
+            });
+            (loaded_decision, result)
+        } else {
+            // Verify the decision in memory while the certificate is written
+            let result = std::thread::scope(|scope| {
+                let writer = scope.spawn(|| crate::certificate::save(&decision, out_dir, format));
+                let result = crate::stats::record_certificate_checking_time(|| {
+                    self.verify_ns_decision(&decision)
+                });
+                match writer.join() {
+                    Ok(Ok(_)) => {}
+                    Ok(Err(err)) => eprintln!("Warning: Failed to save certificate: {}", err),
+                    Err(payload) => std::panic::resume_unwind(payload),
+                }
+                result
+            });
+            (decision, result)
         };
         
-        // Verify and return result with timing
-        let result = crate::stats::record_certificate_checking_time(|| {
-            self.verify_ns_decision(&loaded_decision)
-        });
-        
         // Print result with consistent formatting
         println!();
         println!(
@@ -648,10 +978,13 @@ where
         // Print the semilinear set for compatibility
         println!();
         println!("Serialized automaton semilinear set:");
-        println!("{}", self.serialized_automaton_semilinear());
+        match semilinear {
+            SPresburgerSet::Semilinear(set) => println!("{}", set),
+            set => println!("(star component budget exceeded) {}", set),
+        }
         
         // Print decision details
-        match &loaded_decision {
+        match &decision {
             crate::ns_decision::NSDecision::Serializable { invariant } => {
                 println!();
                 println!("✅ PROOF CERTIFICATE FOUND");
@@ -673,7 +1006,7 @@ where
         }
         
         // Determine the result and stats string based on decision type
-        let (result_emoji, result_text, stats_result) = match &loaded_decision {
+        let (result_emoji, result_text, stats_result) = match &decision {
             crate::ns_decision::NSDecision::Serializable { .. } => ("✅", "SERIALIZABLE".green().bold(), "serializable"),
             crate::ns_decision::NSDecision::NotSerializable { .. } => ("❌", "NOT SERIALIZABLE".red().bold(), "not_serializable"),
             crate::ns_decision::NSDecision::Timeout { .. } => ("⏱️", "TIMEOUT".yellow().bold(), "timeout"),
@@ -700,13 +1033,54 @@ where
         result
     }
 
-    /// Create a serializability certificate (NSDecision) without full visualization
+    /// Create a serializability certificate (NSDecision) without full visualization.
+    ///
+    /// Running out of the ISL operation budget (`--isl-max-ops`) gives a
+    /// `Timeout` decision.
     pub fn create_certificate(&self, out_dir: &str) -> crate::ns_decision::NSDecision<G, L, Req, Resp>
     where
-        G: Clone + Ord + Hash + Display + std::fmt::Debug,
-        L: Clone + Ord + Hash + Display + std::fmt::Debug,
-        Req: Clone + Ord + Hash + Display + std::fmt::Debug,
-        Resp: Clone + Ord + Hash + Display + std::fmt::Debug,
+        G: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        L: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        Req: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        Resp: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+    {
+        let start = std::time::Instant::now();
+        let decision =
+            crate::isl::with_operation_budget(|| self.create_certificate_unbudgeted(out_dir))
+                .unwrap_or_else(|message| {
+                    eprintln!("{}: {}", "Warning".yellow().bold(), message);
+                    crate::ns_decision::NSDecision::Timeout { message }
+                });
+
+        // Write the debug report (`--log-level`)
+        if crate::debug_report::log_enabled(crate::debug_report::LogLevel::Info) {
+            let result = match &decision {
+                crate::ns_decision::NSDecision::Serializable { .. } => "serializable",
+                crate::ns_decision::NSDecision::NotSerializable { .. } => "Not serializable",
+                crate::ns_decision::NSDecision::Timeout { .. } => "timeout",
+            };
+            let elapsed_ms = start.elapsed().as_millis() as u64;
+            if let Err(err) = crate::reachability::get_debug_logger().finalize(
+                result.to_string(),
+                elapsed_ms,
+                out_dir,
+            ) {
+                eprintln!(
+                    "{}: Failed to write debug report: {}",
+                    "Warning".yellow().bold(),
+                    err
+                );
+            }
+        }
+        decision
+    }
+
+    fn create_certificate_unbudgeted(&self, out_dir: &str) -> crate::ns_decision::NSDecision<G, L, Req, Resp>
+    where
+        G: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        L: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        Req: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
+        Resp: Clone + Ord + Hash + Display + std::fmt::Debug + Send + Sync,
     {
         use crate::ns_to_petri::*;
         use ReqPetriState::*;
@@ -718,10 +1092,9 @@ where
             .unwrap_or("unknown")
             .to_string();
 
-        crate::reachability::init_debug_logger(
-            program_name.clone(),
-            format!("Network System: {:?}", self),
-        );
+        crate::reachability::init_debug_logger(program_name.clone(), out_dir, || {
+            format!("Network System: {:?}", self)
+        });
 
         // Convert to Petri net
         let mut places_that_must_be_zero = HashSet::default();
@@ -736,30 +1109,51 @@ where
         let places_that_must_be_zero: Vec<_> = places_that_must_be_zero.into_iter().collect();
 
         // Create serialized automaton semilinear set
-        let ser: SemilinearSet<_> = self.serialized_automaton_kleene(|req, resp| {
-            SemilinearSet::singleton(SparseVector::unit(Response(req, resp)))
-        });
+        // (stays semilinear unless a star exceeds the component budget)
+        crate::semilinear::take_membership_counters();
+        let ser: SPresburgerSet<_> = self.serialized_automaton_stored(
+            "spresburger",
+            Response,
+            SPresburgerSet::atom,
+            SPresburgerSet::Semilinear,
+            |ser| match ser {
+                SPresburgerSet::Semilinear(ser) => Some(ser),
+                _ => None,
+            },
+        );
+        if let Some(elimination) = crate::kleene::take_elimination_stats() {
+            crate::stats::set_kleene_elimination_stats(elimination);
+        }
         
         // Collect Petri net size stats
-        let places_count = petri.get_places().len();
-        let transitions_count = petri.get_transitions().len();
+        let places_count = petri.num_places();
+        let transitions_count = petri.num_transitions();
         crate::stats::set_petri_net_sizes(places_count, transitions_count);
         
         // Collect semilinear set stats
-        let semilinear_stats = crate::stats::SemilinearSetStats {
-            num_components: ser.components.len(),
-            components: ser.components.iter().map(|c| crate::stats::SemilinearComponent {
+        let membership = crate::semilinear::take_membership_counters();
+        let components = match &ser {
+            SPresburgerSet::Semilinear(ser) => ser.components.iter().map(|c| crate::stats::SemilinearComponent {
                 periods: c.periods.len(),
             }).collect(),
+            _ => vec![],
+        };
+        let semilinear_stats = crate::stats::SemilinearSetStats {
+            num_components: components.len(),
+            components,
+            membership_trivial: membership.trivial,
+            membership_cached: membership.cached,
+            membership_dp: membership.dynamic_programming,
+            membership_isl: membership.isl,
         };
         crate::stats::set_semilinear_stats(semilinear_stats);
 
         // Run the proof-based analysis to get Decision
         let result_with_proofs =
-            crate::reachability_with_proofs::is_petri_reachability_set_subset_of_semilinear_new(
+            crate::reachability_with_proofs::is_petri_reachability_set_subset_of_spresburger(
                 petri.clone(),
                 &places_that_must_be_zero,
-                ser.clone(),
+                ser,
                 out_dir,
             );
 
@@ -970,6 +1364,32 @@ fn extract_name_and_value(s: &str) -> Option<(String, usize)> {
 mod tests {
     use super::*;
 
+    #[test]
+    fn test_builder_matches_add_methods() {
+        let mut ns: NS<String, String, String, String> = NS::new("G0".to_string());
+        let mut builder = NSBuilder::new("G0".to_string());
+        let s = |x: &str| x.to_string();
+        for i in 0..40 {
+            let (l1, l2) = (format!("L{}", i % 7), format!("L{}", (i * 3) % 5));
+            let (g1, g2) = (format!("G{}", i % 3), format!("G{}", (i + 1) % 4));
+            let req = format!("Req{}", i % 4);
+            let resp = format!("Resp{}", i % 6);
+
+            ns.add_request(req.clone(), l1.clone());
+            builder.add_request(req, &l1);
+            ns.add_transition(l1.clone(), g1.clone(), l2.clone(), g2.clone());
+            builder.add_transition(&l1, &g1, &l2, &g2);
+            ns.add_response(l2.clone(), resp.clone());
+            builder.add_response(&l2, resp);
+        }
+        ns.add_transition(s("L0"), s("G0"), s("L1"), s("G1"));
+        builder.add_transition(&s("L0"), &s("G0"), &s("L1"), &s("G1"));
+
+        let built = builder.build();
+        assert_eq!(built, ns);
+        assert_eq!(serde_json::to_string(&built).unwrap(), serde_json::to_string(&ns).unwrap());
+    }
+
     #[test]
     fn test_ns_parse() {
         let input = r#"
@@ -1225,6 +1645,38 @@ mod tests {
         assert!(globals.iter().any(|&g| g == "G2"));
         assert!(globals.iter().any(|&g| g == "G3"));
     }
+    #[test]
+    fn test_operation_budget_gives_timeout() {
+        use crate::ns_decision::NSDecision;
+        use crate::presburger::PresburgerSet;
+
+        let s = |x: &str| x.to_string();
+        let mut ns = NS::<String, String, String, String>::new(s("G0"));
+        ns.add_request(s("Req"), s("L0"));
+        ns.add_transition(s("L0"), s("G0"), s("L1"), s("G1"));
+        ns.add_transition(s("L0"), s("G1"), s("L1"), s("G0"));
+        ns.add_response(s("L1"), s("Resp"));
+
+        // No other test runs a budgeted analysis, so the global limit can be set here
+        crate::isl::set_max_operations(1);
+        let budgeted = crate::isl::with_operation_budget(|| {
+            let xy = PresburgerSet::universe(vec![s("x"), s("y")]);
+            let x_or_y = PresburgerSet::atom(s("x")).union(&PresburgerSet::atom(s("y")));
+            xy.difference(&x_or_y).is_empty()
+        });
+        let budget_active = crate::isl::budget_active();
+        let dir = tempfile::tempdir().unwrap();
+        let decision = ns.create_certificate(dir.path().to_str().unwrap());
+        let budget_active_after_certificate = crate::isl::budget_active();
+        crate::isl::set_max_operations(0);
+
+        assert!(budgeted.is_err());
+        assert!(matches!(decision, NSDecision::Timeout { .. }));
+        // The flag is cleared after the unwind, so later analyses are unbudgeted
+        assert!(!budget_active);
+        assert!(!budget_active_after_certificate);
+    }
+
     #[test]
     fn test_serialized_automaton_no_transitions() {
         let mut ns = NS::<String, String, String, String>::new("Initial".to_string());
@@ -1419,6 +1871,29 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_index_lookups() {
+        let mut ns = NS::<String, String, String, String>::new("G0".to_string());
+        ns.add_request("Req".to_string(), "L0".to_string());
+        ns.add_response("L1".to_string(), "Resp".to_string());
+        ns.add_transition("L0".to_string(), "G0".to_string(), "L1".to_string(), "G1".to_string());
+        ns.add_transition("L0".to_string(), "G0".to_string(), "L0".to_string(), "G2".to_string());
+        let [l0, l1, g0, g1, g2] = ["L0", "L1", "G0", "G1", "G2"].map(String::from);
+
+        let index = ns.index();
+        assert_eq!(index.successors(&l0, &g0), &[(&l1, &g1), (&l0, &g2)]);
+        assert!(index.successors(&l1, &g1).is_empty());
+        assert_eq!(index.responses(&l1), &[&"Resp".to_string()]);
+        assert!(index.has_request(&"Req".to_string(), &l0));
+        assert!(!index.has_request(&"Req".to_string(), &l1));
+        assert!(index.has_transition(&l0, &g0, &l1, &g1));
+        assert!(!index.has_transition(&l1, &g0, &l0, &g1));
+
+        let mut responses = index.reachable_responses(&l0, &g0);
+        responses.sort();
+        assert_eq!(responses, vec![(&"Resp".to_string(), &g1)]);
+    }
+
     #[test]
     fn test_graphviz_output() {
         let mut ns = NS::<String, String, String, String>::new("NoSession".to_string());
@@ -443,6 +443,11 @@ where
     }
 
     /// Check that the invariant is inductive (preserved by all transitions)
+    ///
+    /// Each internal transition, request creation and request completion gives an
+    /// obligation: the source invariant, after the step, implies the target invariant.
+    /// The obligations are collected first, in the order of the checks below, and then
+    /// decided on the `--jobs` worker pool (see `InductiveObligations`).
     fn check_inductive(&self, ns: &NS<G, L, Req, Resp>) -> Result<(), String>
     where
         G: Clone + Display + Eq + Hash + Ord + Debug + ToString,
@@ -450,149 +455,89 @@ where
         Req: Clone + Display + Eq + Hash + Ord + Debug + ToString,
         Resp: Clone + Display + Eq + Hash + Ord + Debug + ToString,
     {
+        let mut obligations = InductiveObligations::new(&self.global_invariants);
+
         // Check 1: Internal transitions preserve the invariant
         for (from_local, from_global, to_local, to_global) in &ns.transitions {
             // Get invariants for source and target global states
-            let from_inv = self
-                .global_invariants
-                .get(from_global)
-                .ok_or_else(|| format!("No invariant for global state: {}", from_global))?;
-            let to_inv = self
-                .global_invariants
-                .get(to_global)
-                .ok_or_else(|| format!("No invariant for global state: {}", to_global))?;
+            let Some(from_inv) = obligations.invariant(from_global) else {
+                obligations.fail(format!("No invariant for global state: {}", from_global));
+                return obligations.check();
+            };
+            let Some(to_inv) = obligations.invariant(to_global) else {
+                obligations.fail(format!("No invariant for global state: {}", to_global));
+                return obligations.check();
+            };
 
-            // For each possible request type that could be in this local state
+            // For each possible request type that could be in this local state:
+            // remove one from source, add one to target
             for (req, _) in &ns.requests {
                 let from_var =
                     RequestStatePair(req.clone(), RequestState::InFlight(from_local.clone()));
                 let to_var =
                     RequestStatePair(req.clone(), RequestState::InFlight(to_local.clone()));
-
-                // Convert to Either type for the operations
-                let from_inv_either: ProofInvariant<Either<usize, RequestStatePair<Req, L, Resp>>> =
-                    from_inv.clone().map(|v| Either::Right(v.clone()));
-
-                // Apply the transition: remove one from source, add one to target
-                let inv_after_remove = from_inv_either.filter_and_subtract_one(&from_var);
-                let inv_after_add = inv_after_remove.add_one(&to_var);
-
-                // Project back to the original type
-                let inv_after_transition = inv_after_add.project_right();
-
-                // Check if the result implies the target invariant
-                if !self.check_formula_implies(&inv_after_transition, to_inv)? {
-                    return Err(format!(
+                obligations.push(from_inv, to_inv, Some(&from_var), &to_var, || {
+                    format!(
                         "Invariant not inductive for transition ({}, {}) -> ({}, {}) with request {}",
                         from_local, from_global, to_local, to_global, req
-                    ));
-                }
+                    )
+                });
             }
         }
 
         // Check 2: Request creation preserves the invariant
         for (req, initial_local) in &ns.requests {
-            let initial_inv = self
-                .global_invariants
-                .get(&ns.initial_global)
-                .ok_or_else(|| {
-                    format!(
-                        "No invariant for initial global state: {}",
-                        ns.initial_global
-                    )
-                })?;
+            let Some(initial_inv) = obligations.invariant(&ns.initial_global) else {
+                obligations.fail(format!(
+                    "No invariant for initial global state: {}",
+                    ns.initial_global
+                ));
+                return obligations.check();
+            };
 
             let new_var =
                 RequestStatePair(req.clone(), RequestState::InFlight(initial_local.clone()));
-
-            // Convert to Either type for the operation
-            let initial_inv_either: ProofInvariant<Either<usize, RequestStatePair<Req, L, Resp>>> =
-                initial_inv.clone().map(|v| Either::Right(v.clone()));
-
-            let inv_after_add = initial_inv_either.add_one(&new_var);
-            let inv_after_creation = inv_after_add.project_right();
-
-            // Check if creating a new request preserves the initial state invariant
-            if !self.check_formula_implies(&inv_after_creation, initial_inv)? {
-                return Err(format!(
+            obligations.push(initial_inv, initial_inv, None, &new_var, || {
+                format!(
                     "Invariant not inductive for request creation: {} at local state {}",
                     req, initial_local
-                ));
-            }
+                )
+            });
         }
 
         // Check 3: Request completion preserves the invariant
         for (final_local, resp) in &ns.responses {
             // For each global state where this response could occur
             for global_state in ns.get_global_states() {
-                let global_inv = self
-                    .global_invariants
-                    .get(global_state)
-                    .ok_or_else(|| format!("No invariant for global state: {}", global_state))?;
+                let Some(global_inv) = obligations.invariant(global_state) else {
+                    obligations.fail(format!("No invariant for global state: {}", global_state));
+                    return obligations.check();
+                };
 
-                // For each request type that could complete with this response
+                // For each request type that could complete with this response:
+                // remove inflight, add completed, in the same global state
                 for (req, _) in &ns.requests {
                     let inflight_var =
                         RequestStatePair(req.clone(), RequestState::InFlight(final_local.clone()));
                     let completed_var =
                         RequestStatePair(req.clone(), RequestState::Completed(resp.clone()));
-
-                    // Convert to Either type for the operations
-                    let global_inv_either: ProofInvariant<
-                        Either<usize, RequestStatePair<Req, L, Resp>>,
-                    > = global_inv.clone().map(|v| Either::Right(v.clone()));
-
-                    // Apply completion: remove inflight, add completed
-                    let inv_after_remove = global_inv_either.filter_and_subtract_one(&inflight_var);
-                    let inv_after_add = inv_after_remove.add_one(&completed_var);
-                    let inv_after_completion = inv_after_add.project_right();
-
-                    // Check if completion preserves the same global state invariant
-                    if !self.check_formula_implies(&inv_after_completion, global_inv)? {
-                        return Err(format!(
-                            "Invariant not inductive for request completion: {} at {} -> {} in global state {}",
-                            req, final_local, resp, global_state
-                        ));
-                    }
+                    obligations.push(
+                        global_inv,
+                        global_inv,
+                        Some(&inflight_var),
+                        &completed_var,
+                        || {
+                            format!(
+                                "Invariant not inductive for request completion: {} at {} -> {} in global state {}",
+                                req, final_local, resp, global_state
+                            )
+                        },
+                    );
                 }
             }
         }
 
-        Ok(())
-    }
-
-    /// Check if one proof invariant implies another using Presburger arithmetic
-    fn check_formula_implies(
-        &self,
-        antecedent: &ProofInvariant<RequestStatePair<Req, L, Resp>>,
-        consequent: &ProofInvariant<RequestStatePair<Req, L, Resp>>,
-    ) -> Result<bool, String>
-    where
-        G: Display,
-        L: Clone + Display + ToString,
-        Req: Clone + Display + ToString,
-        Resp: Clone + Display + ToString,
-    {
-        // Get all variables that might appear in either formula
-        let mut all_vars = HashSet::default();
-        all_vars.extend(antecedent.variables.iter().cloned());
-        all_vars.extend(consequent.variables.iter().cloned());
-
-        // Convert to a consistent vector of string variables
-        let mut string_vars: Vec<String> = all_vars.iter().map(|v| v.to_string()).collect();
-        string_vars.sort();
-
-        // Convert both invariants to use string representations
-        let antecedent_string = antecedent.clone().map(|v| v.to_string());
-        let consequent_string = consequent.clone().map(|v| v.to_string());
-
-        // Convert to Presburger sets using the same variable mapping
-        let antecedent_set = formula_to_presburger(&antecedent_string.formula, &string_vars);
-        let consequent_set = formula_to_presburger(&consequent_string.formula, &string_vars);
-
-        // Check if antecedent ⊆ consequent (i.e., antecedent \ consequent = ∅)
-        let difference = antecedent_set.difference(&consequent_set);
-        Ok(difference.is_empty())
+        obligations.check()
     }
 
     /// Check that the invariant implies the target property (serializability)
@@ -607,12 +552,11 @@ where
         // Get the semilinear set of serializable executions
         // This uses Response(Req, Resp) as the type
         use crate::ns_to_petri::ReqPetriState;
-        let serializable_set: crate::semilinear::SemilinearSet<_> =
-            ns.serialized_automaton_kleene(|req, resp| {
-                crate::semilinear::SemilinearSet::singleton(crate::semilinear::SparseVector::unit(
-                    ReqPetriState::Response(req, resp),
-                ))
-            });
+        // (in SPresburger form, so that a star over the component budget does not panic)
+        use crate::spresburger::SPresburgerSet;
+        let serializable_set: SPresburgerSet<_> = ns.serialized_automaton_kleene(|req, resp| {
+            SPresburgerSet::atom(ReqPetriState::Response(req, resp))
+        });
 
         // Check each global state
         for (global_state, invariant) in &self.global_invariants {
@@ -633,7 +577,7 @@ where
             let substituted_invariant = invariant.substitute(&mut mapping);
 
             // Check if the invariant implies membership in the serializable set
-            if !self.invariant_implies_semilinear(
+            if !self.invariant_implies_spresburger(
                 &substituted_invariant,
                 &serializable_set,
                 global_state,
@@ -655,6 +599,21 @@ where
         semilinear: &crate::semilinear::SemilinearSet<T>,
         global_state: &G,
     ) -> Result<bool, String>
+    where
+        T: Clone + Eq + Hash + Display + Debug + Ord + ToString,
+        G: Display,
+    {
+        let semilinear = crate::spresburger::SPresburgerSet::from_semilinear(semilinear.clone());
+        self.invariant_implies_spresburger(invariant, &semilinear, global_state)
+    }
+
+    /// `invariant_implies_semilinear` for a set in any `SPresburgerSet` form
+    fn invariant_implies_spresburger<T>(
+        &self,
+        invariant: &ProofInvariant<T>,
+        semilinear: &crate::spresburger::SPresburgerSet<T>,
+        global_state: &G,
+    ) -> Result<bool, String>
     where
         T: Clone + Eq + Hash + Display + Debug + Ord + ToString,
         G: Display,
@@ -669,8 +628,7 @@ where
 
         // Convert semilinear set to String type and then to PresburgerSet
         let string_semilinear = semilinear.clone().rename(|v| v.to_string());
-        let mut spresburger =
-            crate::spresburger::SPresburgerSet::from_semilinear(string_semilinear.clone());
+        let mut spresburger = string_semilinear.clone();
         let semilinear_as_presburger = spresburger.as_presburger();
 
         // Check if invariant_set ⊆ semilinear_set
@@ -697,6 +655,171 @@ where
 
 
 
+/// The inductiveness obligations of an `NSInvariant`, see `check_inductive`.
+///
+/// Obligations are stated over the invariants as strings, which is what
+/// `formula_to_presburger` works on, so that they can be shared with the worker threads.
+/// Each distinct invariant is converted once, and global states whose invariants are
+/// structurally equal share it. An obligation that repeats an earlier one (same source
+/// and target invariant, same tokens moved, e.g. a transition between two global states
+/// with the same invariants as another) is checked only once.
+struct InductiveObligations<'a, G, Var: Eq + Hash> {
+    global_invariants: &'a HashMap<G, ProofInvariant<Var>>,
+    /// Index of each distinct invariant in `invariants`
+    ids: HashMap<&'a ProofInvariant<Var>, usize>,
+    invariants: Vec<StringInvariant>,
+    seen: HashSet<(usize, usize, Option<String>, String)>,
+    obligations: Vec<Obligation>,
+}
+
+/// An invariant over the string names of its variables
+struct StringInvariant {
+    invariant: ProofInvariant<String>,
+    /// The same, ready for `filter_and_subtract_one` and `add_one`
+    shiftable: ProofInvariant<Either<usize, String>>,
+}
+
+enum Obligation {
+    /// The invariant `from`, with a token moved from `remove` (or a fresh one) to `add`,
+    /// implies the invariant `to`
+    Implies {
+        from: usize,
+        to: usize,
+        remove: Option<String>,
+        add: String,
+        error: String,
+    },
+    /// The check cannot even be stated, and fails at this point
+    Fail(String),
+}
+
+impl<'a, G, Var> InductiveObligations<'a, G, Var>
+where
+    G: Eq + Hash,
+    Var: Eq + Hash + Display,
+{
+    fn new(global_invariants: &'a HashMap<G, ProofInvariant<Var>>) -> Self {
+        InductiveObligations {
+            global_invariants,
+            ids: HashMap::default(),
+            invariants: Vec::new(),
+            seen: HashSet::default(),
+            obligations: Vec::new(),
+        }
+    }
+
+    /// The id of the invariant of `global`, if it has one
+    fn invariant(&mut self, global: &G) -> Option<usize> {
+        let invariant = self.global_invariants.get(global)?;
+        if let Some(&id) = self.ids.get(invariant) {
+            return Some(id);
+        }
+        let as_strings = ProofInvariant {
+            variables: invariant.variables.iter().map(|v| v.to_string()).collect(),
+            formula: invariant.formula.clone().map(|v| v.to_string()),
+        };
+        let shiftable = as_strings.clone().map(Either::Right);
+        self.invariants.push(StringInvariant {
+            invariant: as_strings,
+            shiftable,
+        });
+        let id = self.invariants.len() - 1;
+        self.ids.insert(invariant, id);
+        Some(id)
+    }
+
+    /// Add the obligation that `from` with a token moved from `remove` to `add` implies
+    /// `to`, unless it was already added. `error` describes it if it fails.
+    fn push(
+        &mut self,
+        from: usize,
+        to: usize,
+        remove: Option<&Var>,
+        add: &Var,
+        error: impl FnOnce() -> String,
+    ) {
+        let remove = remove.map(|v| v.to_string());
+        let add = add.to_string();
+        if !self.seen.insert((from, to, remove.clone(), add.clone())) {
+            return;
+        }
+        self.obligations.push(Obligation::Implies {
+            from,
+            to,
+            remove,
+            add,
+            error: error(),
+        });
+    }
+
+    fn fail(&mut self, error: String) {
+        self.obligations.push(Obligation::Fail(error));
+    }
+
+    /// Decide the obligations, reporting the first one that fails (in the order they
+    /// were added, as a sequential check would)
+    fn check(self) -> Result<(), String> {
+        let invariants = &self.invariants;
+        let outcomes = crate::parallel::run_until_decisive(
+            &self.obligations,
+            crate::parallel::jobs(),
+            |_, obligation| match obligation {
+                Obligation::Implies {
+                    from,
+                    to,
+                    remove,
+                    add,
+                    error,
+                } => {
+                    let from = &invariants[*from].shiftable;
+                    let shifted = match remove {
+                        Some(remove) => from.filter_and_subtract_one(remove).add_one(add),
+                        None => from.add_one(add),
+                    };
+                    if string_invariant_implies(
+                        &shifted.project_right(),
+                        &invariants[*to].invariant,
+                    ) {
+                        Ok(())
+                    } else {
+                        Err(error.clone())
+                    }
+                }
+                Obligation::Fail(error) => Err(error.clone()),
+            },
+            |outcome| outcome.is_err(),
+        );
+        outcomes
+            .into_iter()
+            .find(|outcome| outcome.is_err())
+            .unwrap_or(Ok(()))
+    }
+}
+
+/// Check if one proof invariant implies another using Presburger arithmetic.
+///
+/// The consequent is usually the invariant of a global state that many obligations
+/// lead to; `formula_to_presburger` memoizes its set per thread, so it is converted
+/// once per worker rather than once per obligation.
+fn string_invariant_implies(
+    antecedent: &ProofInvariant<String>,
+    consequent: &ProofInvariant<String>,
+) -> bool {
+    // Get all variables that might appear in either formula, in a consistent order
+    let mut all_vars = HashSet::default();
+    all_vars.extend(antecedent.variables.iter().cloned());
+    all_vars.extend(consequent.variables.iter().cloned());
+    let mut string_vars: Vec<String> = all_vars.into_iter().collect();
+    string_vars.sort();
+
+    // Convert to Presburger sets using the same variable mapping
+    let antecedent_set = formula_to_presburger(&antecedent.formula, &string_vars);
+    let consequent_set = formula_to_presburger(&consequent.formula, &string_vars);
+
+    // Check if antecedent ⊆ consequent (i.e., antecedent \ consequent = ∅)
+    antecedent_set.difference(&consequent_set).is_empty()
+}
+
 /// Translate a Petri net proof to NS-level invariants
 pub fn translate_petri_proof_to_ns<G, L, Req, Resp>(
     petri_proof: ProofInvariant<PetriPlace<L, G, Req, Resp>>,
@@ -708,6 +831,7 @@ where
     Req: Clone + Eq + Hash + Debug + Display,
     Resp: Clone + Eq + Hash + Debug + Display,
 {
+    let _span = crate::trace::span("proof_translation");
     let mut global_invariants = HashMap::default();
 
     // Get all global states from the NS
@@ -1507,6 +1631,35 @@ mod tests {
             _ => panic!("Expected NotSerializable decision"),
         }
     }
+
+    #[test]
+    fn test_inductive_obligations_share_invariants_and_skip_repeats() {
+        // x = 0, over x and y
+        let x = "x".to_string();
+        let y = "y".to_string();
+        let invariant = ProofInvariant::new(
+            vec![x.clone(), y.clone()],
+            Formula::Constraint(Constraint::new(AffineExpr::from_var(x.clone()), CompOp::Eq)),
+        );
+        let mut global_invariants = HashMap::default();
+        global_invariants.insert("G1", invariant.clone());
+        global_invariants.insert("G2", invariant);
+
+        let mut obligations = InductiveObligations::new(&global_invariants);
+        let g1 = obligations.invariant(&"G1").unwrap();
+        let g2 = obligations.invariant(&"G2").unwrap();
+        assert_eq!(g1, g2);
+        assert_eq!(obligations.invariant(&"G3"), None);
+
+        // Adding a y keeps x = 0, adding an x does not
+        obligations.push(g1, g2, None, &y, || "add y".to_string());
+        obligations.push(g2, g1, None, &y, || panic!("repeated obligation"));
+        obligations.push(g1, g1, None, &x, || "add x".to_string());
+        obligations.push(g1, g1, Some(&y), &x, || "move y to x".to_string());
+        assert_eq!(obligations.obligations.len(), 3);
+
+        assert_eq!(obligations.check(), Err("add x".to_string()));
+    }
 }
 
 /// Check if a formula with no free variables is satisfied
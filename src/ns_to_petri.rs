@@ -229,6 +229,6 @@ mod tests {
         assert_eq!(initial_marking_set.len(), 1);
 
         // Verify transitions count (one for request, one for response, one for state transition)
-        assert_eq!(petri.get_transitions().len(), 3);
+        assert_eq!(petri.num_transitions(), 3);
     }
 }
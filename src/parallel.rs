@@ -0,0 +1,261 @@
+//! Bounded worker pool for independent analysis tasks.
+//!
+//! The pool runs a list of tasks and stops at the first *decisive* result (e.g. a
+//! reachable disjunct). Results are always reported as if the tasks had run
+//! sequentially in index order, so the outcome does not depend on thread scheduling.
+
+use std::cell::{Cell, RefCell};
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
+
+/// Number of worker threads used for parallel analyses (1 = sequential)
+static JOBS: AtomicUsize = AtomicUsize::new(1);
+
+thread_local! {
+    /// Cancellation flag of the task currently running on this thread, if any
+    static CANCEL_TOKEN: RefCell<Option<Arc<AtomicBool>>> = const { RefCell::new(None) };
+    /// Deadline of the analysis running on this thread, if any (see `with_deadline`)
+    static DEADLINE: Cell<Option<Instant>> = const { Cell::new(None) };
+}
+
+/// Set the number of worker threads (called from `main.rs`)
+pub fn set_jobs(jobs: usize) {
+    JOBS.store(jobs.max(1), Ordering::SeqCst);
+}
+
+/// Get the number of worker threads
+pub fn jobs() -> usize {
+    JOBS.load(Ordering::SeqCst)
+}
+
+/// Whether the task running on the current thread has been cancelled, or the deadline
+/// of its analysis has passed.
+///
+/// Long-running work (such as an SMPT subprocess) polls this and gives up early;
+/// the result of a cancelled task is always discarded by the pool.
+pub fn is_cancelled() -> bool {
+    deadline_passed()
+        || CANCEL_TOKEN.with(|token| {
+            token
+                .borrow()
+                .as_ref()
+                .is_some_and(|token| token.load(Ordering::SeqCst))
+        })
+}
+
+/// Whether the current thread is running a pool task or an analysis with a deadline,
+/// which may be cancelled
+pub fn in_cancellable_task() -> bool {
+    DEADLINE.with(Cell::get).is_some() || CANCEL_TOKEN.with(|token| token.borrow().is_some())
+}
+
+/// Run `f` with a deadline, after which `is_cancelled` holds on this thread and on the
+/// pool threads it starts. Used for the per-file timeout of the batch mode.
+pub fn with_deadline<R>(deadline: Option<Instant>, f: impl FnOnce() -> R) -> R {
+    let previous = DEADLINE.with(|slot| slot.replace(deadline));
+    let result = f();
+    DEADLINE.with(|slot| slot.set(previous));
+    result
+}
+
+/// Whether the deadline of the analysis on this thread has passed
+pub fn deadline_passed() -> bool {
+    DEADLINE
+        .with(Cell::get)
+        .is_some_and(|deadline| Instant::now() >= deadline)
+}
+
+/// Run `tasks` in index order until the first decisive result.
+///
+/// Returns the results of tasks `0..=d`, where `d` is the lowest index whose result
+/// satisfies `is_decisive`, or the results of all tasks if none does. This is exactly
+/// the prefix a sequential loop with early exit would produce.
+///
+/// With `jobs > 1` the tasks are pulled from a shared counter by `jobs` scoped threads.
+/// Once task `d` is decisive, tasks after `d` are no longer started and the running
+/// ones are cancelled (see `is_cancelled`). Tasks before `d` always run to completion,
+/// since one of them may still turn out to be decisive. A task that panics counts as
+/// decisive, and its panic is resumed on the calling thread with the original payload.
+pub fn run_until_decisive<T, R, F, D>(tasks: &[T], jobs: usize, run: F, is_decisive: D) -> Vec<R>
+where
+    T: Sync,
+    R: Send,
+    F: Fn(usize, &T) -> R + Sync,
+    D: Fn(&R) -> bool + Sync,
+{
+    if jobs <= 1 || tasks.len() <= 1 {
+        let mut results = Vec::new();
+        for (i, task) in tasks.iter().enumerate() {
+            let result = run(i, task);
+            let decisive = is_decisive(&result);
+            results.push(result);
+            if decisive {
+                break;
+            }
+        }
+        return results;
+    }
+
+    let next = AtomicUsize::new(0);
+    let cutoff = AtomicUsize::new(usize::MAX);
+    let tokens: Vec<Arc<AtomicBool>> = (0..tasks.len())
+        .map(|_| Arc::new(AtomicBool::new(false)))
+        .collect();
+    let slots: Vec<Mutex<Option<std::thread::Result<R>>>> =
+        (0..tasks.len()).map(|_| Mutex::new(None)).collect();
+
+    // Workers belong to the analysis of the calling thread
+    let deadline = DEADLINE.with(Cell::get);
+    let collector = crate::stats::analysis_collector();
+    let budgeted = crate::isl::budget_active();
+
+    std::thread::scope(|scope| {
+        for _ in 0..jobs.min(tasks.len()) {
+            scope.spawn(|| {
+                DEADLINE.with(|slot| slot.set(deadline));
+                crate::isl::set_budget_active(budgeted);
+                loop {
+                    let i = next.fetch_add(1, Ordering::SeqCst);
+                    if i >= tasks.len() || i > cutoff.load(Ordering::SeqCst) {
+                        break;
+                    }
+
+                    CANCEL_TOKEN.with(|token| *token.borrow_mut() = Some(tokens[i].clone()));
+                    let result = panic::catch_unwind(AssertUnwindSafe(|| {
+                        crate::stats::with_analysis_collector(collector.clone(), || {
+                            run(i, &tasks[i])
+                        })
+                    }));
+                    CANCEL_TOKEN.with(|token| *token.borrow_mut() = None);
+
+                    let decisive = result.as_ref().map_or(true, |result| is_decisive(result));
+                    if !tokens[i].load(Ordering::SeqCst) && decisive {
+                        let previous = cutoff.fetch_min(i, Ordering::SeqCst);
+                        if i < previous {
+                            for token in &tokens[i + 1..] {
+                                token.store(true, Ordering::SeqCst);
+                            }
+                        }
+                    }
+                    *slots[i].lock().unwrap() = Some(result);
+                }
+
+                // Release ISL objects cached on this thread, then the thread's ctx itself
+                crate::isl::reset_thread_ctx();
+            });
+        }
+    });
+
+    let end = match cutoff.into_inner() {
+        usize::MAX => tasks.len(),
+        d => d + 1,
+    };
+    slots
+        .into_iter()
+        .take(end)
+        .map(|slot| {
+            match slot
+                .into_inner()
+                .unwrap()
+                .expect("every task before the cutoff has run")
+            {
+                Ok(result) => result,
+                Err(payload) => panic::resume_unwind(payload),
+            }
+        })
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_run_until_decisive_matches_sequential() {
+        let tasks: Vec<usize> = (0..20).collect();
+        // Later tasks finish first, so the lowest decisive index must win anyway
+        let run = |_: usize, t: &usize| {
+            std::thread::sleep(std::time::Duration::from_millis((20 - *t as u64) * 2));
+            *t
+        };
+        let is_decisive = |r: &usize| *r == 7 || *r == 15;
+
+        let sequential = run_until_decisive(&tasks, 1, run, is_decisive);
+        let parallel = run_until_decisive(&tasks, 8, run, is_decisive);
+        assert_eq!(sequential, (0..=7).collect::<Vec<_>>());
+        assert_eq!(parallel, sequential);
+    }
+
+    #[test]
+    fn test_run_until_decisive_without_decisive_result() {
+        let tasks: Vec<usize> = (0..10).collect();
+        let results = run_until_decisive(&tasks, 4, |i, t| i + t, |_| false);
+        assert_eq!(results, (0..10).map(|i| 2 * i).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_panic_payload_reaches_caller() {
+        let tasks: Vec<usize> = (0..8).collect();
+        let outcome = panic::catch_unwind(|| {
+            run_until_decisive(
+                &tasks,
+                4,
+                |i, _| {
+                    if i == 3 {
+                        panic::resume_unwind(Box::new(i));
+                    }
+                    false
+                },
+                |_| false,
+            )
+        });
+        assert_eq!(*outcome.unwrap_err().downcast::<usize>().unwrap(), 3);
+    }
+
+    #[test]
+    fn test_cancellation_is_visible_to_later_tasks() {
+        let tasks: Vec<usize> = (0..4).collect();
+        let results = run_until_decisive(
+            &tasks,
+            4,
+            |i, _| {
+                if i == 0 {
+                    true
+                } else {
+                    // Wait until task 0 cancels us
+                    let start = std::time::Instant::now();
+                    while !is_cancelled() && start.elapsed().as_secs() < 5 {
+                        std::thread::yield_now();
+                    }
+                    is_cancelled()
+                }
+            },
+            |decisive| *decisive,
+        );
+        assert_eq!(results, vec![true]);
+        assert!(!is_cancelled());
+    }
+
+    #[test]
+    fn test_deadline_reaches_pool_threads() {
+        let tasks: Vec<usize> = (0..4).collect();
+        let passed = with_deadline(Some(Instant::now()), || {
+            run_until_decisive(&tasks, 4, |_, _| is_cancelled(), |_| false)
+        });
+        assert_eq!(passed, vec![true; 4]);
+        assert!(!in_cancellable_task());
+
+        let far = Instant::now() + std::time::Duration::from_secs(3600);
+        let pending = with_deadline(Some(far), || {
+            run_until_decisive(
+                &tasks,
+                4,
+                |_, _| in_cancellable_task() && !is_cancelled(),
+                |_| false,
+            )
+        });
+        assert_eq!(pending, vec![true; 4]);
+    }
+}
@@ -93,6 +93,10 @@ pub mod hc_expr_serde {
 // Now we need to tell serde to use our custom module for Hc<Expr> fields
 // We'll need to update the Expr enum to use this
 
+/// Hash-consing table for expressions.
+///
+/// `HcTable` synchronises internally, so the constructors take `&self` and one table can
+/// be shared by the worker threads of `program_to_ns` (see `--parallel-ns`).
 pub struct ExprHc {
     table: HcTable<Expr>,
 }
@@ -103,11 +107,11 @@ impl ExprHc {
             table: HcTable::new(),
         }
     }
-    pub fn assign(&mut self, var: String, expr: Hc<Expr>) -> Hc<Expr> {
+    pub fn assign(&self, var: String, expr: Hc<Expr>) -> Hc<Expr> {
         self.table.hashcons(Expr::Assign(var, expr))
     }
 
-    pub fn equal(&mut self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
+    pub fn equal(&self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
         // If both are constants, return 1 or 0
         if let Expr::Number(n1) = left.as_ref() {
             if let Expr::Number(n2) = right.as_ref() {
@@ -117,7 +121,7 @@ impl ExprHc {
         self.table.hashcons(Expr::Equal(left, right))
     }
 
-    pub fn add(&mut self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
+    pub fn add(&self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
         // If both are constants, return the sum
         if let Expr::Number(n1) = left.as_ref() {
             if let Expr::Number(n2) = right.as_ref() {
@@ -127,7 +131,7 @@ impl ExprHc {
         self.table.hashcons(Expr::Add(left, right))
     }
 
-    pub fn subtract(&mut self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
+    pub fn subtract(&self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
         // If both are constants, return the difference
         if let Expr::Number(n1) = left.as_ref() {
             if let Expr::Number(n2) = right.as_ref() {
@@ -137,7 +141,7 @@ impl ExprHc {
         self.table.hashcons(Expr::Subtract(left, right))
     }
 
-    pub fn not(&mut self, expr: Hc<Expr>) -> Hc<Expr> {
+    pub fn not(&self, expr: Hc<Expr>) -> Hc<Expr> {
         // If expr is a constant, return 1 or 0
         if let Expr::Number(n) = expr.as_ref() {
             return self.number(if *n == 0 { 1 } else { 0 });
@@ -145,7 +149,7 @@ impl ExprHc {
         self.table.hashcons(Expr::Not(expr))
     }
 
-    pub fn and(&mut self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
+    pub fn and(&self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
         // Short-circuit: if left is 0, return 0 without evaluating right
         if let Expr::Number(n) = left.as_ref() {
             if *n == 0 {
@@ -159,7 +163,7 @@ impl ExprHc {
         self.table.hashcons(Expr::And(left, right))
     }
 
-    pub fn or(&mut self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
+    pub fn or(&self, left: Hc<Expr>, right: Hc<Expr>) -> Hc<Expr> {
         // Short-circuit: if left is non-zero, return 1 without evaluating right
         if let Expr::Number(n) = left.as_ref() {
             if *n != 0 {
@@ -173,7 +177,7 @@ impl ExprHc {
         self.table.hashcons(Expr::Or(left, right))
     }
 
-    pub fn sequence(&mut self, first: Hc<Expr>, second: Hc<Expr>) -> Hc<Expr> {
+    pub fn sequence(&self, first: Hc<Expr>, second: Hc<Expr>) -> Hc<Expr> {
         // If first is a constant, return second
         if let Expr::Number(_) = first.as_ref() {
             return second;
@@ -182,7 +186,7 @@ impl ExprHc {
     }
 
     pub fn if_expr(
-        &mut self,
+        &self,
         cond: Hc<Expr>,
         then_branch: Hc<Expr>,
         else_branch: Hc<Expr>,
@@ -199,7 +203,7 @@ impl ExprHc {
             .hashcons(Expr::If(cond, then_branch, else_branch))
     }
 
-    pub fn while_expr(&mut self, cond: Hc<Expr>, body: Hc<Expr>) -> Hc<Expr> {
+    pub fn while_expr(&self, cond: Hc<Expr>, body: Hc<Expr>) -> Hc<Expr> {
         // If cond is a 0 constant, return 0
         if let Expr::Number(_) = cond.as_ref() {
             if cond == self.number(0) {
@@ -209,25 +213,31 @@ impl ExprHc {
         self.table.hashcons(Expr::While(cond, body))
     }
 
-    pub fn yield_expr(&mut self) -> Hc<Expr> {
+    pub fn yield_expr(&self) -> Hc<Expr> {
         self.table.hashcons(Expr::Yield)
     }
 
-    pub fn exit(&mut self) -> Hc<Expr> {
+    pub fn exit(&self) -> Hc<Expr> {
         self.table.hashcons(Expr::Exit)
     }
 
-    pub fn unknown(&mut self) -> Hc<Expr> {
+    pub fn unknown(&self) -> Hc<Expr> {
         self.table.hashcons(Expr::Unknown)
     }
 
-    pub fn number(&mut self, n: i64) -> Hc<Expr> {
+    pub fn number(&self, n: i64) -> Hc<Expr> {
         self.table.hashcons(Expr::Number(n))
     }
 
-    pub fn variable(&mut self, var: String) -> Hc<Expr> {
+    pub fn variable(&self, var: String) -> Hc<Expr> {
         self.table.hashcons(Expr::Variable(var))
     }
+
+    /// Hash-cons `expr` as it is, without the simplifications of the constructors above
+    /// (for expressions that were built by them before, like those of `incremental.rs`)
+    pub fn node(&self, expr: Expr) -> Hc<Expr> {
+        self.table.hashcons(expr)
+    }
 }
 
 #[derive(Debug)]
@@ -264,6 +274,7 @@ pub enum Token {
 
 /// Parse a string directly into an expression
 pub fn parse(source: &str, table: &mut ExprHc) -> Result<Hc<Expr>, String> {
+    let _span = crate::trace::span("parse");
     let tokens = tokenize(source)?;
     let mut parser = Parser::new(tokens);
     parser.parse(table)
@@ -271,6 +282,7 @@ pub fn parse(source: &str, table: &mut ExprHc) -> Result<Hc<Expr>, String> {
 
 /// Parse a string into a program containing multiple requests
 pub fn parse_program(source: &str, table: &mut ExprHc) -> Result<Program, String> {
+    let _span = crate::trace::span("parse");
     let tokens = tokenize(source)?;
     let mut parser = Parser::new(tokens);
     parser.parse_program(table)
@@ -1,12 +1,232 @@
 use crate::deterministic_map::{HashMap, HashSet};
 use crate::graphviz;
 use crate::utils::string::escape_for_graphviz_id;
-use std::hash::Hash;
+use std::hash::{BuildHasher, Hash, Hasher};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
 
+/// Dense index of a place in the place table of a Petri net
+pub type PlaceId = u32;
+
+/// Interning table assigning dense `PlaceId`s to places in order of first appearance.
+///
+/// The table is shared between clones of a net and only copied when a clone
+/// interns a new place, so cloning a net does not clone its places.
+#[derive(Clone)]
+struct PlaceTable<Place> {
+    places: Vec<Place>,
+    /// Hash of each place, so that hashing a net does not rehash its places
+    hashes: Vec<u64>,
+    ids: HashMap<Place, PlaceId>,
+}
+
+impl<Place> PlaceTable<Place>
+where
+    Place: Clone + PartialEq + Eq + Hash,
+{
+    fn new() -> Self {
+        PlaceTable {
+            places: Vec::new(),
+            hashes: Vec::new(),
+            ids: HashMap::default(),
+        }
+    }
+
+    fn intern(&mut self, place: Place) -> PlaceId {
+        if let Some(&id) = self.ids.get(&place) {
+            return id;
+        }
+        let id = self.places.len() as PlaceId;
+        self.hashes.push(self.ids.hasher().hash_one(&place));
+        self.ids.insert(place.clone(), id);
+        self.places.push(place);
+        id
+    }
+}
+
+/// One side (inputs or outputs) of all transitions in CSR form:
+/// the places of transition `t` are `places[offsets[t]..offsets[t + 1]]`.
+#[derive(Clone)]
+struct Arcs {
+    offsets: Vec<u32>,
+    places: Vec<PlaceId>,
+}
+
+impl Arcs {
+    fn new() -> Self {
+        Arcs {
+            offsets: vec![0],
+            places: Vec::new(),
+        }
+    }
+
+    fn len(&self) -> usize {
+        self.offsets.len() - 1
+    }
+
+    fn get(&self, t: usize) -> &[PlaceId] {
+        &self.places[self.offsets[t] as usize..self.offsets[t + 1] as usize]
+    }
+
+    fn push(&mut self, places: impl IntoIterator<Item = PlaceId>) {
+        self.places.extend(places);
+        self.offsets.push(self.places.len() as u32);
+    }
+
+    /// Keep only the transitions `t` with `keep[t]`, preserving their order
+    fn retain(&mut self, keep: &[bool]) {
+        let mut kept = Arcs::new();
+        for t in (0..self.len()).filter(|&t| keep[t]) {
+            kept.push(self.get(t).iter().copied());
+        }
+        *self = kept;
+    }
+}
+
+/// Prune with the linear-time propagation of `propagate_reachable` instead of
+/// rescanning all transitions for every newly reachable place
+pub static LINEAR_PRUNING: AtomicBool = AtomicBool::new(true);
+
+pub fn set_linear_pruning(on: bool) {
+    LINEAR_PRUNING.store(on, Ordering::SeqCst);
+}
+
+pub fn linear_pruning_enabled() -> bool {
+    LINEAR_PRUNING.load(Ordering::SeqCst)
+}
+
+/// Places reachable from `seeds` and transitions that can fire, where transition `t`
+/// consumes `from.get(t)` and produces `to.get(t)`.
+///
+/// Rescans every transition each time a place is popped from the worklist, i.e.
+/// O(places * transitions * arity). Kept as reference for `propagate_reachable`.
+fn scan_reachable(n_places: usize, from: &Arcs, to: &Arcs, seeds: &[PlaceId]) -> (Vec<bool>, Vec<bool>) {
+    let mut reachable_places = vec![false; n_places];
+    for &id in seeds {
+        reachable_places[id as usize] = true;
+    }
+    let mut reachable_transitions = vec![false; from.len()];
+    let mut worklist: Vec<PlaceId> = seeds.to_vec();
+
+    while let Some(_current_place) = worklist.pop() {
+        // Check all transitions to see if any can now fire
+        for transition_idx in 0..from.len() {
+            // Skip if we've already processed this transition
+            if reachable_transitions[transition_idx] {
+                continue;
+            }
+
+            // Check if all input places of this transition are reachable
+            let can_fire = from
+                .get(transition_idx)
+                .iter()
+                .all(|&input_place| reachable_places[input_place as usize]);
+
+            if can_fire {
+                // Mark this transition as reachable (can fire)
+                reachable_transitions[transition_idx] = true;
+
+                // Add all output places to reachable set and worklist
+                for &output_place in to.get(transition_idx) {
+                    if !reachable_places[output_place as usize] {
+                        reachable_places[output_place as usize] = true;
+                        worklist.push(output_place);
+                    }
+                }
+            }
+        }
+    }
+
+    (reachable_places, reachable_transitions)
+}
+
+/// Same result as `scan_reachable` in O(places + arcs), by Horn-clause propagation.
+///
+/// Each transition counts the input arcs whose place is not reachable yet. When a
+/// place becomes reachable, the counters of the transitions consuming it are
+/// decremented through a place -> consumer index, and a transition fires exactly
+/// once, when its counter reaches zero.
+fn propagate_reachable(
+    n_places: usize,
+    from: &Arcs,
+    to: &Arcs,
+    seeds: &[PlaceId],
+) -> (Vec<bool>, Vec<bool>) {
+    let mut reachable_places = vec![false; n_places];
+    let mut reachable_transitions = vec![false; from.len()];
+
+    // Like the scan, only look at the transitions once some place is reachable,
+    // so that without seeds not even input-free transitions fire
+    if seeds.is_empty() {
+        return (reachable_places, reachable_transitions);
+    }
+
+    // CSR index from each place to the transitions consuming it, one entry per arc
+    let mut consumer_offsets = vec![0u32; n_places + 1];
+    for &place in &from.places {
+        consumer_offsets[place as usize + 1] += 1;
+    }
+    for i in 0..n_places {
+        consumer_offsets[i + 1] += consumer_offsets[i];
+    }
+    let mut consumers = vec![0u32; from.places.len()];
+    let mut next_slot = consumer_offsets.clone();
+    for t in 0..from.len() {
+        for &place in from.get(t) {
+            consumers[next_slot[place as usize] as usize] = t as u32;
+            next_slot[place as usize] += 1;
+        }
+    }
+
+    let mut missing_inputs: Vec<u32> = (0..from.len()).map(|t| from.get(t).len() as u32).collect();
+    let mut ready: Vec<usize> = (0..from.len()).filter(|&t| missing_inputs[t] == 0).collect();
+    let mut worklist: Vec<PlaceId> = Vec::new();
+    for &id in seeds {
+        if !reachable_places[id as usize] {
+            reachable_places[id as usize] = true;
+            worklist.push(id);
+        }
+    }
+
+    loop {
+        // Fire every transition whose inputs are all reachable
+        while let Some(t) = ready.pop() {
+            reachable_transitions[t] = true;
+            for &output_place in to.get(t) {
+                if !reachable_places[output_place as usize] {
+                    reachable_places[output_place as usize] = true;
+                    worklist.push(output_place);
+                }
+            }
+        }
+
+        let Some(place) = worklist.pop() else {
+            break;
+        };
+        let consumers_of_place = &consumers
+            [consumer_offsets[place as usize] as usize..consumer_offsets[place as usize + 1] as usize];
+        for &t in consumers_of_place {
+            missing_inputs[t as usize] -= 1;
+            if missing_inputs[t as usize] == 0 {
+                ready.push(t as usize);
+            }
+        }
+    }
+
+    (reachable_places, reachable_transitions)
+}
+
+/// A Petri net over places of type `Place`.
+///
+/// Places are interned into a shared table and referred to by `PlaceId`; transitions
+/// are stored as flat CSR arrays of IDs. Generic places are only materialized by the
+/// `get_*` accessors, while pruning and the `*_ids` accessors work on IDs directly.
 #[derive(Clone)]
 pub struct Petri<Place> {
-    initial_marking: Vec<Place>,
-    transitions: Vec<(Vec<Place>, Vec<Place>)>,
+    places: Arc<PlaceTable<Place>>,
+    initial_marking: Vec<PlaceId>,
+    inputs: Arcs,
+    outputs: Arcs,
 }
 
 impl<Place> Petri<Place>
@@ -15,75 +235,180 @@ where
 {
     /// Create a new Petri net with initial marking
     pub fn new(initial_marking: Vec<Place>) -> Self {
+        let mut places = PlaceTable::new();
+        let initial_marking = initial_marking
+            .into_iter()
+            .map(|place| places.intern(place))
+            .collect();
         Petri {
+            places: Arc::new(places),
             initial_marking,
-            transitions: Vec::new(),
+            inputs: Arcs::new(),
+            outputs: Arcs::new(),
+        }
+    }
+
+    /// Get the ID of a place, interning it if the net has not seen it yet
+    pub fn intern(&mut self, place: Place) -> PlaceId {
+        match self.places.ids.get(&place) {
+            Some(&id) => id,
+            None => Arc::make_mut(&mut self.places).intern(place),
         }
     }
 
     /// Add a transition to the Petri net (input places, output places)
     pub fn add_transition(&mut self, input: Vec<Place>, output: Vec<Place>) {
-        self.transitions.push((input, output));
+        let input: Vec<PlaceId> = input.into_iter().map(|p| self.intern(p)).collect();
+        let output: Vec<PlaceId> = output.into_iter().map(|p| self.intern(p)).collect();
+        self.inputs.push(input);
+        self.outputs.push(output);
     }
 
     /// Get all unique places in the Petri net
     pub fn get_places(&self) -> Vec<Place> {
-        let mut places = HashSet::default();
-
-        // Collect places from initial marking
-        for place in &self.initial_marking {
-            places.insert(place.clone());
-        }
-
-        // Collect places from transitions
-        for (input, output) in &self.transitions {
-            for place in input {
-                places.insert(place.clone());
-            }
-            for place in output {
-                places.insert(place.clone());
-            }
-        }
-
-        places.into_iter().collect()
+        self.place_ids()
+            .into_iter()
+            .map(|id| self.place(id).clone())
+            .collect()
     }
 
     /// Get the initial marking of the Petri net
     pub fn get_initial_marking(&self) -> Vec<Place> {
-        self.initial_marking.clone()
+        self.resolve(&self.initial_marking)
     }
 
     /// Get all transitions in the Petri net
     pub fn get_transitions(&self) -> Vec<(Vec<Place>, Vec<Place>)> {
-        self.transitions.clone()
+        (0..self.num_transitions())
+            .map(|t| {
+                let (input, output) = self.transition(t);
+                (self.resolve(input), self.resolve(output))
+            })
+            .collect()
+    }
+
+    /// Resolve a list of place IDs to places
+    pub fn resolve(&self, ids: &[PlaceId]) -> Vec<Place> {
+        ids.iter().map(|&id| self.place(id).clone()).collect()
     }
 }
 
-impl<Place> Petri<Place>
-where
-    Place: Clone + PartialEq + Eq + Hash + Ord,
-{
-    /// Get all unique places in the Petri net, sorted for deterministic ordering
-    pub fn get_places_sorted(&self) -> Vec<Place> {
-        let mut places = HashSet::default();
+impl<Place> Petri<Place> {
+    /// The place with the given ID
+    pub fn place(&self, id: PlaceId) -> &Place {
+        &self.places.places[id as usize]
+    }
+
+    /// The ID of a place, if the net has interned it
+    pub fn place_id(&self, place: &Place) -> Option<PlaceId>
+    where
+        Place: Eq + Hash,
+    {
+        self.places.ids.get(place).copied()
+    }
+
+    /// Number of interned places; every `PlaceId` of this net is below this bound
+    pub fn place_table_len(&self) -> usize {
+        self.places.places.len()
+    }
 
-        // Collect places from initial marking
-        for place in &self.initial_marking {
-            places.insert(place.clone());
+    /// Mark the places that occur in the initial marking or in a transition
+    fn used_places(&self) -> Vec<bool> {
+        let mut used = vec![false; self.place_table_len()];
+        for &id in self
+            .initial_marking
+            .iter()
+            .chain(&self.inputs.places)
+            .chain(&self.outputs.places)
+        {
+            used[id as usize] = true;
         }
+        used
+    }
 
-        // Collect places from transitions
-        for (input, output) in &self.transitions {
-            for place in input {
-                places.insert(place.clone());
-            }
-            for place in output {
-                places.insert(place.clone());
+    /// IDs of all places occurring in the net, in increasing order
+    pub fn place_ids(&self) -> Vec<PlaceId> {
+        self.used_places()
+            .into_iter()
+            .enumerate()
+            .filter(|(_, used)| *used)
+            .map(|(id, _)| id as PlaceId)
+            .collect()
+    }
+
+    /// Number of unique places in the Petri net
+    pub fn num_places(&self) -> usize {
+        self.used_places().into_iter().filter(|used| *used).count()
+    }
+
+    /// Number of transitions in the Petri net
+    pub fn num_transitions(&self) -> usize {
+        self.inputs.len()
+    }
+
+    /// Input and output place IDs of transition `t`
+    pub fn transition(&self, t: usize) -> (&[PlaceId], &[PlaceId]) {
+        (self.inputs.get(t), self.outputs.get(t))
+    }
+
+    /// Initial marking as place IDs
+    pub fn initial_marking_ids(&self) -> &[PlaceId] {
+        &self.initial_marking
+    }
+}
+
+/// Structural equality: equal initial markings and equal transitions in the same order.
+/// Place IDs can only be compared directly when both nets share their place table.
+impl<Place: PartialEq> PartialEq for Petri<Place> {
+    fn eq(&self, other: &Self) -> bool {
+        if self.initial_marking.len() != other.initial_marking.len()
+            || self.inputs.offsets != other.inputs.offsets
+            || self.outputs.offsets != other.outputs.offsets
+        {
+            return false;
+        }
+        if Arc::ptr_eq(&self.places, &other.places) {
+            return self.initial_marking == other.initial_marking
+                && self.inputs.places == other.inputs.places
+                && self.outputs.places == other.outputs.places;
+        }
+        let same = |a: &[PlaceId], b: &[PlaceId]| {
+            a.iter()
+                .zip(b)
+                .all(|(&x, &y)| self.place(x) == other.place(y))
+        };
+        same(&self.initial_marking, &other.initial_marking)
+            && same(&self.inputs.places, &other.inputs.places)
+            && same(&self.outputs.places, &other.outputs.places)
+    }
+}
+
+impl<Place: Eq> Eq for Petri<Place> {}
+
+/// Structural hash, consistent with `PartialEq`, over the cached hashes of the places
+impl<Place: Hash> Hash for Petri<Place> {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        let hashes = &self.places.hashes;
+        state.write_usize(self.initial_marking.len());
+        for &id in &self.initial_marking {
+            state.write_u64(hashes[id as usize]);
+        }
+        for arcs in [&self.inputs, &self.outputs] {
+            arcs.offsets.hash(state);
+            for &id in &arcs.places {
+                state.write_u64(hashes[id as usize]);
             }
         }
+    }
+}
 
-        // Sort places to ensure deterministic ordering
-        let mut places_vec: Vec<Place> = places.into_iter().collect();
+impl<Place> Petri<Place>
+where
+    Place: Clone + PartialEq + Eq + Hash + Ord,
+{
+    /// Get all unique places in the Petri net, sorted for deterministic ordering
+    pub fn get_places_sorted(&self) -> Vec<Place> {
+        let mut places_vec = self.get_places();
         places_vec.sort();
         places_vec
     }
@@ -114,18 +439,19 @@ where
         dot.push_str("\n  // Transition nodes\n");
         dot.push_str("  node [shape=rect, width=0.5, height=0.2, fixedsize=true, style=filled, fillcolor=\"#404040\", fontcolor=white];\n");
 
-        for (i, _) in self.transitions.iter().enumerate() {
+        for i in 0..self.num_transitions() {
             dot.push_str(&format!("  T_{} [label=\"t{}\", fontcolor=white];\n", i, i));
         }
 
         let places = self.get_places();
+        let transitions = self.get_transitions();
         // Count tokens per place
         let mut initial_count = HashMap::default();
         // Add zero to initial_count for each place
         for place in &places {
             initial_count.insert(place.clone(), 0);
         }
-        for place in &self.initial_marking {
+        for place in &self.get_initial_marking() {
             *initial_count.entry(place.clone()).or_insert(0) += 1;
         }
 
@@ -162,7 +488,7 @@ where
         let mut input_counts = HashMap::default();
         let mut output_counts = HashMap::default();
 
-        for (i, (input, output)) in self.transitions.iter().enumerate() {
+        for (i, (input, output)) in transitions.iter().enumerate() {
             // Count inputs from each place to this transition
             for place in input {
                 let key = (place.clone(), i);
@@ -178,7 +504,7 @@ where
 
         // Define transition edges with weights
         dot.push_str("\n  // Transition edges\n");
-        for (i, (input, output)) in self.transitions.iter().enumerate() {
+        for (i, (input, output)) in transitions.iter().enumerate() {
             // Process unique input places
             let mut unique_inputs = HashMap::default();
             for place in input {
@@ -244,34 +570,53 @@ where
 }
 
 impl<P> Petri<P> {
-    /// Run an operation on each place
+    /// Run an operation on each place occurrence
     pub fn for_each_place(&self, mut f: impl for<'a> FnMut(&'a P)) {
-        self.initial_marking.iter().for_each(&mut f);
-        for (from, to) in &self.transitions {
-            from.iter().for_each(&mut f);
-            to.iter().for_each(&mut f);
+        for &id in self
+            .initial_marking
+            .iter()
+            .chain(&self.inputs.places)
+            .chain(&self.outputs.places)
+        {
+            f(self.place(id));
         }
     }
+}
 
+impl<P: Clone + PartialEq + Eq + Hash> Petri<P> {
     /// Rename all the places
-    pub fn rename<Q>(self, mut f: impl FnMut(P) -> Q) -> Petri<Q> {
+    ///
+    /// `f` is applied once per interned place. Places that `f` maps to the same
+    /// value are merged.
+    pub fn rename<Q: Clone + PartialEq + Eq + Hash>(self, mut f: impl FnMut(P) -> Q) -> Petri<Q> {
+        let old_places = match Arc::try_unwrap(self.places) {
+            Ok(table) => table.places,
+            Err(shared) => shared.places.clone(),
+        };
+        let mut places = PlaceTable::new();
+        let new_ids: Vec<PlaceId> = old_places
+            .into_iter()
+            .map(|place| places.intern(f(place)))
+            .collect();
+
+        let remap = |mut arcs: Arcs| {
+            for id in &mut arcs.places {
+                *id = new_ids[*id as usize];
+            }
+            arcs
+        };
         Petri {
-            initial_marking: self.initial_marking.into_iter().map(&mut f).collect(),
-            transitions: self
-                .transitions
-                .into_iter()
-                .map(|(from, to)| {
-                    (
-                        from.into_iter().map(&mut f).collect(),
-                        to.into_iter().map(&mut f).collect(),
-                    )
-                })
+            places: Arc::new(places),
+            initial_marking: self
+                .initial_marking
+                .iter()
+                .map(|&id| new_ids[id as usize])
                 .collect(),
+            inputs: remap(self.inputs),
+            outputs: remap(self.outputs),
         }
     }
-}
 
-impl<P: Clone + PartialEq + Eq + Hash> Petri<P> {
     /// Add transitions to make arbitrarily many markings in the given place
     pub fn add_existential_place(&mut self, place: P) {
         self.add_transition(vec![], vec![place]);
@@ -284,7 +629,19 @@ where
 {
     /// Remove transitions where input places are exactly the same as output places
     pub fn remove_identity_transitions(&mut self) {
-        self.transitions.retain(|(input, output)| input != output);
+        let keep: Vec<bool> = (0..self.num_transitions())
+            .map(|t| self.inputs.get(t) != self.outputs.get(t))
+            .collect();
+        self.retain_transitions(&keep);
+    }
+
+    /// Keep only the transitions `t` with `keep[t]`
+    fn retain_transitions(&mut self, keep: &[bool]) {
+        if keep.iter().all(|k| *k) {
+            return;
+        }
+        self.inputs.retain(keep);
+        self.outputs.retain(keep);
     }
 
     /// Filter the Petri net to keep only reachable transitions using a worklist algorithm
@@ -299,88 +656,74 @@ where
     ///
     /// Returns a list of places that were removed (initial list of places minus final list of places).
     pub fn filter_reachable(&mut self, initial_places: &[Place]) -> Vec<Place> {
-        // Get all places that appear in the Petri net before filtering
-        let all_places_before: HashSet<Place> = self.get_places().into_iter().collect();
+        let initial_ids: Vec<PlaceId> = initial_places
+            .iter()
+            .map(|place| self.intern(place.clone()))
+            .collect();
+        let removed = self.filter_reachable_ids(&initial_ids);
+        self.resolve(&removed)
+    }
 
-        self.remove_identity_transitions();
+    /// `filter_reachable` on place IDs; returns the IDs of the removed places
+    pub fn filter_reachable_ids(&mut self, initial_ids: &[PlaceId]) -> Vec<PlaceId> {
+        self.prune_ids(initial_ids, false)
+    }
 
-        let mut reachable_places: HashSet<Place> = initial_places.iter().cloned().collect();
-        let mut reachable_transitions: HashSet<usize> = HashSet::default();
-        let mut worklist: Vec<Place> = initial_places.to_vec();
+    /// Keep the transitions that can fire from `seeds`, following transitions
+    /// backwards (outputs to inputs) if `backward` is set, and return the removed places
+    fn prune_ids(&mut self, seeds: &[PlaceId], backward: bool) -> Vec<PlaceId> {
+        // Get all places that appear in the Petri net before filtering
+        let used_before = self.used_places();
 
-        while let Some(_current_place) = worklist.pop() {
-            // Check all transitions to see if any can now fire
-            for (transition_idx, (inputs, outputs)) in self.transitions.iter().enumerate() {
-                // Skip if we've already processed this transition
-                if reachable_transitions.contains(&transition_idx) {
-                    continue;
-                }
+        self.remove_identity_transitions();
 
-                // Check if all input places of this transition are reachable
-                let can_fire = inputs
-                    .iter()
-                    .all(|input_place| reachable_places.contains(input_place));
-
-                if can_fire {
-                    // Mark this transition as reachable (can fire)
-                    reachable_transitions.insert(transition_idx);
-
-                    // Add all output places to reachable set and worklist
-                    for output_place in outputs {
-                        if !reachable_places.contains(output_place) {
-                            reachable_places.insert(output_place.clone());
-                            worklist.push(output_place.clone());
-                        }
-                    }
-                }
-            }
-        }
+        let (from, to) = if backward {
+            (&self.outputs, &self.inputs)
+        } else {
+            (&self.inputs, &self.outputs)
+        };
+        let (reachable_places, reachable_transitions) = if linear_pruning_enabled() {
+            propagate_reachable(self.place_table_len(), from, to, seeds)
+        } else {
+            scan_reachable(self.place_table_len(), from, to, seeds)
+        };
 
         // Filter transitions to keep only reachable ones
-        self.transitions = self
-            .transitions
-            .iter()
-            .enumerate()
-            .filter(|(idx, _)| reachable_transitions.contains(idx))
-            .map(|(_, transition)| transition.clone())
-            .collect();
+        self.retain_transitions(&reachable_transitions);
 
         // Filter initial marking to keep only places that still exist in the net
         self.initial_marking
-            .retain(|place| reachable_places.contains(place));
+            .retain(|&place| reachable_places[place as usize]);
 
         // Get all places that remain after filtering transitions
-        let all_places_after: HashSet<Place> = self.get_places().into_iter().collect();
+        let used_after = self.used_places();
 
-        let all_places_after_plus_initial: HashSet<Place> = all_places_after
-            .clone()
-            .into_iter()
-            .chain(initial_places.iter().cloned())
-            .collect();
-
-        assert_eq!(reachable_places, all_places_after_plus_initial);
+        let mut initial = vec![false; self.place_table_len()];
+        for &id in seeds {
+            initial[id as usize] = true;
+        }
+        for id in 0..self.place_table_len() {
+            assert_eq!(reachable_places[id], used_after[id] || initial[id]);
+        }
 
         // Calculate removed places: places that were in the net before but not after
-        let removed_places: Vec<Place> = all_places_before
-            .difference(&all_places_after)
-            .cloned()
-            .collect();
-
-        removed_places
+        (0..self.place_table_len())
+            .filter(|&id| used_before[id] && !used_after[id])
+            .map(|id| id as PlaceId)
+            .collect()
     }
 
     /// Filter the Petri net to keep only transitions reachable from the initial marking
     pub fn filter_reachable_from_initial(&mut self) -> Vec<Place> {
         let initial_marking = self.initial_marking.clone();
-        self.filter_reachable(&initial_marking)
+        let removed = self.filter_reachable_ids(&initial_marking);
+        self.resolve(&removed)
     }
 
     /// Flip the Petri net by reversing all transitions (input becomes output, output becomes input)
     /// This is useful for backwards reachability analysis
     pub fn flip(&mut self) {
-        for (inputs, outputs) in &mut self.transitions {
-            std::mem::swap(inputs, outputs);
-        }
+        std::mem::swap(&mut self.inputs, &mut self.outputs);
     }
 
     /// Filter the Petri net to keep only transitions that can reach the given target places
@@ -394,16 +737,37 @@ where
     /// 1. `removed_forward` — transitions deleted in the forward filtering steps
     /// 2. `removed_backward` — transitions deleted in the backward filtering steps
     pub fn filter_backwards_reachable(&mut self, target_places: &[Place]) -> Vec<Place> {
-        // Step 1: Flip the net
-        self.flip();
-
-        // Step 2: Run forward reachability from target places
-        let places = self.filter_reachable(target_places);
+        let target_ids: Vec<PlaceId> = target_places
+            .iter()
+            .map(|place| self.intern(place.clone()))
+            .collect();
+        let removed = self.filter_backwards_reachable_ids(&target_ids);
+        self.resolve(&removed)
+    }
 
-        // Step 3: Flip back to original orientation
-        self.flip();
+    /// `filter_backwards_reachable` on place IDs; returns the IDs of the removed places
+    ///
+    /// Equivalent to flipping the net, filtering forward from the targets and
+    /// flipping back, but follows the arcs backwards in place.
+    pub fn filter_backwards_reachable_ids(&mut self, target_ids: &[PlaceId]) -> Vec<PlaceId> {
+        self.prune_ids(target_ids, true)
+    }
 
-        places
+    /// Append the transitions of `before` that no longer occur in the net to `removed`
+    fn collect_removed_transitions(
+        &self,
+        before: &(Arcs, Arcs),
+        removed: &mut Vec<(Vec<Place>, Vec<Place>)>,
+    ) {
+        let remaining: HashSet<(&[PlaceId], &[PlaceId])> = (0..self.num_transitions())
+            .map(|t| self.transition(t))
+            .collect();
+        for t in 0..before.0.len() {
+            let transition = (before.0.get(t), before.1.get(t));
+            if !remaining.contains(&transition) {
+                removed.push((self.resolve(transition.0), self.resolve(transition.1)));
+            }
+        }
     }
 
     /// Iteratively filter the Petri net using alternating forward and backward reachability
@@ -428,32 +792,27 @@ where
         let mut removed_backward = Vec::new();
 
         let initial_places = self.initial_marking.clone();
-        let mut previous_count = self.transitions.len();
+        let target_ids: Vec<PlaceId> = target_places
+            .iter()
+            .map(|place| self.intern(place.clone()))
+            .collect();
+        let mut previous_count = self.num_transitions();
         let mut iteration = 0;
 
         loop {
             iteration += 1;
+            crate::stats::record_pruning_iteration();
 
             // Step 1: Filter forward from initial marking
-            let before_forward = self.transitions.clone();
-            self.filter_reachable(&initial_places);
-            for tr in before_forward
-                .into_iter()
-                .filter(|tr| !self.transitions.contains(tr))
-            {
-                removed_forward.push(tr);
-            }
+            let before_forward = (self.inputs.clone(), self.outputs.clone());
+            self.filter_reachable_ids(&initial_places);
+            self.collect_removed_transitions(&before_forward, &mut removed_forward);
 
             // Step 2: Filter backward from target places
-            let before_backward = self.transitions.clone();
-            self.filter_backwards_reachable(target_places);
-            for tr in before_backward
-                .into_iter()
-                .filter(|tr| !self.transitions.contains(tr))
-            {
-                removed_backward.push(tr);
-            }
-            let after_backward = self.transitions.len();
+            let before_backward = (self.inputs.clone(), self.outputs.clone());
+            self.filter_backwards_reachable_ids(&target_ids);
+            self.collect_removed_transitions(&before_backward, &mut removed_backward);
+            let after_backward = self.num_transitions();
 
             // Check if we've reached a fixed point (no changes)
             if after_backward == previous_count {
@@ -486,17 +845,102 @@ mod tests {
         petri.add_transition(vec!["P3"], vec!["P4"]); // t2: P3 -> P4 (unreachable)
 
         // Before filtering: should have 3 transitions
-        assert_eq!(petri.transitions.len(), 3);
+        assert_eq!(petri.num_transitions(), 3);
 
         petri.filter_reachable_from_initial();
 
         // After filtering: should have only 2 reachable transitions (t0 and t1)
-        assert_eq!(petri.transitions.len(), 2);
-        assert_eq!(petri.transitions[0], (vec!["P0"], vec!["P1"])); // t0
-        assert_eq!(petri.transitions[1], (vec!["P1"], vec!["P2"])); // t1
+        assert_eq!(petri.num_transitions(), 2);
+        assert_eq!(petri.get_transitions()[0], (vec!["P0"], vec!["P1"])); // t0
+        assert_eq!(petri.get_transitions()[1], (vec!["P1"], vec!["P2"])); // t1
         // t2 (P3 -> P4) should be removed
     }
 
+    #[test]
+    fn test_interned_places() {
+        let mut petri = Petri::new(vec!["A", "A"]);
+        petri.add_transition(vec!["A"], vec!["B", "B"]);
+        assert_eq!(petri.initial_marking_ids(), &[0, 0]);
+        assert_eq!(petri.transition(0), (&[0][..], &[1, 1][..]));
+        assert_eq!(petri.place_id(&"B"), Some(1));
+        assert_eq!(petri.num_places(), 2);
+
+        // A clone shares the place table until it interns a new place
+        let mut clone = petri.clone();
+        clone.add_transition(vec!["B"], vec!["C"]);
+        assert_eq!(clone.place_id(&"C"), Some(2));
+        assert_eq!(petri.place_id(&"C"), None);
+        assert_eq!(petri.num_transitions(), 1);
+
+        // Renaming merges places that map to the same value
+        let merged = clone.rename(|p| if p == "C" { "A" } else { p });
+        assert_eq!(
+            merged.get_transitions(),
+            vec![(vec!["A"], vec!["B", "B"]), (vec!["B"], vec!["A"])]
+        );
+        assert_eq!(merged.num_places(), 2);
+    }
+
+    #[test]
+    fn test_structural_eq_and_hash() {
+        let hash = |petri: &Petri<&str>| {
+            crate::deterministic_map::DeterministicHasher::default().hash_one(petri)
+        };
+
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["B"]);
+
+        // Same net, with the places interned in a different order
+        let mut other = Petri::new(vec![]);
+        other.intern("B");
+        other.intern("A");
+        other.initial_marking.push(other.place_id(&"A").unwrap());
+        other.add_transition(vec!["A"], vec!["B"]);
+        assert_eq!(petri.initial_marking_ids(), &[0]);
+        assert_eq!(other.initial_marking_ids(), &[1]);
+        assert!(petri == other);
+        assert_eq!(hash(&petri), hash(&other));
+
+        let mut clone = petri.clone();
+        assert!(clone == petri);
+        clone.add_transition(vec!["B"], vec!["A"]);
+        assert!(clone != petri);
+        assert_ne!(hash(&clone), hash(&petri));
+    }
+
+    #[test]
+    fn test_propagate_matches_scan() {
+        // Small pseudo-random nets with duplicate arcs and input-free transitions
+        let mut state: u64 = 0x2545F4914F6CDD1D;
+        let mut next = |bound: u64| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            (state % bound) as u32
+        };
+        for _ in 0..200 {
+            let n_places = 1 + next(12) as usize;
+            let mut from = Arcs::new();
+            let mut to = Arcs::new();
+            for _ in 0..next(20) {
+                let n_in = next(4);
+                let n_out = next(3);
+                from.push((0..n_in).map(|_| next(n_places as u64)).collect::<Vec<_>>());
+                to.push((0..n_out).map(|_| next(n_places as u64)).collect::<Vec<_>>());
+            }
+            let seeds: Vec<PlaceId> = (0..next(3)).map(|_| next(n_places as u64)).collect();
+
+            assert_eq!(
+                propagate_reachable(n_places, &from, &to, &seeds),
+                scan_reachable(n_places, &from, &to, &seeds)
+            );
+            assert_eq!(
+                propagate_reachable(n_places, &to, &from, &seeds),
+                scan_reachable(n_places, &to, &from, &seeds)
+            );
+        }
+    }
+
     #[test]
     fn test_filter_reachable_complex() {
         // More complex net: requires multiple places to fire transition
@@ -507,15 +951,15 @@ mod tests {
         petri.add_transition(vec!["F"], vec!["G"]); // t3: F -> G (unreachable, F not reachable)
 
         // Before filtering: should have 4 transitions
-        assert_eq!(petri.transitions.len(), 4);
+        assert_eq!(petri.num_transitions(), 4);
 
         petri.filter_reachable_from_initial();
 
         // After filtering: should have only 3 reachable transitions (t0, t1, t2)
-        assert_eq!(petri.transitions.len(), 3);
-        assert_eq!(petri.transitions[0], (vec!["A"], vec!["C"])); // t0
-        assert_eq!(petri.transitions[1], (vec!["B"], vec!["D"])); // t1
-        assert_eq!(petri.transitions[2], (vec!["C", "D"], vec!["E"])); // t2
+        assert_eq!(petri.num_transitions(), 3);
+        assert_eq!(petri.get_transitions()[0], (vec!["A"], vec!["C"])); // t0
+        assert_eq!(petri.get_transitions()[1], (vec!["B"], vec!["D"])); // t1
+        assert_eq!(petri.get_transitions()[2], (vec!["C", "D"], vec!["E"])); // t2
         // t3 (F -> G) should be removed
     }
 
@@ -527,14 +971,14 @@ mod tests {
         petri.add_transition(vec!["P2"], vec!["P3"]); // t1: P2 -> P3
 
         // Before filtering: should have 2 transitions
-        assert_eq!(petri.transitions.len(), 2);
+        assert_eq!(petri.num_transitions(), 2);
 
         // Filter reachable from custom set including P2 (not in initial marking)
         petri.filter_reachable(&["P2"]);
 
         // After filtering: should have only 1 reachable transition (t1)
-        assert_eq!(petri.transitions.len(), 1);
-        assert_eq!(petri.transitions[0], (vec!["P2"], vec!["P3"])); // t1
+        assert_eq!(petri.num_transitions(), 1);
+        assert_eq!(petri.get_transitions()[0], (vec!["P2"], vec!["P3"])); // t1
         // t0 (P0 -> P1) should be removed since P0 is not in custom initial set
     }
 
@@ -548,19 +992,19 @@ mod tests {
         petri.add_transition(vec!["Unreachable"], vec!["AlsoUnreachable"]); // t3
 
         // Before filtering: 4 transitions
-        assert_eq!(petri.transitions.len(), 4);
+        assert_eq!(petri.num_transitions(), 4);
 
         petri.filter_reachable_from_initial();
 
         // After filtering: only 3 reachable transitions remain (t0, t1, t2)
-        assert_eq!(petri.transitions.len(), 3);
-        assert_eq!(petri.transitions[0], (vec!["Start"], vec!["Process1"]));
+        assert_eq!(petri.num_transitions(), 3);
+        assert_eq!(petri.get_transitions()[0], (vec!["Start"], vec!["Process1"]));
         assert_eq!(
-            petri.transitions[1],
+            petri.get_transitions()[1],
             (vec!["Process1", "Resource"], vec!["Process2"])
         );
         assert_eq!(
-            petri.transitions[2],
+            petri.get_transitions()[2],
             (vec!["Process2"], vec!["End", "Resource"])
         );
         // t3 (Unreachable -> AlsoUnreachable) should be removed
@@ -573,21 +1017,21 @@ mod tests {
         petri.add_transition(vec!["P1", "P2"], vec!["P3"]); // t1: P1+P2 -> P3
 
         // Before flip
-        assert_eq!(petri.transitions[0], (vec!["P0"], vec!["P1"]));
-        assert_eq!(petri.transitions[1], (vec!["P1", "P2"], vec!["P3"]));
+        assert_eq!(petri.get_transitions()[0], (vec!["P0"], vec!["P1"]));
+        assert_eq!(petri.get_transitions()[1], (vec!["P1", "P2"], vec!["P3"]));
 
         petri.flip();
 
         // After flip: inputs and outputs should be swapped
-        assert_eq!(petri.transitions[0], (vec!["P1"], vec!["P0"])); // was P0 -> P1, now P1 -> P0
-        assert_eq!(petri.transitions[1], (vec!["P3"], vec!["P1", "P2"])); // was P1+P2 -> P3, now P3 -> P1+P2
+        assert_eq!(petri.get_transitions()[0], (vec!["P1"], vec!["P0"])); // was P0 -> P1, now P1 -> P0
+        assert_eq!(petri.get_transitions()[1], (vec!["P3"], vec!["P1", "P2"])); // was P1+P2 -> P3, now P3 -> P1+P2
 
         // Flip back
         petri.flip();
 
         // Should be back to original
-        assert_eq!(petri.transitions[0], (vec!["P0"], vec!["P1"]));
-        assert_eq!(petri.transitions[1], (vec!["P1", "P2"], vec!["P3"]));
+        assert_eq!(petri.get_transitions()[0], (vec!["P0"], vec!["P1"]));
+        assert_eq!(petri.get_transitions()[1], (vec!["P1", "P2"], vec!["P3"]));
     }
 
     #[test]
@@ -600,15 +1044,15 @@ mod tests {
         petri.add_transition(vec!["P4"], vec!["P5"]); // t3: P4 -> P5 (unreachable from target)
 
         // Before filtering: 4 transitions
-        assert_eq!(petri.transitions.len(), 4);
+        assert_eq!(petri.num_transitions(), 4);
 
         // Filter backwards reachable to P2 (only transitions that can lead to P2)
         petri.filter_backwards_reachable(&["P2"]);
 
         // After filtering: should keep t0 and t1 (can reach P2), remove t2 and t3
-        assert_eq!(petri.transitions.len(), 2);
-        assert_eq!(petri.transitions[0], (vec!["P0"], vec!["P1"])); // t0: P0 -> P1 (can reach P2)
-        assert_eq!(petri.transitions[1], (vec!["P1"], vec!["P2"])); // t1: P1 -> P2 (can reach P2)
+        assert_eq!(petri.num_transitions(), 2);
+        assert_eq!(petri.get_transitions()[0], (vec!["P0"], vec!["P1"])); // t0: P0 -> P1 (can reach P2)
+        assert_eq!(petri.get_transitions()[1], (vec!["P1"], vec!["P2"])); // t1: P1 -> P2 (can reach P2)
         // t2 (P2 -> P3) removed because it doesn't lead TO P2
         // t3 (P4 -> P5) removed because it can't reach P2
     }
@@ -624,16 +1068,16 @@ mod tests {
         petri.add_transition(vec!["X"], vec!["Y"]); // t4: X -> Y (unconnected, can't reach E)
 
         // Before filtering: 5 transitions
-        assert_eq!(petri.transitions.len(), 5);
+        assert_eq!(petri.num_transitions(), 5);
 
         // Filter backwards reachable to E (transitions that can lead to E)
         petri.filter_backwards_reachable(&["E"]);
 
         // Should keep t0, t1, t2 (all can lead to E), remove t3, t4
-        assert_eq!(petri.transitions.len(), 3);
-        assert_eq!(petri.transitions[0], (vec!["A"], vec!["C"])); // t0: can contribute to E
-        assert_eq!(petri.transitions[1], (vec!["B"], vec!["D"])); // t1: can contribute to E  
-        assert_eq!(petri.transitions[2], (vec!["C", "D"], vec!["E"])); // t2: directly creates E
+        assert_eq!(petri.num_transitions(), 3);
+        assert_eq!(petri.get_transitions()[0], (vec!["A"], vec!["C"])); // t0: can contribute to E
+        assert_eq!(petri.get_transitions()[1], (vec!["B"], vec!["D"])); // t1: can contribute to E  
+        assert_eq!(petri.get_transitions()[2], (vec!["C", "D"], vec!["E"])); // t2: directly creates E
         // t3 (E -> F) removed: doesn't lead TO E
         // t4 (X -> Y) removed: unconnected
     }
@@ -650,38 +1094,38 @@ mod tests {
         let mut petri_backward = petri_forward.clone();
 
         println!("Original net: Start->Middle->End->Cleanup, Isolated->Nowhere");
-        assert_eq!(petri_forward.transitions.len(), 4);
+        assert_eq!(petri_forward.num_transitions(), 4);
 
         // Forward reachability from "Start"
         petri_forward.filter_reachable(&["Start"]);
         println!(
             "Forward from 'Start': {} transitions remain",
-            petri_forward.transitions.len()
+            petri_forward.num_transitions()
         );
-        assert_eq!(petri_forward.transitions.len(), 3); // Keep t0, t1, t2; remove t3
+        assert_eq!(petri_forward.num_transitions(), 3); // Keep t0, t1, t2; remove t3
 
         // Backward reachability to "End"
         petri_backward.filter_backwards_reachable(&["End"]);
         println!(
             "Backward to 'End': {} transitions remain",
-            petri_backward.transitions.len()
+            petri_backward.num_transitions()
         );
-        assert_eq!(petri_backward.transitions.len(), 2); // Keep t0, t1; remove t2, t3
+        assert_eq!(petri_backward.num_transitions(), 2); // Keep t0, t1; remove t2, t3
 
         // Forward: transitions reachable FROM start
         assert_eq!(
-            petri_forward.transitions[0],
+            petri_forward.get_transitions()[0],
             (vec!["Start"], vec!["Middle"])
         );
-        assert_eq!(petri_forward.transitions[1], (vec!["Middle"], vec!["End"]));
-        assert_eq!(petri_forward.transitions[2], (vec!["End"], vec!["Cleanup"]));
+        assert_eq!(petri_forward.get_transitions()[1], (vec!["Middle"], vec!["End"]));
+        assert_eq!(petri_forward.get_transitions()[2], (vec!["End"], vec!["Cleanup"]));
 
         // Backward: transitions that can reach TO end
         assert_eq!(
-            petri_backward.transitions[0],
+            petri_backward.get_transitions()[0],
             (vec!["Start"], vec!["Middle"])
         );
-        assert_eq!(petri_backward.transitions[1], (vec!["Middle"], vec!["End"]));
+        assert_eq!(petri_backward.get_transitions()[1], (vec!["Middle"], vec!["End"]));
         // End->Cleanup removed because it doesn't lead TO End
     }
 
@@ -695,15 +1139,15 @@ mod tests {
         petri.add_transition(vec!["Isolated"], vec!["B"]); // t3: Isolated -> B (unreachable from Start)
 
         // Before filtering: 4 transitions
-        assert_eq!(petri.transitions.len(), 4);
+        assert_eq!(petri.num_transitions(), 4);
 
         // Bidirectional filter to Target
         petri.filter_bidirectional_reachable(&["Target"]);
 
         // Should keep only t0 and t1 (path from Start to Target)
-        assert_eq!(petri.transitions.len(), 2);
-        assert_eq!(petri.transitions[0], (vec!["Start"], vec!["A"])); // t0: needed for path
-        assert_eq!(petri.transitions[1], (vec!["A"], vec!["Target"])); // t1: needed for path
+        assert_eq!(petri.num_transitions(), 2);
+        assert_eq!(petri.get_transitions()[0], (vec!["Start"], vec!["A"])); // t0: needed for path
+        assert_eq!(petri.get_transitions()[1], (vec!["A"], vec!["Target"])); // t1: needed for path
         // t2 removed: Target->After doesn't help reach Target
         // t3 removed: Isolated->B unreachable from Start
     }
@@ -721,16 +1165,16 @@ mod tests {
         petri.add_transition(vec!["Unreachable"], vec!["F"]); // t6: Unreachable -> F (isolated)
 
         // Before filtering: 7 transitions
-        assert_eq!(petri.transitions.len(), 7);
+        assert_eq!(petri.num_transitions(), 7);
 
         // Bidirectional filter to Target
         petri.filter_bidirectional_reachable(&["Target"]);
 
         // Should keep only the direct path: Start -> A -> B -> Target
-        assert_eq!(petri.transitions.len(), 3);
-        assert_eq!(petri.transitions[0], (vec!["Start"], vec!["A"])); // t0: needed
-        assert_eq!(petri.transitions[1], (vec!["A"], vec!["B"])); // t1: needed
-        assert_eq!(petri.transitions[2], (vec!["B"], vec!["Target"])); // t2: needed
+        assert_eq!(petri.num_transitions(), 3);
+        assert_eq!(petri.get_transitions()[0], (vec!["Start"], vec!["A"])); // t0: needed
+        assert_eq!(petri.get_transitions()[1], (vec!["A"], vec!["B"])); // t1: needed
+        assert_eq!(petri.get_transitions()[2], (vec!["B"], vec!["Target"])); // t2: needed
         // t3, t4 removed: A->C->D is a dead end that doesn't reach Target
         // t5 removed: Target->E doesn't help reach Target
         // t6 removed: Unreachable->F is isolated from Start
@@ -748,16 +1192,16 @@ mod tests {
         petri.add_transition(vec!["Isolated"], vec!["D"]); // t5: Isolated -> D (unreachable)
 
         // Before filtering: 6 transitions
-        assert_eq!(petri.transitions.len(), 6);
+        assert_eq!(petri.num_transitions(), 6);
 
         // Bidirectional filter to both targets
         petri.filter_bidirectional_reachable(&["Target1", "Target2"]);
 
         // Should keep path to both targets: Start -> A -> {Target1, Target2}
-        assert_eq!(petri.transitions.len(), 3);
-        assert_eq!(petri.transitions[0], (vec!["Start"], vec!["A"])); // t0: needed for both
-        assert_eq!(petri.transitions[1], (vec!["A"], vec!["Target1"])); // t1: needed for Target1
-        assert_eq!(petri.transitions[2], (vec!["A"], vec!["Target2"])); // t2: needed for Target2
+        assert_eq!(petri.num_transitions(), 3);
+        assert_eq!(petri.get_transitions()[0], (vec!["Start"], vec!["A"])); // t0: needed for both
+        assert_eq!(petri.get_transitions()[1], (vec!["A"], vec!["Target1"])); // t1: needed for Target1
+        assert_eq!(petri.get_transitions()[2], (vec!["A"], vec!["Target2"])); // t2: needed for Target2
         // t3, t4 removed: don't help reach the targets
         // t5 removed: isolated from Start
     }
@@ -775,17 +1219,17 @@ mod tests {
         petri.add_transition(vec!["Y"], vec!["Z"]); // t6: Y -> Z (depends on t5, doesn't reach Target)
 
         // Before filtering: 7 transitions
-        assert_eq!(petri.transitions.len(), 7);
+        assert_eq!(petri.num_transitions(), 7);
 
         // Bidirectional filter to Target
         petri.filter_bidirectional_reachable(&["Target"]);
 
         // Should eliminate the X->Y->Z branch since it doesn't reach Target
-        assert_eq!(petri.transitions.len(), 4);
-        assert_eq!(petri.transitions[0], (vec!["Start"], vec!["A"])); // t0: needed
-        assert_eq!(petri.transitions[1], (vec!["A"], vec!["B"])); // t1: needed  
-        assert_eq!(petri.transitions[2], (vec!["B"], vec!["C"])); // t2: needed
-        assert_eq!(petri.transitions[3], (vec!["C"], vec!["Target"])); // t3: needed
+        assert_eq!(petri.num_transitions(), 4);
+        assert_eq!(petri.get_transitions()[0], (vec!["Start"], vec!["A"])); // t0: needed
+        assert_eq!(petri.get_transitions()[1], (vec!["A"], vec!["B"])); // t1: needed  
+        assert_eq!(petri.get_transitions()[2], (vec!["B"], vec!["C"])); // t2: needed
+        assert_eq!(petri.get_transitions()[3], (vec!["C"], vec!["Target"])); // t3: needed
         // t4, t5, t6 removed: A->X->Y->Z doesn't contribute to reaching Target
     }
 
@@ -805,45 +1249,45 @@ mod tests {
 
         println!(
             "Original net has {} transitions",
-            petri_original.transitions.len()
+            petri_original.num_transitions()
         );
-        assert_eq!(petri_original.transitions.len(), 6);
+        assert_eq!(petri_original.num_transitions(), 6);
 
         // Test 1: Forward-only filtering
         let mut petri_forward = petri_original.clone();
         let _removed_places = petri_forward.filter_reachable_from_initial();
         println!(
             "Forward-only filtering: {} transitions remain",
-            petri_forward.transitions.len()
+            petri_forward.num_transitions()
         );
-        assert_eq!(petri_forward.transitions.len(), 5); // Removes only t5 (isolated), keeps everything else
+        assert_eq!(petri_forward.num_transitions(), 5); // Removes only t5 (isolated), keeps everything else
 
         // Test 2: Backward-only filtering
         let mut petri_backward = petri_original.clone();
         petri_backward.filter_backwards_reachable(&["Target"]);
         println!(
             "Backward-only filtering: {} transitions remain",
-            petri_backward.transitions.len()
+            petri_backward.num_transitions()
         );
-        assert_eq!(petri_backward.transitions.len(), 3); // Removes t4, t5; keeps t3
+        assert_eq!(petri_backward.num_transitions(), 3); // Removes t4, t5; keeps t3
 
         // Test 3: Bidirectional filtering (the optimal result)
         let mut petri_bidirectional = petri_original.clone();
         petri_bidirectional.filter_bidirectional_reachable(&["Target"]);
         println!(
             "Bidirectional filtering: {} transitions remain",
-            petri_bidirectional.transitions.len()
+            petri_bidirectional.num_transitions()
         );
-        assert_eq!(petri_bidirectional.transitions.len(), 3); // Keeps only essential path: t0, t1, t2
+        assert_eq!(petri_bidirectional.num_transitions(), 3); // Keeps only essential path: t0, t1, t2
 
         // Verify the bidirectional result is optimal
         assert_eq!(
-            petri_bidirectional.transitions[0],
+            petri_bidirectional.get_transitions()[0],
             (vec!["Start"], vec!["A"])
         );
-        assert_eq!(petri_bidirectional.transitions[1], (vec!["A"], vec!["B"]));
+        assert_eq!(petri_bidirectional.get_transitions()[1], (vec!["A"], vec!["B"]));
         assert_eq!(
-            petri_bidirectional.transitions[2],
+            petri_bidirectional.get_transitions()[2],
             (vec!["B"], vec!["Target"])
         );
 
@@ -0,0 +1,575 @@
+//! In-process checks that refute reachability queries before SMPT is called.
+//!
+//! Every reachable marking `M` of a net with initial marking `M0` and incidence matrix
+//! `C` satisfies the state equation `M = M0 + C·σ` for some firing count vector `σ >= 0`.
+//! A query whose constraints contradict this cannot be reachable, and the checks below
+//! answer that with ISL emptiness checks, in two tiers:
+//!
+//! 1. P-invariants: `y·M = y·M0` for every `y` with `yᵀ·C = 0`. A basis is computed once
+//!    per net (one per thread, keyed by a structural hash of the net and compared by its
+//!    incidence matrix) and reused for every query on it. The proof is the conjunction
+//!    of those equations.
+//! 2. The state equation itself, over the firing counts. The proof is
+//!    `∃σ >= 0. M = M0 + C·σ`.
+//!
+//! Both proofs are inductive invariants of the net that exclude the query, just like the
+//! certificates SMPT exports, and use the same (sanitized) place names. Queries neither
+//! tier refutes go to SMPT. `--without-precheck` turns the checks off.
+
+use crate::deterministic_map::{DeterministicHasher, HashMap};
+use crate::petri::Petri;
+use crate::presburger::{Constraint, ConstraintType, PresburgerSet, QuantifiedSet, Variable};
+use crate::proof_parser::{AffineExpr, CompOp, Formula, ProofInvariant};
+use crate::utils::string::sanitize;
+use std::cell::RefCell;
+use std::fmt::Display;
+use std::hash::{BuildHasher, Hash};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+static PRECHECK: AtomicBool = AtomicBool::new(true);
+
+pub fn set_precheck(on: bool) {
+    PRECHECK.store(on, Ordering::SeqCst);
+}
+
+pub fn precheck_enabled() -> bool {
+    PRECHECK.load(Ordering::SeqCst)
+}
+
+/// Nets with more distinct transition effects than this skip the state equation tier:
+/// ISL decides integer emptiness exactly, which can blow up on large systems
+const MAX_STATE_EQUATION_COLUMNS: usize = 256;
+
+/// Invariant bases of the most recent nets seen on this thread
+const MAX_CACHED_NETS: usize = 64;
+
+thread_local! {
+    /// By the structural hash of the net, with its incidence matrix to rule out collisions
+    static INVARIANTS: RefCell<HashMap<u64, (Incidence, Arc<Vec<Invariant>>)>> = RefCell::new(HashMap::default());
+}
+
+/// Which check refuted a query
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Tier {
+    PInvariants,
+    StateEquation,
+}
+
+impl Tier {
+    pub fn name(self) -> &'static str {
+        match self {
+            Tier::PInvariants => "P-invariants",
+            Tier::StateEquation => "state equation",
+        }
+    }
+}
+
+/// `weights·M = constant` for all reachable markings `M`, over place indices
+#[derive(Debug, Clone, PartialEq, Eq)]
+struct Invariant {
+    weights: Vec<(usize, i64)>,
+    constant: i64,
+}
+
+/// The net as SMPT sees it: places by sanitized name, and the distinct nonzero columns
+/// of the incidence matrix
+#[derive(Clone, PartialEq, Eq)]
+struct Incidence {
+    places: Vec<String>,
+    initial: Vec<i64>,
+    columns: Vec<Vec<(usize, i64)>>,
+}
+
+impl Incidence {
+    fn new<P: Clone + Eq + Hash + Display>(petri: &Petri<P>) -> Self {
+        let mut places: Vec<String> = petri
+            .get_places()
+            .iter()
+            .map(|place| sanitize(&place.to_string()))
+            .collect();
+        places.sort();
+        places.dedup();
+        let index: HashMap<String, usize> = places
+            .iter()
+            .enumerate()
+            .map(|(i, name)| (name.clone(), i))
+            .collect();
+        let index_of = |id| index[&sanitize(&petri.place(id).to_string())];
+
+        let mut initial = vec![0; places.len()];
+        for &id in petri.initial_marking_ids() {
+            initial[index_of(id)] += 1;
+        }
+
+        let mut columns = Vec::new();
+        for t in 0..petri.num_transitions() {
+            let (inputs, outputs) = petri.transition(t);
+            let mut effect = vec![0i64; places.len()];
+            for &id in inputs {
+                effect[index_of(id)] -= 1;
+            }
+            for &id in outputs {
+                effect[index_of(id)] += 1;
+            }
+            let column: Vec<(usize, i64)> = effect
+                .into_iter()
+                .enumerate()
+                .filter(|&(_, c)| c != 0)
+                .collect();
+            if !column.is_empty() {
+                columns.push(column);
+            }
+        }
+        columns.sort();
+        columns.dedup();
+
+        Incidence {
+            places,
+            initial,
+            columns,
+        }
+    }
+
+    /// The query over place indices; places the net does not have are empty
+    fn query<P: Display>(
+        &self,
+        constraints: &[Constraint<P>],
+    ) -> Vec<(Vec<(usize, i64)>, i64, ConstraintType)> {
+        constraints
+            .iter()
+            .map(|constraint| {
+                let terms = constraint
+                    .linear_combination()
+                    .iter()
+                    .filter_map(|(coeff, place)| {
+                        let name = sanitize(&place.to_string());
+                        self.places
+                            .binary_search(&name)
+                            .ok()
+                            .map(|i| (i, *coeff as i64))
+                    })
+                    .collect();
+                (
+                    terms,
+                    constraint.constant_term() as i64,
+                    constraint.constraint_type(),
+                )
+            })
+            .collect()
+    }
+
+    fn place_var(&self, i: usize) -> Variable<String> {
+        Variable::Var(self.places[i].clone())
+    }
+}
+
+/// Try to show in-process that no reachable marking of `petri` satisfies `constraints`,
+/// returning the tier that did and its proof over the net's sanitized place names
+pub fn refute<P>(
+    petri: &Petri<P>,
+    constraints: &[Constraint<P>],
+) -> Option<(Tier, ProofInvariant<String>)>
+where
+    P: Clone + Eq + Hash + Display,
+{
+    if !precheck_enabled() {
+        return None;
+    }
+    crate::stats::record_precheck_query();
+    let _span = crate::trace::span("precheck");
+
+    let net = Incidence::new(petri);
+    let query = net.query(constraints);
+
+    let invariants = invariants_of(petri, &net);
+    if let Some(proof) = refute_with_invariants(&net, &query, &invariants) {
+        crate::stats::record_precheck_refutation(Tier::PInvariants);
+        return Some((Tier::PInvariants, proof));
+    }
+
+    if net.columns.len() <= MAX_STATE_EQUATION_COLUMNS {
+        if let Some(proof) = refute_with_state_equation(&net, &query) {
+            crate::stats::record_precheck_refutation(Tier::StateEquation);
+            return Some((Tier::StateEquation, proof));
+        }
+    }
+    None
+}
+
+/// The P-invariant basis of the net, computed on first use
+fn invariants_of<P: Clone + Eq + Hash + Display>(
+    petri: &Petri<P>,
+    net: &Incidence,
+) -> Arc<Vec<Invariant>> {
+    let key = DeterministicHasher::default().hash_one(petri);
+    let cached = INVARIANTS.with(|cache| match cache.borrow().get(&key) {
+        Some((cached_net, invariants)) if cached_net == net => Some(invariants.clone()),
+        _ => None,
+    });
+    if let Some(invariants) = cached {
+        return invariants;
+    }
+    let invariants = Arc::new(p_invariants(net));
+    INVARIANTS.with(|cache| {
+        let mut cache = cache.borrow_mut();
+        if cache.len() >= MAX_CACHED_NETS {
+            cache.clear();
+        }
+        cache.insert(key, (net.clone(), invariants.clone()));
+    });
+    invariants
+}
+
+/// A basis of `{ y : yᵀ·C = 0 }` with integer entries, by fraction-free Gaussian
+/// elimination on the columns of `C`. Empty if the entries get too large.
+fn p_invariants(net: &Incidence) -> Vec<Invariant> {
+    let n = net.places.len();
+    let mut rows: Vec<Vec<i128>> = net
+        .columns
+        .iter()
+        .map(|column| {
+            let mut row = vec![0i128; n];
+            for &(i, c) in column {
+                row[i] = c as i128;
+            }
+            row
+        })
+        .collect();
+
+    // Reduced row echelon form, with each row divided by the gcd of its entries
+    let mut pivots = Vec::new();
+    let mut rank = 0;
+    for col in 0..n {
+        let Some(r) = (rank..rows.len()).find(|&r| rows[r][col] != 0) else {
+            continue;
+        };
+        rows.swap(rank, r);
+        let pivot_row = rows[rank].clone();
+        for (i, row) in rows.iter_mut().enumerate() {
+            if i == rank || row[col] == 0 {
+                continue;
+            }
+            let factor = row[col];
+            for (entry, &pivot_entry) in row.iter_mut().zip(&pivot_row) {
+                let Some(value) = entry
+                    .checked_mul(pivot_row[col])
+                    .and_then(|value| value.checked_sub(pivot_entry.checked_mul(factor)?))
+                else {
+                    return Vec::new();
+                };
+                *entry = value;
+            }
+            normalize(row);
+        }
+        pivots.push(col);
+        rank += 1;
+    }
+    rows.truncate(rank);
+
+    // One basis vector per free column
+    let mut invariants = Vec::new();
+    for free in (0..n).filter(|col| !pivots.contains(col)) {
+        let mut y = vec![0i128; n];
+        let mut scale: i128 = 1;
+        for (row, &pivot) in rows.iter().zip(&pivots) {
+            if row[free] != 0 {
+                let Some(lcm) = lcm(scale, row[pivot]) else {
+                    return Vec::new();
+                };
+                scale = lcm;
+            }
+        }
+        y[free] = scale;
+        for (row, &pivot) in rows.iter().zip(&pivots) {
+            if row[free] != 0 {
+                let Some(weight) = row[free]
+                    .checked_mul(scale / row[pivot])
+                    .and_then(i128::checked_neg)
+                else {
+                    return Vec::new();
+                };
+                y[pivot] = weight;
+            }
+        }
+        normalize(&mut y);
+
+        let weights: Option<Vec<(usize, i64)>> = y
+            .iter()
+            .enumerate()
+            .filter(|&(_, &w)| w != 0)
+            .map(|(i, &w)| i64::try_from(w).ok().map(|w| (i, w)))
+            .collect();
+        let Some(weights) = weights else {
+            continue;
+        };
+        let constant = weights
+            .iter()
+            .map(|&(i, w)| w as i128 * net.initial[i] as i128)
+            .sum::<i128>();
+        if let Ok(constant) = i64::try_from(constant) {
+            invariants.push(Invariant { weights, constant });
+        }
+    }
+    invariants
+}
+
+fn gcd(a: i128, b: i128) -> i128 {
+    let (mut a, mut b) = (a.abs(), b.abs());
+    while b != 0 {
+        (a, b) = (b, a % b);
+    }
+    a
+}
+
+fn lcm(a: i128, b: i128) -> Option<i128> {
+    let g = gcd(a, b);
+    if g == 0 {
+        return Some(0);
+    }
+    (a.abs() / g).checked_mul(b.abs())
+}
+
+/// Divide a vector by the gcd of its entries
+fn normalize(v: &mut [i128]) {
+    let g = v.iter().fold(0, |g, &x| gcd(g, x));
+    if g > 1 {
+        for x in v.iter_mut() {
+            *x /= g;
+        }
+    }
+}
+
+/// A constraint of a `QuantifiedSet`, or `None` if a coefficient does not fit
+fn set_constraint<T>(
+    terms: Vec<(i64, Variable<T>)>,
+    constant: i64,
+    constraint_type: ConstraintType,
+) -> Option<Constraint<Variable<T>>> {
+    let linear_combination = terms
+        .into_iter()
+        .filter(|(coeff, _)| *coeff != 0)
+        .map(|(coeff, var)| i32::try_from(coeff).ok().map(|coeff| (coeff, var)))
+        .collect::<Option<Vec<_>>>()?;
+    Some(Constraint::new(
+        linear_combination,
+        i32::try_from(constant).ok()?,
+        constraint_type,
+    ))
+}
+
+/// Whether the constraints over `variables` have no integer solution
+fn is_infeasible(constraints: Vec<Constraint<Variable<String>>>, variables: Vec<String>) -> bool {
+    PresburgerSet::from_quantified_sets(&[QuantifiedSet::new(constraints)], variables).is_empty()
+}
+
+/// Tier 1: the query, non-negative counts and the P-invariants have no common solution
+fn refute_with_invariants(
+    net: &Incidence,
+    query: &[(Vec<(usize, i64)>, i64, ConstraintType)],
+    invariants: &[Invariant],
+) -> Option<ProofInvariant<String>> {
+    let mut constraints = Vec::new();
+    for (terms, constant, constraint_type) in query {
+        let terms = terms.iter().map(|&(i, c)| (c, net.place_var(i))).collect();
+        constraints.push(set_constraint(terms, *constant, *constraint_type)?);
+    }
+    for i in 0..net.places.len() {
+        constraints.push(set_constraint(
+            vec![(1, net.place_var(i))],
+            0,
+            ConstraintType::NonNegative,
+        )?);
+    }
+    for invariant in invariants {
+        let terms = invariant
+            .weights
+            .iter()
+            .map(|&(i, w)| (w, net.place_var(i)))
+            .collect();
+        constraints.push(set_constraint(
+            terms,
+            -invariant.constant,
+            ConstraintType::EqualToZero,
+        )?);
+    }
+    if !is_infeasible(constraints, net.places.clone()) {
+        return None;
+    }
+
+    let formula = Formula::And(
+        invariants
+            .iter()
+            .map(|invariant| {
+                let terms = invariant
+                    .weights
+                    .iter()
+                    .map(|&(i, w)| (net.place_var(i), w));
+                Formula::Constraint(crate::proof_parser::Constraint::new(
+                    AffineExpr::from_terms(terms, -invariant.constant),
+                    CompOp::Eq,
+                ))
+            })
+            .collect(),
+    );
+    Some(ProofInvariant::new(net.places.clone(), formula))
+}
+
+/// Tier 2: no firing counts `σ >= 0` lead from the initial marking to a non-negative
+/// marking satisfying the query
+fn refute_with_state_equation(
+    net: &Incidence,
+    query: &[(Vec<(usize, i64)>, i64, ConstraintType)],
+) -> Option<ProofInvariant<String>> {
+    let counts: Vec<String> = (0..net.columns.len()).map(|k| format!("t{}", k)).collect();
+    let count_var = |k: usize| Variable::Var(counts[k].clone());
+
+    // M_p = M0_p + Σ_k C_pk σ_k, as coefficients of the σ_k and a constant
+    let mut marking: Vec<Vec<(usize, i64)>> = vec![Vec::new(); net.places.len()];
+    for (k, column) in net.columns.iter().enumerate() {
+        for &(i, c) in column {
+            marking[i].push((k, c));
+        }
+    }
+    let substitute = |terms: &[(usize, i64)], constant: i64| {
+        let mut coeffs = vec![0i64; counts.len()];
+        let mut constant = constant;
+        for &(i, a) in terms {
+            constant = constant.checked_add(a.checked_mul(net.initial[i])?)?;
+            for &(k, c) in &marking[i] {
+                coeffs[k] = coeffs[k].checked_add(a.checked_mul(c)?)?;
+            }
+        }
+        let terms = coeffs
+            .into_iter()
+            .enumerate()
+            .map(|(k, c)| (c, count_var(k)))
+            .collect();
+        Some((terms, constant))
+    };
+
+    let mut constraints = Vec::new();
+    for (terms, constant, constraint_type) in query {
+        let (terms, constant) = substitute(terms, *constant)?;
+        constraints.push(set_constraint(terms, constant, *constraint_type)?);
+    }
+    for i in 0..net.places.len() {
+        let (terms, constant) = substitute(&[(i, 1)], 0)?;
+        constraints.push(set_constraint(
+            terms,
+            constant,
+            ConstraintType::NonNegative,
+        )?);
+    }
+    for k in 0..counts.len() {
+        constraints.push(set_constraint(
+            vec![(1, count_var(k))],
+            0,
+            ConstraintType::NonNegative,
+        )?);
+    }
+    if !is_infeasible(constraints, counts.clone()) {
+        return None;
+    }
+
+    // ∃σ. σ >= 0 ∧ M = M0 + C·σ, with σ_k as existential variable k
+    let mut body = Vec::new();
+    for (i, row) in marking.iter().enumerate() {
+        let terms = std::iter::once((net.place_var(i), 1))
+            .chain(row.iter().map(|&(k, c)| (Variable::Existential(k), -c)));
+        body.push(Formula::Constraint(crate::proof_parser::Constraint::new(
+            AffineExpr::from_terms(terms, -net.initial[i]),
+            CompOp::Eq,
+        )));
+    }
+    for k in 0..counts.len() {
+        body.push(Formula::Constraint(crate::proof_parser::Constraint::new(
+            AffineExpr::from_terms([(Variable::Existential(k), 1)], 0),
+            CompOp::Geq,
+        )));
+    }
+    let formula = (0..counts.len())
+        .rev()
+        .fold(Formula::And(body), |formula, k| {
+            Formula::Exists(k, Box::new(formula))
+        });
+    Some(ProofInvariant::new(net.places.clone(), formula))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_p_invariants_of_a_cycle() {
+        // A token moving back and forth between A and B: A + B stays 1
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["B"]);
+        petri.add_transition(vec!["B"], vec!["A"]);
+
+        let net = Incidence::new(&petri);
+        assert_eq!(
+            p_invariants(&net),
+            vec![Invariant {
+                weights: vec![(0, 1), (1, 1)],
+                constant: 1
+            }]
+        );
+    }
+
+    #[test]
+    fn test_invariants_cached_by_structure() {
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["B"]);
+        petri.add_transition(vec!["B"], vec!["A"]);
+        let first = invariants_of(&petri, &Incidence::new(&petri));
+
+        // The same net built separately finds the cached basis
+        let mut same = Petri::new(vec!["A"]);
+        same.add_transition(vec!["A"], vec!["B"]);
+        same.add_transition(vec!["B"], vec!["A"]);
+        let cached = invariants_of(&same, &Incidence::new(&same));
+        assert!(Arc::ptr_eq(&first, &cached));
+
+        let mut other = Petri::new(vec!["A"]);
+        other.add_transition(vec!["A"], vec!["B", "B"]);
+        let recomputed = invariants_of(&other, &Incidence::new(&other));
+        assert!(!Arc::ptr_eq(&first, &recomputed));
+    }
+
+    #[test]
+    fn test_refute_tiers() {
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["B"]);
+        petri.add_transition(vec!["B"], vec!["A"]);
+
+        // A = 1 and B = 1 breaks A + B = 1
+        let both = vec![
+            Constraint::new(vec![(1, "A")], -1, ConstraintType::EqualToZero),
+            Constraint::new(vec![(1, "B")], -1, ConstraintType::EqualToZero),
+        ];
+        let (tier, proof) = refute(&petri, &both).unwrap();
+        assert_eq!(tier, Tier::PInvariants);
+        assert_eq!(proof.variables, vec!["A", "B"]);
+
+        // A single transition A -> B from B: A = 1, B = 0 keeps A + B = 1, but getting
+        // there would take firing the transition -1 times
+        let mut forward = Petri::new(vec!["B"]);
+        forward.add_transition(vec!["A"], vec!["B"]);
+        let backwards = vec![Constraint::new(
+            vec![(1, "A")],
+            -1,
+            ConstraintType::EqualToZero,
+        )];
+        let (tier, _) = refute(&forward, &backwards).unwrap();
+        assert_eq!(tier, Tier::StateEquation);
+
+        // The initial marking is reachable
+        let initial = vec![Constraint::new(
+            vec![(1, "B")],
+            -1,
+            ConstraintType::EqualToZero,
+        )];
+        assert!(refute(&forward, &initial).is_none());
+    }
+}
@@ -11,11 +11,70 @@ use std::{
 
 use crate::kleene::Kleene;
 use either::Either;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, Ordering};
 
+/// Build ISL sets directly from constraints instead of printing and re-parsing ISL strings
+pub static DIRECT_ISL_CONSTRUCTION: AtomicBool = AtomicBool::new(true);
+
+pub fn set_direct_isl_construction(on: bool) {
+    DIRECT_ISL_CONSTRUCTION.store(on, Ordering::SeqCst);
+}
+
+/// Normalize the disjuncts of reachability queries before checking them one by one
+/// (see `PresburgerSet::normalize_disjuncts`)
+pub static NORMALIZE_DISJUNCTS: AtomicBool = AtomicBool::new(true);
+
+pub fn set_normalize_disjuncts(on: bool) {
+    NORMALIZE_DISJUNCTS.store(on, Ordering::SeqCst);
+}
+
+/// A dense constraint row over the set dimensions, then the existential variables,
+/// then the constant term. `true` marks an equality (`= 0`), `false` an inequality (`>= 0`).
+type ConstraintRow = (bool, Vec<i64>);
+
+/// Build an ISL set over `n_dims` dimensions from dense constraint rows via
+/// `rust_set_from_constraints`. The `n_exists` existential variables are projected out.
+fn isl_set_from_rows(n_dims: usize, n_exists: usize, rows: &[ConstraintRow]) -> *mut isl::isl_set {
+    let width = n_dims + n_exists + 1;
+    let is_eq: Vec<i32> = rows.iter().map(|(eq, _)| *eq as i32).collect();
+    let mut coeffs: Vec<std::ffi::c_long> = Vec::with_capacity(rows.len() * width);
+    for (_, row) in rows {
+        assert_eq!(row.len(), width, "constraint row has the wrong width");
+        coeffs.extend(row.iter().map(|&c| c as std::ffi::c_long));
+    }
+
+    let set = unsafe {
+        isl::rust_set_from_constraints(
+            isl::get_ctx(),
+            n_dims as i32,
+            n_exists as i32,
+            rows.len() as i32,
+            is_eq.as_ptr(),
+            coeffs.as_ptr(),
+        )
+    };
+    if set.is_null() {
+        isl::check_budget();
+        panic!(
+            "ISL failed to build a set from {} constraints over {} dimensions ({} existential)",
+            rows.len(),
+            n_dims,
+            n_exists
+        );
+    }
+    set
+}
+
+/// A Presburger set over the atoms in `mapping`.
+///
+/// Cloning is O(1): ISL refcounts the set, and the mapping is shared. Sets combined by
+/// `harmonize_all` end up sharing one mapping, so later harmonizations of the same sets
+/// only compare pointers.
 #[derive(Debug)]
 pub struct PresburgerSet<T> {
     isl_set: *mut isl::isl_set, // raw pointer to the underlying ISL set
-    mapping: Vec<T>,            // mapping of dimensions to atoms of type T
+    mapping: Arc<[T]>,          // mapping of dimensions to atoms of type T
 }
 
 // Ensure the ISL set is freed when PresburgerSet goes out of scope
@@ -27,7 +86,7 @@ impl<T> Drop for PresburgerSet<T> {
     }
 }
 
-impl<T: Clone> Clone for PresburgerSet<T> {
+impl<T> Clone for PresburgerSet<T> {
     fn clone(&self) -> Self {
         let new_ptr = unsafe { isl::isl_set_copy(self.isl_set) }; // increment refcount or duplicate&#8203;:contentReference[oaicite:1]{index=1}
         PresburgerSet {
@@ -39,88 +98,153 @@ impl<T: Clone> Clone for PresburgerSet<T> {
 
 impl<T: Ord + Eq + Clone + Debug + ToString> PresburgerSet<T> {
     pub fn harmonize(&mut self, other: &mut PresburgerSet<T>) {
-        // 1. Determine the combined, sorted mapping
-        let mut combined_atoms: BTreeSet<T> = BTreeSet::new();
-        for atom in self.mapping.iter().chain(other.mapping.iter()) {
-            combined_atoms.insert(atom.clone());
-        }
-        let combined_mapping: Vec<T> = combined_atoms.into_iter().collect();
-
-        // 2. Early exit if already harmonized
-        if self.mapping == combined_mapping && other.mapping == combined_mapping {
-            let space1 = unsafe { isl::isl_set_get_space(self.isl_set) };
-            let space2 = unsafe { isl::isl_set_get_space(other.isl_set) };
-            let spaces_equal = unsafe { isl::isl_space_is_equal(space1, space2) == 1 };
-            unsafe {
-                isl::isl_space_free(space1);
-                isl::isl_space_free(space2);
+        Self::harmonize_all(&mut [&mut *self, &mut *other]);
+    }
+
+    /// Embed all `sets` into the sorted union of their mappings.
+    ///
+    /// Every set that is not already over the combined mapping is embedded by a single
+    /// call to `rust_harmonize_sets_n`, which does one preimage per set. This reorders
+    /// dimensions where needed and fixes the dimensions a set doesn't mention to 0.
+    pub fn harmonize_all(sets: &mut [&mut PresburgerSet<T>]) {
+        // Sets that share one mapping are already harmonized
+        let Some(first) = sets.first() else {
+            return;
+        };
+        if sets
+            .iter()
+            .all(|set| Arc::ptr_eq(&set.mapping, &first.mapping))
+        {
+            return;
+        }
+
+        // 1. Determine the combined, sorted mapping, reusing a set's mapping if it is equal
+        let combined_atoms: BTreeSet<T> = sets
+            .iter()
+            .flat_map(|set| set.mapping.iter().cloned())
+            .collect();
+        let combined_mapping: Arc<[T]> = match sets.iter().find(|set| {
+            set.mapping.len() == combined_atoms.len() && set.mapping.iter().eq(&combined_atoms)
+        }) {
+            Some(set) => set.mapping.clone(),
+            None => combined_atoms.into_iter().collect(),
+        };
+
+        // 2. Collect the sets that still need embedding, with the target position of each of
+        //    their dimensions (sets already over the combined mapping are left alone)
+        let mut pending = Vec::new();
+        let mut indices: Vec<i32> = Vec::new();
+        let mut dims: Vec<i32> = Vec::new();
+        for (k, set) in sets.iter().enumerate() {
+            if Arc::ptr_eq(&set.mapping, &combined_mapping) || set.mapping == combined_mapping {
+                continue;
             }
-            if spaces_equal {
-                return;
+            pending.push(k);
+            dims.push(set.mapping.len() as i32);
+            indices.extend(set.mapping.iter().map(|atom| {
+                combined_mapping
+                    .binary_search(atom)
+                    .expect("atom is in the combined mapping") as i32
+            }));
+        }
+
+        // 3. Embed them all at once
+        if !pending.is_empty() {
+            let mut raw_sets: Vec<*mut isl::isl_set> = pending
+                .iter()
+                .map(|&k| std::mem::replace(&mut sets[k].isl_set, ptr::null_mut()))
+                .collect();
+            let error = unsafe {
+                isl::rust_harmonize_sets_n(
+                    raw_sets.as_mut_ptr(),
+                    raw_sets.len() as i32,
+                    combined_mapping.len() as i32,
+                    indices.as_ptr(),
+                    dims.as_ptr(),
+                )
+            };
+            if error != 0 {
+                isl::check_budget();
+            }
+            assert_eq!(error, 0, "rust_harmonize_sets_n failed");
+            for (&k, raw_set) in pending.iter().zip(raw_sets) {
+                sets[k].isl_set = raw_set;
             }
         }
 
-        // 3. Embed each set into the combined space using direct embedding
-        self.isl_set = Self::embed_set_to_mapping(self.isl_set, &self.mapping, &combined_mapping);
-        other.isl_set =
-            Self::embed_set_to_mapping(other.isl_set, &other.mapping, &combined_mapping);
+        // 4. Share the combined mapping
+        for set in sets.iter_mut() {
+            set.mapping = combined_mapping.clone();
+        }
+    }
 
-        // 4. Update mappings
-        self.mapping = combined_mapping.clone();
-        other.mapping = combined_mapping;
+    /// Harmonize all `sets` once, then combine them left to right with the ISL operation `op`
+    /// (which must consume both arguments). Returns `None` if `sets` is empty.
+    fn fold_harmonized(
+        sets: &[Self],
+        op: unsafe extern "C" fn(*mut isl::isl_set, *mut isl::isl_set) -> *mut isl::isl_set,
+    ) -> Option<Self> {
+        let mut owned: Vec<Self> = sets.to_vec();
+        Self::harmonize_all(&mut owned.iter_mut().collect::<Vec<_>>());
+
+        let mut iter = owned.into_iter();
+        let mut acc = iter.next()?;
+        for mut next in iter {
+            acc.isl_set = unsafe { op(acc.isl_set, next.isl_set) };
+            next.isl_set = ptr::null_mut();
+        }
+        Some(acc)
     }
 
-    /// Embed a set from its current mapping into a target mapping using direct ISL operations
-    fn embed_set_to_mapping(
-        mut isl_set: *mut isl::isl_set,
-        current_mapping: &[T],
-        target_mapping: &[T],
-    ) -> *mut isl::isl_set {
-        unsafe {
-            // Algorithm:
-            // 1. For each atom in target_mapping not in current_mapping:
-            //    - Find its position in target_mapping
-            //    - Insert a dimension at that position
-            //    - Constrain that dimension to 0
-            // 2. Handle dimension reordering if needed
-
-            let mut current_pos = 0; // Position in the evolving set
-
-            for (target_pos, target_atom) in target_mapping.iter().enumerate() {
-                if current_mapping.contains(target_atom) {
-                    // This atom exists in current mapping
-                    // Check if it's in the right position
-                    if current_pos < current_mapping.len()
-                        && &current_mapping[current_pos] == target_atom
-                    {
-                        // Atom is in correct position, advance
-                        current_pos += 1;
-                    } else {
-                        // Atom exists but in wrong position - we'd need to reorder
-                        // For now, assume mappings are in sorted order so this shouldn't happen
-                        // If it does, we'll need more complex reordering logic
-                        current_pos += 1;
-                    }
-                } else {
-                    // This atom is missing from current mapping
-                    // Insert a dimension at target_pos and constrain it to 0
-                    isl_set = isl::isl_set_insert_dims(
-                        isl_set,
-                        isl::isl_dim_type_isl_dim_set,
-                        target_pos as c_uint,
-                        1,
-                    );
-                    isl_set = isl::isl_set_fix_si(
-                        isl_set,
-                        isl::isl_dim_type_isl_dim_set,
-                        target_pos as c_uint,
-                        0,
-                    );
-                }
-            }
+    /// Union of all `sets`, harmonized in one step instead of pairwise.
+    /// The union of no sets is `zero()`.
+    pub fn union_all(sets: &[Self]) -> Self {
+        Self::fold_harmonized(sets, isl::isl_set_union).unwrap_or_else(Self::zero)
+    }
+
+    /// Intersection of all `sets`, harmonized in one step instead of pairwise.
+    /// Returns `None` for no sets, since the universe depends on the caller's atoms.
+    pub fn intersection_all(sets: &[Self]) -> Option<Self> {
+        Self::fold_harmonized(sets, isl::isl_set_intersect)
+    }
 
-            isl_set
+    /// This set over `domain`, with new dimensions for the atoms of `free`, which take any
+    /// non-negative value, and the other atoms of `domain` it does not mention fixed to 0.
+    ///
+    /// For `free` disjoint from the set's atoms, this is the Minkowski sum with a universe
+    /// over `free` harmonized with a universe over `domain`, in one preimage instead of a
+    /// sum and two harmonizations.
+    pub fn embed(mut self, free: &[T], domain: &[T]) -> Self {
+        debug_assert!(free.iter().all(|atom| !self.mapping.contains(atom)));
+        let n = self.mapping.len();
+        crate::trace::count_isl_operation();
+        let mut set_ptr = unsafe {
+            isl::isl_set_add_dims(
+                std::mem::replace(&mut self.isl_set, ptr::null_mut()),
+                isl::isl_dim_type_isl_dim_set,
+                free.len() as c_uint,
+            )
+        };
+        for dim_index in n..n + free.len() {
+            set_ptr = unsafe {
+                isl::isl_set_lower_bound_si(
+                    set_ptr,
+                    isl::isl_dim_type_isl_dim_set,
+                    dim_index as c_uint,
+                    0,
+                )
+            };
         }
+        self.isl_set = set_ptr;
+        self.mapping = self.mapping.iter().chain(free).cloned().collect();
+
+        // Over the sorted domain, the universe is left alone when it covers the set's atoms
+        let mut domain = domain.to_vec();
+        domain.sort();
+        domain.dedup();
+        let mut universe = PresburgerSet::universe(domain);
+        self.harmonize(&mut universe);
+        self
     }
 }
 
@@ -137,7 +261,7 @@ impl<T: Clone + ToString> PresburgerSet<T> {
 
         PresburgerSet {
             isl_set: set_ptr,
-            mapping: vec![atom], // one dimension corresponding to the single atom
+            mapping: Arc::new([atom]), // one dimension corresponding to the single atom
         }
     }
 
@@ -150,13 +274,12 @@ impl<T: Clone + ToString> PresburgerSet<T> {
         U: Clone + ToString,
         F: Fn(T) -> U,
     {
-        // Take ownership of both the ISL set pointer and mapping to avoid double-free
+        // Take ownership of the ISL set pointer to avoid double-free
         let isl_set = std::mem::replace(&mut self.isl_set, std::ptr::null_mut());
-        let mapping = std::mem::take(&mut self.mapping);
 
         PresburgerSet {
             isl_set,
-            mapping: mapping.into_iter().map(f).collect(),
+            mapping: self.mapping.iter().cloned().map(f).collect(),
         }
     }
 
@@ -193,7 +316,7 @@ impl<T: Clone> PresburgerSet<T> {
         }
         PresburgerSet {
             isl_set: set_ptr,
-            mapping: atoms,
+            mapping: atoms.into(),
         }
     }
 }
@@ -208,6 +331,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
         let unified_mapping = a.mapping.clone();
         // Perform the union operation on the underlying isl_set pointers.
         // We pass ownership of a.isl_set and b.isl_set to isl_set_union (so they will be used and freed inside).
+        crate::trace::count_isl_operation();
         let result_ptr = unsafe { isl::isl_set_union(a.isl_set, b.isl_set) };
         // Prevent a and b from freeing the now-consumed pointers in their Drop
         a.isl_set = ptr::null_mut();
@@ -224,6 +348,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
         let mut b = other.clone();
         a.harmonize(&mut b);
         let unified_mapping = a.mapping.clone();
+        crate::trace::count_isl_operation();
         let result_ptr = unsafe { isl::isl_set_intersect(a.isl_set, b.isl_set) };
         a.isl_set = ptr::null_mut();
         b.isl_set = ptr::null_mut();
@@ -238,6 +363,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
         let mut b = other.clone();
         a.harmonize(&mut b);
         let unified_mapping = a.mapping.clone();
+        crate::trace::count_isl_operation();
         let result_ptr = unsafe { isl::isl_set_subtract(a.isl_set, b.isl_set) };
         a.isl_set = ptr::null_mut();
         b.isl_set = ptr::null_mut();
@@ -258,6 +384,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
         match self.mapping.iter().position(|x| *x == variable) {
             Some(idx) => {
                 // found: project it out of the ISL set
+                crate::trace::count_isl_operation();
                 unsafe {
                     self.isl_set = isl::isl_set_project_out(
                         self.isl_set,
@@ -267,7 +394,9 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
                     );
                 }
                 // remove it from our mapping
-                self.mapping.remove(idx);
+                let mut mapping = self.mapping.to_vec();
+                mapping.remove(idx);
+                self.mapping = mapping.into();
             }
             None => {
             }
@@ -312,7 +441,11 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PartialEq for PresburgerSet<T> {
         let mut b = other.clone();
         a.harmonize(&mut b);
         // isl_set_is_equal returns isl_bool (1 = true, 0 = false, -1 = error)
+        crate::trace::count_isl_operation();
         let result_bool = unsafe { isl::isl_set_is_equal(a.isl_set, b.isl_set) };
+        if result_bool < 0 {
+            isl::check_budget();
+        }
         // No need to null out a.isl_set and b.isl_set here, because is_equal does not consume (it uses __isl_keep).
         // We can directly drop a and b, which will free their pointers.
         result_bool == 1 // return true if ISL indicated equality (isl_bool_true)
@@ -324,7 +457,12 @@ impl<T: Eq + Clone + Ord + Debug + ToString> Eq for PresburgerSet<T> {}
 // Implement .is_empty() for PresburgerSet<T>
 impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
     pub fn is_empty(&self) -> bool {
-        unsafe { isl::isl_set_is_empty(self.isl_set) == 1 }
+        crate::trace::count_isl_operation();
+        let result = unsafe { isl::isl_set_is_empty(self.isl_set) };
+        if result < 0 {
+            isl::check_budget();
+        }
+        result == 1
     }
 }
 
@@ -332,6 +470,9 @@ impl<T: Eq + Clone + Ord + Debug + ToString> PresburgerSet<T> {
 impl<T: Display> Display for PresburgerSet<T> {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         let str: *mut i8 = unsafe { isl::isl_set_to_str(self.isl_set) };
+        if str.is_null() {
+            isl::check_budget();
+        }
         let mapping_str = self
             .mapping
             .iter()
@@ -354,7 +495,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> Kleene for PresburgerSet<T> {
         let set_ptr = unsafe { isl::isl_set_empty(space) };
         PresburgerSet {
             isl_set: set_ptr,
-            mapping: Vec::new(),
+            mapping: Arc::new([]),
         }
     }
 
@@ -367,7 +508,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> Kleene for PresburgerSet<T> {
 
         PresburgerSet {
             isl_set: set_ptr,
-            mapping: Vec::new(),
+            mapping: Arc::new([]),
         }
     }
 
@@ -382,6 +523,7 @@ impl<T: Eq + Clone + Ord + Debug + ToString> Kleene for PresburgerSet<T> {
         let mut b = other.clone();
         a.harmonize(&mut b);
         let unified_mapping = a.mapping.clone();
+        crate::trace::count_isl_operation();
         let result_ptr = unsafe { isl::isl_set_sum(a.isl_set, b.isl_set) };
         a.isl_set = ptr::null_mut();
         b.isl_set = ptr::null_mut();
@@ -494,7 +636,7 @@ impl<T> Variable<T> {
     }
 }
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
 pub struct Constraint<T> {
     linear_combination: Vec<(i32, T)>,
     constant_term: i32,
@@ -601,7 +743,7 @@ impl<T> Constraint<T> {
     }
 }
 
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub enum ConstraintType {
     NonNegative,
     EqualToZero,
@@ -698,6 +840,16 @@ impl<T: Clone + Ord + Debug + ToString + Eq + Hash> PresburgerSet<T> {
     /// This processes each LinearSet component of the SemilinearSet and represents it
     /// as a set of constraints in the PresburgerSet.
     pub fn from_semilinear_set(semilinear_set: &SemilinearSet<T>) -> Self {
+        Self::from_semilinear_set_with(
+            semilinear_set,
+            DIRECT_ISL_CONSTRUCTION.load(Ordering::SeqCst),
+        )
+    }
+
+    /// `from_semilinear_set` with an explicit choice between direct construction
+    /// and the ISL string path (both produce the same set)
+    fn from_semilinear_set_with(semilinear_set: &SemilinearSet<T>, direct: bool) -> Self {
+        let _span = crate::trace::span("semilinear_to_presburger");
         // First, collect all keys used in the semilinear set
         let mut all_keys = BTreeSet::new();
         for component in &semilinear_set.components {
@@ -715,7 +867,7 @@ impl<T: Clone + Ord + Debug + ToString + Eq + Hash> PresburgerSet<T> {
         }
 
         // Convert BTreeSet to Vec for consistent ordering
-        let mapping: Vec<T> = all_keys.into_iter().collect();
+        let mapping: Arc<[T]> = all_keys.into_iter().collect();
 
         // Create a context and an empty result set
         let ctx = isl::get_ctx();
@@ -723,13 +875,17 @@ impl<T: Clone + Ord + Debug + ToString + Eq + Hash> PresburgerSet<T> {
 
         // Process each linear set component
         for component in &semilinear_set.components {
-            // Convert the linear set to an ISL set string and parse it
-            let set_string = generate_linear_set_string(component, &mapping);
+            let component_set = if direct {
+                linear_set_to_isl(component, &mapping)
+            } else {
+                // Convert the linear set to an ISL set string and parse it
+                let set_string = generate_linear_set_string(component, &mapping);
 
-            // Parse the ISL set string
-            let component_set = unsafe {
-                let cstr = CString::new(set_string).unwrap();
-                isl::isl_set_read_from_str(ctx, cstr.as_ptr())
+                // Parse the ISL set string
+                unsafe {
+                    let cstr = CString::new(set_string).unwrap();
+                    isl::isl_set_read_from_str(ctx, cstr.as_ptr())
+                }
             };
 
             // Union with the result set
@@ -755,6 +911,39 @@ impl<T: Clone + Ord + Debug + ToString + Eq + Hash> PresburgerSet<T> {
     }
 }
 
+/// Build the ISL set of a LinearSet directly: the same constraints as
+/// `generate_linear_set_string`, i.e. `p_i = base_i + sum_j period_j[i] * e_j`
+/// and `e_j >= 0`, with one existential per period.
+fn linear_set_to_isl<T: Clone + Ord + Eq + Hash>(
+    linear_set: &LinearSet<T>,
+    mapping: &[T],
+) -> *mut isl::isl_set {
+    let n_dims = mapping.len();
+    let n_exists = linear_set.periods.len();
+    let width = n_dims + n_exists + 1;
+    let mut rows: Vec<ConstraintRow> = Vec::with_capacity(n_dims + n_exists);
+
+    // p_i - sum_j period_j[i] * e_j - base_i = 0
+    for (i, key) in mapping.iter().enumerate() {
+        let mut row = vec![0i64; width];
+        row[i] = 1;
+        for (period_idx, period) in linear_set.periods.iter().enumerate() {
+            row[n_dims + period_idx] = -(period.get(key) as i64);
+        }
+        row[width - 1] = -(linear_set.base.get(key) as i64);
+        rows.push((true, row));
+    }
+
+    // e_j >= 0
+    for period_idx in 0..n_exists {
+        let mut row = vec![0i64; width];
+        row[n_dims + period_idx] = 1;
+        rows.push((false, row));
+    }
+
+    isl_set_from_rows(n_dims, n_exists, &rows)
+}
+
 /// Helper function to generate an ISL set string from a LinearSet
 fn generate_linear_set_string<T: ToString + Clone + Ord + Eq + Hash>(
     linear_set: &LinearSet<T>,
@@ -1656,6 +1845,35 @@ mod presburger_equality_tests {
 /// This converts an ISL-based representation to a pure Rust representation
 /// that can be processed without relying on the ISL library.
 impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
+    /// Number of basic sets, i.e. of disjuncts `to_quantified_sets` returns
+    pub fn num_basic_sets(&self) -> usize {
+        let n = unsafe { isl::isl_set_n_basic_set(self.isl_set) };
+        if n < 0 {
+            isl::check_budget();
+        }
+        n.max(0) as usize
+    }
+
+    /// The same set of place counts with fewer and simpler disjuncts: coalesced, without
+    /// basic sets contained in others, and with the constraints that follow from all
+    /// counts being non-negative left out (see `rust_set_normalize_disjuncts`).
+    ///
+    /// Only points with non-negative coordinates are kept as they are.
+    pub fn normalize_disjuncts(&self) -> Self {
+        let set = unsafe { isl::rust_set_normalize_disjuncts(isl::isl_set_copy(self.isl_set)) };
+        if set.is_null() {
+            isl::check_budget();
+            panic!(
+                "ISL failed to normalize the disjuncts of {:?}",
+                self.mapping
+            );
+        }
+        PresburgerSet {
+            isl_set: set,
+            mapping: self.mapping.clone(),
+        }
+    }
+
     pub fn to_quantified_sets(&self) -> Vec<QuantifiedSet<T>> {
         // We'll use a simpler approach that works in a single pass
 
@@ -1667,7 +1885,7 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
             // We need to use the isl_set_foreach_basic_set function to iterate through basic sets
             struct UserData<T> {
                 result_sets: Vec<QuantifiedSet<T>>,
-                mapping: Vec<T>,
+                mapping: Arc<[T]>,
             }
 
             // Callback for each basic set
@@ -1677,7 +1895,7 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
             ) -> isl::isl_stat {
                 unsafe {
                     let user_data = &mut *(user as *mut UserData<T>);
-                    let mapping = &user_data.mapping;
+                    let mapping: &[T] = &user_data.mapping;
 
                     // Create a new QuantifiedSet for this basic set
                     let mut quantified_set = QuantifiedSet {
@@ -1812,11 +2030,14 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
             };
 
             // Iterate through each basic set
-            isl::isl_set_foreach_basic_set(
+            let status = isl::isl_set_foreach_basic_set(
                 set_copy,
                 Some(basic_set_callback::<T>),
                 &mut user_data as *mut _ as *mut std::os::raw::c_void,
             );
+            if status < 0 {
+                isl::check_budget();
+            }
 
             // Extract result sets
             result = user_data.result_sets;
@@ -1833,7 +2054,16 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
 ///
 /// This function converts a Rust representation back to an ISL-based representation.
 impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
-    pub fn from_quantified_sets(sets: &[QuantifiedSet<T>], mapping: Vec<T>) -> Self 
+    pub fn from_quantified_sets(sets: &[QuantifiedSet<T>], mapping: impl Into<Arc<[T]>>) -> Self 
+    where
+        T: Display,
+    {
+        Self::from_quantified_sets_with(sets, mapping.into(), DIRECT_ISL_CONSTRUCTION.load(Ordering::SeqCst))
+    }
+
+    /// `from_quantified_sets` with an explicit choice between direct construction
+    /// and the ISL string path (both produce the same set)
+    fn from_quantified_sets_with(sets: &[QuantifiedSet<T>], mapping: Arc<[T]>, direct: bool) -> Self
     where
         T: Display,
     {
@@ -1845,6 +2075,16 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
 
         // Process each QuantifiedSet (each one becomes a basic set in the result)
         for quantified_set in sets {
+            if direct {
+                let set = quantified_set_to_isl(quantified_set, &mapping);
+                result_set = if result_set.is_null() {
+                    set
+                } else {
+                    unsafe { isl::isl_set_union(result_set, set) }
+                };
+                continue;
+            }
+
             // Create the ISL set string for this QuantifiedSet
             let set_string = create_isl_set_string(quantified_set, &mapping);
 
@@ -1855,6 +2095,7 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
 
                 // Check if ISL returned NULL (syntax error)
                 if parsed_set.is_null() {
+                    isl::check_budget();
                     panic!(
                         "ISL syntax error while parsing set string. This likely indicates a bug in constraint generation.\n\
                          Set string: {}\n\
@@ -1889,6 +2130,66 @@ impl<T: Clone + Ord + Debug + ToString> PresburgerSet<T> {
     }
 }
 
+/// Build the ISL set of a QuantifiedSet directly, with the same constraints as
+/// `create_isl_set_string`: every constraint of the set plus `p_i >= 0`.
+/// Existential variables are numbered by their position among the indices used.
+fn quantified_set_to_isl<T: ToString + Display + Debug>(
+    quantified_set: &QuantifiedSet<T>,
+    mapping: &[T],
+) -> *mut isl::isl_set {
+    let existential_vars: Vec<usize> = quantified_set
+        .constraints
+        .iter()
+        .flat_map(|c| {
+            c.linear_combination
+                .iter()
+                .filter_map(|(_, var)| match var {
+                    Variable::Existential(idx) => Some(*idx),
+                    _ => None,
+                })
+        })
+        .collect::<BTreeSet<usize>>()
+        .into_iter()
+        .collect();
+
+    // Variables are matched by string representation, as in the string path
+    let mapping_strings: Vec<String> = mapping.iter().map(|x| x.to_string()).collect();
+
+    let n_dims = mapping.len();
+    let n_exists = existential_vars.len();
+    let width = n_dims + n_exists + 1;
+    let mut rows: Vec<ConstraintRow> = Vec::with_capacity(quantified_set.constraints.len() + n_dims);
+
+    for constraint in &quantified_set.constraints {
+        let mut row = vec![0i64; width];
+        for (coeff, var) in constraint.linear_combination.iter() {
+            let column = match var {
+                Variable::Var(t) => {
+                    let t_str = t.to_string();
+                    mapping_strings
+                        .iter()
+                        .position(|x| *x == t_str)
+                        .unwrap_or_else(|| panic!("Variable {} not found in mapping {:?}", t, mapping))
+                }
+                Variable::Existential(idx) => n_dims + existential_vars.binary_search(idx).unwrap(),
+            };
+            // Repeated variables add up, as they do in the parsed expression
+            row[column] += *coeff as i64;
+        }
+        row[width - 1] = constraint.constant_term as i64;
+        rows.push((constraint.constraint_type == ConstraintType::EqualToZero, row));
+    }
+
+    // Non-negativity constraints for regular variables
+    for i in 0..n_dims {
+        let mut row = vec![0i64; width];
+        row[i] = 1;
+        rows.push((false, row));
+    }
+
+    isl_set_from_rows(n_dims, n_exists, &rows)
+}
+
 // Helper function to create ISL set string from a QuantifiedSet
 fn create_isl_set_string<T: ToString + Display + Debug>(quantified_set: &QuantifiedSet<T>, mapping: &[T]) -> String {
     // Collect all existential variables used in this set
@@ -2062,6 +2363,86 @@ mod tests {
         println!("u2: {:}", u2);
     }
 
+    #[test]
+    fn test_harmonize_reorders_dimensions() {
+        // { (b, a) | b = 1, a = 2 } over mapping [b, a]
+        let qs = QuantifiedSet::new(vec![
+            Constraint::new(vec![(1, Variable::Var('b'))], -1, ConstraintType::EqualToZero),
+            Constraint::new(vec![(1, Variable::Var('a'))], -2, ConstraintType::EqualToZero),
+        ]);
+        let mut reversed = PresburgerSet::from_quantified_sets(&[qs.clone()], vec!['b', 'a']);
+        let mut other = PresburgerSet::atom('c');
+        reversed.harmonize(&mut other);
+        assert_eq!(*reversed.mapping, ['a', 'b', 'c']);
+
+        // Same set built directly over the sorted mapping, with c = 0
+        let mut sorted_qs = qs.constraints().to_vec();
+        sorted_qs.push(Constraint::new(
+            vec![(1, Variable::Var('c'))],
+            0,
+            ConstraintType::EqualToZero,
+        ));
+        let expected =
+            PresburgerSet::from_quantified_sets(&[QuantifiedSet::new(sorted_qs)], vec!['a', 'b', 'c']);
+        assert!(unsafe { isl::isl_set_is_equal(reversed.isl_set, expected.isl_set) } == 1);
+    }
+
+    #[test]
+    fn test_harmonize_shares_mapping() {
+        let mut a = PresburgerSet::universe(vec!['a', 'b']);
+        let mut b = PresburgerSet::atom('b');
+        let before = a.mapping.clone();
+        a.harmonize(&mut b);
+        // `a` was already over the combined mapping, so `b` adopts it
+        assert!(Arc::ptr_eq(&a.mapping, &before));
+        assert!(Arc::ptr_eq(&a.mapping, &b.mapping));
+        assert!(Arc::ptr_eq(&a.clone().mapping, &a.mapping));
+
+        let union = a.union(&b);
+        assert!(Arc::ptr_eq(&union.mapping, &before));
+        assert_eq!(union.project_out('a').mapping.len(), 1);
+    }
+
+    #[test]
+    fn test_union_all_matches_pairwise_union() {
+        let atoms: Vec<PresburgerSet<char>> = "dbeac".chars().map(PresburgerSet::atom).collect();
+        let pairwise = atoms
+            .iter()
+            .cloned()
+            .reduce(|acc, next| acc.union(&next))
+            .unwrap();
+        let all = PresburgerSet::union_all(&atoms);
+        assert_eq!(*all.mapping, ['a', 'b', 'c', 'd', 'e']);
+        assert_eq!(all, pairwise);
+        assert!(PresburgerSet::<char>::union_all(&[]).is_empty());
+    }
+
+    #[test]
+    fn test_intersection_all_matches_pairwise_intersection() {
+        let sets = vec![
+            PresburgerSet::universe(vec!['b', 'a']),
+            PresburgerSet::atom('a'),
+            PresburgerSet::atom('a').union(&PresburgerSet::atom('b')),
+        ];
+        let pairwise = sets[0].intersection(&sets[1]).intersection(&sets[2]);
+        let all = PresburgerSet::intersection_all(&sets).unwrap();
+        assert_eq!(all, pairwise);
+        assert!(PresburgerSet::<char>::intersection_all(&[]).is_none());
+    }
+
+    #[test]
+    fn test_embed_matches_sum_and_harmonization() {
+        let set = PresburgerSet::atom('b').union(&PresburgerSet::atom('c'));
+        let free = ['a', 'd'];
+        let domain = ['e', 'd', 'c', 'b', 'a'];
+
+        let mut expected = PresburgerSet::universe(free.to_vec()).times(set.clone());
+        expected.harmonize(&mut PresburgerSet::universe(domain.to_vec()));
+        let embedded = set.embed(&free, &domain);
+        assert_eq!(*embedded.mapping, ['a', 'b', 'c', 'd', 'e']);
+        assert_eq!(embedded, expected);
+    }
+
     #[test]
     fn test_union_commutative() {
         let a = PresburgerSet::atom('a');
@@ -2202,6 +2583,71 @@ mod tests {
         assert_eq!(union.mapping, round_trip.mapping);
     }
 
+    #[test]
+    fn test_direct_construction_matches_string_path_semilinear() {
+        use crate::semilinear::{LinearSet, SemilinearSet, SparseVector};
+
+        let mut base = SparseVector::new();
+        base.set('a', 1);
+        base.set('c', 3);
+        let mut period1 = SparseVector::new();
+        period1.set('b', 1);
+        period1.set('c', 2);
+        let mut period2 = SparseVector::new();
+        period2.set('a', 2);
+        let with_periods = LinearSet {
+            base: base.clone(),
+            periods: vec![period1, period2],
+        };
+        let point = LinearSet {
+            base,
+            periods: vec![],
+        };
+
+        for components in [vec![], vec![point.clone()], vec![with_periods, point]] {
+            let semilinear = SemilinearSet::new(components);
+            let direct = PresburgerSet::from_semilinear_set_with(&semilinear, true);
+            let parsed = PresburgerSet::from_semilinear_set_with(&semilinear, false);
+            assert_eq!(direct.mapping, parsed.mapping);
+            assert_eq!(direct, parsed, "direct: {}, parsed: {}", direct, parsed);
+        }
+    }
+
+    #[test]
+    fn test_direct_construction_matches_string_path_quantified() {
+        // x = 2*E3 + 1, y - x - E7 >= 0, E3 >= 0, E7 >= 0  (sparse existential indices)
+        let odd_below = QuantifiedSet::new(vec![
+            Constraint::new(
+                vec![(1, Variable::Var('x')), (-2, Variable::Existential(3))],
+                -1,
+                ConstraintType::EqualToZero,
+            ),
+            Constraint::new(
+                vec![
+                    (1, Variable::Var('y')),
+                    (-1, Variable::Var('x')),
+                    (-1, Variable::Existential(7)),
+                ],
+                0,
+                ConstraintType::NonNegative,
+            ),
+            Constraint::new(vec![(1, Variable::Existential(3))], 0, ConstraintType::NonNegative),
+            Constraint::new(vec![(1, Variable::Existential(7))], 0, ConstraintType::NonNegative),
+        ]);
+        // x + x - 4 = 0  (repeated variable), no existentials
+        let two = QuantifiedSet::new(vec![Constraint::new(
+            vec![(1, Variable::Var('x')), (1, Variable::Var('x'))],
+            -4,
+            ConstraintType::EqualToZero,
+        )]);
+
+        for sets in [vec![], vec![two.clone()], vec![odd_below, two]] {
+            let direct = PresburgerSet::from_quantified_sets_with(&sets, vec!['x', 'y'].into(), true);
+            let parsed = PresburgerSet::from_quantified_sets_with(&sets, vec!['x', 'y'].into(), false);
+            assert_eq!(direct, parsed, "direct: {}, parsed: {}", direct, parsed);
+        }
+    }
+
     #[test]
     fn test_conversion_atom() {
         // Test with a single atom
@@ -2383,7 +2829,7 @@ mod tests {
         }
 
         assert!(!presburger.is_empty());
-        assert_eq!(mapping, presburger.mapping);
+        assert_eq!(mapping, *presburger.mapping);
     }
 
     #[test]
@@ -2420,4 +2866,51 @@ mod tests {
         assert!(!zero_vars.contains(&"u")); // Multiple variables in constraint  
         assert!(!zero_vars.contains(&"v")); // Non-zero constant term
     }
+
+    #[test]
+    fn test_normalize_disjuncts() {
+        use ConstraintType::{EqualToZero, NonNegative};
+        let x = Variable::Var('x');
+        let y = Variable::Var('y');
+
+        // x <= 5 with y = 0, 2 <= x <= 3 with y = 0 (inside the first), and y >= 10
+        let sets = [
+            QuantifiedSet {
+                constraints: vec![
+                    Constraint::new(vec![(-1, x)], 5, NonNegative),
+                    Constraint::new(vec![(1, y)], 0, EqualToZero),
+                ],
+            },
+            QuantifiedSet {
+                constraints: vec![
+                    Constraint::new(vec![(1, x)], -2, NonNegative),
+                    Constraint::new(vec![(-1, x)], 3, NonNegative),
+                    Constraint::new(vec![(1, y)], 0, EqualToZero),
+                ],
+            },
+            QuantifiedSet {
+                constraints: vec![
+                    Constraint::new(vec![(1, x)], 0, NonNegative),
+                    Constraint::new(vec![(1, y)], -10, NonNegative),
+                ],
+            },
+        ];
+        let presburger = PresburgerSet::from_quantified_sets(&sets, vec!['x', 'y']);
+        assert_eq!(presburger.num_basic_sets(), 3);
+
+        let normalized = presburger.normalize_disjuncts();
+        assert_eq!(normalized.num_basic_sets(), 2);
+
+        // Same place counts, and x >= 0 no longer spelled out
+        let counts = PresburgerSet::universe(vec!['x', 'y']);
+        assert_eq!(
+            normalized.intersection(&counts),
+            presburger.intersection(&counts)
+        );
+        for disjunct in normalized.to_quantified_sets() {
+            assert!(disjunct.constraints.iter().all(|constraint| {
+                constraint.linear_combination != vec![(1, x)] || constraint.constant_term != 0
+            }));
+        }
+    }
 }
@@ -1,11 +1,10 @@
 use crate::deterministic_map::HashMap;
-use crate::kleene::Kleene; // <-- bring in zero()
 use crate::presburger::{Constraint as PConstraint, PresburgerSet, QuantifiedSet, Variable};
 use either::Either;
 use serde::{Serialize, Deserialize};
 use std::fmt::{self, Display};
 use std::fs;
-use std::hash::Hash;
+use std::hash::{BuildHasher, Hash, Hasher};
 use std::path::Path;
 
 // Helper module for serializing HashMap with non-string keys
@@ -44,6 +43,19 @@ pub struct AffineExpr<T: Eq + Hash> {
 }
 
 impl<T: Eq + Hash> AffineExpr<T> {
+    /// An expression with the given coefficients and constant
+    pub fn from_terms(terms: impl IntoIterator<Item = (Variable<T>, i64)>, constant: i64) -> Self {
+        AffineExpr {
+            terms: terms.into_iter().collect(),
+            constant,
+        }
+    }
+
+    /// The variables with their coefficients
+    pub fn terms(&self) -> impl Iterator<Item = (&Variable<T>, i64)> {
+        self.terms.iter().map(|(var, coeff)| (var, *coeff))
+    }
+
     /// Map variable type from T to U
     pub fn rename_vars<U, F>(self, mut f: F) -> AffineExpr<U>
     where
@@ -64,6 +76,19 @@ impl<T: Eq + Hash> AffineExpr<T> {
     }
 }
 
+/// Structural hash, consistent with `PartialEq`: the terms are combined independently of
+/// the map's iteration order.
+impl<T: Eq + Hash> Hash for AffineExpr<T> {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        let terms = self.terms.iter().fold(0u64, |acc, term| {
+            acc.wrapping_add(self.terms.hasher().hash_one(term))
+        });
+        state.write_usize(self.terms.len());
+        state.write_u64(terms);
+        self.constant.hash(state);
+    }
+}
+
 impl<T: Clone + Eq + Hash> AffineExpr<T> {
     /// Create a zero expression
     pub fn new() -> Self {
@@ -254,7 +279,7 @@ where
 }
 
 /// Comparison operators (normalized to only = and >=)
-#[derive(Debug, Clone, Copy, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, serde::Serialize, serde::Deserialize)]
 pub enum CompOp {
     Eq,  // =
     Geq, // >=
@@ -270,7 +295,7 @@ impl fmt::Display for CompOp {
 }
 
 /// Linear constraint: expr op 0
-#[derive(Debug, Clone, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+#[derive(Debug, Clone, PartialEq, Eq, Hash, serde::Serialize, serde::Deserialize)]
 pub struct Constraint<T: Eq + Hash> {
     pub expr: AffineExpr<T>,
     pub op: CompOp,
@@ -321,7 +346,7 @@ impl<T: fmt::Display + Eq + Hash> fmt::Display for Constraint<T> {
 }
 
 /// Normalized formula (no Not or Implies)
-#[derive(Debug, Clone, PartialEq, Eq, serde::Serialize, serde::Deserialize)]
+#[derive(Debug, Clone, PartialEq, Eq, Hash, serde::Serialize, serde::Deserialize)]
 pub enum Formula<T: Eq + Hash> {
     Constraint(Constraint<T>),
     And(Vec<Formula<T>>),
@@ -504,7 +529,7 @@ impl<T: fmt::Display + Eq + Hash> fmt::Display for Formula<T> {
 }
 
 /// The proof invariant extracted from an SMT-LIB file
-#[derive(Debug, Clone, serde::Serialize, serde::Deserialize)]
+#[derive(Debug, Clone, PartialEq, Eq, Hash, serde::Serialize, serde::Deserialize)]
 pub struct ProofInvariant<T: Eq + Hash> {
     /// Variables declared in the cert function
     pub variables: Vec<T>,
@@ -1830,21 +1855,20 @@ fn formula_to_presburger(formula: &Formula<String>, mapping: Vec<String>) -> Pre
         }
         Formula::And(children) => {
             // intersection of all children
-            let mut iter = children
+            let sets: Vec<_> = children
                 .iter()
-                .map(|f| formula_to_presburger(f, mapping.clone()));
-            let first = iter
-                .next()
-                .unwrap_or_else(|| PresburgerSet::universe(mapping.clone()));
-            iter.fold(first, |acc, next| acc.intersection(&next))
+                .map(|f| formula_to_presburger(f, mapping.clone()))
+                .collect();
+            PresburgerSet::intersection_all(&sets)
+                .unwrap_or_else(|| PresburgerSet::universe(mapping.clone()))
         }
         Formula::Or(children) => {
             // union of all children
-            let mut iter = children
+            let sets: Vec<_> = children
                 .iter()
-                .map(|f| formula_to_presburger(f, mapping.clone()));
-            let first = iter.next().unwrap_or_else(PresburgerSet::zero);
-            iter.fold(first, |acc, next| acc.union(&next))
+                .map(|f| formula_to_presburger(f, mapping.clone()))
+                .collect();
+            PresburgerSet::union_all(&sets)
         }
         Formula::Exists(_idx, body) => {
             // Existential variables are already handled in the constraints
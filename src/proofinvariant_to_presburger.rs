@@ -1,16 +1,22 @@
-use crate::kleene::Kleene;
+use crate::deterministic_map::{DeterministicHasher, HashMap};
 use crate::presburger::{PresburgerSet, QuantifiedSet, Variable};
 use crate::proof_parser::{Constraint as ProofConstraint, Formula, ProofInvariant};
 use either::Either;
 use std::fmt::Display;
-use std::hash::Hash;
+use std::hash::{BuildHasher, Hash, Hasher};
 use std::cell::RefCell;
-use std::collections::HashMap;
 
-// Thread-local cache for formula_to_presburger
-// Key is a string representation of (formula, mapping)
+/// A cached `formula_to_presburger` result; the key is kept to rule out digest collisions
+struct CachedFormula {
+    formula: Formula<String>,
+    mapping: Vec<String>,
+    result: PresburgerSet<String>,
+}
+
+// Thread-local cache for formula_to_presburger, keyed by the structural digest of
+// (formula, mapping)
 thread_local! {
-    static FORMULA_CACHE: RefCell<HashMap<String, PresburgerSet<String>>> = RefCell::new(HashMap::new());
+    static FORMULA_CACHE: RefCell<HashMap<u64, Vec<CachedFormula>>> = RefCell::new(HashMap::default());
 }
 
 /// Clear the formula_to_presburger cache
@@ -23,10 +29,49 @@ pub fn clear_formula_cache() {
 /// Get the current size of the formula_to_presburger cache
 pub fn formula_cache_size() -> usize {
     FORMULA_CACHE.with(|cache| {
-        cache.borrow().len()
+        cache.borrow().values().map(Vec::len).sum()
     })
 }
 
+/// Structural digests of a formula and of all its subformulas, computed bottom-up in
+/// one pass so that the recursive cache lookups do not rehash shared subtrees
+struct Digest {
+    hash: u64,
+    children: Vec<Digest>,
+}
+
+impl Digest {
+    fn of(formula: &Formula<String>) -> Digest {
+        let mut hasher = DeterministicHasher::default().build_hasher();
+        std::mem::discriminant(formula).hash(&mut hasher);
+        let children = match formula {
+            Formula::Constraint(constraint) => {
+                constraint.hash(&mut hasher);
+                Vec::new()
+            }
+            Formula::And(formulas) | Formula::Or(formulas) => {
+                formulas.iter().map(Digest::of).collect()
+            }
+            Formula::Exists(id, body) | Formula::Forall(id, body) => {
+                id.hash(&mut hasher);
+                vec![Digest::of(body)]
+            }
+        };
+        hasher.write_usize(children.len());
+        for child in &children {
+            hasher.write_u64(child.hash);
+        }
+        Digest {
+            hash: hasher.finish(),
+            children,
+        }
+    }
+}
+
+fn mapping_digest(mapping: &[String]) -> u64 {
+    DeterministicHasher::default().hash_one(mapping)
+}
+
 /// Convert a single affine constraint to a PresburgerSet
 /// Note: This only works when T is String since that's what the proof parser uses
 pub fn from_affine_constraint(
@@ -48,33 +93,53 @@ pub fn formula_to_presburger(
     formula: &Formula<String>,
     mapping: &[String],
 ) -> PresburgerSet<String> {
-    // Create a cache key from the formula and mapping
-    let cache_key = format!("{:?}|{:?}", formula, mapping);
-    
+    formula_to_presburger_memo(formula, &Digest::of(formula), mapping, mapping_digest(mapping))
+}
+
+/// Memoized formula_to_presburger, given the digests of `formula` and `mapping`
+fn formula_to_presburger_memo(
+    formula: &Formula<String>,
+    digest: &Digest,
+    mapping: &[String],
+    mapping_digest: u64,
+) -> PresburgerSet<String> {
+    let key = digest.hash ^ mapping_digest.rotate_left(17);
+
     // Check if we have a cached result
     let cached_result = FORMULA_CACHE.with(|cache| {
-        cache.borrow().get(&cache_key).cloned()
+        cache.borrow().get(&key).and_then(|entries| {
+            entries
+                .iter()
+                .find(|entry| entry.mapping == mapping && entry.formula == *formula)
+                .map(|entry| entry.result.clone())
+        })
     });
-    
+
     if let Some(result) = cached_result {
         return result;
     }
-    
+
     // Compute the result
-    let result = formula_to_presburger_impl(formula, mapping);
-    
+    let result = formula_to_presburger_impl(formula, digest, mapping, mapping_digest);
+
     // Store in cache
     FORMULA_CACHE.with(|cache| {
-        cache.borrow_mut().insert(cache_key, result.clone());
+        cache.borrow_mut().entry(key).or_default().push(CachedFormula {
+            formula: formula.clone(),
+            mapping: mapping.to_vec(),
+            result: result.clone(),
+        });
     });
-    
+
     result
 }
 
 /// Internal implementation of formula_to_presburger (not memoized)
 fn formula_to_presburger_impl(
     formula: &Formula<String>,
+    digest: &Digest,
     mapping: &[String],
+    mapping_digest: u64,
 ) -> PresburgerSet<String> {
     match formula {
         Formula::Constraint(constraint) => {
@@ -84,20 +149,23 @@ fn formula_to_presburger_impl(
 
         Formula::And(formulas) => {
             // AND = intersection of all subformulas
-            formulas
+            let sets: Vec<_> = formulas
                 .iter()
-                .map(|f| formula_to_presburger(f, mapping))
-                .reduce(|a, b| a.intersection(&b))
+                .zip(&digest.children)
+                .map(|(f, d)| formula_to_presburger_memo(f, d, mapping, mapping_digest))
+                .collect();
+            PresburgerSet::intersection_all(&sets)
                 .unwrap_or_else(|| PresburgerSet::universe(mapping.to_vec()))
         }
 
         Formula::Or(formulas) => {
             // OR = union of all subformulas
-            formulas
+            let sets: Vec<_> = formulas
                 .iter()
-                .map(|f| formula_to_presburger(f, mapping))
-                .reduce(|a, b| a.union(&b))
-                .unwrap_or_else(PresburgerSet::<String>::zero)
+                .zip(&digest.children)
+                .map(|(f, d)| formula_to_presburger_memo(f, d, mapping, mapping_digest))
+                .collect();
+            PresburgerSet::union_all(&sets)
         }
 
         &Formula::Exists(id, ref form) => {
@@ -303,6 +371,7 @@ where
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::kleene::Kleene;
     use crate::proof_parser::{AffineExpr, CompOp};
     use either::{Left, Right};
 
@@ -399,6 +468,37 @@ mod tests {
         println!("Multi-variable constraint: {}", ps);
     }
 
+    #[test]
+    fn test_formula_cache_is_structural() {
+        let term = |v: &str, c: i64| AffineExpr::from_var(v.to_string()).mul_by_const(c);
+        let xy = term("x", 2).add(&term("y", 3));
+        let yx = term("y", 3).add(&term("x", 2));
+        assert_eq!(xy, yx);
+        let hash = |e: &AffineExpr<String>| DeterministicHasher::default().hash_one(e);
+        assert_eq!(hash(&xy), hash(&yx));
+
+        let formula = |e: AffineExpr<String>| {
+            Formula::Or(vec![
+                Formula::Constraint(ProofConstraint::new(e, CompOp::Geq)),
+                Formula::Constraint(ProofConstraint::new(term("x", 1), CompOp::Eq)),
+            ])
+        };
+        let mapping = vec!["x".to_string(), "y".to_string()];
+
+        clear_formula_cache();
+        let first = formula_to_presburger(&formula(xy), &mapping);
+        let size = formula_cache_size();
+        assert_eq!(size, 3);
+        let second = formula_to_presburger(&formula(yx), &mapping);
+        assert_eq!(formula_cache_size(), size);
+        assert_eq!(first, second);
+
+        // A different mapping is a different entry
+        let swapped = vec!["y".to_string(), "x".to_string()];
+        formula_to_presburger(&formula(term("x", 2)), &swapped);
+        assert_eq!(formula_cache_size(), size + 3);
+    }
+
     #[test]
     fn test_and_formula() {
         // Test: x >= 0 AND x <= 10 (represented as x >= 0 AND -x + 10 >= 0)
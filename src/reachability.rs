@@ -16,14 +16,51 @@ static DEBUG_LOGGER: Mutex<Option<DebugLogger>> = Mutex::new(None);
 
 pub static BIDIRECTIONAL_PRUNING_ENABLED: AtomicBool = AtomicBool::new(true);
 
-/// Initialize the global debug logger
-pub fn init_debug_logger(program_name: String, program_content: String) {
-    let logger = DebugLogger::new(program_name, program_content);
-    *DEBUG_LOGGER.lock().unwrap() = Some(logger);
+/// Initialize the debug logger of this analysis: the global one, or the task logger a
+/// batch file runs under. The program content is only rendered if the debug report is
+/// enabled, and the report is streamed to `out_dir` with `--log-stream`.
+pub fn init_debug_logger(
+    program_name: String,
+    out_dir: &str,
+    program_content: impl FnOnce() -> String,
+) {
+    use crate::debug_report::{LogLevel, log_enabled};
+
+    let logger = if !log_enabled(LogLevel::Info) {
+        DebugLogger::new(program_name, String::new())
+    } else {
+        new_debug_logger(program_name, out_dir, program_content())
+    };
+    if let Err(logger) = crate::debug_report::replace_task_logger(logger) {
+        *DEBUG_LOGGER.lock().unwrap() = Some(logger);
+    }
 }
 
-/// Get a reference to the global debug logger, or create a default one if not initialized
+fn new_debug_logger(program_name: String, out_dir: &str, content: String) -> DebugLogger {
+    use crate::debug_report::log_stream;
+
+    if log_stream() {
+        let path = format!("{}/debug_report.html", out_dir);
+        DebugLogger::streaming(program_name.clone(), content.clone(), &path).unwrap_or_else(|e| {
+            eprintln!(
+                "{}: Cannot stream the debug report to {}: {}",
+                "Warning".yellow().bold(),
+                path,
+                e
+            );
+            DebugLogger::new(program_name, content)
+        })
+    } else {
+        DebugLogger::new(program_name, content)
+    }
+}
+
+/// Get the debug logger of the current task (see `debug_report::with_task_logger`), falling
+/// back to the global debug logger, which is created with defaults if not initialized
 pub fn get_debug_logger() -> DebugLogger {
+    if let Some(logger) = crate::debug_report::task_logger() {
+        return logger;
+    }
     let mut guard = DEBUG_LOGGER.lock().unwrap();
     if guard.is_none() {
         *guard = Some(DebugLogger::new(
@@ -61,8 +98,8 @@ pub fn is_petri_reachability_set_subset_of_semilinear<P, Q>(
     out_dir: &str,
 ) -> bool
 where
-    P: Clone + Hash + Ord + Display + Debug,
-    Q: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+    Q: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     is_petri_reachability_set_subset_of_semilinear_new(
         petri,
@@ -90,28 +127,30 @@ pub fn is_petri_reachability_set_subset_of_semilinear_new<P, Q>(
     out_dir: &str,
 ) -> bool
 where
-    P: Clone + Hash + Ord + Display + Debug,
-    Q: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+    Q: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             "Reachability Analysis Start",
             "Starting new SPresburgerSet-based reachability analysis",
-            &format!(
-                "Petri net places: [{}]\nPlaces that must be zero: [{}]\nSemilinear set: {}",
-                petri
-                    .get_places()
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", "),
-                places_that_must_be_zero
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", "),
-                semilinear
-            ),
+            || {
+                format!(
+                    "Petri net places: [{}]\nPlaces that must be zero: [{}]\nSemilinear set: {}",
+                    petri
+                        .get_places()
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", "),
+                    places_that_must_be_zero
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", "),
+                    semilinear
+                )
+            },
         );
 
         // Step 1: Convert semilinear set to SPresburgerSet and embed it in Either<P,Q> domain
@@ -132,11 +171,9 @@ where
             .collect();
 
         let varying_universe = SPresburgerSet::universe(places_that_can_vary);
-        debug_logger.step(
-            "Varying Universe",
-            "Varying universe",
-            &format!("Varying universe: {}", varying_universe),
-        );
+        debug_logger.step_with("Varying Universe", "Varying universe", || {
+            format!("Varying universe: {}", varying_universe)
+        });
 
         let response_places = petri
             .get_places()
@@ -148,43 +185,37 @@ where
             .collect::<Vec<_>>();
 
         let response_universe = SPresburgerSet::universe(response_places);
-        debug_logger.step(
-            "Response Universe",
-            "Response universe",
-            &format!("Response universe: {}", response_universe),
-        );
+        debug_logger.step_with("Response Universe", "Response universe", || {
+            format!("Response universe: {}", response_universe)
+        });
 
         // Step 3: Compute complement: universe - embedded_semilinear
         let complement = response_universe.difference(q_spresburger);
-        debug_logger.step(
+        debug_logger.step_with(
             "Compute Complement",
             "Computing complement (universe - embedded_semilinear)",
-            &format!("Complement: {}", complement),
+            || format!("Complement: {}", complement),
         );
 
         let complement_embedded = complement.rename(|q| Right(q));
-        debug_logger.step(
+        debug_logger.step_with(
             "Complement Embedded",
             "Complement embedded in Either<P,Q> domain",
-            &format!("Complement embedded: {}", complement_embedded),
+            || format!("Complement embedded: {}", complement_embedded),
         );
 
         let end_result_set = varying_universe.times(complement_embedded);
-        debug_logger.step(
-            "End Result Set",
-            "End result set",
-            &format!("End result set: {}", end_result_set),
-        );
+        debug_logger.step_with("End Result Set", "End result set", || {
+            format!("End result set: {}", end_result_set)
+        });
 
         // Step 4: Check if this constraint set is reachable
         // Note: we've effectively incorporated the zero constraints by filtering the universe
         let result = !can_reach_presburger(petri, end_result_set, out_dir);
 
-        debug_logger.step(
-            "Final Result",
-            "Reachability analysis complete",
-            &format!("Subset property holds: {}", result),
-        );
+        debug_logger.step_with("Final Result", "Reachability analysis complete", || {
+            format!("Subset property holds: {}", result)
+        });
 
         result
     })
@@ -201,83 +232,99 @@ pub fn can_reach_presburger<P>(
     out_dir: &str,
 ) -> bool
 where
-    P: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             "Presburger Reachability Start",
             "Expanding domain and converting to disjunctive normal form",
-            &format!("SPresburgerSet to be checked: {}", presburger),
+            || format!("SPresburgerSet to be checked: {}", presburger),
         );
 
         // First step: Expand the domain of the presburger set to include all places in the Petri net
         let all_petri_places = petri.get_places();
-        debug_logger.step(
+        debug_logger.step_with(
             "Domain Expansion",
             "Expanding presburger set domain to match Petri net",
-            &format!(
-                "Petri net places: [{}]",
-                all_petri_places
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Petri net places: [{}]",
+                    all_petri_places
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
         presburger = presburger.expand_domain(all_petri_places);
-        debug_logger.step(
-            "Domain Expanded",
-            "Presburger set domain expanded",
-            &format!("Expanded presburger set: {}", presburger),
-        );
+        debug_logger.step_with("Domain Expanded", "Presburger set domain expanded", || {
+            format!("Expanded presburger set: {}", presburger)
+        });
 
         // Convert SPresburgerSet to disjunctive normal form (list of quantified sets)
         let disjuncts = presburger.extract_constraint_disjuncts();
 
-        debug_logger.step(
+        debug_logger.step_with(
             "Disjunct Conversion",
             "SPresburgerSet converted to disjuncts",
-            &format!(
-                "Number of disjuncts: {}\nDisjuncts: {}",
-                disjuncts.len(),
-                disjuncts
-                    .iter()
-                    .map(|d| d.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Number of disjuncts: {}\nDisjuncts: {}",
+                    disjuncts.len(),
+                    disjuncts
+                        .iter()
+                        .map(|d| d.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
-        // Check if ANY disjunct is reachable
-        for (i, quantified_set) in disjuncts.iter().enumerate() {
-            debug_logger.log_disjunct_start(i, quantified_set);
-            println!("Checking disjunct {}: {}", i, quantified_set);
+        // Check if ANY disjunct is reachable. With --jobs the disjuncts run on a worker
+        // pool, each logging into its own logger that is merged below in disjunct order.
+        let outcomes = crate::parallel::run_until_decisive(
+            &disjuncts,
+            crate::parallel::jobs(),
+            |i, quantified_set| {
+                let task_logger = DebugLogger::new(format!("disjunct {}", i), String::new());
+                let reachable = crate::debug_report::with_task_logger(&task_logger, || {
+                    task_logger.log_disjunct_start(i, quantified_set);
+                    println!("Checking disjunct {}: {}", i, quantified_set);
+                    can_reach_quantified_set(petri.clone(), quantified_set.clone(), out_dir, i)
+                });
+                (reachable, task_logger)
+            },
+            |(reachable, _)| *reachable,
+        );
 
-            if can_reach_quantified_set(petri.clone(), quantified_set.clone(), out_dir, i) {
+        for (i, (reachable, task_logger)) in outcomes.into_iter().enumerate() {
+            debug_logger.absorb(&task_logger);
+            if reachable {
                 println!(
                     "Disjunct {} is reachable - constraint set is satisfiable",
                     i
                 );
-                debug_logger.step(
+                debug_logger.step_with(
                     &format!("Disjunct {} Result", i),
                     "Disjunct is REACHABLE - constraint set is satisfiable",
-                    &format!("Disjunct {}: REACHABLE", i),
+                    || format!("Disjunct {}: REACHABLE", i),
                 );
                 return true;
             }
-            debug_logger.step(
+            debug_logger.step_with(
                 &format!("Disjunct {} Result", i),
                 "Disjunct is UNREACHABLE",
-                &format!("Disjunct {}: UNREACHABLE", i),
+                || format!("Disjunct {}: UNREACHABLE", i),
             );
         }
 
         println!("No disjuncts are reachable - constraint set is unsatisfiable");
-        debug_logger.step(
+        debug_logger.step_with(
             "All Disjuncts Checked",
             "No disjuncts are reachable - constraint set is unsatisfiable",
-            &format!("Checked {} disjuncts, all UNREACHABLE", disjuncts.len()),
+            || format!("Checked {} disjuncts, all UNREACHABLE", disjuncts.len()),
         );
         false
     })
@@ -306,27 +353,29 @@ where
     P: Clone + Hash + Ord + Display + Debug,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Quantified Set {} Start", disjunct_id),
             "Extracting and reifying existential variables",
-            &format!("Quantified set: {}", quantified_set),
+            || format!("Quantified set: {}", quantified_set),
         );
 
         let (variables, basic_constraint_set) =
             quantified_set.extract_and_reify_existential_variables();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Quantified Set {} Variables", disjunct_id),
             "Existential variables extracted",
-            &format!(
-                "Variables: {:?}\nBasic constraint set: {}",
-                variables,
-                basic_constraint_set
-                    .iter()
-                    .map(|c| c.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Variables: {:?}\nBasic constraint set: {}",
+                    variables,
+                    basic_constraint_set
+                        .iter()
+                        .map(|c| c.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
         // Transform the Petri net from Petri<P> to Petri<Either<usize, P>>
@@ -398,10 +447,10 @@ where
         let zero_variables = super::presburger::Constraint::extract_zero_variables(&constraints);
         let zero_variables_set: HashSet<P> = zero_variables.into_iter().collect();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Zero Variables {}", disjunct_id),
             "Extracted zero variables from constraints",
-            &format!("Zero variables: {:?}", zero_variables_set),
+            || format!("Zero variables: {:?}", zero_variables_set),
         );
 
         // Get all places in the Petri net
@@ -413,17 +462,19 @@ where
             .filter(|place| !zero_variables_set.contains(place))
             .collect();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Nonzero Places {}", disjunct_id),
             "Determined nonzero places for bidirectional filtering",
-            &format!(
-                "Nonzero places: [{}]",
-                nonzero_places
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Nonzero places: [{}]",
+                    nonzero_places
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
         let (removed_forward, removed_backward) =
@@ -499,6 +550,10 @@ where
         match result.outcome {
             crate::smpt::SmptVerificationOutcome::Reachable { .. } => true, // Reachable means not serializable
             crate::smpt::SmptVerificationOutcome::Unreachable { .. } => false, // Unreachable means serializable
+            crate::smpt::SmptVerificationOutcome::Error { .. } if crate::parallel::is_cancelled() => {
+                // A sibling disjunct already decided the result; this one is discarded
+                false
+            }
             crate::smpt::SmptVerificationOutcome::Error { message } => {
                 eprintln!(
                     "CRITICAL ERROR: SMPT verification failed in disjunct {}: {}",
@@ -531,7 +586,7 @@ mod tests {
         petri.add_transition(vec!["C"], vec!["F"]); // t4: C -> F (reachable)
 
         // Before pruning: 5 transitions
-        assert_eq!(petri.get_transitions().len(), 5);
+        assert_eq!(petri.num_transitions(), 5);
 
         // Create constraints: A = 0, C = 0 (so B and F are nonzero)
         let constraints = vec![
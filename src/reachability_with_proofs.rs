@@ -5,13 +5,12 @@ use crate::petri::*;
 use crate::proof_parser::ProofInvariant;
 use crate::semilinear::*;
 use crate::size_logger::{PetriNetSize, log_petri_size_csv};
-use crate::spresburger::SPresburgerSet;
+use crate::spresburger::{SPresburgerExpr, SPresburgerSet};
 use colored::*;
 use either::{Either, Left, Right};
 use std::fmt::{Debug, Display};
 use std::hash::Hash;
 use std::path::Path;
-use std::sync::Mutex;
 
 /// Decision enum for reachability analysis results with proof/trace support
 #[derive(Debug, Clone, serde::Serialize, serde::Deserialize)]
@@ -21,25 +20,20 @@ pub enum Decision<P: Eq + Hash> {
     Timeout { message: String },
 }
 
-/// Global debug logger for reachability analysis
-static DEBUG_LOGGER: Mutex<Option<DebugLogger>> = Mutex::new(None);
-
-/// Initialize the global debug logger
-pub fn init_debug_logger(program_name: String, program_content: String) {
-    let logger = DebugLogger::new(program_name, program_content);
-    *DEBUG_LOGGER.lock().unwrap() = Some(logger);
+/// Initialize the debug logger; shared with `reachability`, so that SMPT calls and the
+/// proof steps end up in the same report
+pub fn init_debug_logger(
+    program_name: String,
+    out_dir: &str,
+    program_content: impl FnOnce() -> String,
+) {
+    crate::reachability::init_debug_logger(program_name, out_dir, program_content);
 }
 
-/// Get a reference to the global debug logger, or create a default one if not initialized
+/// Get the debug logger of the current task, falling back to the global one (see
+/// `reachability::get_debug_logger`)
 pub fn get_debug_logger() -> DebugLogger {
-    let mut guard = DEBUG_LOGGER.lock().unwrap();
-    if guard.is_none() {
-        *guard = Some(DebugLogger::new(
-            "default".to_string(),
-            "No program content".to_string(),
-        ));
-    }
-    guard.as_ref().unwrap().clone()
+    crate::reachability::get_debug_logger()
 }
 
 /// Execute a closure with the debug logger
@@ -59,8 +53,8 @@ pub fn is_petri_reachability_set_subset_of_semilinear<P, Q>(
     out_dir: &str,
 ) -> Decision<Either<P, Q>>
 where
-    P: Clone + Hash + Ord + Display + Debug,
-    Q: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+    Q: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     is_petri_reachability_set_subset_of_semilinear_new(
         petri,
@@ -87,32 +81,53 @@ pub fn is_petri_reachability_set_subset_of_semilinear_new<P, Q>(
     out_dir: &str,
 ) -> Decision<Either<P, Q>>
 where
-    P: Clone + Hash + Ord + Display + Debug,
-    Q: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+    Q: Clone + Hash + Ord + Display + Debug + Send + Sync,
+{
+    is_petri_reachability_set_subset_of_spresburger(
+        petri,
+        places_that_must_be_zero,
+        SPresburgerSet::from_semilinear(semilinear),
+        out_dir,
+    )
+}
+
+/// Same as `is_petri_reachability_set_subset_of_semilinear_new`, for a target set that may
+/// already be in Presburger form (e.g. when a Kleene star exceeded the semilinear budget).
+pub fn is_petri_reachability_set_subset_of_spresburger<P, Q>(
+    petri: Petri<Either<P, Q>>,
+    places_that_must_be_zero: &[P],
+    q_spresburger: SPresburgerSet<Q>,
+    out_dir: &str,
+) -> Decision<Either<P, Q>>
+where
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+    Q: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             "Reachability Analysis Start",
             "Starting new SPresburgerSet-based reachability analysis",
-            &format!(
-                "Petri net places: [{}]\nPlaces that must be zero: [{}]\nSemilinear set: {}",
-                petri
-                    .get_places()
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", "),
-                places_that_must_be_zero
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", "),
-                semilinear
-            ),
+            || {
+                format!(
+                    "Petri net places: [{}]\nPlaces that must be zero: [{}]\nTarget set: {}",
+                    petri
+                        .get_places()
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", "),
+                    places_that_must_be_zero
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", "),
+                    q_spresburger
+                )
+            },
         );
 
-        // Step 1: Convert semilinear set to SPresburgerSet and embed it in Either<P,Q> domain
-        let q_spresburger = SPresburgerSet::from_semilinear(semilinear);
+        // Step 1: The target set is embedded in the Either<P,Q> domain below
 
         // Step 2: Create universe over places that can vary (filter out places_that_must_be_zero)
         // Since places_that_must_be_zero are constrained to 0, they don't participate in the analysis
@@ -128,12 +143,10 @@ where
             })
             .collect();
 
-        let varying_universe = SPresburgerSet::universe(places_that_can_vary);
-        debug_logger.step(
-            "Varying Universe",
-            "Varying universe",
-            &format!("Varying universe: {}", varying_universe),
-        );
+        let varying_universe = SPresburgerExpr::universe(places_that_can_vary);
+        debug_logger.step_with("Varying Universe", "Varying universe", || {
+            describe_expr("Varying universe", &varying_universe)
+        });
 
         let response_places = petri
             .get_places()
@@ -144,38 +157,35 @@ where
             })
             .collect::<Vec<_>>();
 
-        let response_universe = SPresburgerSet::universe(response_places);
-        debug_logger.step(
-            "Response Universe",
-            "Response universe",
-            &format!("Response universe: {}", response_universe),
-        );
+        let response_universe = SPresburgerExpr::universe(response_places);
+        debug_logger.step_with("Response Universe", "Response universe", || {
+            describe_expr("Response universe", &response_universe)
+        });
 
         // Step 3: Compute complement: universe - embedded_semilinear
-        let complement = response_universe.difference(q_spresburger);
-        debug_logger.step(
+        // (deferred until the disjuncts are extracted, see `SPresburgerExpr`)
+        let complement = response_universe.difference(SPresburgerExpr::Set(q_spresburger));
+        debug_logger.step_with(
             "Compute Complement",
             "Computing complement (universe - embedded_semilinear)",
-            &format!("Complement: {}", complement),
+            || describe_expr("Complement", &complement),
         );
 
         let complement_embedded = complement.rename(|q| Right(q));
-        debug_logger.step(
+        debug_logger.step_with(
             "Complement Embedded",
             "Complement embedded in Either<P,Q> domain",
-            &format!("Complement embedded: {}", complement_embedded),
+            || describe_expr("Complement embedded", &complement_embedded),
         );
 
         let end_result_set = varying_universe.times(complement_embedded);
-        debug_logger.step(
-            "End Result Set",
-            "End result set",
-            &format!("End result set: {}", end_result_set),
-        );
+        debug_logger.step_with("End Result Set", "End result set", || {
+            describe_expr("End result set", &end_result_set)
+        });
 
         // Step 4: Check if this constraint set is reachable
         // Note: we've effectively incorporated the zero constraints by filtering the universe
-        let can_reach_decision = can_reach_presburger(petri, end_result_set, out_dir);
+        let can_reach_decision = can_reach_presburger_expr(petri, end_result_set, out_dir);
 
         // IMPORTANT: Decision variants are based on the TYPE of evidence, not the answer:
         // - If complement IS reachable: subset property FAILS, we have a counterexample trace → Decision::CounterExample
@@ -184,20 +194,20 @@ where
             Decision::CounterExample { trace } => {
                 // Complement is reachable, so subset property does NOT hold
                 // We have a trace showing non-serializability
-                debug_logger.step(
+                debug_logger.step_with(
                     "Final Result",
                     "Subset property FAILS - NOT serializable",
-                    &format!("Found counterexample trace: {:?}", trace),
+                    || format!("Found counterexample trace: {:?}", trace),
                 );
                 Decision::CounterExample { trace }
             }
             Decision::Proof { proof } => {
                 // Complement is unreachable, so subset property HOLDS
                 // We have a proof of serializability
-                debug_logger.step(
+                debug_logger.step_with(
                     "Final Result",
                     "Subset property HOLDS - IS serializable",
-                    &format!("Have proof certificate: {}", proof.is_some()),
+                    || format!("Have proof certificate: {}", proof.is_some()),
                 );
                 Decision::Proof { proof }
             }
@@ -214,6 +224,19 @@ where
     })
 }
 
+/// `label: expr` for the debug report. Deferred expressions are shown as such rather than
+/// evaluated, which would repeat their ISL work (and count it against `--isl-max-ops`);
+/// the evaluated set is logged at "Domain Expanded".
+fn describe_expr<T>(label: &str, expr: &SPresburgerExpr<T>) -> String
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash + Display,
+{
+    match expr {
+        SPresburgerExpr::Set(set) => format!("{}: {}", label, set),
+        deferred => format!("{} (deferred expression): {}", label, deferred),
+    }
+}
+
 /// Checks if a Petri net can reach any state satisfying the given SPresburgerSet constraints.
 ///
 /// APPROACH: Convert SPresburgerSet to disjunctive normal form and check each disjunct.
@@ -221,100 +244,156 @@ where
 /// The Petri net can reach the SPresburgerSet if it can reach ANY of the disjuncts.
 pub fn can_reach_presburger<P>(
     petri: Petri<P>,
-    mut presburger: SPresburgerSet<P>,
+    presburger: SPresburgerSet<P>,
     out_dir: &str,
 ) -> Decision<P>
 where
-    P: Clone + Hash + Ord + Display + Debug,
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
+{
+    can_reach_presburger_expr(petri, SPresburgerExpr::Set(presburger), out_dir)
+}
+
+/// `can_reach_presburger` for a set that is evaluated with the domain expansion
+pub fn can_reach_presburger_expr<P>(
+    petri: Petri<P>,
+    presburger: SPresburgerExpr<P>,
+    out_dir: &str,
+) -> Decision<P>
+where
+    P: Clone + Hash + Ord + Display + Debug + Send + Sync,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             "Presburger Reachability Start",
             "Expanding domain and converting to disjunctive normal form",
-            &format!("SPresburgerSet to be checked: {}", presburger),
+            || describe_expr("SPresburgerSet to be checked", &presburger),
         );
 
         // First step: Expand the domain of the presburger set to include all places in the Petri net
         let all_petri_places = petri.get_places();
-        debug_logger.step(
+        debug_logger.step_with(
             "Domain Expansion",
             "Expanding presburger set domain to match Petri net",
-            &format!(
-                "Petri net places: [{}]",
-                all_petri_places
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Petri net places: [{}]",
+                    all_petri_places
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
-        presburger = presburger.expand_domain(all_petri_places);
-        debug_logger.step(
-            "Domain Expanded",
-            "Presburger set domain expanded",
-            &format!("Expanded presburger set: {}", presburger),
-        );
+        let mut presburger = presburger.expand_domain(all_petri_places).evaluate();
+        debug_logger.step_with("Domain Expanded", "Presburger set domain expanded", || {
+            format!("Expanded presburger set: {}", presburger)
+        });
 
         // Convert SPresburgerSet to disjunctive normal form (list of quantified sets)
         let disjuncts = presburger.extract_constraint_disjuncts();
 
-        debug_logger.step(
+        debug_logger.step_with(
             "Disjunct Conversion",
             "SPresburgerSet converted to disjuncts",
-            &format!(
-                "Number of disjuncts: {}\nDisjuncts: {}",
-                disjuncts.len(),
-                disjuncts
-                    .iter()
-                    .map(|d| d.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Number of disjuncts: {}\nDisjuncts: {}",
+                    disjuncts.len(),
+                    disjuncts
+                        .iter()
+                        .map(|d| d.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
-        // Check if ANY disjunct is reachable, collecting proofs along the way
+        // Check if ANY disjunct is reachable, collecting proofs along the way.
+        // Disjuncts are independent, so with --jobs they run on a worker pool. Each one
+        // logs into its own logger and stats, which are merged below in disjunct order.
+        let initial_places = petri.num_places();
+        let initial_transitions = petri.num_transitions();
+
+        let outcomes: Vec<_> = if crate::smpt::smpt_multi_enabled() && disjuncts.len() > 1 {
+            // One SMPT run for all of them; stats go straight to the main collector
+            can_reach_disjuncts_together(&petri, &disjuncts, out_dir)
+                .into_iter()
+                .map(|decision| (decision, Vec::new(), None))
+                .collect()
+        } else {
+            crate::parallel::run_until_decisive(
+                &disjuncts,
+                crate::parallel::jobs(),
+                |i, quantified_set| {
+                    let _span = crate::trace::span_with("disjunct", || i.to_string());
+                    let task_logger = DebugLogger::new(format!("disjunct {}", i), String::new());
+                    let (decision, stats) =
+                        crate::debug_report::with_task_logger(&task_logger, || {
+                            crate::stats::collect_disjunct_stats(|| {
+                                task_logger.log_disjunct_start(i, quantified_set);
+                                println!("Checking disjunct {}: {}", i, quantified_set);
+
+                                // Start disjunct stats collection
+                                crate::stats::start_disjunct_analysis(
+                                    i,
+                                    initial_places,
+                                    initial_transitions,
+                                );
+
+                                can_reach_quantified_set(
+                                    petri.clone(),
+                                    quantified_set.clone(),
+                                    out_dir,
+                                    i,
+                                )
+                            })
+                        });
+                    (decision, stats, Some(task_logger))
+                },
+                |(decision, _, _)| !matches!(decision, Decision::Proof { .. }),
+            )
+        };
+
         let mut disjunct_proofs = Vec::new();
 
-        for (i, quantified_set) in disjuncts.iter().enumerate() {
-            debug_logger.log_disjunct_start(i, quantified_set);
-            println!("Checking disjunct {}: {}", i, quantified_set);
-            
-            // Record initial petri net size for this disjunct
-            let initial_places = petri.get_places().len();
-            let initial_transitions = petri.get_transitions().len();
-            
-            // Start disjunct stats collection
-            crate::stats::start_disjunct_analysis(i, initial_places, initial_transitions);
+        for (i, (decision, stats, task_logger)) in outcomes.into_iter().enumerate() {
+            if let Some(task_logger) = task_logger {
+                debug_logger.absorb(&task_logger);
+            }
+            for disjunct_stats in stats {
+                crate::stats::add_disjunct_stats(disjunct_stats);
+            }
 
-            match can_reach_quantified_set(petri.clone(), quantified_set.clone(), out_dir, i) {
+            match decision {
                 Decision::CounterExample { trace } => {
                     println!(
                         "Disjunct {} is reachable - constraint set is satisfiable",
                         i
                     );
-                    debug_logger.step(
+                    debug_logger.step_with(
                         &format!("Disjunct {} Result", i),
                         "Disjunct is REACHABLE - constraint set is satisfiable",
-                        &format!("Disjunct {}: REACHABLE", i),
+                        || format!("Disjunct {}: REACHABLE", i),
                     );
                     return Decision::CounterExample { trace };
                 }
                 Decision::Proof { proof } => {
-                    debug_logger.step(
+                    debug_logger.step_with(
                         &format!("Disjunct {} Result", i),
                         "Disjunct is UNREACHABLE",
-                        &format!("Disjunct {}: UNREACHABLE", i),
+                        || format!("Disjunct {}: UNREACHABLE", i),
                     );
                     if let Some(p) = proof {
                         disjunct_proofs.push(p);
                     }
                 }
                 Decision::Timeout { message } => {
-                    debug_logger.step(
+                    debug_logger.step_with(
                         &format!("Disjunct {} Result", i),
                         "Analysis TIMED OUT",
-                        &format!("Disjunct {}: TIMEOUT - {}", i, message),
+                        || format!("Disjunct {}: TIMEOUT - {}", i, message),
                     );
                     return Decision::Timeout { message };
                 }
@@ -322,10 +401,10 @@ where
         }
 
         println!("No disjuncts are reachable - constraint set is unsatisfiable");
-        debug_logger.step(
+        debug_logger.step_with(
             "All Disjuncts Checked",
             "No disjuncts are reachable - constraint set is unsatisfiable",
-            &format!("Checked {} disjuncts, all UNREACHABLE", disjuncts.len()),
+            || format!("Checked {} disjuncts, all UNREACHABLE", disjuncts.len()),
         );
 
         // Combine all disjunct proofs by ANDing them together
@@ -370,10 +449,10 @@ where
     P: Clone + Hash + Ord + Display + Debug,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Quantified Set {} Start", disjunct_id),
             "Extracting and reifying existential variables",
-            &format!("Quantified set: {}", quantified_set),
+            || format!("Quantified set: {}", quantified_set),
         );
 
         let (existential_places, basic_constraint_set) =
@@ -388,18 +467,20 @@ where
             })
             .collect();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Quantified Set {} Variables", disjunct_id),
             "Existential variables extracted",
-            &format!(
-                "Variables: {:?}\nBasic constraint set: {}",
-                existential_indices,
-                basic_constraint_set
-                    .iter()
-                    .map(|c| c.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Variables: {:?}\nBasic constraint set: {}",
+                    existential_indices,
+                    basic_constraint_set
+                        .iter()
+                        .map(|c| c.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
         // Transform the Petri net from Petri<P> to Petri<Either<usize, P>>
@@ -437,56 +518,254 @@ where
         );
 
         // Handle existential quantification for proofs and traces
-        match result {
-            Decision::CounterExample { trace } => {
-                // Transform trace from Either<usize, P> to P by filtering out existential places
-                let transformed_trace: Vec<(Vec<P>, Vec<P>)> = trace
-                    .into_iter()
-                    .map(|(inputs, outputs)| {
-                        let transformed_inputs: Vec<P> = inputs
-                            .into_iter()
-                            .filter_map(|place| match place {
-                                Either::Left(_) => None, // Skip existential places
-                                Either::Right(p) => Some(p),
-                            })
-                            .collect();
-                        let transformed_outputs: Vec<P> = outputs
-                            .into_iter()
-                            .filter_map(|place| match place {
-                                Either::Left(_) => None, // Skip existential places
-                                Either::Right(p) => Some(p),
-                            })
-                            .collect();
-                        (transformed_inputs, transformed_outputs)
-                    })
-                    .collect();
-                Decision::CounterExample {
-                    trace: transformed_trace,
-                }
-            }
-            Decision::Proof { proof } => {
-                // If we have a proof, we need to existentially quantify and project
-                let final_proof = proof.map(|p| {
-                    use crate::proofinvariant_to_presburger::{
-                        existentially_quantify_keep_either, project_proof_from_either,
-                    };
+        project_existential_decision(result, &existential_indices)
+    })
+}
 
-                    // First quantify over the existential variables (indices)
-                    let quantified = existentially_quantify_keep_either(p, &existential_indices);
+/// Check all disjuncts of `can_reach_presburger` on one net with one SMPT run
+/// (`--smpt-multi`), returning their decisions in order up to the first decisive one.
+///
+/// The net gets the existential places of every disjunct; the other disjuncts' places
+/// are unconstrained in each query. It is pruned once, towards the places any disjunct
+/// needs nonzero, and the proofs are translated back through the same eliminations and
+/// quantified over all existential places, which any of them may mention.
+fn can_reach_disjuncts_together<P>(
+    petri: &Petri<P>,
+    disjuncts: &[super::presburger::QuantifiedSet<P>],
+    out_dir: &str,
+) -> Vec<Decision<P>>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    with_debug_logger(|debug_logger| {
+        let mut existential_indices = Vec::new();
+        let mut queries = Vec::new();
+        for (i, quantified_set) in disjuncts.iter().enumerate() {
+            debug_logger.log_disjunct_start(i, quantified_set);
+            println!("Checking disjunct {}: {}", i, quantified_set);
 
-                    // Then project from Either<usize, P> to P
-                    project_proof_from_either(quantified)
+            let (existential_places, constraints) =
+                quantified_set.extract_and_reify_existential_variables();
+            existential_indices.extend(existential_places.iter().filter_map(|place| match place {
+                Either::Left(idx) => Some(*idx),
+                Either::Right(_) => None,
+            }));
+            queries.push(constraints);
+        }
+        existential_indices.sort();
+        existential_indices.dedup();
+
+        let mut new_petri = petri.clone().rename(|p| Either::Right(p));
+        for idx in &existential_indices {
+            new_petri.add_existential_place(Either::Left(*idx));
+        }
+        debug_logger.log_petri_net(
+            "Transformed Petri Net (all disjuncts)",
+            "Petri net with the existential variables of every disjunct added",
+            &new_petri,
+        );
+
+        // Build mapping from sanitized names to Either<usize, P> for proof conversion
+        let mut name_to_place: HashMap<String, Either<usize, P>> = HashMap::default();
+        for place in new_petri.get_places() {
+            let sanitized_name = crate::utils::string::sanitize(&place.to_string());
+            name_to_place.insert(sanitized_name, place);
+        }
+
+        let csv_path = Path::new(out_dir).join("petri_size_stats.csv");
+        let program_name = Path::new(out_dir)
+            .file_name()
+            .unwrap()
+            .to_string_lossy()
+            .into_owned();
+        let pre_pruning_places = new_petri.num_places();
+        let pre_pruning_transitions = new_petri.num_transitions();
+
+        // Prune to a fixed point, keeping each round's removed places for the proofs
+        let mut rounds = Vec::new();
+        let mut iterations = 0;
+        if crate::reachability::optimize_enabled() {
+            // A place is a target unless every disjunct requires it to be zero
+            let mut zero_everywhere: Option<HashSet<Either<usize, P>>> = None;
+            for constraints in &queries {
+                let zero: HashSet<_> =
+                    super::presburger::Constraint::extract_zero_variables(constraints)
+                        .into_iter()
+                        .collect();
+                zero_everywhere = Some(match zero_everywhere {
+                    Some(previous) => previous.intersection(&zero).cloned().collect(),
+                    None => zero,
                 });
+            }
+            let zero_everywhere = zero_everywhere.unwrap_or_default();
+            let target_places: Vec<Either<usize, P>> = new_petri
+                .get_places()
+                .into_iter()
+                .filter(|place| !zero_everywhere.contains(place))
+                .collect();
+
+            let pruning = crate::trace::span("pruning");
+            loop {
+                iterations += 1;
+                let transitions_before = new_petri.num_transitions();
+                let initial_marking = new_petri.get_initial_marking();
+                let removed_forward = new_petri.filter_reachable(&initial_marking);
+                let removed_backward = new_petri.filter_backwards_reachable(&target_places);
+                if new_petri.num_transitions() == transitions_before {
+                    break;
+                }
+                rounds.push((removed_forward, removed_backward));
+                if iterations > 100 {
+                    eprintln!("WARNING: Pruning recursion exceeded 100 iterations, stopping");
+                    break;
+                }
+            }
+            drop(pruning);
+            debug_logger.step_with(
+                "Shared Pruning Results",
+                "Pruned the shared net towards the targets of all disjuncts",
+                || {
+                    format!(
+                        "Transitions: {} -> {} in {} rounds",
+                        pre_pruning_transitions,
+                        new_petri.num_transitions(),
+                        rounds.len()
+                    )
+                },
+            );
+        }
 
-                Decision::Proof { proof: final_proof }
+        // The net is pruned once for all disjuncts: its sizes are logged once, under the
+        // first disjunct, and its iterations counted there
+        for (stage, num_places, num_transitions) in [
+            ("pre_pruning", pre_pruning_places, pre_pruning_transitions),
+            (
+                "post_pruning",
+                new_petri.num_places(),
+                new_petri.num_transitions(),
+            ),
+        ] {
+            let size = PetriNetSize {
+                program_name: program_name.clone(),
+                disjunct_id: 0,
+                stage,
+                num_places,
+                num_transitions,
+            };
+            log_petri_size_csv(&csv_path, &size).expect("Failed to log Petri‐net size");
+        }
+        for i in 0..queries.len() {
+            crate::stats::start_disjunct_analysis(i, petri.num_places(), petri.num_transitions());
+            if queries.len() > 1 {
+                crate::stats::set_shared_pruning();
             }
-            Decision::Timeout { message } => {
-                Decision::Timeout { message }
+            if i == 0 {
+                for _ in 0..iterations {
+                    crate::stats::record_pruning_iteration();
+                }
             }
+            crate::stats::finalize_disjunct(new_petri.num_places(), new_petri.num_transitions());
         }
+
+        // Reduce towards the places any of the disjuncts mentions
+        let observed: HashSet<Either<usize, P>> = queries
+            .iter()
+            .flat_map(|constraints| constraint_places(constraints))
+            .collect();
+        let reduction = reduce_for_smpt(&mut new_petri, &observed, out_dir, 0);
+
+        let results = crate::smpt::can_reach_constraint_sets(&new_petri, &queries, out_dir);
+
+        results
+            .into_iter()
+            .map(|result| {
+                let decision = expand_reduced_decision(
+                    convert_smpt_result_to_decision(result, &name_to_place),
+                    reduction.as_ref(),
+                );
+                let decision = match decision {
+                    Decision::Proof { proof: Some(mut p) } => {
+                        use crate::proofinvariant_to_presburger::{
+                            eliminate_backward, eliminate_forward,
+                        };
+
+                        // Apply eliminations in REVERSE order of pruning
+                        for (removed_forward, removed_backward) in rounds.iter().rev() {
+                            if !removed_backward.is_empty() {
+                                p = eliminate_backward(&p, removed_backward);
+                            }
+                            if !removed_forward.is_empty() {
+                                p = eliminate_forward(&p, removed_forward);
+                            }
+                        }
+                        Decision::Proof { proof: Some(p) }
+                    }
+                    other => other,
+                };
+                project_existential_decision(decision, &existential_indices)
+            })
+            .collect()
     })
 }
 
+/// Drop the existential places from a decision on a net extended with them, quantifying
+/// them out of the proof
+fn project_existential_decision<P>(
+    decision: Decision<Either<usize, P>>,
+    existential_indices: &[usize],
+) -> Decision<P>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    match decision {
+        Decision::CounterExample { trace } => {
+            // Transform trace from Either<usize, P> to P by filtering out existential places
+            let transformed_trace: Vec<(Vec<P>, Vec<P>)> = trace
+                .into_iter()
+                .map(|(inputs, outputs)| {
+                    let transformed_inputs: Vec<P> = inputs
+                        .into_iter()
+                        .filter_map(|place| match place {
+                            Either::Left(_) => None, // Skip existential places
+                            Either::Right(p) => Some(p),
+                        })
+                        .collect();
+                    let transformed_outputs: Vec<P> = outputs
+                        .into_iter()
+                        .filter_map(|place| match place {
+                            Either::Left(_) => None, // Skip existential places
+                            Either::Right(p) => Some(p),
+                        })
+                        .collect();
+                    (transformed_inputs, transformed_outputs)
+                })
+                .collect();
+            Decision::CounterExample {
+                trace: transformed_trace,
+            }
+        }
+        Decision::Proof { proof } => {
+            // If we have a proof, we need to existentially quantify and project
+            let final_proof = proof.map(|p| {
+                use crate::proofinvariant_to_presburger::{
+                    existentially_quantify_keep_either, project_proof_from_either,
+                };
+
+                // First quantify over the existential variables (indices)
+                let quantified = existentially_quantify_keep_either(p, existential_indices);
+
+                // Then project from Either<usize, P> to P
+                project_proof_from_either(quantified)
+            });
+
+            Decision::Proof { proof: final_proof }
+        }
+        Decision::Timeout { message } => {
+            Decision::Timeout { message }
+        }
+    }
+}
+
 /// Reachability check with constraints using SMPT with pruning and debug logging
 pub fn can_reach_constraint_set_with_debug<P>(
     petri: Petri<P>,
@@ -545,8 +824,8 @@ where
             .into_owned(),
             disjunct_id: disjunct_id,
             stage: "pre_pruning",
-            num_places: petri.get_places().len(),
-            num_transitions: petri.get_transitions().len(),
+            num_places: petri.num_places(),
+            num_transitions: petri.num_transitions(),
         };
         log_petri_size_csv(&csv_path, &before).expect("Failed to log Petri‐net size (pre‐pruning)");
 
@@ -554,10 +833,10 @@ where
         let zero_variables = super::presburger::Constraint::extract_zero_variables(&constraints);
         let zero_variables_set: HashSet<P> = zero_variables.into_iter().collect();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Zero Variables {}", disjunct_id),
             "Extracted zero variables from constraints",
-            &format!("Zero variables: {:?}", zero_variables_set),
+            || format!("Zero variables: {:?}", zero_variables_set),
         );
 
         // Get all places in the Petri net
@@ -570,17 +849,19 @@ where
             .filter(|place| !zero_variables_set.contains(place))
             .collect();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Nonzero Places {}", disjunct_id),
             "Determined nonzero places for bidirectional filtering",
-            &format!(
-                "Nonzero places: [{}]",
-                nonzero_places
-                    .iter()
-                    .map(|p| p.to_string())
-                    .collect::<Vec<_>>()
-                    .join(", ")
-            ),
+            || {
+                format!(
+                    "Nonzero places: [{}]",
+                    nonzero_places
+                        .iter()
+                        .map(|p| p.to_string())
+                        .collect::<Vec<_>>()
+                        .join(", ")
+                )
+            },
         );
 
         // Check if optimization is enabled
@@ -616,6 +897,91 @@ where
     })
 }
 
+/// The places the constraints mention
+fn constraint_places<P: Clone + Hash + Eq>(
+    constraints: &[super::presburger::Constraint<P>],
+) -> HashSet<P> {
+    constraints
+        .iter()
+        .flat_map(|constraint| constraint.linear_combination().iter())
+        .map(|(_, place)| place.clone())
+        .collect()
+}
+
+/// Apply the structural reductions of `crate::reduction` to a pruned net before it goes
+/// to SMPT, logging its size afterwards under `disjunct_id`
+fn reduce_for_smpt<P>(
+    petri: &mut Petri<P>,
+    observed: &HashSet<P>,
+    out_dir: &str,
+    disjunct_id: usize,
+) -> Option<crate::reduction::Reduction<P>>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    if !crate::reduction::net_reduction_enabled() {
+        return None;
+    }
+    let transitions_before = petri.num_transitions();
+    let places_before = petri.num_places();
+    let reduction = {
+        let _span = crate::trace::span("net_reduction");
+        crate::reduction::reduce(petri, observed)
+    };
+
+    with_debug_logger(|debug_logger| {
+        debug_logger.step_with(
+            "Net Reduction",
+            "Applied structural reductions before SMPT",
+            || {
+                format!(
+                    "Places: {} -> {}\nTransitions: {} -> {}",
+                    places_before,
+                    petri.num_places(),
+                    transitions_before,
+                    petri.num_transitions()
+                )
+            },
+        );
+    });
+    let csv_path = Path::new(out_dir).join("petri_size_stats.csv");
+    let size = PetriNetSize {
+        program_name: Path::new(out_dir)
+            .file_name()
+            .unwrap()
+            .to_string_lossy()
+            .into_owned(),
+        disjunct_id,
+        stage: "post_reduction",
+        num_places: petri.num_places(),
+        num_transitions: petri.num_transitions(),
+    };
+    log_petri_size_csv(&csv_path, &size).expect("Failed to log Petri‐net size (post‐reduction)");
+    Some(reduction)
+}
+
+/// Turn a decision on a net reduced by `reduce_for_smpt` into one on the net before
+fn expand_reduced_decision<P>(
+    decision: Decision<P>,
+    reduction: Option<&crate::reduction::Reduction<P>>,
+) -> Decision<P>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let Some(reduction) = reduction else {
+        return decision;
+    };
+    match decision {
+        Decision::Proof { proof } => Decision::Proof {
+            proof: proof.map(|proof| reduction.translate_proof(proof)),
+        },
+        Decision::CounterExample { trace } => Decision::CounterExample {
+            trace: reduction.expand_trace(trace),
+        },
+        other => other,
+    }
+}
+
 /// Helper function to convert SMPT result to Decision with proof mapping
 fn convert_smpt_result_to_decision<P>(
     result: crate::smpt::SmptVerificationResult<P>,
@@ -642,6 +1008,10 @@ where
 
             Decision::Proof { proof }
         }
+        SmptVerificationOutcome::Error { message } if crate::parallel::is_cancelled() => {
+            // A sibling disjunct already decided the result; this one is discarded
+            Decision::Timeout { message }
+        }
         SmptVerificationOutcome::Error { message } => {
             eprintln!("SMPT verification error: {}", message);
             // Check if this is a timeout error
@@ -678,16 +1048,13 @@ where
     P: Clone + Hash + Ord + Display + Debug,
 {
     with_debug_logger(|debug_logger| {
-        debug_logger.step(
+        debug_logger.step_with(
             &format!(
                 "Recursive Iteration {} for Disjunct {}",
                 iteration, disjunct_id
             ),
             "Starting recursive pruning iteration",
-            &format!(
-                "Petri net has {} transitions",
-                petri.get_transitions().len()
-            ),
+            || format!("Petri net has {} transitions", petri.num_transitions()),
         );
 
         // Safety check to prevent infinite recursion
@@ -716,22 +1083,24 @@ where
         let initial_places = petri.get_initial_marking();
 
         // Track the number of transitions before pruning
-        let transitions_before = petri.get_transitions().len();
+        let transitions_before = petri.num_transitions();
 
         // Attempt one round of pruning
+        let pruning = crate::trace::span("pruning");
         let removed_forward = petri.filter_reachable(&initial_places);
         let removed_backward = petri.filter_backwards_reachable(target_places);
+        drop(pruning);
 
         // Track the number of transitions after pruning
-        let transitions_after = petri.get_transitions().len();
+        let transitions_after = petri.num_transitions();
         
         // Record pruning iteration
         crate::stats::record_pruning_iteration();
 
-        debug_logger.step(
+        debug_logger.step_with(
             &format!("Pruning Results - Iteration {}", iteration),
             "Completed one round of bidirectional pruning",
-            &format!(
+            || format!(
                 "Transitions: {} -> {} (removed {})\nRemoved {} places forward, {} places backward",
                 transitions_before,
                 transitions_after,
@@ -775,13 +1144,15 @@ where
         // Check if we're at base case (no transitions were removed)
         if transitions_before == transitions_after {
             // BASE CASE: No more pruning possible, run SMPT
-            debug_logger.step(
+            debug_logger.step_with(
                 &format!("Base Case Reached - Iteration {}", iteration),
                 "No transitions removed (fixed point reached), running SMPT",
-                &format!(
-                    "Final Petri net has {} transitions",
-                    petri.get_transitions().len()
-                ),
+                || {
+                    format!(
+                        "Final Petri net has {} transitions",
+                        petri.num_transitions()
+                    )
+                },
             );
 
             debug_logger.log_petri_net(
@@ -799,8 +1170,8 @@ where
                 .into_owned(),
                 disjunct_id: disjunct_id,
                 stage: "post_pruning",
-                num_places: petri.get_places().len(),
-                num_transitions: petri.get_transitions().len(),
+                num_places: petri.num_places(),
+                num_transitions: petri.num_transitions(),
             };
 
             let csv_path = Path::new(out_dir).join("petri_size_stats.csv");
@@ -809,10 +1180,14 @@ where
             // Finalize disjunct stats
             crate::stats::finalize_disjunct(after.num_places, after.num_transitions);
 
+            let observed = constraint_places(&constraints);
+            let reduction = reduce_for_smpt(&mut petri, &observed, out_dir, disjunct_id);
+
             let result =
                 crate::smpt::can_reach_constraint_set(petri, constraints, out_dir, disjunct_id);
 
-            return convert_smpt_result_to_decision(result, &name_to_place);
+            let decision = convert_smpt_result_to_decision(result, &name_to_place);
+            return expand_reduced_decision(decision, reduction.as_ref());
         }
 
         // RECURSIVE CASE: Some pruning occurred
@@ -837,14 +1212,16 @@ where
             Decision::Proof { proof: Some(mut p) } => {
                 use crate::proofinvariant_to_presburger::{eliminate_backward, eliminate_forward};
 
-                debug_logger.step(
+                debug_logger.step_with(
                     &format!("Proof Translation - Iteration {}", iteration),
                     "Applying proof eliminations in reverse order",
-                    &format!(
-                        "Applying {} backward eliminations, {} forward eliminations",
-                        removed_backward.len(),
-                        removed_forward.len()
-                    ),
+                    || {
+                        format!(
+                            "Applying {} backward eliminations, {} forward eliminations",
+                            removed_backward.len(),
+                            removed_forward.len()
+                        )
+                    },
                 );
 
                 // Apply eliminations in REVERSE order of pruning
@@ -857,14 +1234,16 @@ where
                 Decision::Proof { proof: Some(p) }
             }
             Decision::CounterExample { trace } => {
-                debug_logger.step(
+                debug_logger.step_with(
                     &format!("Trace Translation - Iteration {}", iteration),
                     "Restoring removed transitions to trace",
-                    &format!(
-                        "Adding {} backward transitions, {} forward transitions back to trace",
-                        removed_backward.len(),
-                        removed_forward.len()
-                    ),
+                    || {
+                        format!(
+                            "Adding {} backward transitions, {} forward transitions back to trace",
+                            removed_backward.len(),
+                            removed_forward.len()
+                        )
+                    },
                 );
 
                 // For counterexamples, we need to add back the removed transitions
@@ -895,7 +1274,7 @@ mod tests {
         petri.add_transition(vec!["C"], vec!["F"]); // t4: C -> F (reachable)
 
         // Before pruning: 5 transitions
-        assert_eq!(petri.get_transitions().len(), 5);
+        assert_eq!(petri.num_transitions(), 5);
 
         // Create constraints: A = 0, C = 0 (so B and F are nonzero)
         let constraints = vec![
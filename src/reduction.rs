@@ -0,0 +1,495 @@
+//! Structural reductions of the nets handed to SMPT.
+//!
+//! Pruning (`Petri::filter_bidirectional_reachable` and friends) removes transitions that
+//! cannot matter; the reductions here shrink what is left while keeping the reachability
+//! of the query, for nets where yield-free code paths become long chains of transitions:
+//!
+//! - Duplicate transitions (the same inputs and outputs) are merged.
+//! - Places that no transition consumes and the query does not mention are dropped.
+//! - Post-agglomeration: a place `p` the query does not mention, initially empty, whose
+//!   only consumer `t` takes just `p` and produces no place the query mentions, is fused
+//!   away. Every producer of `p` produces the outputs of `t` instead, and `t` goes.
+//!   Tokens in `p` can always move on through `t` without changing whether the query
+//!   holds, so the reduced net reaches the query exactly when the original does.
+//!
+//! A `Reduction` remembers the steps, to turn a trace of the reduced net back into one of
+//! the original net (each reduced transition stands for a firing sequence of original
+//! ones) and a proof for the reduced net into one for the original: an invariant `I` of
+//! the reduced net becomes `I(M + M(p)·outputs(t))`, firing the pending `t`s of
+//! every fused place, which is again inductive and excludes the query.
+//!
+//! `--without-net-reduction` turns the reductions off.
+
+use crate::deterministic_map::{HashMap, HashSet};
+use crate::petri::Petri;
+use crate::presburger::Variable;
+use crate::proof_parser::{AffineExpr, Constraint, Formula, ProofInvariant};
+use std::fmt::Display;
+use std::hash::Hash;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+static NET_REDUCTION: AtomicBool = AtomicBool::new(true);
+
+pub fn set_net_reduction(on: bool) {
+    NET_REDUCTION.store(on, Ordering::SeqCst);
+}
+
+pub fn net_reduction_enabled() -> bool {
+    NET_REDUCTION.load(Ordering::SeqCst)
+}
+
+type Transition<P> = (Vec<P>, Vec<P>);
+
+/// One reduction step, in the order they were applied
+#[derive(Debug, Clone, PartialEq, Eq)]
+enum Step<P> {
+    /// A place that nothing consumes was dropped
+    Dropped(P),
+    /// A place was fused into the producers of its only consumer, which had these outputs
+    Agglomerated(P, Vec<P>),
+}
+
+/// How a net was reduced, to translate results on the reduced net back
+#[derive(Debug, Clone)]
+pub struct Reduction<P> {
+    steps: Vec<Step<P>>,
+    /// The original firing sequence behind each transition of the reduced net, keyed by
+    /// its sorted inputs and outputs
+    expansions: HashMap<Transition<P>, Vec<Transition<P>>>,
+}
+
+impl<P> Reduction<P>
+where
+    P: Clone + Hash + Ord + Display,
+{
+    /// The trace of the original net that a trace of the reduced net stands for
+    pub fn expand_trace(&self, trace: Vec<Transition<P>>) -> Vec<Transition<P>> {
+        trace
+            .into_iter()
+            .flat_map(
+                |transition| match self.expansions.get(&sorted(&transition)) {
+                    Some(expansion) => expansion.clone(),
+                    None => vec![transition],
+                },
+            )
+            .collect()
+    }
+
+    /// The invariant of the original net that an invariant of the reduced net stands for
+    pub fn translate_proof(&self, proof: ProofInvariant<P>) -> ProofInvariant<P> {
+        let ProofInvariant {
+            mut variables,
+            mut formula,
+        } = proof;
+        for step in self.steps.iter().rev() {
+            match step {
+                Step::Dropped(place) => {
+                    if !variables.contains(place) {
+                        variables.push(place.clone());
+                    }
+                }
+                Step::Agglomerated(place, outputs) => {
+                    // q ↦ q + (number of times t produces q)·p, for every output q of t
+                    let mut shifts: HashMap<P, i64> = HashMap::default();
+                    for output in outputs {
+                        *shifts.entry(output.clone()).or_insert(0) += 1;
+                    }
+                    formula = shift_places(formula, &shifts, place);
+                    if !variables.contains(place) {
+                        variables.push(place.clone());
+                    }
+                    for output in outputs {
+                        if !variables.contains(output) {
+                            variables.push(output.clone());
+                        }
+                    }
+                }
+            }
+        }
+        ProofInvariant::new(variables, formula)
+    }
+}
+
+fn sorted<P: Clone + Ord>((inputs, outputs): &Transition<P>) -> Transition<P> {
+    let mut inputs = inputs.clone();
+    let mut outputs = outputs.clone();
+    inputs.sort();
+    outputs.sort();
+    (inputs, outputs)
+}
+
+/// Substitute `q + shift·p` for every place `q` with a shift
+fn shift_places<P>(formula: Formula<P>, shifts: &HashMap<P, i64>, p: &P) -> Formula<P>
+where
+    P: Clone + Hash + Eq,
+{
+    match formula {
+        Formula::Constraint(Constraint { expr, op }) => {
+            let mut terms: HashMap<Variable<P>, i64> = HashMap::default();
+            for (var, coeff) in expr.terms() {
+                *terms.entry(var.clone()).or_insert(0) += coeff;
+                if let Variable::Var(q) = var {
+                    if let Some(shift) = shifts.get(q) {
+                        *terms.entry(Variable::Var(p.clone())).or_insert(0) += coeff * shift;
+                    }
+                }
+            }
+            terms.retain(|_, coeff| *coeff != 0);
+            Formula::Constraint(Constraint::new(
+                AffineExpr::from_terms(terms, expr.get_constant()),
+                op,
+            ))
+        }
+        Formula::And(formulas) => Formula::And(
+            formulas
+                .into_iter()
+                .map(|f| shift_places(f, shifts, p))
+                .collect(),
+        ),
+        Formula::Or(formulas) => Formula::Or(
+            formulas
+                .into_iter()
+                .map(|f| shift_places(f, shifts, p))
+                .collect(),
+        ),
+        Formula::Exists(idx, body) => {
+            Formula::Exists(idx, Box::new(shift_places(*body, shifts, p)))
+        }
+        Formula::Forall(idx, body) => {
+            Formula::Forall(idx, Box::new(shift_places(*body, shifts, p)))
+        }
+    }
+}
+
+/// Reduce `petri` in place, keeping the reachability of any query over `observed`
+pub fn reduce<P>(petri: &mut Petri<P>, observed: &HashSet<P>) -> Reduction<P>
+where
+    P: Clone + Hash + Ord + Display,
+{
+    let mut reducer = Reducer::new(petri, observed);
+    reducer.run();
+
+    let mut reduced = Petri::new(reducer.initial);
+    let mut expansions = HashMap::default();
+    for (transition, origin) in reducer.transitions.into_iter().flatten() {
+        reduced.add_transition(transition.0.clone(), transition.1.clone());
+        expansions.insert(transition, origin);
+    }
+    *petri = reduced;
+    Reduction {
+        steps: reducer.steps,
+        expansions,
+    }
+}
+
+/// The net being reduced: its transitions in their original order (`None` once removed),
+/// with the original firing sequence of each, indexed by the places they touch.
+///
+/// A worklist holds the places whose consumers or producers changed, so each step only
+/// looks at the transitions it affects.
+struct Reducer<'a, P> {
+    observed: &'a HashSet<P>,
+    initial: Vec<P>,
+    transitions: Vec<Option<(Transition<P>, Vec<Transition<P>>)>>,
+    /// The live transition with each sorted inputs and outputs, to merge duplicates
+    by_transition: HashMap<Transition<P>, usize>,
+    /// Number of input arcs from each place
+    consumed: HashMap<P, usize>,
+    consumers: HashMap<P, HashSet<usize>>,
+    producers: HashMap<P, HashSet<usize>>,
+    pending: Vec<P>,
+    steps: Vec<Step<P>>,
+}
+
+impl<'a, P> Reducer<'a, P>
+where
+    P: Clone + Hash + Ord,
+{
+    fn new(petri: &Petri<P>, observed: &'a HashSet<P>) -> Self {
+        let mut reducer = Reducer {
+            observed,
+            initial: petri.get_initial_marking(),
+            transitions: Vec::new(),
+            by_transition: HashMap::default(),
+            consumed: HashMap::default(),
+            consumers: HashMap::default(),
+            producers: HashMap::default(),
+            pending: Vec::new(),
+            steps: Vec::new(),
+        };
+        // Duplicates keep their first occurrence; identities cannot change anything
+        for transition in petri.get_transitions() {
+            let key = sorted(&transition);
+            if key.0 == key.1 || reducer.by_transition.contains_key(&key) {
+                continue;
+            }
+            reducer.transitions.push(Some((key, vec![transition])));
+            reducer.link(reducer.transitions.len() - 1);
+        }
+
+        let mut places: Vec<P> = reducer.initial.clone();
+        places.extend(reducer.consumers.keys().cloned());
+        places.extend(reducer.producers.keys().cloned());
+        places.sort();
+        places.dedup();
+        reducer.pending = places;
+        reducer
+    }
+
+    fn transition(&self, i: usize) -> &Transition<P> {
+        &self.transitions[i].as_ref().expect("live transition").0
+    }
+
+    /// Add transition `i` to the indices
+    fn link(&mut self, i: usize) {
+        let (inputs, outputs) = &self.transitions[i].as_ref().expect("live transition").0;
+        self.by_transition
+            .insert((inputs.clone(), outputs.clone()), i);
+        for place in inputs {
+            *self.consumed.entry(place.clone()).or_insert(0) += 1;
+            self.consumers.entry(place.clone()).or_default().insert(i);
+        }
+        for place in outputs {
+            self.producers.entry(place.clone()).or_default().insert(i);
+        }
+    }
+
+    /// Remove transition `i` from the indices, queueing its places
+    fn unlink(&mut self, i: usize) {
+        let transition = &self.transitions[i].as_ref().expect("live transition").0;
+        if self.by_transition.get(transition) == Some(&i) {
+            self.by_transition.remove(transition);
+        }
+        let (inputs, outputs) = transition;
+        for place in inputs {
+            if let Some(count) = self.consumed.get_mut(place) {
+                *count -= 1;
+            }
+            if let Some(consumers) = self.consumers.get_mut(place) {
+                consumers.remove(&i);
+            }
+            self.pending.push(place.clone());
+        }
+        for place in outputs {
+            if let Some(producers) = self.producers.get_mut(place) {
+                producers.remove(&i);
+            }
+            self.pending.push(place.clone());
+        }
+    }
+
+    fn remove(&mut self, i: usize) -> (Transition<P>, Vec<Transition<P>>) {
+        self.unlink(i);
+        self.transitions[i].take().expect("live transition")
+    }
+
+    /// Change transition `i` with `f`, then merge it into an equal transition (the
+    /// earlier one stays) or drop it if it became an identity
+    fn update(&mut self, i: usize, f: impl FnOnce(&mut (Transition<P>, Vec<Transition<P>>))) {
+        self.unlink(i);
+        f(self.transitions[i].as_mut().expect("live transition"));
+        let transition = self.transition(i);
+        let identity = transition.0 == transition.1;
+        match self.by_transition.get(transition).copied() {
+            _ if identity => self.transitions[i] = None,
+            Some(j) if j < i => self.transitions[i] = None,
+            duplicate => {
+                if let Some(j) = duplicate {
+                    self.remove(j);
+                }
+                self.link(i);
+                let outputs = self.transition(i).1.clone();
+                self.pending.extend(outputs);
+            }
+        }
+    }
+
+    /// The producers of `place`, in net order
+    fn producers_of(&self, place: &P) -> Vec<usize> {
+        let mut producers: Vec<usize> = self
+            .producers
+            .get(place)
+            .into_iter()
+            .flatten()
+            .copied()
+            .collect();
+        producers.sort_unstable();
+        producers
+    }
+
+    fn run(&mut self) {
+        while let Some(place) = self.pending.pop() {
+            if self.droppable(&place) {
+                self.drop_place(place);
+            } else if let Some(t) = self.fusable(&place) {
+                self.fuse(place, t);
+            }
+        }
+    }
+
+    /// A place nothing consumes, that the query does not mention and the net still has
+    fn droppable(&self, place: &P) -> bool {
+        !self.observed.contains(place)
+            && self.consumed.get(place).copied().unwrap_or(0) == 0
+            && (self
+                .producers
+                .get(place)
+                .is_some_and(|producers| !producers.is_empty())
+                || self.initial.contains(place))
+    }
+
+    fn drop_place(&mut self, place: P) {
+        for i in self.producers_of(&place) {
+            self.update(i, |((_, outputs), _)| outputs.retain(|q| *q != place));
+        }
+        self.initial.retain(|q| *q != place);
+        self.steps.push(Step::Dropped(place));
+    }
+
+    /// The only consumer of `place`, if the place can be fused away through it
+    fn fusable(&self, place: &P) -> Option<usize> {
+        if self.observed.contains(place)
+            || self.consumed.get(place) != Some(&1)
+            || self.initial.contains(place)
+        {
+            return None;
+        }
+        let &t = self.consumers.get(place)?.iter().next()?;
+        let (inputs, outputs) = self.transition(t);
+        let fusable = inputs.len() == 1
+            && !outputs.contains(place)
+            && outputs.iter().all(|q| !self.observed.contains(q));
+        fusable.then_some(t)
+    }
+
+    /// Fuse `place` into its producers, which produce the outputs of its consumer `t`
+    fn fuse(&mut self, place: P, t: usize) {
+        let ((_, outputs), consumer_origin) = self.remove(t);
+        for i in self.producers_of(&place) {
+            self.update(i, |((_, producer_outputs), origin)| {
+                let k = producer_outputs.iter().filter(|&q| *q == place).count();
+                producer_outputs.retain(|q| *q != place);
+                for _ in 0..k {
+                    producer_outputs.extend(outputs.iter().cloned());
+                    origin.extend(consumer_origin.iter().cloned());
+                }
+                producer_outputs.sort();
+            });
+        }
+        self.steps.push(Step::Agglomerated(place, outputs));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::proof_parser::CompOp;
+
+    #[test]
+    fn test_reduce_chain() {
+        // A -> p1 -> p2 -> B with a duplicate first step and a side output nothing reads
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["p1"]);
+        petri.add_transition(vec!["A"], vec!["p1"]);
+        petri.add_transition(vec!["p1"], vec!["p2", "log"]);
+        petri.add_transition(vec!["p2"], vec!["B"]);
+
+        let observed: HashSet<&str> = ["A", "B"].into_iter().collect();
+        let reduction = reduce(&mut petri, &observed);
+
+        // p2 -> B produces the observed B, so p2 stays
+        assert_eq!(
+            petri.get_transitions(),
+            vec![(vec!["A"], vec!["p2"]), (vec!["p2"], vec!["B"])]
+        );
+
+        assert_eq!(
+            reduction.expand_trace(vec![(vec!["A"], vec!["p2"]), (vec!["p2"], vec!["B"])]),
+            vec![
+                (vec!["A"], vec!["p1"]),
+                (vec!["p1"], vec!["p2", "log"]),
+                (vec!["p2"], vec!["B"])
+            ]
+        );
+    }
+
+    #[test]
+    fn test_reduce_long_chain_and_merged_producers() {
+        // A -> p0 -> p1 -> ... -> p999 -> B
+        let places: Vec<String> = (0..1000).map(|i| format!("p{i}")).collect();
+        let mut petri = Petri::new(vec!["A".to_string()]);
+        petri.add_transition(vec!["A".to_string()], vec![places[0].clone()]);
+        for pair in places.windows(2) {
+            petri.add_transition(vec![pair[0].clone()], vec![pair[1].clone()]);
+        }
+        petri.add_transition(vec![places[999].clone()], vec!["B".to_string()]);
+
+        let observed: HashSet<String> = ["A", "B"].into_iter().map(String::from).collect();
+        let reduction = reduce(&mut petri, &observed);
+        let s = |x: &str| x.to_string();
+        assert_eq!(
+            petri.get_transitions(),
+            vec![
+                (vec![s("A")], vec![s("p999")]),
+                (vec![s("p999")], vec![s("B")])
+            ]
+        );
+        let expanded = reduction.expand_trace(vec![(vec![s("A")], vec![s("p999")])]);
+        assert_eq!(expanded.len(), 1000);
+
+        // A -> p -> r and A -> q -> r become the same transition, which is merged
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["p"]);
+        petri.add_transition(vec!["A"], vec!["q"]);
+        petri.add_transition(vec!["p"], vec!["r"]);
+        petri.add_transition(vec!["q"], vec!["r"]);
+        petri.add_transition(vec!["r"], vec!["B"]);
+        let observed: HashSet<&str> = ["A", "B"].into_iter().collect();
+        reduce(&mut petri, &observed);
+        assert_eq!(
+            petri.get_transitions(),
+            vec![(vec!["A"], vec!["r"]), (vec!["r"], vec!["B"])]
+        );
+    }
+
+    #[test]
+    fn test_translate_proof() {
+        // A -> p -> q q -> B: p is fused away, q stays as B is observed
+        let mut petri = Petri::new(vec!["A"]);
+        petri.add_transition(vec!["A"], vec!["p"]);
+        petri.add_transition(vec!["p"], vec!["q", "q"]);
+        petri.add_transition(vec!["q"], vec!["B"]);
+
+        let observed: HashSet<&str> = ["A", "B"].into_iter().collect();
+        let reduction = reduce(&mut petri, &observed);
+        assert_eq!(
+            petri.get_transitions(),
+            vec![(vec!["A"], vec!["q", "q"]), (vec!["q"], vec!["B"])]
+        );
+
+        // 2A + q + B = 2 on the reduced net becomes 2A + 2p + q + B = 2
+        let proof = ProofInvariant::new(
+            vec!["A", "B", "q"],
+            Formula::Constraint(Constraint::new(
+                AffineExpr::from_terms(
+                    [
+                        (Variable::Var("A"), 2),
+                        (Variable::Var("q"), 1),
+                        (Variable::Var("B"), 1),
+                    ],
+                    -2,
+                ),
+                CompOp::Eq,
+            )),
+        );
+        let translated = reduction.translate_proof(proof);
+        let Formula::Constraint(constraint) = &translated.formula else {
+            panic!("expected a constraint, got {:?}", translated.formula);
+        };
+        assert_eq!(constraint.expr.get_coeff(&Variable::Var("A")), 2);
+        assert_eq!(constraint.expr.get_coeff(&Variable::Var("p")), 2);
+        assert_eq!(constraint.expr.get_coeff(&Variable::Var("q")), 1);
+        assert_eq!(constraint.expr.get_constant(), -2);
+        assert!(translated.variables.contains(&"p"));
+    }
+}
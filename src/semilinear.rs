@@ -6,7 +6,7 @@ pub use std::hash::Hash;
 
 use crate::kleene::Kleene;
 
-use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
 
 pub static REMOVE_REDUNDANT: AtomicBool = AtomicBool::new(true);
 
@@ -20,6 +20,13 @@ pub fn set_generate_less(on: bool) {
     GENERATE_LESS.store(on, Ordering::SeqCst);
 }
 
+/// Maximum number of linear sets `star` may build before giving up (see `try_star`)
+pub static STAR_COMPONENT_BUDGET: AtomicUsize = AtomicUsize::new(4096);
+
+pub fn set_star_component_budget(budget: usize) {
+    STAR_COMPONENT_BUDGET.store(budget.max(1), Ordering::SeqCst);
+}
+
 /// A sparse vector in d-dimensional nonnegative integer space.
 /// Keys represent dimensions and values represent the value at that dimension.
 /// Dimensions not present in the HashMap are assumed to be 0.
@@ -149,13 +156,18 @@ impl<K: Eq + Hash + Clone + Ord> LinearSet<K> {
     /// Optimize the linear set by deduplicating period vectors, without changing its semantic
     /// meaning.
     pub fn dedup_periods(&mut self) {
+        self.dedup_periods_with(&mut MembershipCache::new());
+    }
+
+    /// `dedup_periods` with a shared membership cache
+    pub fn dedup_periods_with(&mut self, cache: &mut MembershipCache<K>) {
         // iteratively remove periods that are linear combinations of others
         'fixpoint: loop {
             // try to find an index i such that periods[i] is a linear combination of the other periods
             for i in 0..self.periods.len() {
                 let mut other_periods = self.periods.clone();
                 other_periods.remove(i);
-                if is_nonnegative_combination(&self.periods[i], &other_periods) {
+                if cache.is_nonnegative_combination(&self.periods[i], &other_periods) {
                     self.periods.remove(i);
                     continue 'fixpoint;
                 }
@@ -217,11 +229,16 @@ impl<K: Eq + Hash + Clone + Ord + std::fmt::Display> std::fmt::Display for Semil
 
 impl<K: Eq + Hash + Clone + Ord> SemilinearSet<K> {
     /// Create a new semilinear set from a list of LinearSet components.
-    pub fn new(mut components: Vec<LinearSet<K>>) -> Self {
+    pub fn new(components: Vec<LinearSet<K>>) -> Self {
+        Self::new_with(components, &mut MembershipCache::new())
+    }
+
+    /// `new` with a membership cache shared with other calls (see `try_star_within`)
+    fn new_with(mut components: Vec<LinearSet<K>>, cache: &mut MembershipCache<K>) -> Self {
         // Filter out duplicate period vectors
         if REMOVE_REDUNDANT.load(Ordering::SeqCst) {
             for lin in &mut components {
-                lin.dedup_periods();
+                lin.dedup_periods_with(cache);
             }
         }
 
@@ -230,7 +247,8 @@ impl<K: Eq + Hash + Clone + Ord> SemilinearSet<K> {
             'fixpoint: loop {
                 for i in 0..components.len() {
                     for j in i + 1..components.len() {
-                        if let Some(merged) = try_merge_linear_sets(&components[i], &components[j])
+                        if let Some(merged) =
+                            try_merge_linear_sets_with(&components[i], &components[j], cache)
                         {
                             components[i] = merged;
                             components.swap_remove(j);
@@ -307,80 +325,356 @@ impl<K: Eq + Hash + Clone + Ord> SemilinearSet<K> {
     }
 }
 
+impl<K: Eq + Hash + Clone + Ord> SemilinearSet<K> {
+    /// Kleene star, built incrementally within `STAR_COMPONENT_BUDGET` linear sets.
+    ///
+    /// Returns `Err(factors)` once the intermediate result exceeds the budget, where
+    /// `factors` is a list of small semilinear sets whose product (`times`) is the star,
+    /// so that a caller can finish the computation in another representation.
+    pub fn try_star(self) -> Result<Self, Vec<Self>> {
+        let budget = STAR_COMPONENT_BUDGET.load(Ordering::SeqCst);
+        self.try_star_within(budget)
+    }
+
+    /// `try_star` with an explicit component budget
+    pub fn try_star_within(self, budget: usize) -> Result<Self, Vec<Self>> {
+        // Lots of heuristic optimizations to prevent blow up.
+        // As a reminder, a linear set looks like:  b(p1+...+pN)*  and a SLS is a union of these.
+        //
+        // 1. Pull out linear sets with zero base.
+        //      (p* + ...)* = p*(...)*
+        //
+        // 2. Remove redundant periods.
+        //      p*(b(p+q)* + ...)* = p*(bq* + ...)*
+        //
+        // 3. Pull out bases with no periods.
+        //      (b + ...)* = b*(...)*
+        //
+        // 4. Lastly, for the components that are left, use
+        //      (bP* + ...)* = (bP*)* (...)* = (1 + b(b+P)*) (...)*
+        //    one component at a time, simplifying after each step.
+        let mut extra_periods = HashSet::default();
+
+        // 1. Pull out linear sets with zero base.
+        let mut components = self.components;
+        if GENERATE_LESS.load(Ordering::SeqCst) {
+            components.retain(|comp| {
+                if comp.base.is_zero() {
+                    for p in &comp.periods {
+                        extra_periods.insert(p.clone());
+                    }
+                    false
+                } else {
+                    true
+                }
+            });
+
+            // 2+3. Remove redundant periods, and pull out bases with no periods.
+            loop {
+                let mut modified = false;
+                components.retain_mut(|comp| {
+                    // Remove redundant periods.
+                    // TODO: this could, in fact, be strengthened to p \in extra_periods*
+                    if REMOVE_REDUNDANT.load(Ordering::SeqCst) {
+                        comp.periods.retain(|p| !extra_periods.contains(p));
+                    }
+                    // If the component has no periods, we add its base to extra_periods
+                    if comp.periods.is_empty() {
+                        extra_periods.insert(comp.base.clone());
+                        modified = true;
+                        false
+                    } else {
+                        true
+                    }
+                });
+                if !modified {
+                    break;
+                }
+            }
+        }
+
+        // 4. Multiply in the factors (1 + b(b+P)*) one by one. Without simplification this
+        //    produces the same components, in the same order, as enumerating all subsets of
+        //    the components by bit mask (component i = bit i).
+        let mut cache = MembershipCache::new();
+        let mut result_components = vec![LinearSet {
+            base: SparseVector::new(),
+            periods: vec![],
+        }];
+        let mut remaining = components.into_iter();
+        while let Some(comp) = remaining.next() {
+            let mut with_comp = Vec::with_capacity(result_components.len());
+            for lin in &result_components {
+                let mut periods = lin.periods.clone();
+                periods.push(comp.base.clone());
+                periods.extend(comp.periods.iter().cloned());
+                with_comp.push(LinearSet {
+                    base: lin.base.add(&comp.base),
+                    periods,
+                });
+            }
+            result_components.extend(with_comp);
+
+            // Prune subsumed and mergeable linear sets so the next step stays small
+            if GENERATE_LESS.load(Ordering::SeqCst) {
+                result_components =
+                    SemilinearSet::new_with(result_components, &mut cache).components;
+            }
+
+            if result_components.len() > budget {
+                // Hand back the factors: partial result, remaining (1 + b(b+P)*), extra*
+                let mut factors = vec![SemilinearSet {
+                    components: result_components,
+                }];
+                for comp in remaining {
+                    let mut periods = vec![comp.base.clone()];
+                    periods.extend(comp.periods);
+                    factors.push(SemilinearSet {
+                        components: vec![
+                            LinearSet {
+                                base: SparseVector::new(),
+                                periods: vec![],
+                            },
+                            LinearSet {
+                                base: comp.base,
+                                periods,
+                            },
+                        ],
+                    });
+                }
+                factors.push(SemilinearSet {
+                    components: vec![LinearSet {
+                        base: SparseVector::new(),
+                        periods: extra_periods.into_iter().collect(),
+                    }],
+                });
+                return Err(factors);
+            }
+        }
+
+        // Add the extra periods to all the components
+        for comp in &mut result_components {
+            for p in &extra_periods {
+                comp.periods.push(p.clone());
+            }
+        }
+        // todo check this block with Jules
+        if GENERATE_LESS.load(Ordering::SeqCst) {
+            Ok(SemilinearSet::new_with(result_components, &mut cache))
+        } else {
+            Ok(SemilinearSet {
+                components: result_components,
+            })
+        }
+    }
+}
+
 /// Returns true if `target` can be expressed as a nonnegative integer combination
 /// of the vectors in `periods`.
 pub fn is_nonnegative_combination<K: Eq + Hash + Clone + Ord>(
     target: &SparseVector<K>,
     periods: &[SparseVector<K>],
 ) -> bool {
-    // We'll do a DFS with memoization.  The memo stores `(current_vector, index_in_periods)`.
-    let mut memo = HashSet::default();
-    dfs(target, 0, periods, &mut memo)
+    MembershipCache::new().is_nonnegative_combination(target, periods)
 }
 
-fn dfs<K: Eq + Hash + Clone + Ord>(
-    target: &SparseVector<K>,
-    idx: usize,
-    periods: &[SparseVector<K>],
-    memo: &mut HashSet<(SparseVector<K>, usize)>,
-) -> bool {
-    // If our target has become the zero vector, we are done.
-    if target.values.is_empty() {
-        return true;
-    }
-    // If we've run out of period vectors, and we still haven't zeroed out `target`, fail.
-    if idx == periods.len() {
-        return false;
+/// Problems with more states than this (the product of `target[k] + 1` over all keys)
+/// are handed to ISL instead of the dynamic program.
+const DP_STATE_LIMIT: usize = 1 << 16;
+
+thread_local! {
+    // Per thread, so that analyses running side by side (batch mode) count separately
+    static MEMBERSHIP: std::cell::Cell<MembershipCounters> = const {
+        std::cell::Cell::new(MembershipCounters {
+            trivial: 0,
+            cached: 0,
+            dynamic_programming: 0,
+            isl: 0,
+        })
+    };
+}
+
+fn count_membership(update: impl FnOnce(&mut MembershipCounters)) {
+    MEMBERSHIP.with(|counters| {
+        let mut current = counters.get();
+        update(&mut current);
+        counters.set(current);
+    });
+}
+
+/// How many membership queries were answered by each path of `is_nonnegative_combination`
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MembershipCounters {
+    pub trivial: usize,
+    pub cached: usize,
+    pub dynamic_programming: usize,
+    pub isl: usize,
+}
+
+/// Return the membership counters accumulated so far on this thread, and reset them
+pub fn take_membership_counters() -> MembershipCounters {
+    MEMBERSHIP.with(|counters| counters.take())
+}
+
+/// Memoized `is_nonnegative_combination`, shared by all the subsumption checks of one
+/// `SemilinearSet::new` or `star` call.
+pub struct MembershipCache<K: Eq + Hash + Clone + Ord> {
+    results: HashMap<Vec<SparseVector<K>>, HashMap<SparseVector<K>, bool>>,
+}
+
+impl<K: Eq + Hash + Clone + Ord> MembershipCache<K> {
+    pub fn new() -> Self {
+        MembershipCache {
+            results: HashMap::default(),
+        }
     }
 
-    // Check if we already encountered this (vector, index) pair.
-    let key = (target.clone(), idx);
-    if memo.contains(&key) {
-        return false;
+    pub fn is_nonnegative_combination(
+        &mut self,
+        target: &SparseVector<K>,
+        periods: &[SparseVector<K>],
+    ) -> bool {
+        let problem = match CombinationProblem::new(target, periods) {
+            Ok(problem) => problem,
+            Err(answer) => {
+                count_membership(|counters| counters.trivial += 1);
+                return answer;
+            }
+        };
+        if let Some(&answer) = self.results.get(periods).and_then(|r| r.get(target)) {
+            count_membership(|counters| counters.cached += 1);
+            return answer;
+        }
+        let answer = problem.solve();
+        self.results
+            .entry(periods.to_vec())
+            .or_default()
+            .insert(target.clone(), answer);
+        answer
     }
-    memo.insert(key);
+}
 
-    let p = &periods[idx];
+/// `target ∈ periods*` over the dense coordinates of `target`, restricted to the periods
+/// that can actually be used (no coordinate above the target, none outside its support).
+struct CombinationProblem {
+    target: Vec<usize>,
+    periods: Vec<Vec<usize>>,
+}
 
-    // We'll compute the maximum times we might subtract p from target in *any* dimension
-    // (to keep all coordinates nonnegative).
-    let mut max_coeff = usize::MAX;
-    for (k, &p_val) in &p.values {
-        if p_val > 0 {
-            let t_val = target.values.get(k).copied().unwrap_or(0);
-            let c = t_val / p_val;
-            if c < max_coeff {
-                max_coeff = c;
+impl CombinationProblem {
+    /// Returns `Err(answer)` when the question is settled without any search.
+    fn new<K: Eq + Hash + Clone + Ord>(
+        target: &SparseVector<K>,
+        periods: &[SparseVector<K>],
+    ) -> Result<Self, bool> {
+        if target.is_zero() {
+            return Err(true);
+        }
+        let mut keys: Vec<&K> = target.values.keys().collect();
+        keys.sort();
+        let index: HashMap<&K, usize> = keys.iter().enumerate().map(|(i, k)| (*k, i)).collect();
+        let dense_target: Vec<usize> = keys.iter().map(|k| target.values[*k]).collect();
+
+        let mut dense_periods: Vec<Vec<usize>> = Vec::new();
+        'periods: for p in periods {
+            let mut dense = vec![0; keys.len()];
+            for (k, &v) in &p.values {
+                match index.get(k) {
+                    Some(&i) if v <= dense_target[i] => dense[i] = v,
+                    _ if v == 0 => {}
+                    _ => continue 'periods,
+                }
+            }
+            if dense == dense_target {
+                return Err(true);
+            }
+            if dense.iter().any(|&v| v > 0) && !dense_periods.contains(&dense) {
+                dense_periods.push(dense);
             }
         }
+
+        // Every coordinate of the target must be produced by some period
+        let covered = (0..keys.len()).all(|i| dense_periods.iter().any(|p| p[i] > 0));
+        if !covered {
+            return Err(false);
+        }
+        Ok(CombinationProblem {
+            target: dense_target,
+            periods: dense_periods,
+        })
     }
 
-    // We try all coefficients c = 0..=max_coeff.
-    // c=0 => skip p entirely, check next.
-    for c in 0..=max_coeff {
-        if c == 0 {
-            // Not using p at all
-            if dfs(target, idx + 1, periods, memo) {
-                return true;
+    fn solve(&self) -> bool {
+        let states = self
+            .target
+            .iter()
+            .try_fold(1usize, |acc, &t| acc.checked_mul(t + 1))
+            .filter(|&states| states <= DP_STATE_LIMIT);
+        match states {
+            Some(states) => {
+                count_membership(|counters| counters.dynamic_programming += 1);
+                self.solve_by_dp(states)
             }
-        } else {
-            // Subtract c * p from the target
-            let mut new_target = target.clone();
-            for (k, &p_val) in &p.values {
-                let t_val = new_target.values.get(k).copied().unwrap_or(0);
-                let new_val = t_val.saturating_sub(c * p_val);
-                if new_val == 0 {
-                    new_target.values.remove(k);
-                } else {
-                    new_target.values.insert(k.clone(), new_val);
+            None => {
+                count_membership(|counters| counters.isl += 1);
+                self.solve_by_isl()
+            }
+        }
+    }
+
+    /// Unbounded knapsack over the box `0..=target`, encoded in mixed radix.
+    fn solve_by_dp(&self, states: usize) -> bool {
+        let dims = self.target.len();
+        let mut strides = vec![1; dims];
+        for i in 1..dims {
+            strides[i] = strides[i - 1] * (self.target[i - 1] + 1);
+        }
+
+        let mut reachable = vec![false; states];
+        reachable[0] = true;
+        for p in &self.periods {
+            let offset: usize = (0..dims).map(|i| p[i] * strides[i]).sum();
+            // Visiting states in increasing order lets each period be used any number of times
+            let mut coords = vec![0; dims];
+            for state in 0..states {
+                if reachable[state] && (0..dims).all(|i| coords[i] + p[i] <= self.target[i]) {
+                    reachable[state + offset] = true;
+                }
+                for i in 0..dims {
+                    coords[i] += 1;
+                    if coords[i] <= self.target[i] {
+                        break;
+                    }
+                    coords[i] = 0;
                 }
             }
-            if dfs(&new_target, idx + 1, periods, memo) {
+            if reachable[states - 1] {
                 return true;
             }
         }
+        false
+    }
+
+    /// Check that `{target} ∩ periods*` is nonempty in ISL.
+    fn solve_by_isl(&self) -> bool {
+        let to_sparse = |dense: &[usize]| {
+            let mut v = SparseVector::new();
+            for (i, &x) in dense.iter().enumerate() {
+                v.set(i, x);
+            }
+            v
+        };
+        let monoid = SemilinearSet {
+            components: vec![LinearSet {
+                base: SparseVector::new(),
+                periods: self.periods.iter().map(|p| to_sparse(p)).collect(),
+            }],
+        };
+        let point = SemilinearSet::singleton(to_sparse(&self.target));
+        let monoid = crate::presburger::PresburgerSet::from_semilinear_set(&monoid);
+        let point = crate::presburger::PresburgerSet::from_semilinear_set(&point);
+        !monoid.intersection(&point).is_empty()
     }
-    false
 }
 
 /// Subtract vector b from vector a, returning a - b, or None if that can't be done nonnegatively.
@@ -408,6 +702,15 @@ fn sub_vectors<K: Eq + Hash + Clone + Ord>(
 /// Check if linear_set1 is contained in linear_set2
 /// i.e. L1 ⊆ L2
 pub fn linear_set_subset<K: Eq + Hash + Clone + Ord>(l1: &LinearSet<K>, l2: &LinearSet<K>) -> bool {
+    linear_set_subset_with(l1, l2, &mut MembershipCache::new())
+}
+
+/// `linear_set_subset` with a shared membership cache
+pub fn linear_set_subset_with<K: Eq + Hash + Clone + Ord>(
+    l1: &LinearSet<K>,
+    l2: &LinearSet<K>,
+    cache: &mut MembershipCache<K>,
+) -> bool {
     // 1. Check if (base1 - base2) is in submonoid(periods2).
     //    We do "base1 - base2" in a nonnegative sense, so if base2 has bigger coords in some dimension,
     //    we can’t do it at all => subset is false.  But sometimes you might want to do "base2 - base1".
@@ -420,13 +723,13 @@ pub fn linear_set_subset<K: Eq + Hash + Clone + Ord>(l1: &LinearSet<K>, l2: &Lin
     let Some(diff) = sub_vectors(&l1.base, &l2.base) else {
         return false;
     };
-    if !is_nonnegative_combination(&diff, &l2.periods) {
+    if !cache.is_nonnegative_combination(&diff, &l2.periods) {
         return false;
     }
 
     // 2. Check that every period u_i^(1) is in the submonoid of l2.periods as well.
     for p in &l1.periods {
-        if !is_nonnegative_combination(p, &l2.periods) {
+        if !cache.is_nonnegative_combination(p, &l2.periods) {
             return false;
         }
     }
@@ -439,12 +742,21 @@ pub fn linear_set_subset<K: Eq + Hash + Clone + Ord>(l1: &LinearSet<K>, l2: &Lin
 pub fn try_merge_linear_sets<K: Eq + Hash + Clone + Ord>(
     l1: &LinearSet<K>,
     l2: &LinearSet<K>,
+) -> Option<LinearSet<K>> {
+    try_merge_linear_sets_with(l1, l2, &mut MembershipCache::new())
+}
+
+/// `try_merge_linear_sets` with a shared membership cache
+pub fn try_merge_linear_sets_with<K: Eq + Hash + Clone + Ord>(
+    l1: &LinearSet<K>,
+    l2: &LinearSet<K>,
+    cache: &mut MembershipCache<K>,
 ) -> Option<LinearSet<K>> {
     if l1 == l2 {
         return Some(l1.clone());
     }
     // Check if l1 is a subset of l2
-    if linear_set_subset(l1, l2) {
+    if linear_set_subset_with(l1, l2, cache) {
         return Some(l2.clone());
     }
     // Check if it's aP* and ab(P+b)*
@@ -526,110 +838,19 @@ impl<K: Eq + Hash + Clone + Ord> Kleene for SemilinearSet<K> {
     }
 
     fn star(self) -> Self {
-        // Lots of heuristic optimizations to prevent blow up.
-        // As a reminder, a linear set looks like:  b(p1+...+pN)*  and a SLS is a union of these.
-        //
-        // 1. Pull out linear sets with zero base.
-        //      (p* + ...)* = p*(...)*
-        //
-        // 2. Remove redundant periods.
-        //      p*(b(p+q)* + ...)* = p*(bq* + ...)*
-        //
-        // 3. Pull out bases with no periods.
-        //      (b + ...)* = b*(...)*
-        //
-        // 4. Lastly, for any combinations that are left, we have to do the slow thing of
-        //      (bp* + ...)* = bb*p*(...)* + (...)*
-        //    recursively.
-        let mut extra_periods = HashSet::default();
-
-        // 1. Pull out linear sets with zero base.
-        let mut components = self.components;
-        if GENERATE_LESS.load(Ordering::SeqCst) {
-            components.retain(|comp| {
-                if comp.base.is_zero() {
-                    for p in &comp.periods {
-                        extra_periods.insert(p.clone());
-                    }
-                    false
-                } else {
-                    true
-                }
-            });
-
-            // 2+3. Remove redundant periods, and pull out bases with no periods.
-            loop {
-                let mut modified = false;
-                components.retain_mut(|comp| {
-                    // Remove redundant periods.
-                    // TODO: this could, in fact, be strengthened to p \in extra_periods*
-                    if REMOVE_REDUNDANT.load(Ordering::SeqCst) {
-                        comp.periods.retain(|p| !extra_periods.contains(p));
-                    }
-                    // If the component has no periods, we add its base to extra_periods
-                    if comp.periods.is_empty() {
-                        extra_periods.insert(comp.base.clone());
-                        modified = true;
-                        false
-                    } else {
-                        true
-                    }
-                });
-                if !modified {
-                    break;
-                }
-            }
-        }
-
-        // 4. Slow, recursive thing (but not actually implemented recursively)
-        let mut result_components = Vec::new();
-        // We use bit masks to iterate over all non-empty subsets of components
-        let n = components.len();
-        if n > 30 {
-            // Log this as a timeout before panicking
-            crate::stats::set_analysis_result("timeout");
-            crate::stats::finalize_stats();
-            panic!("Number of components in semilinear set is too large");
-        }
-        for mask in 0..(1 << n) {
-            // Determine subset X for this mask
-            let mut subset_base = SparseVector {
-                values: HashMap::default(),
-            };
-            let mut subset_periods: Vec<SparseVector<K>> = Vec::new();
-
-            for (i, comp) in components.iter().enumerate() {
-                if mask & (1 << i) != 0 {
-                    // add this component's base to subset_base
-                    subset_base = subset_base.add(&comp.base);
-                    // include this component's base and periods in subset_periods
-                    subset_periods.push(comp.base.clone());
-                    for p in &comp.periods {
-                        subset_periods.push(p.clone());
-                    }
-                }
+        match self.try_star() {
+            Ok(result) => result,
+            Err(_) => {
+                // Log this as a timeout before panicking
+                crate::stats::set_analysis_result("timeout");
+                crate::stats::finalize_stats();
+                panic!("Number of components in semilinear set is too large");
             }
-            // Create the linear set for this subset
-            result_components.push(LinearSet {
-                base: subset_base,
-                periods: subset_periods,
-            });
         }
+    }
 
-        // Add the extra periods to all the components
-        for comp in &mut result_components {
-            for p in &extra_periods {
-                comp.periods.push(p.clone());
-            }
-        }
-        // todo check this block with Jules
-        if GENERATE_LESS.load(Ordering::SeqCst) {
-            SemilinearSet::new(result_components)
-        } else {
-            SemilinearSet {
-                components: result_components,
-            }
-        }
+    fn weight(&self) -> usize {
+        self.components.len()
     }
 }
 
@@ -825,6 +1046,110 @@ mod tests {
             ground_truth_a_star_times_b_plus_b_times_c
         );
     }
+
+    fn vector(a: usize, b: usize, c: usize) -> SparseVector<String> {
+        let mut v = SparseVector::new();
+        v.set("a".to_string(), a);
+        v.set("b".to_string(), b);
+        v.set("c".to_string(), c);
+        v
+    }
+
+    fn contains(set: &SemilinearSet<String>, v: &SparseVector<String>) -> bool {
+        set.components.iter().any(|lin| vector_in_linear_set(v, lin))
+    }
+
+    /// Reference answer: try every coefficient of every period
+    fn brute_force_combination(target: &[usize], periods: &[Vec<usize>]) -> bool {
+        let Some((p, rest)) = periods.split_first() else {
+            return target.iter().all(|&t| t == 0);
+        };
+        let mut remaining = target.to_vec();
+        loop {
+            if brute_force_combination(&remaining, rest) {
+                return true;
+            }
+            if p.iter().all(|&x| x == 0) || remaining.iter().zip(p).any(|(&t, &x)| t < x) {
+                return false;
+            }
+            for (t, &x) in remaining.iter_mut().zip(p) {
+                *t -= x;
+            }
+        }
+    }
+
+    #[test]
+    fn test_nonnegative_combination_matches_brute_force() {
+        let period_choices: Vec<Vec<usize>> = vec![
+            vec![1, 0, 0],
+            vec![0, 2, 0],
+            vec![1, 1, 0],
+            vec![0, 3, 2],
+            vec![2, 0, 1],
+            vec![0, 0, 0],
+        ];
+        let mut cache = MembershipCache::new();
+        for mask in 0..(1 << period_choices.len()) {
+            let dense: Vec<Vec<usize>> = (0..period_choices.len())
+                .filter(|i| mask & (1 << i) != 0)
+                .map(|i| period_choices[i].clone())
+                .collect();
+            let periods: Vec<_> = dense.iter().map(|p| vector(p[0], p[1], p[2])).collect();
+            for a in 0..4 {
+                for b in 0..5 {
+                    for c in 0..3 {
+                        let expected = brute_force_combination(&[a, b, c], &dense);
+                        let target = vector(a, b, c);
+                        assert_eq!(is_nonnegative_combination(&target, &periods), expected);
+                        // Twice through the cache, the second time from memory
+                        assert_eq!(cache.is_nonnegative_combination(&target, &periods), expected);
+                        assert_eq!(cache.is_nonnegative_combination(&target, &periods), expected);
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_star_budget_factors_multiply_to_star() {
+        // (ab + b(c)* + a(aa)* + bbc)*: four components that survive simplification
+        let set = SemilinearSet::new(vec![
+            LinearSet {
+                base: vector(1, 1, 0),
+                periods: vec![vector(0, 0, 1)],
+            },
+            LinearSet {
+                base: vector(0, 1, 0),
+                periods: vec![vector(0, 0, 1)],
+            },
+            LinearSet {
+                base: vector(1, 0, 0),
+                periods: vec![vector(2, 0, 0)],
+            },
+            LinearSet {
+                base: vector(0, 2, 1),
+                periods: vec![vector(1, 1, 1)],
+            },
+        ]);
+
+        let full = set.clone().try_star_within(usize::MAX).unwrap();
+        let factors = set.try_star_within(1).unwrap_err();
+        assert!(factors.len() > 1);
+        let product = factors
+            .into_iter()
+            .fold(SemilinearSet::one(), |acc, f| acc.times(f));
+
+        for a in 0..5 {
+            for b in 0..5 {
+                for c in 0..4 {
+                    let v = vector(a, b, c);
+                    assert_eq!(contains(&full, &v), contains(&product, &v), "{}", v);
+                }
+            }
+        }
+        assert!(contains(&full, &vector(1, 2, 0)));
+        assert!(!contains(&full, &vector(0, 0, 1)));
+    }
 }
 
 //     #[test]
@@ -12,13 +12,16 @@ lazy_static::lazy_static! {
     static ref GLOBAL_LOGGER: Mutex<HashMap<String, String>> = Mutex::new(HashMap::new());
 }
 
+// Serializes Petri size CSV writes, which may come from parallel disjunct workers
+static PETRI_SIZE_CSV_LOCK: Mutex<()> = Mutex::new(());
+
 #[derive(Serialize)]
 pub struct PetriNetSize {
     // A string representing the program name (benchmark)
     pub program_name: String,
     /// Identifier so you know which disjunct / iteration this came from
     pub disjunct_id: usize,
-    /// "pre_pruning" or "post_pruning"
+    /// "pre_pruning", "post_pruning" or "post_reduction"
     pub stage: &'static str,
     /// Number of places in the net at this point
     pub num_places: usize,
@@ -28,6 +31,8 @@ pub struct PetriNetSize {
 
 /// Append a record to a CSV file (no headers, so you can keep appending)
 pub fn log_petri_size_csv(path: &Path, entry: &PetriNetSize) -> Result<(), std::io::Error> {
+    let _guard = PETRI_SIZE_CSV_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+
     // Decide if we need to write headers: either file doesn't exist yet,
     // or it exists but is zero‐length.
     let need_header = match path.metadata() {
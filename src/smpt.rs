@@ -31,26 +31,24 @@ use std::hash::Hash;
 use std::path::Path;
 use std::process::{Command, Output};
 use std::sync::Mutex;
-use std::collections::hash_map::DefaultHasher;
-use std::hash::Hasher;
+use std::sync::atomic::{AtomicBool, Ordering};
+use crate::smpt_cache::{CacheStore, StableHasher};
 
 // === Constants ===
 const SMPT_WRAPPER_PATH: &str = "./smpt_wrapper.sh";
 const SMPT_PYTHON_MODULE: &str = "smpt";
 // const DEFAULT_METHODS: &[&str] = &["STATE-EQUATION", "BMC", "K-INDUCTION", "SMT", "PDR-REACH"];
 const DEFAULT_METHODS: &[&str] = &["STATE-EQUATION", "BMC"];
+/// Error message of an SMPT run that was killed because its task was cancelled
+pub const SMPT_CANCELLED_MESSAGE: &str = "SMPT cancelled";
 
 // === Cache Infrastructure ===
 
-/// Cache entry for SMPT results
+/// Cache entry for SMPT results; the raw output is stored separately (see `smpt_cache`)
 #[derive(Clone, serde::Serialize, serde::Deserialize)]
 struct CacheEntry {
     /// The cached result
     result: SmptVerificationOutcome<String>,
-    /// Raw stdout from SMPT
-    raw_stdout: String,
-    /// Raw stderr from SMPT  
-    raw_stderr: String,
 }
 
 /// Statistics for cache usage
@@ -82,9 +80,8 @@ impl CacheStats {
     }
 }
 
-/// Global cache for SMPT results
-/// Key is a hash of (petri net structure, constraints)
-static SMPT_CACHE: Mutex<Option<HashMap<u64, CacheEntry>>> = Mutex::new(None);
+/// On-disk cache of SMPT results, keyed by a stable hash of (petri net, constraints)
+static SMPT_CACHE: Mutex<Option<CacheStore>> = Mutex::new(None);
 
 /// Cache statistics for the current run
 static CACHE_STATS: Mutex<CacheStats> = Mutex::new(CacheStats { hits: 0, misses: 0 });
@@ -100,10 +97,24 @@ pub fn set_use_cache(enabled: bool) {
     *USE_CACHE.lock().unwrap() = enabled;
     if enabled {
         println!("{} SMPT result caching", "Enabled".green().bold());
-        // Ensure cache directory exists
-        std::fs::create_dir_all(CACHE_DIR).ok();
-        // Load filesystem cache into memory
-        load_cache_from_filesystem();
+        // Only the index is read here; values are loaded on a hit
+        match CacheStore::open(Path::new(CACHE_DIR)) {
+            Ok(store) => {
+                if store.len() > 0 {
+                    println!(
+                        "{} {} cache entries from index in {:.1?}",
+                        "Loaded".green().bold(),
+                        store.len(),
+                        store.stats().index_load_time
+                    );
+                }
+                *SMPT_CACHE.lock().unwrap() = Some(store);
+            }
+            Err(e) => {
+                eprintln!("{}: Failed to open SMPT cache in {}: {}", "Warning".yellow(), CACHE_DIR, e);
+                *USE_CACHE.lock().unwrap() = false;
+            }
+        }
     }
 }
 
@@ -117,13 +128,13 @@ pub fn clear_cache() {
     let mut cache_opt = SMPT_CACHE.lock().unwrap();
     if let Some(cache) = cache_opt.as_mut() {
         let size = cache.len();
-        cache.clear();
+        cache.clear().ok();
         if size > 0 {
             println!("{} SMPT cache ({} entries)", "Cleared".yellow().bold(), size);
         }
     }
     
-    // Clear filesystem cache
+    // Clear entries left by the old one-JSON-file-per-entry cache
     if let Ok(entries) = std::fs::read_dir(CACHE_DIR) {
         for entry in entries.flatten() {
             if entry.path().extension().and_then(|s| s.to_str()) == Some("json") {
@@ -147,69 +158,109 @@ pub fn print_cache_stats() {
             format!("{:.1}%", stats.hit_rate()).green().bold()
         );
         println!("  Cache misses: {}", stats.misses);
+        if let Some(store) = SMPT_CACHE.lock().unwrap().as_ref() {
+            let store_stats = store.stats();
+            println!(
+                "  Entries: {} ({} bytes, {} evicted)",
+                store_stats.entries, store_stats.total_bytes, store_stats.evictions
+            );
+            println!(
+                "  Bytes read: {}, written: {}",
+                store_stats.bytes_read, store_stats.bytes_written
+            );
+            println!(
+                "  Index load time: {:.1?}, value load time: {:.1?}",
+                store_stats.index_load_time, store_stats.value_load_time
+            );
+        }
     }
 }
 
-/// Load cache from filesystem into memory
-fn load_cache_from_filesystem() {
+/// Look up a cached result, returning it with the raw SMPT output (empty if not stored)
+fn load_cache_entry(key: (u64, u64)) -> Option<(CacheEntry, String, String)> {
     let mut cache_opt = SMPT_CACHE.lock().unwrap();
-    if cache_opt.is_none() {
-        *cache_opt = Some(HashMap::default());
-    }
-    
-    let cache = cache_opt.as_mut().unwrap();
-    let mut loaded = 0;
-    
-    if let Ok(entries) = std::fs::read_dir(CACHE_DIR) {
-        for entry in entries.flatten() {
-            let path = entry.path();
-            if path.extension().and_then(|s| s.to_str()) == Some("json") {
-                if let Some(key_str) = path.file_stem().and_then(|s| s.to_str()) {
-                    if let Ok(key) = key_str.parse::<u64>() {
-                        if let Ok(contents) = std::fs::read_to_string(&path) {
-                            if let Ok(entry) = serde_json::from_str::<CacheEntry>(&contents) {
-                                cache.insert(key, entry);
-                                loaded += 1;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    if loaded > 0 {
-        println!("{} {} cache entries from filesystem", "Loaded".green().bold(), loaded);
-    }
+    let store = cache_opt.as_mut()?;
+    let bytes = store.get(key.0, key.1)?;
+    let entry = serde_json::from_slice::<CacheEntry>(&bytes).ok()?;
+    let (raw_stdout, raw_stderr) = store
+        .get_raw(key.0)
+        .and_then(|raw| serde_json::from_slice::<(String, String)>(&raw).ok())
+        .unwrap_or_default();
+    Some((entry, raw_stdout, raw_stderr))
 }
 
-/// Save a cache entry to filesystem
-fn save_cache_entry(key: u64, entry: &CacheEntry) {
-    if let Ok(json) = serde_json::to_string_pretty(entry) {
-        let path = format!("{}/{}.json", CACHE_DIR, key);
-        std::fs::write(path, json).ok();
+/// Save a cache entry, with the raw output unless that is disabled
+fn save_cache_entry(key: (u64, u64), entry: &CacheEntry, raw_stdout: &str, raw_stderr: &str) {
+    let Ok(value) = serde_json::to_vec(entry) else {
+        return;
+    };
+    let raw = if crate::smpt_cache::store_raw_output() {
+        serde_json::to_vec(&(raw_stdout, raw_stderr)).ok()
+    } else {
+        None
+    };
+    if let Some(store) = SMPT_CACHE.lock().unwrap().as_mut() {
+        if let Err(e) = store.put(key.0, key.1, &value, raw.as_deref()) {
+            eprintln!("{}: Failed to write SMPT cache entry: {}", "Warning".yellow(), e);
+        }
     }
 }
 
-/// Compute a hash for cache key from Petri net and constraints
-fn compute_cache_key<P>(petri: &Petri<P>, constraints: &[Constraint<P>]) -> u64 
+/// Compute a stable `(key, check)` hash of the Petri net and constraints.
+///
+/// Places are hashed by their .net name, which is also how cached traces refer to them,
+/// so equal nets get equal keys.
+fn compute_cache_key<P>(petri: &Petri<P>, constraints: &[Constraint<P>]) -> (u64, u64)
 where
     P: Clone + Hash + Ord + Display + Debug,
 {
-    let mut hasher = DefaultHasher::new();
-    
-    // Hash the Petri net structure
-    // Convert to string representation for consistent hashing
-    let net_str = petri_to_pnet(petri, "cache_key");
-    net_str.hash(&mut hasher);
-    
-    // Hash the constraints
+    let mut hasher = StableHasher::new();
+
+    // Initial marking as a multiset of names
+    let names = pnet_place_names(petri);
+    let mut marking_count: HashMap<&str, usize> = HashMap::default();
+    for &id in petri.initial_marking_ids() {
+        *marking_count.entry(names[id as usize].as_str()).or_insert(0) += 1;
+    }
+    let mut sorted_places: Vec<(&str, usize)> = marking_count.into_iter().collect();
+    sorted_places.sort();
+    hasher.write_u64(sorted_places.len() as u64);
+    for (name, count) in sorted_places {
+        hasher.write_str(name);
+        hasher.write_u64(count as u64);
+    }
+
+    // Transitions in order
+    hasher.write_u64(petri.num_transitions() as u64);
+    for t in 0..petri.num_transitions() {
+        let (input_places, output_places) = petri.transition(t);
+        for places in [input_places, output_places] {
+            hasher.write_u64(places.len() as u64);
+            for &id in places {
+                hasher.write_str(&names[id as usize]);
+            }
+        }
+    }
+
+    // Constraints, with places named as in the XML query
+    hasher.write_u64(constraints.len() as u64);
     for constraint in constraints {
-        // Convert constraint to string for consistent hashing
-        let constraint_str = format!("{:?}", constraint);
-        constraint_str.hash(&mut hasher);
+        hasher.write_u64(match constraint.constraint_type() {
+            ConstraintType::NonNegative => 0,
+            ConstraintType::EqualToZero => 1,
+        });
+        hasher.write_i64(constraint.constant_term() as i64);
+        hasher.write_u64(constraint.linear_combination().len() as u64);
+        for (coeff, place) in constraint.linear_combination() {
+            hasher.write_i64(*coeff as i64);
+            // Places of the net reuse their rendered names
+            match petri.place_id(place) {
+                Some(id) => hasher.write_str(&names[id as usize]),
+                None => hasher.write_str(&sanitize(&place.to_string())),
+            }
+        }
     }
-    
+
     hasher.finish()
 }
 
@@ -269,6 +320,29 @@ pub fn set_smpt_timeout(timeout_seconds: u64) {
     *SMPT_TIMEOUT_SECONDS.lock().unwrap() = timeout_seconds;
 }
 
+/// Check all disjuncts of a net in one SMPT run (see `can_reach_constraint_sets`)
+static SMPT_MULTI: AtomicBool = AtomicBool::new(false);
+
+pub fn set_smpt_multi(on: bool) {
+    SMPT_MULTI.store(on, Ordering::SeqCst);
+}
+
+pub fn smpt_multi_enabled() -> bool {
+    SMPT_MULTI.load(Ordering::SeqCst)
+}
+
+/// Answer queries from the result cache only and never start SMPT (`--bench-replay`), so
+/// that end-to-end runs are deterministic; a cache miss is an error
+static SMPT_REPLAY: AtomicBool = AtomicBool::new(false);
+
+pub fn set_smpt_replay(on: bool) {
+    SMPT_REPLAY.store(on, Ordering::SeqCst);
+}
+
+pub fn smpt_replay_enabled() -> bool {
+    SMPT_REPLAY.load(Ordering::SeqCst)
+}
+
 // === Public Types ===
 
 /// Convert a Petri net to SMPT .net format
@@ -277,42 +351,36 @@ pub fn petri_to_pnet<Place>(petri: &Petri<Place>, net_name: &str) -> String
 where
     Place: ToString + Clone + PartialEq + Eq + Hash,
 {
-    // A small helper to sanitize non-alphanumeric chars from strings.
-    fn sanitize(s: &str) -> String {
-        s.chars()
-            .map(|c| if c.is_alphanumeric() { c } else { '_' })
-            .collect()
-    }
-
+    let names = pnet_place_names(petri);
     let mut out = String::new();
 
     // 1. net {...}
     out.push_str(&format!("net {{{}}}\n", sanitize(net_name)));
 
     // 2. Count how many times each place appears in the initial marking.
-    let mut marking_count: HashMap<String, usize> = HashMap::default();
-    for place in petri.get_initial_marking() {
-        let place_str = sanitize(&place.to_string());
-        *marking_count.entry(place_str).or_insert(0) += 1;
+    let mut marking_count: HashMap<&str, usize> = HashMap::default();
+    for &id in petri.initial_marking_ids() {
+        *marking_count.entry(names[id as usize].as_str()).or_insert(0) += 1;
     }
 
     // 3. Output the "pl" lines, e.g. "pl P1 (1)"
     //    for each place in initial marking.
     // Sort by place name for deterministic output
-    let mut sorted_places: Vec<(String, usize)> = marking_count.into_iter().collect();
-    sorted_places.sort_by(|a, b| a.0.cmp(&b.0));
+    let mut sorted_places: Vec<(&str, usize)> = marking_count.into_iter().collect();
+    sorted_places.sort_by(|a, b| a.0.cmp(b.0));
     for (place, count) in sorted_places {
         out.push_str(&format!("pl {} ({})\n", place, count));
     }
 
     // 4. Output each transition, named t0, t1, ...
-    for (i, (input_places, output_places)) in petri.get_transitions().iter().enumerate() {
+    for i in 0..petri.num_transitions() {
+        let (input_places, output_places) = petri.transition(i);
         // "tr tX <inputs> -> <outputs>"
         out.push_str(&format!("tr t{} ", i));
 
         // Input places
-        for p in input_places {
-            out.push_str(&sanitize(&p.to_string()));
+        for &p in input_places {
+            out.push_str(&names[p as usize]);
             out.push(' ');
         }
 
@@ -321,11 +389,11 @@ where
 
         // Output places
         let mut first = true;
-        for p in output_places {
+        for &p in output_places {
             if !first {
                 out.push(' ');
             }
-            out.push_str(&sanitize(&p.to_string()));
+            out.push_str(&names[p as usize]);
             first = false;
         }
         out.push('\n');
@@ -334,10 +402,19 @@ where
     out
 }
 
+/// Sanitized .net name of every interned place, indexed by place ID
+fn pnet_place_names<Place: ToString>(petri: &Petri<Place>) -> Vec<String> {
+    (0..petri.place_table_len())
+        .map(|id| sanitize(&petri.place(id as PlaceId).to_string()))
+        .collect()
+}
+
 // === Main API Functions ===
 
 /// Check if constraints are reachable in a Petri net using SMPT
 /// Returns detailed verification result with proof/counterexample
+///
+/// Queries the in-process checks of `crate::precheck` refute never reach SMPT.
 pub fn can_reach_constraint_set<P>(
     petri: Petri<P>,
     constraints: Vec<Constraint<P>>,
@@ -347,64 +424,57 @@ pub fn can_reach_constraint_set<P>(
 where
     P: Clone + Hash + Ord + Display + Debug,
 {
+    if let Some(result) = prechecked(&petri, &constraints, disjunct_id) {
+        return result;
+    }
+    check_with_smpt(petri, constraints, out_dir, disjunct_id)
+}
+
+/// The result of the in-process checks of `crate::precheck`, if they refute the query
+fn prechecked<P>(
+    petri: &Petri<P>,
+    constraints: &[Constraint<P>],
+    disjunct_id: usize,
+) -> Option<SmptVerificationResult<P>>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let (tier, proof) = crate::precheck::refute(petri, constraints)?;
+    println!(
+        "{} Disjunct {} refuted by {} without SMPT",
+        "✓".green().bold(),
+        disjunct_id,
+        tier.name()
+    );
+    Some(SmptVerificationResult {
+        outcome: SmptVerificationOutcome::Unreachable {
+            proof_certificate: None,
+            parsed_proof: Some(proof),
+        },
+        raw_stdout: String::new(),
+        raw_stderr: String::new(),
+    })
+}
+
+/// `can_reach_constraint_set` without the pre-checks
+fn check_with_smpt<P>(
+    petri: Petri<P>,
+    constraints: Vec<Constraint<P>>,
+    out_dir: &str,
+    disjunct_id: usize,
+) -> SmptVerificationResult<P>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let _span = crate::trace::span_with("smpt", || format!("disjunct {}", disjunct_id));
     // Get debug logger from global state
     let debug_logger = crate::reachability::get_debug_logger();
     
     // Record SMPT call
     crate::stats::increment_smpt_calls();
 
-    // Check cache if enabled
-    if is_cache_enabled() {
-        let cache_key = compute_cache_key(&petri, &constraints);
-        let mut cache_opt = SMPT_CACHE.lock().unwrap();
-        
-        // Initialize cache if needed
-        if cache_opt.is_none() {
-            *cache_opt = Some(HashMap::default());
-        }
-        
-        if let Some(cache) = cache_opt.as_ref() {
-            if let Some(entry) = cache.get(&cache_key) {
-            println!("{} SMPT cache hit for disjunct {}", "✓".green().bold(), disjunct_id);
-            CACHE_STATS.lock().unwrap().record_hit();
-            
-            // Convert cached result back to the correct type
-            // The cache stores results with String places, we need to convert back to P
-            let outcome = match &entry.result {
-                SmptVerificationOutcome::Unreachable { proof_certificate, parsed_proof } => {
-                    SmptVerificationOutcome::Unreachable {
-                        proof_certificate: proof_certificate.clone(),
-                        parsed_proof: parsed_proof.clone(),
-                    }
-                }
-                SmptVerificationOutcome::Reachable { trace } => {
-                    // Convert trace from String back to P
-                    let converted_trace = trace.iter().map(|(inputs, outputs)| {
-                        let convert_places = |places: &Vec<String>| -> Vec<P> {
-                            places.iter().filter_map(|s| {
-                                // Try to convert string back to P using the petri net places
-                                petri.get_places_sorted().into_iter().find(|p| {
-                                    sanitize(&p.to_string()) == *s
-                                })
-                            }).collect()
-                        };
-                        (convert_places(inputs), convert_places(outputs))
-                    }).collect();
-                    
-                    SmptVerificationOutcome::Reachable { trace: converted_trace }
-                }
-                SmptVerificationOutcome::Error { message } => {
-                    SmptVerificationOutcome::Error { message: message.clone() }
-                }
-            };
-            
-                return SmptVerificationResult {
-                    outcome,
-                    raw_stdout: entry.raw_stdout.clone(),
-                    raw_stderr: entry.raw_stderr.clone(),
-                };
-            }
-        }
+    if let Some(result) = cached_result(&petri, &constraints, disjunct_id) {
+        return result;
     }
 
     // Debug logging
@@ -458,33 +528,12 @@ where
     // Try to run SMPT tool with the Petri net for trace mapping
     let result = run_smpt(&pnet_file_path, &xml_file_path, &petri);
 
-    // Log the result
-    match &result.outcome {
-        SmptVerificationOutcome::Unreachable { .. } => {
-            println!(
-                "  {} SMPT result: {}",
-                "→".bright_black(),
-                "UNREACHABLE".bright_black()
-            );
-        }
-        SmptVerificationOutcome::Reachable { .. } => {
-            println!(
-                "  {} SMPT result: {}",
-                "→".bright_black(),
-                "REACHABLE".yellow().bold()
-            );
-        }
-        SmptVerificationOutcome::Error { message } => {
-            eprintln!("ERROR: Failed to run SMPT: {}", message);
-            eprintln!("Generated files for manual verification:");
-            eprintln!("  XML: {}", xml_file_path);
-            eprintln!("  Net: {}", pnet_file_path);
-            eprintln!(
-                "Manual command: ./smpt_wrapper.sh -n {} --xml {}",
-                pnet_file_path, xml_file_path
-            );
-        }
-    }
+    print_result(
+        &result.outcome,
+        disjunct_id,
+        &xml_file_path,
+        &pnet_file_path,
+    );
 
     // Save raw SMPT output to files if available
     // For now, we need to re-run SMPT to get raw output since we removed SmptResult
@@ -497,15 +546,14 @@ where
         SmptVerificationOutcome::Error { message } => message.as_str(),
     };
 
-    let smpt_call = SmptCall {
+    debug_logger.smpt_call_with(|| SmptCall {
         disjunct_id,
         petri_net_content: pnet_content,
         xml_content: xml,
         result: result_str.to_string(),
         execution_time_ms: None, // We measure time externally now
         constraints_description: format_constraints_description(&constraints),
-    };
-    debug_logger.smpt_call(smpt_call);
+    });
 
     // Save raw SMPT output for debugging
     let stdout_path = format!("{}/smpt_output_disjunct_{}.stdout", out_dir, disjunct_id);
@@ -513,9 +561,85 @@ where
     std::fs::write(&stdout_path, &result.raw_stdout).ok();
     std::fs::write(&stderr_path, &result.raw_stderr).ok();
 
-    // Cache the result if caching is enabled
+    cache_result(&petri, &constraints, &result, disjunct_id);
+
+    result
+}
+
+/// The cached result of a query, if caching is enabled and the query was cached before
+fn cached_result<P>(
+    petri: &Petri<P>,
+    constraints: &[Constraint<P>],
+    disjunct_id: usize,
+) -> Option<SmptVerificationResult<P>>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    // Check cache if enabled
     if is_cache_enabled() {
-        let cache_key = compute_cache_key(&petri, &constraints);
+        let cache_key = compute_cache_key(petri, constraints);
+        if let Some((entry, raw_stdout, raw_stderr)) = load_cache_entry(cache_key) {
+            println!("{} SMPT cache hit for disjunct {}", "✓".green().bold(), disjunct_id);
+            CACHE_STATS.lock().unwrap().record_hit();
+            
+            // Convert cached result back to the correct type
+            // The cache stores results with String places, we need to convert back to P
+            let outcome = match &entry.result {
+                SmptVerificationOutcome::Unreachable { proof_certificate, parsed_proof } => {
+                    SmptVerificationOutcome::Unreachable {
+                        proof_certificate: proof_certificate.clone(),
+                        parsed_proof: parsed_proof.clone(),
+                    }
+                }
+                SmptVerificationOutcome::Reachable { trace } => {
+                    // Convert trace from String back to P using the petri net places
+                    let names = pnet_place_names(petri);
+                    let mut place_by_name: HashMap<&str, PlaceId> = HashMap::default();
+                    for id in petri.place_ids() {
+                        // On a name clash, use the smallest place as the sorted search did
+                        let entry = place_by_name.entry(names[id as usize].as_str()).or_insert(id);
+                        if petri.place(id) < petri.place(*entry) {
+                            *entry = id;
+                        }
+                    }
+                    let converted_trace = trace.iter().map(|(inputs, outputs)| {
+                        let convert_places = |places: &Vec<String>| -> Vec<P> {
+                            places.iter().filter_map(|s| {
+                                place_by_name.get(s.as_str()).map(|&id| petri.place(id).clone())
+                            }).collect()
+                        };
+                        (convert_places(inputs), convert_places(outputs))
+                    }).collect();
+                    
+                    SmptVerificationOutcome::Reachable { trace: converted_trace }
+                }
+                SmptVerificationOutcome::Error { message } => {
+                    SmptVerificationOutcome::Error { message: message.clone() }
+                }
+            };
+            
+            return Some(SmptVerificationResult {
+                outcome,
+                raw_stdout,
+                raw_stderr,
+            });
+        }
+    }
+    None
+}
+
+/// Store the result of a query if caching is enabled
+fn cache_result<P>(
+    petri: &Petri<P>,
+    constraints: &[Constraint<P>],
+    result: &SmptVerificationResult<P>,
+    disjunct_id: usize,
+) where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    // Cache the result if caching is enabled (a cancelled run says nothing about the query)
+    if is_cache_enabled() && !crate::parallel::is_cancelled() {
+        let cache_key = compute_cache_key(petri, constraints);
         
         // Convert result to String-based version for caching
         let cache_outcome = match &result.outcome {
@@ -546,21 +670,53 @@ where
         
         let cache_entry = CacheEntry {
             result: cache_outcome,
-            raw_stdout: result.raw_stdout.clone(),
-            raw_stderr: result.raw_stderr.clone(),
         };
-        
-        let mut cache_opt = SMPT_CACHE.lock().unwrap();
-        if let Some(cache) = cache_opt.as_mut() {
-            cache.insert(cache_key, cache_entry.clone());
-            // Save to filesystem
-            save_cache_entry(cache_key, &cache_entry);
-        }
+        save_cache_entry(cache_key, &cache_entry, &result.raw_stdout, &result.raw_stderr);
         
         println!("{} SMPT result cached for disjunct {}", "→".bright_black(), disjunct_id);
     }
+}
 
-    result
+/// Print the outcome of a query, with the files to rerun it by hand if it failed
+fn print_result<P>(
+    outcome: &SmptVerificationOutcome<P>,
+    disjunct_id: usize,
+    xml_file_path: &str,
+    pnet_file_path: &str,
+) {
+    match outcome {
+        SmptVerificationOutcome::Unreachable { .. } => {
+            println!(
+                "  {} SMPT result: {}",
+                "→".bright_black(),
+                "UNREACHABLE".bright_black()
+            );
+        }
+        SmptVerificationOutcome::Reachable { .. } => {
+            println!(
+                "  {} SMPT result: {}",
+                "→".bright_black(),
+                "REACHABLE".yellow().bold()
+            );
+        }
+        SmptVerificationOutcome::Error { .. } if crate::parallel::is_cancelled() => {
+            println!(
+                "  {} SMPT cancelled for disjunct {}",
+                "→".bright_black(),
+                disjunct_id
+            );
+        }
+        SmptVerificationOutcome::Error { message } => {
+            eprintln!("ERROR: Failed to run SMPT: {}", message);
+            eprintln!("Generated files for manual verification:");
+            eprintln!("  XML: {}", xml_file_path);
+            eprintln!("  Net: {}", pnet_file_path);
+            eprintln!(
+                "Manual command: ./smpt_wrapper.sh -n {} --xml {}",
+                pnet_file_path, xml_file_path
+            );
+        }
+    }
 }
 
 /// Install SMPT tool - returns true if already installed or successfully installed
@@ -685,10 +841,40 @@ fn execute_smpt(
     args: &[String],
     stdout_path: &str,
     stderr_path: &str,
+    timeout_seconds: Option<u64>,
 ) -> Result<Output, std::io::Error> {
     use std::fs::File;
     use std::process::Stdio;
 
+    // Hand the query to a long-lived worker if enabled (see `smpt_server.rs`)
+    if crate::smpt_server::smpt_server_enabled() {
+        match crate::smpt_server::execute(args, stdout_path, stderr_path, timeout_seconds) {
+            Ok(status) => {
+                return Ok(Output {
+                    status,
+                    stdout: std::fs::read(stdout_path)?,
+                    stderr: std::fs::read(stderr_path)?,
+                });
+            }
+            Err(e)
+                if matches!(
+                    e.kind(),
+                    std::io::ErrorKind::Interrupted | std::io::ErrorKind::TimedOut
+                ) =>
+            {
+                return Err(e);
+            }
+            Err(e) => {
+                eprintln!(
+                    "{}: SMPT worker failed ({}), running SMPT directly from now on",
+                    "Warning".yellow(),
+                    e
+                );
+                crate::smpt_server::set_smpt_server(false);
+            }
+        }
+    }
+
     // Create output files
     let stdout_file = File::create(stdout_path)?;
     let stderr_file = File::create(stderr_path)?;
@@ -713,8 +899,33 @@ fn execute_smpt(
     cmd.stderr(Stdio::from(stderr_file));
     cmd.stdin(Stdio::null()); // Explicitly close stdin
 
-    // Execute and wait for completion
-    let status = cmd.status()?;
+    // Execute and wait for completion, killing SMPT if the task gets cancelled
+    // (a sibling disjunct already decided the result, see `parallel.rs`)
+    let cancellable = crate::parallel::in_cancellable_task();
+    if cancellable {
+        // Own process group, so that killing it also kills the wrapper's python child
+        use std::os::unix::process::CommandExt;
+        cmd.process_group(0);
+    }
+    let mut child = cmd.spawn()?;
+    let status = if !cancellable {
+        child.wait()?
+    } else {
+        loop {
+            if let Some(status) = child.try_wait()? {
+                break status;
+            }
+            if crate::parallel::is_cancelled() {
+                unsafe { libc::kill(-(child.id() as libc::pid_t), libc::SIGKILL) };
+                child.wait()?;
+                return Err(std::io::Error::new(
+                    std::io::ErrorKind::Interrupted,
+                    SMPT_CANCELLED_MESSAGE,
+                ));
+            }
+            std::thread::sleep(std::time::Duration::from_millis(20));
+        }
+    };
 
     // Read the files back
     let stdout = std::fs::read(stdout_path)?;
@@ -763,18 +974,8 @@ fn extract_trace_indices(output: &str) -> Vec<usize> {
         // Look for BMC or PDR trace markers
         if lines[i].contains("[BMC] Trace") || lines[i].contains("[PDR] Trace") {
             // Next non-empty line should contain the trace
-            if i + 1 < lines.len() {
-                let trace_line = lines[i + 1].trim();
-                if !trace_line.is_empty() && trace_line.starts_with('t') {
-                    return trace_line
-                        .split_whitespace()
-                        .filter_map(|s| {
-                            // Extract number from "t0", "t1", etc.
-                            s.strip_prefix('t')
-                                .and_then(|num| num.parse::<usize>().ok())
-                        })
-                        .collect();
-                }
+            if let Some(trace) = lines.get(i + 1).and_then(|line| parse_trace_line(line)) {
+                return trace;
             }
         }
     }
@@ -782,61 +983,99 @@ fn extract_trace_indices(output: &str) -> Vec<usize> {
     Vec::new()
 }
 
+/// Transition indices of a trace line like "t0 t3 t1", if it is one
+fn parse_trace_line(line: &str) -> Option<Vec<usize>> {
+    let trace_line = line.trim();
+    if trace_line.is_empty() || !trace_line.starts_with('t') {
+        return None;
+    }
+    Some(
+        trace_line
+            .split_whitespace()
+            .filter_map(|s| {
+                // Extract number from "t0", "t1", etc.
+                s.strip_prefix('t')
+                    .and_then(|num| num.parse::<usize>().ok())
+            })
+            .collect(),
+    )
+}
+
 /// Convert trace indices to actual transitions (input places, output places)
 fn indices_to_transitions<P>(indices: Vec<usize>, petri: &Petri<P>) -> Vec<(Vec<P>, Vec<P>)>
 where
     P: Clone + PartialEq + Eq + Hash,
 {
-    let transitions = petri.get_transitions();
     indices
         .into_iter()
-        .map(|idx| transitions[idx].clone())
+        .map(|idx| {
+            let (input, output) = petri.transition(idx);
+            (petri.resolve(input), petri.resolve(output))
+        })
         .collect()
 }
 
-/// Run SMPT on a Petri net file with constraints with optional timeout (internal implementation)
-fn run_smpt_internal<P>(
+/// Output of an SMPT run
+struct SmptRun {
+    stdout: String,
+    /// With harmless Python cleanup errors filtered out
+    stderr: String,
+    exit_code: Option<i32>,
+    /// Where SMPT was asked to export its proof
+    proof_file_path: String,
+}
+
+/// Run SMPT on a net and properties file, or say why it could not run to completion
+fn invoke_smpt<P>(
     net_file: &str,
     xml_file: &str,
     timeout_seconds: Option<u64>,
-    petri: &Petri<P>,
-) -> SmptVerificationResult<P>
-where
-    P: Clone + Hash + Ord + Display + Debug,
-{
+) -> Result<SmptRun, SmptVerificationResult<P>> {
+    if smpt_replay_enabled() {
+        return Err(SmptVerificationResult {
+            outcome: SmptVerificationOutcome::Error {
+                message: format!(
+                    "Query for {} is not in the SMPT cache (replay mode)",
+                    xml_file
+                ),
+            },
+            raw_stdout: String::new(),
+            raw_stderr: String::new(),
+        });
+    }
     if !is_smpt_installed() {
-        return SmptVerificationResult {
+        return Err(SmptVerificationResult {
             outcome: SmptVerificationOutcome::Error {
                 message: "SMPT is not installed".to_string(),
             },
             raw_stdout: String::new(),
             raw_stderr: String::new(),
-        };
+        });
     }
 
     // Convert paths to absolute paths for wrapper script compatibility
     let abs_net_file = match std::fs::canonicalize(net_file) {
         Ok(path) => path,
         Err(e) => {
-            return SmptVerificationResult {
+            return Err(SmptVerificationResult {
                 outcome: SmptVerificationOutcome::Error {
                     message: format!("Failed to get absolute path for {}: {}", net_file, e),
                 },
                 raw_stdout: String::new(),
                 raw_stderr: String::new(),
-            };
+            });
         }
     };
     let abs_xml_file = match std::fs::canonicalize(xml_file) {
         Ok(path) => path,
         Err(e) => {
-            return SmptVerificationResult {
+            return Err(SmptVerificationResult {
                 outcome: SmptVerificationOutcome::Error {
                     message: format!("Failed to get absolute path for {}: {}", xml_file, e),
                 },
                 raw_stdout: String::new(),
                 raw_stderr: String::new(),
-            };
+            });
         }
     };
 
@@ -856,24 +1095,63 @@ where
     );
 
     // Execute SMPT
-    let output = match execute_smpt(&args, &stdout_path, &stderr_path) {
+    let output = match execute_smpt(&args, &stdout_path, &stderr_path, timeout_seconds) {
         Ok(output) => output,
+        Err(e) if e.kind() == std::io::ErrorKind::TimedOut => {
+            // A pooled worker hung past the timeout and was killed
+            crate::stats::increment_smpt_timeouts();
+            return Err(SmptVerificationResult {
+                outcome: SmptVerificationOutcome::Error {
+                    message: format!(
+                        "SMPT timeout: Analysis timed out after {}s. Try increasing timeout or enabling optimizations.",
+                        timeout_seconds.unwrap_or(get_smpt_timeout())
+                    ),
+                },
+                raw_stdout: std::fs::read_to_string(&stdout_path).unwrap_or_default(),
+                raw_stderr: std::fs::read_to_string(&stderr_path).unwrap_or_default(),
+            });
+        }
         Err(e) => {
-            return SmptVerificationResult {
+            return Err(SmptVerificationResult {
                 outcome: SmptVerificationOutcome::Error {
                     message: format!("Failed to execute SMPT: {}", e),
                 },
                 raw_stdout: String::new(),
                 raw_stderr: String::new(),
-            };
+            });
         }
     };
 
     let stdout = String::from_utf8_lossy(&output.stdout).into_owned();
-    let mut stderr = String::from_utf8_lossy(&output.stderr).into_owned();
-
     // Filter out harmless Python cleanup errors
-    stderr = filter_python_cleanup_errors(&stderr);
+    let stderr = filter_python_cleanup_errors(&String::from_utf8_lossy(&output.stderr));
+    Ok(SmptRun {
+        stdout,
+        stderr,
+        exit_code: output.status.code(),
+        proof_file_path,
+    })
+}
+
+/// Run SMPT on a Petri net file with constraints with optional timeout (internal implementation)
+fn run_smpt_internal<P>(
+    net_file: &str,
+    xml_file: &str,
+    timeout_seconds: Option<u64>,
+    petri: &Petri<P>,
+) -> SmptVerificationResult<P>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let SmptRun {
+        stdout,
+        stderr,
+        exit_code,
+        proof_file_path,
+    } = match invoke_smpt(net_file, xml_file, timeout_seconds) {
+        Ok(run) => run,
+        Err(result) => return result,
+    };
 
     // Parse SMPT output
     if stdout.contains("TRUE") {
@@ -884,16 +1162,8 @@ where
         if trace_indices.is_empty() {
             let scn_file_path = proof_file_path.replace(".txt", ".txt.scn");
             if let Ok(scn_content) = std::fs::read_to_string(&scn_file_path) {
-                let trace_line = scn_content.trim();
-                if !trace_line.is_empty() && trace_line.starts_with('t') {
-                    trace_indices = trace_line
-                        .split_whitespace()
-                        .filter_map(|s| {
-                            // Extract number from "t0", "t1", etc.
-                            s.strip_prefix('t')
-                                .and_then(|num| num.parse::<usize>().ok())
-                        })
-                        .collect();
+                if let Some(trace) = parse_trace_line(&scn_content) {
+                    trace_indices = trace;
                 }
             }
         }
@@ -934,7 +1204,7 @@ where
         }
     } else {
         // Check for timeout patterns
-        let error_msg = if output.status.code() == Some(1) && stdout.trim() == "# Hello" {
+        let error_msg = if exit_code == Some(1) && stdout.trim() == "# Hello" {
             crate::stats::increment_smpt_timeouts();
             format!(
                 "SMPT timeout: Analysis timed out after {}s. Try increasing timeout or enabling optimizations.",
@@ -964,6 +1234,333 @@ where
     }
 }
 
+/// Check several constraint sets against the same Petri net, sharing one SMPT run
+///
+/// Returns one result per query in order, stopping after the first one that is not
+/// unreachable, as `can_reach_presburger` does. A query the shared run does not settle
+/// (no verdict, no trace, or a proof it cannot attribute) is checked again on its own
+/// with `can_reach_constraint_set`, so the results are the same as checking the queries
+/// one by one.
+pub fn can_reach_constraint_sets<P>(
+    petri: &Petri<P>,
+    queries: &[Vec<Constraint<P>>],
+    out_dir: &str,
+) -> Vec<SmptVerificationResult<P>>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let mut settled: Vec<Option<SmptVerificationResult<P>>> = queries
+        .iter()
+        .enumerate()
+        .map(|(disjunct_id, constraints)| {
+            let refuted = prechecked(petri, constraints, disjunct_id);
+            if refuted.is_some() {
+                return refuted;
+            }
+            let cached = cached_result(petri, constraints, disjunct_id);
+            if cached.is_some() {
+                crate::stats::increment_smpt_calls();
+            }
+            cached
+        })
+        .collect();
+
+    let pending: Vec<usize> = (0..queries.len())
+        .filter(|&disjunct_id| settled[disjunct_id].is_none())
+        .collect();
+    if pending.len() > 1 {
+        for (disjunct_id, result) in run_shared(petri, queries, &pending, out_dir) {
+            cache_result(petri, &queries[disjunct_id], &result, disjunct_id);
+            settled[disjunct_id] = Some(result);
+        }
+    }
+
+    let mut results = Vec::new();
+    for (disjunct_id, result) in settled.into_iter().enumerate() {
+        let result = result.unwrap_or_else(|| {
+            check_with_smpt(
+                petri.clone(),
+                queries[disjunct_id].clone(),
+                out_dir,
+                disjunct_id,
+            )
+        });
+        let unreachable = matches!(result.outcome, SmptVerificationOutcome::Unreachable { .. });
+        results.push(result);
+        if !unreachable {
+            break;
+        }
+    }
+    results
+}
+
+/// Run SMPT once on a multi-property file holding the `pending` queries, returning the
+/// results it settles
+fn run_shared<P>(
+    petri: &Petri<P>,
+    queries: &[Vec<Constraint<P>>],
+    pending: &[usize],
+    out_dir: &str,
+) -> Vec<(usize, SmptVerificationResult<P>)>
+where
+    P: Clone + Hash + Ord + Display + Debug,
+{
+    let _span = crate::trace::span_with("smpt", || format!("disjuncts {:?}", pending));
+    let debug_logger = crate::reachability::get_debug_logger();
+
+    // One SMPT call for all of them
+    crate::stats::increment_smpt_calls();
+    if is_cache_enabled() {
+        let mut cache_stats = CACHE_STATS.lock().unwrap();
+        for _ in pending {
+            cache_stats.record_miss();
+        }
+    }
+
+    debug_logger.log_petri_net(
+        "SMPT Input Petri Net",
+        &format!(
+            "Petri net shared by disjuncts {:?} before SMPT verification",
+            pending
+        ),
+        petri,
+    );
+    for &disjunct_id in pending {
+        debug_logger.log_constraints(
+            "SMPT Input Constraints",
+            &format!(
+                "Constraints for disjunct {} to be verified by SMPT",
+                disjunct_id
+            ),
+            &queries[disjunct_id],
+        );
+    }
+
+    let petri_places: HashSet<String> = petri
+        .get_places_sorted()
+        .iter()
+        .map(|p| sanitize(&p.to_string()))
+        .collect();
+    let ids: Vec<String> = pending
+        .iter()
+        .map(|disjunct_id| format!("disjunct-{}", disjunct_id))
+        .collect();
+    let properties: Vec<(&str, &[Constraint<P>])> = ids
+        .iter()
+        .zip(pending)
+        .map(|(id, &disjunct_id)| (id.as_str(), queries[disjunct_id].as_slice()))
+        .collect();
+    let xml = presburger_constraint_sets_to_xml(&properties, &petri_places);
+    let pnet_content = petri_to_pnet(petri, "constraint_check");
+
+    std::fs::create_dir_all(out_dir).expect("Failed to create output directory");
+    let xml_file_path = format!("{}/smpt_constraints_multi.xml", out_dir);
+    let pnet_file_path = format!("{}/smpt_petri_multi.net", out_dir);
+    std::fs::write(&xml_file_path, &xml).expect("Failed to write SMPT XML");
+    std::fs::write(&pnet_file_path, &pnet_content).expect("Failed to write SMPT Petri net");
+    // A certificate left from an earlier run must not be taken for one of this run
+    std::fs::remove_file(format!("{}/smpt_constraints_multi_proof.txt", out_dir)).ok();
+
+    let run = invoke_smpt::<P>(&pnet_file_path, &xml_file_path, Some(get_smpt_timeout()));
+    let (verdicts, certificates, raw_stdout, raw_stderr) = match run {
+        Ok(run) => {
+            let verdicts = parse_property_verdicts(&run.stdout);
+            let certificates = std::fs::read_to_string(&run.proof_file_path)
+                .map(|content| split_certificates(&content))
+                .unwrap_or_default();
+            (verdicts, certificates, run.stdout, run.stderr)
+        }
+        Err(result) => (Vec::new(), Vec::new(), result.raw_stdout, result.raw_stderr),
+    };
+
+    // The proof file does not say which property a certificate is for, so each unreachable
+    // property takes the first certificate that excludes its own query
+    let mapping: Vec<String> = petri
+        .get_places_sorted()
+        .iter()
+        .map(|p| sanitize(&p.to_string()))
+        .collect();
+    let mut certificates: Vec<Option<(String, ProofInvariant<String>)>> = certificates
+        .into_iter()
+        .map(|certificate| {
+            let proof = parse_proof_file(&certificate).ok()?;
+            Some((certificate, proof))
+        })
+        .collect();
+
+    let mut settled = Vec::new();
+    for (id, verdict) in verdicts {
+        let Some(disjunct_id) = ids
+            .iter()
+            .position(|candidate| *candidate == id)
+            .map(|i| pending[i])
+        else {
+            continue;
+        };
+        let outcome = match verdict {
+            PropertyVerdict::Reachable { trace } if !trace.is_empty() => {
+                SmptVerificationOutcome::Reachable {
+                    trace: indices_to_transitions(trace, petri),
+                }
+            }
+            // The trace may be in the shared .scn file, which does not say whose it is
+            PropertyVerdict::Reachable { .. } => continue,
+            PropertyVerdict::Unreachable => {
+                let Some((certificate, proof)) = certificates
+                    .iter_mut()
+                    .find(|candidate| {
+                        candidate.as_ref().is_some_and(|(_, proof)| {
+                            certificate_excludes(proof, &queries[disjunct_id], &mapping)
+                        })
+                    })
+                    .and_then(Option::take)
+                else {
+                    continue;
+                };
+                SmptVerificationOutcome::Unreachable {
+                    proof_certificate: Some(certificate),
+                    parsed_proof: Some(proof),
+                }
+            }
+        };
+        settled.push((
+            disjunct_id,
+            SmptVerificationResult {
+                outcome,
+                raw_stdout: raw_stdout.clone(),
+                raw_stderr: raw_stderr.clone(),
+            },
+        ));
+    }
+    settled.sort_by_key(|(disjunct_id, _)| *disjunct_id);
+
+    for &disjunct_id in pending {
+        let result = settled.iter().find(|(id, _)| *id == disjunct_id);
+        let result_str = match result.map(|(_, result)| &result.outcome) {
+            Some(outcome) => {
+                print_result(outcome, disjunct_id, &xml_file_path, &pnet_file_path);
+                match outcome {
+                    SmptVerificationOutcome::Unreachable { .. } => "UNREACHABLE",
+                    _ => "REACHABLE",
+                }
+            }
+            None => "UNSETTLED (checked on its own)",
+        };
+        debug_logger.smpt_call_with(|| SmptCall {
+            disjunct_id,
+            petri_net_content: pnet_content.clone(),
+            xml_content: xml.clone(),
+            result: result_str.to_string(),
+            execution_time_ms: None,
+            constraints_description: format_constraints_description(&queries[disjunct_id]),
+        });
+    }
+
+    std::fs::write(format!("{}/smpt_output_multi.stdout", out_dir), &raw_stdout).ok();
+    std::fs::write(format!("{}/smpt_output_multi.stderr", out_dir), &raw_stderr).ok();
+
+    settled
+}
+
+/// What SMPT reported for one property of a multi-property run
+#[derive(Debug, Clone, PartialEq, Eq)]
+enum PropertyVerdict {
+    /// The trace SMPT printed for it, as transition indices (empty if none)
+    Reachable {
+        trace: Vec<usize>,
+    },
+    Unreachable,
+}
+
+/// The `FORMULA <id> TRUE|FALSE` verdicts in SMPT's output, in the order they appear.
+/// A trace printed since the previous verdict belongs to the next `TRUE` one.
+fn parse_property_verdicts(output: &str) -> Vec<(String, PropertyVerdict)> {
+    let lines: Vec<&str> = output.lines().collect();
+    let mut verdicts = Vec::new();
+    let mut trace = Vec::new();
+    for (i, line) in lines.iter().enumerate() {
+        if line.contains("[BMC] Trace") || line.contains("[PDR] Trace") {
+            if let Some(indices) = lines.get(i + 1).and_then(|next| parse_trace_line(next)) {
+                trace = indices;
+            }
+            continue;
+        }
+        let mut words = line.split_whitespace();
+        if words.next() != Some("FORMULA") {
+            continue;
+        }
+        let (Some(id), Some(answer)) = (words.next(), words.next()) else {
+            continue;
+        };
+        let verdict = match answer {
+            "TRUE" => PropertyVerdict::Reachable {
+                trace: std::mem::take(&mut trace),
+            },
+            "FALSE" => PropertyVerdict::Unreachable,
+            _ => continue,
+        };
+        trace.clear();
+        verdicts.push((id.to_string(), verdict));
+    }
+    verdicts
+}
+
+/// Whether no marking satisfying both the invariant `proof` and `constraints` exists, so
+/// that the invariant proves the query unreachable. `mapping` names the places of the net
+/// as they appear in the certificate.
+fn certificate_excludes<P: Display>(
+    proof: &ProofInvariant<String>,
+    constraints: &[Constraint<P>],
+    mapping: &[String],
+) -> bool {
+    use crate::presburger::{PresburgerSet, QuantifiedSet, Variable};
+    use crate::proofinvariant_to_presburger::proof_invariant_to_presburger;
+
+    if !proof.variables.iter().all(|var| mapping.contains(var)) {
+        return false;
+    }
+    let query = QuantifiedSet::new(
+        constraints
+            .iter()
+            .map(|constraint| {
+                Constraint::new(
+                    constraint
+                        .linear_combination()
+                        .iter()
+                        .map(|(coeff, place)| (*coeff, Variable::Var(sanitize(&place.to_string()))))
+                        .collect(),
+                    constraint.constant_term(),
+                    constraint.constraint_type(),
+                )
+            })
+            .collect(),
+    );
+    let query = PresburgerSet::from_quantified_sets(&[query], mapping.to_vec());
+    let invariant = proof_invariant_to_presburger(proof, mapping.to_vec());
+    invariant.intersection(&query).is_empty()
+}
+
+/// Split an exported proof file holding several `cert` definitions into one proof file
+/// per definition, each keeping the shared preamble (`set-logic`)
+fn split_certificates(content: &str) -> Vec<String> {
+    let starts: Vec<usize> = content
+        .match_indices("(define-fun cert")
+        .map(|(start, _)| start)
+        .collect();
+    let Some(&first) = starts.first() else {
+        return Vec::new();
+    };
+    let preamble = &content[..first];
+    starts
+        .iter()
+        .enumerate()
+        .map(|(i, &start)| {
+            let end = starts.get(i + 1).copied().unwrap_or(content.len());
+            format!("{}{}", preamble, &content[start..end])
+        })
+        .collect()
+}
+
 // === Conversion Functions ===
 
 /// Converts a Vec of presburger Constraints to XML format compatible with SMPT
@@ -972,10 +1569,31 @@ pub fn presburger_constraints_to_xml<P: Display>(
     id: &str,
     petri_places: &HashSet<String>,
 ) -> String {
-    let mut xml = format!(
-        r#"<?xml version='1.0' encoding='utf-8'?>
-<property-set>
-  <property>
+    presburger_constraint_sets_to_xml(&[(id, constraints)], petri_places)
+}
+
+/// Converts several constraint sets to one SMPT XML file with one property per set
+pub fn presburger_constraint_sets_to_xml<P: Display>(
+    properties: &[(&str, &[Constraint<P>])],
+    petri_places: &HashSet<String>,
+) -> String {
+    let mut xml = String::from("<?xml version='1.0' encoding='utf-8'?>\n<property-set>\n");
+    for (id, constraints) in properties {
+        push_property_xml(&mut xml, constraints, id, petri_places);
+    }
+    xml.push_str("</property-set>");
+    xml
+}
+
+/// Append one `<property>` element asking whether the constraints are reachable
+fn push_property_xml<P: Display>(
+    xml: &mut String,
+    constraints: &[Constraint<P>],
+    id: &str,
+    petri_places: &HashSet<String>,
+) {
+    xml.push_str(&format!(
+        r#"  <property>
     <id>{}</id>
     <description>Generated from presburger constraints</description>
     <formula>
@@ -984,7 +1602,7 @@ pub fn presburger_constraints_to_xml<P: Display>(
           <conjunction>
 "#,
         id
-    );
+    ));
 
     // If no constraints, create a tautology (always true)
     if constraints.is_empty() {
@@ -1013,10 +1631,8 @@ pub fn presburger_constraints_to_xml<P: Display>(
       </exists-path>
     </formula>
   </property>
-</property-set>"#,
+"#,
     );
-
-    xml
 }
 
 // Use the shared utility function for sanitization
@@ -1249,6 +1865,124 @@ FORMULA reachability-check TRUE TIME 0.403745174407959
         assert_eq!(extract_trace_indices(no_trace), Vec::<usize>::new());
     }
 
+    #[test]
+    fn test_presburger_constraint_sets_to_xml() {
+        let first = vec![Constraint::new(
+            vec![(1, "x")],
+            -5,
+            ConstraintType::NonNegative,
+        )];
+        let second = vec![Constraint::new(
+            vec![(1, "y")],
+            0,
+            ConstraintType::EqualToZero,
+        )];
+        let mut petri_places = HashSet::default();
+        petri_places.insert("x".to_string());
+        petri_places.insert("y".to_string());
+
+        let xml = presburger_constraint_sets_to_xml(
+            &[
+                ("disjunct-0", first.as_slice()),
+                ("disjunct-1", second.as_slice()),
+            ],
+            &petri_places,
+        );
+
+        assert_eq!(xml.matches("<property>").count(), 2);
+        assert!(
+            xml.find("<id>disjunct-0</id>").unwrap() < xml.find("<id>disjunct-1</id>").unwrap()
+        );
+        assert!(xml.ends_with("</property-set>"));
+
+        // A lone property is the same file the single-query path writes
+        let single = presburger_constraints_to_xml(&first, "disjunct-0", &petri_places);
+        assert_eq!(
+            presburger_constraint_sets_to_xml(&[("disjunct-0", first.as_slice())], &petri_places),
+            single
+        );
+    }
+
+    #[test]
+    fn test_parse_property_verdicts() {
+        let output = r#"# Hello
+FORMULA disjunct-0 FALSE TECHNIQUES STATE-EQUATION
+[BMC] Trace
+t2 t0
+FORMULA disjunct-1 TRUE TECHNIQUES BMC
+FORMULA disjunct-2 TRUE TECHNIQUES STATE-EQUATION
+FORMULA disjunct-3 FALSE TECHNIQUES BMC
+# Bye bye
+"#;
+
+        assert_eq!(
+            parse_property_verdicts(output),
+            vec![
+                ("disjunct-0".to_string(), PropertyVerdict::Unreachable),
+                (
+                    "disjunct-1".to_string(),
+                    PropertyVerdict::Reachable { trace: vec![2, 0] }
+                ),
+                (
+                    "disjunct-2".to_string(),
+                    PropertyVerdict::Reachable { trace: vec![] }
+                ),
+                ("disjunct-3".to_string(), PropertyVerdict::Unreachable),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_split_certificates() {
+        let content = r#"(set-logic LIA)
+(define-fun cert ((x Int)) Bool
+  (>= x 0))
+(define-fun cert ((x Int)(y Int)) Bool
+  (= (+ x y) 1))
+"#;
+
+        let certificates = split_certificates(content);
+        assert_eq!(certificates.len(), 2);
+        assert!(
+            certificates
+                .iter()
+                .all(|cert| cert.starts_with("(set-logic LIA)"))
+        );
+        assert_eq!(
+            parse_proof_file(&certificates[0]).unwrap().variables,
+            vec!["x"]
+        );
+        assert_eq!(
+            parse_proof_file(&certificates[1]).unwrap().variables,
+            vec!["x", "y"]
+        );
+
+        assert!(split_certificates("(set-logic LIA)\n").is_empty());
+    }
+
+    #[test]
+    fn test_certificate_excludes_only_its_query() {
+        let proof = parse_proof_file(
+            "(set-logic LIA)\n(define-fun cert ((x Int)(y Int)) Bool\n  (= (+ x y) 1))\n",
+        )
+        .unwrap();
+        let mapping = vec!["x".to_string(), "y".to_string()];
+
+        // x = 2 is excluded by x + y = 1, x = 1 is not
+        let x_is = |n: i32| {
+            vec![Constraint::new(
+                vec![(1, "x")],
+                -n,
+                ConstraintType::EqualToZero,
+            )]
+        };
+        assert!(certificate_excludes(&proof, &x_is(2), &mapping));
+        assert!(!certificate_excludes(&proof, &x_is(1), &mapping));
+
+        // A certificate over places the net does not have is not taken
+        assert!(!certificate_excludes(&proof, &x_is(2), &mapping[..1]));
+    }
+
     #[test]
     fn test_install_smpt_instructions() {
         // Test that install function provides instructions when SMPT is not installed
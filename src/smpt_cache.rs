@@ -0,0 +1,554 @@
+//! On-disk store for SMPT results (see `smpt::set_use_cache`).
+//!
+//! Layout of the cache directory:
+//!
+//! - `index`: an append-only log with one line per event, `P <key> <bytes> <ms>` (put),
+//!   `T <key> <ms>` (touch on a hit) and `D <key>` (delete). Only this file is read at
+//!   startup; values are loaded lazily on a hit.
+//! - `entries/<key>.entry`, and optionally `entries/<key>.raw` with the raw SMPT output.
+//!   Both are written to a temporary file and renamed into place, so concurrent runs
+//!   never observe a partially written value.
+//!
+//! Index lines are appended with a single `write` in append mode, which keeps lines from
+//! concurrent processes intact. Eviction and index compaction take an exclusive `flock`
+//! on `lock`. The value files are the ground truth: an entry whose index line was lost
+//! (e.g. in a compaction racing with another process) is still found on disk.
+
+use crate::deterministic_map::HashMap;
+use std::fs::{File, OpenOptions};
+use std::io::{self, Write};
+use std::os::fd::AsRawFd;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+/// Bumped whenever the stored format or the key derivation changes
+pub const CACHE_FORMAT_VERSION: u64 = 2;
+
+/// Evict least recently used entries once the values exceed this many bytes
+static MAX_CACHE_BYTES: AtomicU64 = AtomicU64::new(1 << 30);
+
+/// Whether raw SMPT stdout/stderr are stored next to the results
+static STORE_RAW_OUTPUT: AtomicBool = AtomicBool::new(true);
+
+pub fn set_max_cache_bytes(bytes: u64) {
+    MAX_CACHE_BYTES.store(bytes.max(1), Ordering::SeqCst);
+}
+
+pub fn set_store_raw_output(on: bool) {
+    STORE_RAW_OUTPUT.store(on, Ordering::SeqCst);
+}
+
+pub fn store_raw_output() -> bool {
+    STORE_RAW_OUTPUT.load(Ordering::SeqCst)
+}
+
+/// Hash with a fixed, platform independent definition, so that cache keys stay valid
+/// across runs, builds and Rust versions (unlike `DefaultHasher`).
+///
+/// Two lanes are kept: FNV-1a for the key, and a multiply-xorshift lane that is stored
+/// with the entry and checked on load to guard against key collisions.
+pub struct StableHasher {
+    key: u64,
+    check: u64,
+}
+
+impl StableHasher {
+    pub fn new() -> Self {
+        let mut hasher = StableHasher {
+            key: 0xcbf2_9ce4_8422_2325,
+            check: 0x9e37_79b9_7f4a_7c15,
+        };
+        hasher.write_u64(CACHE_FORMAT_VERSION);
+        hasher
+    }
+
+    pub fn write_bytes(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.key = (self.key ^ b as u64).wrapping_mul(0x0000_0100_0000_01b3);
+            self.check = (self.check ^ b as u64).wrapping_mul(0xff51_afd7_ed55_8ccd);
+            self.check ^= self.check >> 29;
+        }
+    }
+
+    pub fn write_u64(&mut self, x: u64) {
+        self.write_bytes(&x.to_le_bytes());
+    }
+
+    pub fn write_i64(&mut self, x: i64) {
+        self.write_bytes(&x.to_le_bytes());
+    }
+
+    /// Length-prefixed, so that ("ab", "c") and ("a", "bc") hash differently
+    pub fn write_str(&mut self, s: &str) {
+        self.write_u64(s.len() as u64);
+        self.write_bytes(s.as_bytes());
+    }
+
+    /// Returns `(key, check)`
+    pub fn finish(&self) -> (u64, u64) {
+        (self.key, self.check)
+    }
+}
+
+/// Store statistics for the current run
+#[derive(Debug, Default, Clone)]
+pub struct StoreStats {
+    pub entries: usize,
+    pub total_bytes: u64,
+    pub index_load_time: Duration,
+    pub value_load_time: Duration,
+    pub bytes_read: u64,
+    pub bytes_written: u64,
+    pub evictions: u64,
+}
+
+struct IndexEntry {
+    bytes: u64,
+    last_used_ms: u64,
+}
+
+pub struct CacheStore {
+    dir: PathBuf,
+    index: HashMap<u64, IndexEntry>,
+    index_file: File,
+    index_lines: usize,
+    /// Overrides `MAX_CACHE_BYTES` for this store
+    max_bytes: Option<u64>,
+    stats: StoreStats,
+}
+
+fn now_ms() -> u64 {
+    SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .map(|d| d.as_millis() as u64)
+        .unwrap_or(0)
+}
+
+/// Replay an index log into `(key -> entry, number of lines)`, skipping malformed lines
+fn replay_index(contents: &str) -> (HashMap<u64, IndexEntry>, usize) {
+    let mut index: HashMap<u64, IndexEntry> = HashMap::default();
+    let mut lines = 0;
+    for line in contents.lines() {
+        lines += 1;
+        let fields: Vec<&str> = line.split_ascii_whitespace().collect();
+        let key = |i: usize| fields.get(i).and_then(|s| u64::from_str_radix(s, 16).ok());
+        let num = |i: usize| fields.get(i).and_then(|s| s.parse::<u64>().ok());
+        match (fields.first(), fields.len()) {
+            (Some(&"P"), 4) => {
+                if let (Some(key), Some(bytes), Some(last_used_ms)) = (key(1), num(2), num(3)) {
+                    index.insert(key, IndexEntry { bytes, last_used_ms });
+                }
+            }
+            (Some(&"T"), 3) => {
+                if let (Some(key), Some(ms)) = (key(1), num(2)) {
+                    if let Some(entry) = index.get_mut(&key) {
+                        entry.last_used_ms = entry.last_used_ms.max(ms);
+                    }
+                }
+            }
+            (Some(&"D"), 2) => {
+                if let Some(key) = key(1) {
+                    index.remove(&key);
+                }
+            }
+            _ => {}
+        }
+    }
+    (index, lines)
+}
+
+/// Write `contents` to `path` atomically via a temporary file in the same directory
+fn write_atomic(path: &Path, contents: &[u8]) -> io::Result<()> {
+    static COUNTER: AtomicU64 = AtomicU64::new(0);
+    let tmp = path.with_extension(format!(
+        "tmp-{}-{}",
+        std::process::id(),
+        COUNTER.fetch_add(1, Ordering::SeqCst)
+    ));
+    let result = std::fs::write(&tmp, contents).and_then(|()| std::fs::rename(&tmp, path));
+    if result.is_err() {
+        std::fs::remove_file(&tmp).ok();
+    }
+    result
+}
+
+/// Exclusive advisory lock on `<dir>/lock`, released on drop
+struct DirLock(File);
+
+impl DirLock {
+    fn acquire(dir: &Path) -> io::Result<Self> {
+        let file = OpenOptions::new()
+            .create(true)
+            .truncate(false)
+            .write(true)
+            .open(dir.join("lock"))?;
+        if unsafe { libc::flock(file.as_raw_fd(), libc::LOCK_EX) } != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(DirLock(file))
+    }
+}
+
+impl Drop for DirLock {
+    fn drop(&mut self) {
+        unsafe { libc::flock(self.0.as_raw_fd(), libc::LOCK_UN) };
+    }
+}
+
+impl CacheStore {
+    /// Open (creating if needed) the store in `dir`, reading only its index
+    pub fn open(dir: &Path) -> io::Result<Self> {
+        let start = Instant::now();
+        std::fs::create_dir_all(dir.join("entries"))?;
+        let index_path = dir.join("index");
+        let contents = match std::fs::read_to_string(&index_path) {
+            Ok(contents) => contents,
+            Err(e) if e.kind() == io::ErrorKind::NotFound => String::new(),
+            Err(e) => return Err(e),
+        };
+        let (index, index_lines) = replay_index(&contents);
+        let index_file = OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(&index_path)?;
+
+        let mut store = CacheStore {
+            dir: dir.to_path_buf(),
+            index,
+            index_file,
+            index_lines,
+            max_bytes: None,
+            stats: StoreStats::default(),
+        };
+        store.stats.bytes_read = contents.len() as u64;
+        store.refresh_totals();
+        store.stats.index_load_time = start.elapsed();
+        Ok(store)
+    }
+
+    fn refresh_totals(&mut self) {
+        self.stats.entries = self.index.len();
+        self.stats.total_bytes = self.index.values().map(|e| e.bytes).sum();
+    }
+
+    fn entry_path(&self, key: u64, extension: &str) -> PathBuf {
+        self.dir.join("entries").join(format!("{key:016x}.{extension}"))
+    }
+
+    fn append_index(&mut self, lines: &str) {
+        // One write per batch, so concurrent appends never interleave within a line
+        if self.index_file.write_all(lines.as_bytes()).is_ok() {
+            self.index_lines += lines.lines().count();
+        }
+    }
+
+    fn max_bytes(&self) -> u64 {
+        self.max_bytes
+            .unwrap_or_else(|| MAX_CACHE_BYTES.load(Ordering::SeqCst))
+    }
+
+    pub fn len(&self) -> usize {
+        self.index.len()
+    }
+
+    pub fn stats(&self) -> &StoreStats {
+        &self.stats
+    }
+
+    /// Load the value stored under `key`, if its check hash matches
+    pub fn get(&mut self, key: u64, check: u64) -> Option<Vec<u8>> {
+        let start = Instant::now();
+        let bytes = std::fs::read(self.entry_path(key, "entry")).ok();
+        self.stats.value_load_time += start.elapsed();
+        let Some(bytes) = bytes else {
+            // Evicted by another process: don't count it towards our totals any longer
+            if self.index.remove(&key).is_some() {
+                self.refresh_totals();
+            }
+            return None;
+        };
+        self.stats.bytes_read += bytes.len() as u64;
+
+        // The first 8 bytes hold the check hash of the entry's key
+        if bytes.len() < 8 || bytes[..8] != check.to_le_bytes() {
+            return None;
+        }
+
+        let ms = now_ms();
+        match self.index.get_mut(&key) {
+            Some(entry) => entry.last_used_ms = ms,
+            None => {
+                // Written by a process whose index line we have not seen
+                self.index.insert(
+                    key,
+                    IndexEntry {
+                        bytes: bytes.len() as u64,
+                        last_used_ms: ms,
+                    },
+                );
+                self.refresh_totals();
+            }
+        }
+        self.append_index(&format!("T {key:016x} {ms}\n"));
+        // Hits append to the index too; a failed compaction just leaves the log longer
+        if self.index_needs_compaction() {
+            self.compact().ok();
+        }
+        Some(bytes[8..].to_vec())
+    }
+
+    /// Load the raw output stored with `key`, if any
+    pub fn get_raw(&mut self, key: u64) -> Option<Vec<u8>> {
+        let start = Instant::now();
+        let bytes = std::fs::read(self.entry_path(key, "raw")).ok();
+        self.stats.value_load_time += start.elapsed();
+        if let Some(bytes) = &bytes {
+            self.stats.bytes_read += bytes.len() as u64;
+        }
+        bytes
+    }
+
+    /// Store `value` (and optionally the raw output) under `key`
+    pub fn put(
+        &mut self,
+        key: u64,
+        check: u64,
+        value: &[u8],
+        raw: Option<&[u8]>,
+    ) -> io::Result<()> {
+        let mut contents = Vec::with_capacity(8 + value.len());
+        contents.extend_from_slice(&check.to_le_bytes());
+        contents.extend_from_slice(value);
+        let mut bytes = contents.len() as u64;
+        if let Some(raw) = raw {
+            write_atomic(&self.entry_path(key, "raw"), raw)?;
+            bytes += raw.len() as u64;
+        } else {
+            // Don't leave the raw output of an earlier value behind
+            match std::fs::remove_file(self.entry_path(key, "raw")) {
+                Err(e) if e.kind() != io::ErrorKind::NotFound => return Err(e),
+                _ => {}
+            }
+        }
+        write_atomic(&self.entry_path(key, "entry"), &contents)?;
+        self.stats.bytes_written += bytes;
+
+        let ms = now_ms();
+        self.index.insert(key, IndexEntry { bytes, last_used_ms: ms });
+        self.append_index(&format!("P {key:016x} {bytes} {ms}\n"));
+        self.refresh_totals();
+
+        if self.stats.total_bytes > self.max_bytes() {
+            self.evict()?;
+        }
+        if self.index_needs_compaction() {
+            self.compact()?;
+        }
+        Ok(())
+    }
+
+    /// Delete least recently used entries until the store is below 90% of its budget
+    fn evict(&mut self) -> io::Result<()> {
+        let _lock = DirLock::acquire(&self.dir)?;
+        let target = self.max_bytes() / 10 * 9;
+        let mut by_age: Vec<(u64, u64)> = self
+            .index
+            .iter()
+            .map(|(&key, e)| (e.last_used_ms, key))
+            .collect();
+        by_age.sort_unstable();
+
+        let mut total = self.stats.total_bytes;
+        let mut lines = String::new();
+        for (_, key) in by_age {
+            if total <= target {
+                break;
+            }
+            let entry = self.index.remove(&key).unwrap();
+            std::fs::remove_file(self.entry_path(key, "entry")).ok();
+            std::fs::remove_file(self.entry_path(key, "raw")).ok();
+            total = total.saturating_sub(entry.bytes);
+            self.stats.evictions += 1;
+            lines.push_str(&format!("D {key:016x}\n"));
+        }
+        self.append_index(&lines);
+        self.refresh_totals();
+        Ok(())
+    }
+
+    /// Whether the index log has grown well past one line per live entry
+    fn index_needs_compaction(&self) -> bool {
+        self.index_lines > 2 * self.index.len() + 1024
+    }
+
+    /// Rewrite the index with one line per live entry
+    fn compact(&mut self) -> io::Result<()> {
+        let _lock = DirLock::acquire(&self.dir)?;
+        let index_path = self.dir.join("index");
+        // Pick up what other processes appended since we opened the index
+        if let Ok(contents) = std::fs::read_to_string(&index_path) {
+            let (on_disk, _) = replay_index(&contents);
+            for (key, entry) in on_disk {
+                let ours = self.index.entry(key).or_insert(IndexEntry {
+                    bytes: entry.bytes,
+                    last_used_ms: 0,
+                });
+                ours.last_used_ms = ours.last_used_ms.max(entry.last_used_ms);
+            }
+        }
+        // Drop the entries other processes deleted, whether or not we saw their `D` lines
+        let entries = self.dir.join("entries");
+        self.index
+            .retain(|key, _| entries.join(format!("{key:016x}.entry")).exists());
+
+        let mut compacted = String::new();
+        for (key, entry) in &self.index {
+            compacted.push_str(&format!("P {key:016x} {} {}\n", entry.bytes, entry.last_used_ms));
+        }
+        write_atomic(&index_path, compacted.as_bytes())?;
+        self.index_file = OpenOptions::new().append(true).open(&index_path)?;
+        self.index_lines = self.index.len();
+        self.refresh_totals();
+        Ok(())
+    }
+
+    /// Remove every entry and the index
+    pub fn clear(&mut self) -> io::Result<()> {
+        let _lock = DirLock::acquire(&self.dir)?;
+        std::fs::remove_dir_all(self.dir.join("entries")).ok();
+        std::fs::create_dir_all(self.dir.join("entries"))?;
+        write_atomic(&self.dir.join("index"), b"")?;
+        self.index_file = OpenOptions::new().append(true).open(self.dir.join("index"))?;
+        self.index.clear();
+        self.index_lines = 0;
+        self.refresh_totals();
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_store_round_trip_and_reload() {
+        let dir = tempfile::tempdir().unwrap();
+        let mut store = CacheStore::open(dir.path()).unwrap();
+        store.put(1, 11, b"one", Some(b"raw one")).unwrap();
+        store.put(2, 22, b"two", None).unwrap();
+
+        assert_eq!(store.get(1, 11).as_deref(), Some(&b"one"[..]));
+        assert_eq!(store.get_raw(1).as_deref(), Some(&b"raw one"[..]));
+        assert_eq!(store.get_raw(2), None);
+        // A wrong check hash is a miss
+        assert_eq!(store.get(2, 23), None);
+
+        let mut reopened = CacheStore::open(dir.path()).unwrap();
+        assert_eq!(reopened.len(), 2);
+        assert_eq!(reopened.get(2, 22).as_deref(), Some(&b"two"[..]));
+    }
+
+    #[test]
+    fn test_store_evicts_least_recently_used() {
+        let dir = tempfile::tempdir().unwrap();
+        let mut store = CacheStore::open(dir.path()).unwrap();
+        let value = vec![0u8; 100];
+        store.put(1, 1, &value, None).unwrap();
+        store.put(2, 2, &value, None).unwrap();
+        std::thread::sleep(Duration::from_millis(2));
+        store.get(1, 1).unwrap();
+
+        // Room for two entries: adding a third evicts the least recently used one
+        store.max_bytes = Some(250);
+        store.put(3, 3, &value, None).unwrap();
+
+        assert_eq!(store.get(2, 2), None);
+        assert!(store.get(1, 1).is_some());
+        assert!(store.get(3, 3).is_some());
+        assert_eq!(store.stats().evictions, 1);
+    }
+
+    #[test]
+    fn test_put_without_raw_removes_stale_raw() {
+        let dir = tempfile::tempdir().unwrap();
+        let mut store = CacheStore::open(dir.path()).unwrap();
+        store.put(1, 11, b"one", Some(b"raw one")).unwrap();
+        store.put(1, 11, b"uno", None).unwrap();
+        assert_eq!(store.get(1, 11).as_deref(), Some(&b"uno"[..]));
+        assert_eq!(store.get_raw(1), None);
+    }
+
+    #[test]
+    fn test_hits_compact_the_index() {
+        let dir = tempfile::tempdir().unwrap();
+        let mut store = CacheStore::open(dir.path()).unwrap();
+        store.put(1, 11, b"one", None).unwrap();
+        for _ in 0..2000 {
+            store.get(1, 11).unwrap();
+        }
+        assert!(!store.index_needs_compaction());
+        let index = std::fs::read_to_string(dir.path().join("index")).unwrap();
+        assert!(index.lines().count() <= 2 * store.len() + 1024);
+    }
+
+    #[test]
+    fn test_compaction_drops_entries_evicted_elsewhere() {
+        let dir = tempfile::tempdir().unwrap();
+        let value = vec![0u8; 100];
+        let mut evicting = CacheStore::open(dir.path()).unwrap();
+        evicting.put(1, 1, &value, None).unwrap();
+        evicting.put(2, 2, &value, None).unwrap();
+        let mut compacting = CacheStore::open(dir.path()).unwrap();
+        assert_eq!(compacting.len(), 2);
+
+        // Room for two entries: the first store evicts entry 1
+        std::thread::sleep(Duration::from_millis(2));
+        evicting.get(2, 2).unwrap();
+        evicting.max_bytes = Some(250);
+        evicting.put(3, 3, &value, None).unwrap();
+        assert_eq!(evicting.stats().evictions, 1);
+
+        // The second store never saw the eviction, and must not write entry 1 back
+        compacting.compact().unwrap();
+        assert_eq!(compacting.len(), 2);
+        assert_eq!(compacting.stats().total_bytes, 2 * 108);
+        let reopened = CacheStore::open(dir.path()).unwrap();
+        assert_eq!(reopened.len(), 2);
+        assert!(!reopened.index.contains_key(&1));
+
+        // A miss on an evicted entry forgets it as well
+        let mut stale = CacheStore::open(dir.path()).unwrap();
+        stale.index.insert(
+            1,
+            IndexEntry {
+                bytes: 108,
+                last_used_ms: 0,
+            },
+        );
+        assert_eq!(stale.get(1, 1), None);
+        assert_eq!(stale.len(), 2);
+    }
+
+    #[test]
+    fn test_replay_skips_malformed_lines() {
+        let log = "P 00000000000000ff 10 5\nP 1 2\nT 00000000000000ff 9\nD zz\n";
+        let (index, lines) = replay_index(log);
+        assert_eq!(lines, 4);
+        assert_eq!(index.len(), 1);
+        assert_eq!(index[&0xff].last_used_ms, 9);
+    }
+
+    #[test]
+    fn test_stable_hasher_is_length_prefixed() {
+        let hash = |parts: &[&str]| {
+            let mut hasher = StableHasher::new();
+            for p in parts {
+                hasher.write_str(p);
+            }
+            hasher.finish()
+        };
+        assert_eq!(hash(&["ab", "c"]), hash(&["ab", "c"]));
+        assert_ne!(hash(&["ab", "c"]), hash(&["a", "bc"]));
+    }
+}
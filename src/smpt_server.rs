@@ -0,0 +1,180 @@
+//! Pool of long-lived SMPT worker processes (`--smpt-server`).
+//!
+//! Spawning `python3 -m smpt` per query pays the interpreter and z3 import cost every
+//! time, which dominates runs with many small disjuncts. Instead, each worker runs
+//! `scripts/smpt_server.py` (embedded in the binary) and answers one query at a time over
+//! its stdin/stdout. Idle workers are kept in a pool, so concurrent disjuncts (`--jobs`)
+//! each get their own worker.
+//!
+//! A worker that does not answer within the SMPT timeout plus `HANG_GRACE`, or whose task
+//! is cancelled, is killed (with its process group) and replaced on the next query.
+
+use std::io::{self, BufRead, BufReader, Write};
+use std::os::unix::process::{CommandExt, ExitStatusExt};
+use std::process::{Child, ChildStdin, Command, ExitStatus, Stdio};
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::mpsc::{Receiver, RecvTimeoutError};
+use std::time::{Duration, Instant};
+
+/// Source of the worker, run with `python3 -c`
+const SERVER_SOURCE: &str = include_str!("../scripts/smpt_server.py");
+
+/// How long a fresh worker may take to import SMPT
+const STARTUP_TIMEOUT: Duration = Duration::from_secs(60);
+
+/// Time on top of SMPT's own timeout before a worker is considered hung
+const HANG_GRACE: Duration = Duration::from_secs(30);
+
+/// Whether SMPT queries go to the worker pool instead of a fresh process
+static SMPT_SERVER: AtomicBool = AtomicBool::new(false);
+
+/// Idle workers, ready for the next query
+static IDLE_WORKERS: Mutex<Vec<Worker>> = Mutex::new(Vec::new());
+
+pub fn set_smpt_server(on: bool) {
+    SMPT_SERVER.store(on, Ordering::SeqCst);
+}
+
+pub fn smpt_server_enabled() -> bool {
+    SMPT_SERVER.load(Ordering::SeqCst)
+}
+
+struct Worker {
+    child: Child,
+    stdin: ChildStdin,
+    /// Lines written by the worker on its protocol channel
+    responses: Receiver<String>,
+}
+
+impl Worker {
+    fn spawn() -> io::Result<Self> {
+        let mut child = Command::new("python3")
+            .args(["-u", "-c", SERVER_SOURCE])
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .stderr(Stdio::inherit())
+            // Own process group, so that killing it also kills SMPT's children
+            .process_group(0)
+            .spawn()?;
+        let stdin = child.stdin.take().unwrap();
+        let stdout = child.stdout.take().unwrap();
+
+        let (sender, responses) = std::sync::mpsc::channel();
+        std::thread::spawn(move || {
+            for line in BufReader::new(stdout).lines() {
+                let Ok(line) = line else { break };
+                if sender.send(line).is_err() {
+                    break;
+                }
+            }
+        });
+
+        let mut worker = Worker {
+            child,
+            stdin,
+            responses,
+        };
+        match worker.responses.recv_timeout(STARTUP_TIMEOUT) {
+            Ok(line) if line.contains("\"ready\"") => Ok(worker),
+            _ => {
+                worker.kill();
+                Err(io::Error::other("SMPT worker failed to start"))
+            }
+        }
+    }
+
+    fn kill(&mut self) {
+        unsafe { libc::kill(-(self.child.id() as libc::pid_t), libc::SIGKILL) };
+        self.child.wait().ok();
+    }
+}
+
+/// Parse a `{"status": <code>}` response
+fn parse_status(line: &str) -> Option<i32> {
+    let value: serde_json::Value = serde_json::from_str(line).ok()?;
+    value.get("status")?.as_i64().map(|code| code as i32)
+}
+
+/// Run SMPT with `args` on a pooled worker, writing its output to the given files.
+///
+/// Returns `ErrorKind::TimedOut` if the worker hangs past the timeout, and
+/// `ErrorKind::Interrupted` with `SMPT_CANCELLED_MESSAGE` if the task is cancelled.
+pub fn execute(
+    args: &[String],
+    stdout_path: &str,
+    stderr_path: &str,
+    timeout_seconds: Option<u64>,
+) -> io::Result<ExitStatus> {
+    let idle = IDLE_WORKERS.lock().unwrap().pop();
+    let mut worker = match idle {
+        Some(worker) => worker,
+        None => Worker::spawn()?,
+    };
+
+    let request = serde_json::json!({
+        "args": args,
+        "stdout": stdout_path,
+        "stderr": stderr_path,
+    });
+    if let Err(e) = writeln!(worker.stdin, "{}", request).and_then(|()| worker.stdin.flush()) {
+        worker.kill();
+        return Err(e);
+    }
+
+    let deadline = timeout_seconds
+        .filter(|&t| t > 0)
+        .map(|t| Instant::now() + Duration::from_secs(t) + HANG_GRACE);
+    loop {
+        match worker.responses.recv_timeout(Duration::from_millis(20)) {
+            Ok(line) => {
+                let Some(code) = parse_status(&line) else {
+                    worker.kill();
+                    return Err(io::Error::other(format!("Bad SMPT worker response: {line}")));
+                };
+                IDLE_WORKERS.lock().unwrap().push(worker);
+                return Ok(ExitStatus::from_raw((code & 0xff) << 8));
+            }
+            Err(RecvTimeoutError::Timeout) => {
+                if crate::parallel::is_cancelled() {
+                    worker.kill();
+                    return Err(io::Error::new(
+                        io::ErrorKind::Interrupted,
+                        crate::smpt::SMPT_CANCELLED_MESSAGE,
+                    ));
+                }
+                if deadline.is_some_and(|deadline| Instant::now() > deadline) {
+                    worker.kill();
+                    return Err(io::Error::new(
+                        io::ErrorKind::TimedOut,
+                        "SMPT worker did not answer in time",
+                    ));
+                }
+            }
+            Err(RecvTimeoutError::Disconnected) => {
+                worker.kill();
+                return Err(io::Error::other("SMPT worker exited"));
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_parse_status() {
+        assert_eq!(parse_status("{\"status\": 0}"), Some(0));
+        assert_eq!(parse_status("{\"status\": 1}"), Some(1));
+        assert_eq!(parse_status("{\"ready\": true}"), None);
+        assert_eq!(parse_status("garbage"), None);
+    }
+
+    #[test]
+    fn test_exit_status_round_trip() {
+        for code in [0, 1, 2] {
+            assert_eq!(ExitStatus::from_raw(code << 8).code(), Some(code));
+        }
+    }
+}
@@ -5,11 +5,21 @@
 //! The implementation maintains an internal union type and converts between representations
 //! as needed to perform operations that are unique to each type.
 
+use crate::deterministic_map::HashSet;
 use crate::kleene::Kleene;
 use crate::presburger::PresburgerSet;
-use crate::semilinear::SemilinearSet;
+use crate::semilinear::{LinearSet, SemilinearSet};
 use std::fmt::{Debug, Display};
 use std::hash::Hash;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+/// Build reachability targets as `SPresburgerExpr`s, which are evaluated only when their
+/// disjuncts are extracted
+pub static LAZY_EVALUATION: AtomicBool = AtomicBool::new(true);
+
+pub fn set_lazy_evaluation(on: bool) {
+    LAZY_EVALUATION.store(on, Ordering::SeqCst);
+}
 
 /// A set type that combines both SemilinearSet and PresburgerSet capabilities.
 ///
@@ -23,6 +33,51 @@ use std::hash::Hash;
 pub enum SPresburgerSet<T: Clone + Ord + Debug + ToString + Eq + Hash> {
     Semilinear(SemilinearSet<T>),
     Presburger(PresburgerSet<T>),
+    /// A star that exceeded the semilinear component budget, and the unions and products
+    /// built from it: the union of the terms. Kept apart from `Presburger` so that stars
+    /// over it can still be taken (see `star_factored`).
+    Factored(Vec<FactoredTerm<T>>),
+}
+
+/// The set `set + monoid` of a `SPresburgerSet::Factored`
+#[derive(Debug, Clone)]
+pub struct FactoredTerm<T: Clone + Ord + Debug + ToString + Eq + Hash> {
+    pub set: SemilinearSet<T>,
+    /// A set that contains 0 and is closed under addition; `None` is `{0}`
+    pub monoid: Option<PresburgerSet<T>>,
+}
+
+/// Add `term` to the union `terms`, merging the terms without a monoid
+fn push_term<T>(terms: &mut Vec<FactoredTerm<T>>, term: FactoredTerm<T>)
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    if term.monoid.is_none() {
+        if let Some(plain) = terms.iter_mut().find(|t| t.monoid.is_none()) {
+            let set = std::mem::replace(&mut plain.set, SemilinearSet::zero());
+            plain.set = set.plus(term.set);
+            return;
+        }
+    }
+    terms.push(term);
+}
+
+/// The union of the terms in ISL
+fn factored_to_presburger<T>(terms: &[FactoredTerm<T>]) -> PresburgerSet<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    let sets: Vec<PresburgerSet<T>> = terms
+        .iter()
+        .map(|term| {
+            let set = PresburgerSet::from_semilinear_set(&term.set);
+            match &term.monoid {
+                Some(monoid) => set.times(monoid.clone()),
+                None => set,
+            }
+        })
+        .collect();
+    PresburgerSet::union_all(&sets)
 }
 
 impl<T> SPresburgerSet<T>
@@ -63,7 +118,7 @@ where
             SPresburgerSet::Semilinear(_) => {
                 // Already in semilinear form
             }
-            SPresburgerSet::Presburger(_) => {
+            SPresburgerSet::Presburger(_) | SPresburgerSet::Factored(_) => {
                 // We don't have presburger -> semilinear conversion yet
                 // This is okay according to the user's requirements
                 panic!(
@@ -81,6 +136,10 @@ where
                 let pset = PresburgerSet::from_semilinear_set(sset);
                 *self = SPresburgerSet::Presburger(pset);
             }
+            SPresburgerSet::Factored(terms) => {
+                let pset = factored_to_presburger(terms);
+                *self = SPresburgerSet::Presburger(pset);
+            }
             SPresburgerSet::Presburger(_) => {
                 // Already in presburger form
             }
@@ -92,7 +151,7 @@ where
         self.ensure_semilinear();
         match self {
             SPresburgerSet::Semilinear(sset) => sset,
-            SPresburgerSet::Presburger(_) => unreachable!(),
+            _ => unreachable!(),
         }
     }
 
@@ -100,28 +159,55 @@ where
     pub fn as_presburger(&mut self) -> &PresburgerSet<T> {
         self.ensure_presburger();
         match self {
-            SPresburgerSet::Semilinear(_) => unreachable!(),
             SPresburgerSet::Presburger(pset) => pset,
+            _ => unreachable!(),
+        }
+    }
+
+    /// The set as a PresburgerSet, converting if necessary
+    pub fn into_presburger(mut self) -> PresburgerSet<T> {
+        self.ensure_presburger();
+        match self {
+            SPresburgerSet::Presburger(pset) => pset,
+            _ => unreachable!(),
         }
     }
 
     /// Union of two sets
-    pub fn union(mut self, mut other: Self) -> Self {
+    pub fn union(self, other: Self) -> Self {
         // Try to keep both in the same representation for efficiency
-        match (&mut self, &mut other) {
+        match (self, other) {
             (SPresburgerSet::Semilinear(a), SPresburgerSet::Semilinear(b)) => {
                 // Both semilinear - use semilinear union
-                SPresburgerSet::Semilinear(a.clone().plus(b.clone()))
+                SPresburgerSet::Semilinear(a.plus(b))
             }
             (SPresburgerSet::Presburger(a), SPresburgerSet::Presburger(b)) => {
                 // Both presburger - use presburger union
-                SPresburgerSet::Presburger(a.union(b))
+                SPresburgerSet::Presburger(a.union(&b))
             }
-            _ => {
-                // Mixed types - convert both to presburger
-                self.ensure_presburger();
-                other.ensure_presburger();
-                match (self, other) {
+            (SPresburgerSet::Factored(mut a), SPresburgerSet::Factored(b)) => {
+                for term in b {
+                    push_term(&mut a, term);
+                }
+                SPresburgerSet::Factored(a)
+            }
+            (SPresburgerSet::Factored(mut a), SPresburgerSet::Semilinear(b))
+            | (SPresburgerSet::Semilinear(b), SPresburgerSet::Factored(mut a)) => {
+                // Stay factored, so that a later star still works
+                push_term(
+                    &mut a,
+                    FactoredTerm {
+                        set: b,
+                        monoid: None,
+                    },
+                );
+                SPresburgerSet::Factored(a)
+            }
+            (mut a, mut b) => {
+                // Mixed types - convert the semilinear one to presburger
+                a.ensure_presburger();
+                b.ensure_presburger();
+                match (a, b) {
                     (SPresburgerSet::Presburger(a), SPresburgerSet::Presburger(b)) => {
                         SPresburgerSet::Presburger(a.union(&b))
                     }
@@ -131,6 +217,25 @@ where
         }
     }
 
+    /// Union of many sets at once
+    ///
+    /// If no set is in Presburger form the result stays semilinear (or factored).
+    /// Otherwise every set is converted to Presburger form and they are harmonized in one
+    /// step (see `PresburgerSet::union_all`), instead of once per pairwise union.
+    pub fn union_all(sets: Vec<Self>) -> Self {
+        if !sets
+            .iter()
+            .any(|set| matches!(set, SPresburgerSet::Presburger(_)))
+        {
+            return sets
+                .into_iter()
+                .fold(Self::empty(), |acc, set| acc.union(set));
+        }
+
+        let psets: Vec<PresburgerSet<T>> = sets.into_iter().map(Self::into_presburger).collect();
+        SPresburgerSet::Presburger(PresburgerSet::union_all(&psets))
+    }
+
     /// Intersection of two sets
     pub fn intersection(mut self, mut other: Self) -> Self {
         // Convert both to presburger for intersection
@@ -169,6 +274,10 @@ where
                         .all(|c| c.base.is_zero() && c.periods.is_empty())
             }
             SPresburgerSet::Presburger(pset) => pset.is_empty(),
+            // Monoids contain 0, so a term is empty when its semilinear set is
+            SPresburgerSet::Factored(terms) => {
+                terms.iter().all(|term| term.set.components.is_empty())
+            }
         }
     }
 
@@ -194,6 +303,15 @@ where
                 // Use the presburger set's rename method directly
                 SPresburgerSet::Presburger(pset.rename(f))
             }
+            SPresburgerSet::Factored(terms) => SPresburgerSet::Factored(
+                terms
+                    .into_iter()
+                    .map(|term| FactoredTerm {
+                        set: term.set.rename(&f),
+                        monoid: term.monoid.map(|monoid| monoid.rename(&f)),
+                    })
+                    .collect(),
+            ),
         }
     }
 
@@ -213,6 +331,14 @@ where
                 // Use the presburger set's for_each_key method
                 pset.for_each_key(f);
             }
+            SPresburgerSet::Factored(terms) => {
+                for term in terms {
+                    term.set.for_each_key(|key| f(key.clone()));
+                    if let Some(monoid) = &term.monoid {
+                        monoid.for_each_key(&mut f);
+                    }
+                }
+            }
         }
     }
 
@@ -220,17 +346,25 @@ where
     /// Each QuantifiedSet represents one disjunct in the DNF representation
     ///
     /// This is used by the new reachability checking algorithm to process constraints
-    /// from SPresburgerSet representations.
+    /// from SPresburgerSet representations. Each disjunct costs an SMPT query, so the
+    /// set is first normalized over the (non-negative) place counts, unless disabled
+    /// with `--without-disjunct-normalization`.
     pub fn extract_constraint_disjuncts(&mut self) -> Vec<super::presburger::QuantifiedSet<T>> {
         // Convert to PresburgerSet to access ISL constraint extraction
         self.ensure_presburger();
 
         match self {
             SPresburgerSet::Presburger(pset) => {
+                let before = pset.num_basic_sets();
+                if super::presburger::NORMALIZE_DISJUNCTS.load(Ordering::SeqCst) {
+                    *pset = pset.normalize_disjuncts();
+                }
+                crate::stats::record_disjunct_normalization(before, pset.num_basic_sets());
+
                 // Use PresburgerSet's to_quantified_sets to get constraint information
                 pset.to_quantified_sets()
             }
-            SPresburgerSet::Semilinear(_) => {
+            _ => {
                 // This should not happen after ensure_presburger()
                 unreachable!()
             }
@@ -263,20 +397,19 @@ where
         // Ensure this set is in Presburger form for harmonization
         self.ensure_presburger();
 
-        // Create a universe set over the desired domain
-        let mut universe = Self::universe(domain);
-        universe.ensure_presburger();
+        // Create a universe set over the desired domain, directly in ISL
+        let mut universe = PresburgerSet::universe(domain);
 
         // Harmonize the sets so they have the same domain
-        match (&mut self, &mut universe) {
-            (SPresburgerSet::Presburger(self_pset), SPresburgerSet::Presburger(universe_pset)) => {
+        match self {
+            SPresburgerSet::Presburger(mut pset) => {
                 // Use ISL harmonization to align domains
-                self_pset.harmonize(universe_pset);
+                pset.harmonize(&mut universe);
 
                 // Return the harmonized self (now expanded to the full domain)
-                SPresburgerSet::Presburger(self_pset.clone())
+                SPresburgerSet::Presburger(pset)
             }
-            _ => unreachable!("Both sets should be in Presburger form after ensure_presburger"),
+            _ => unreachable!("The set should be in Presburger form after ensure_presburger"),
         }
     }
 }
@@ -300,24 +433,326 @@ where
         self.union(other)
     }
 
-    fn times(mut self, mut other: Self) -> Self {
-        // Minkowski sum - convert both to presburger
-        self.ensure_presburger();
-        other.ensure_presburger();
+    fn times(self, other: Self) -> Self {
+        // Minkowski sum - stay semilinear (or factored) if possible, so that a later star
+        // still works
         match (self, other) {
-            (SPresburgerSet::Presburger(a), SPresburgerSet::Presburger(b)) => {
-                SPresburgerSet::Presburger(a.times(b))
+            (SPresburgerSet::Semilinear(a), SPresburgerSet::Semilinear(b)) => {
+                SPresburgerSet::Semilinear(a.times(b))
             }
-            _ => unreachable!(),
+            (SPresburgerSet::Factored(a), SPresburgerSet::Semilinear(b))
+            | (SPresburgerSet::Semilinear(b), SPresburgerSet::Factored(a)) => {
+                let mut terms = Vec::with_capacity(a.len());
+                for term in a {
+                    let term = FactoredTerm {
+                        set: term.set.times(b.clone()),
+                        monoid: term.monoid,
+                    };
+                    push_term(&mut terms, term);
+                }
+                SPresburgerSet::Factored(terms)
+            }
+            (SPresburgerSet::Factored(a), SPresburgerSet::Factored(b)) => {
+                let mut terms = Vec::with_capacity(a.len() * b.len());
+                for x in &a {
+                    for y in &b {
+                        let monoid = match (&x.monoid, &y.monoid) {
+                            (Some(m), Some(n)) => Some(m.clone().times(n.clone())),
+                            (Some(m), None) | (None, Some(m)) => Some(m.clone()),
+                            (None, None) => None,
+                        };
+                        let term = FactoredTerm {
+                            set: x.set.clone().times(y.set.clone()),
+                            monoid,
+                        };
+                        push_term(&mut terms, term);
+                    }
+                }
+                SPresburgerSet::Factored(terms)
+            }
+            (a, b) => SPresburgerSet::Presburger(a.into_presburger().times(b.into_presburger())),
         }
     }
 
-    fn star(mut self) -> Self {
+    fn star(self) -> Self {
+        let budget = crate::semilinear::STAR_COMPONENT_BUDGET.load(Ordering::SeqCst);
+        self.star_within_budget(budget)
+    }
+
+    fn weight(&self) -> usize {
+        match self {
+            SPresburgerSet::Semilinear(sset) => sset.weight(),
+            SPresburgerSet::Presburger(_) => 1,
+            SPresburgerSet::Factored(terms) => terms
+                .iter()
+                .map(|term| term.set.weight() + term.monoid.is_some() as usize)
+                .sum(),
+        }
+    }
+}
+
+impl<T> SPresburgerSet<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    /// The star whose `try_star_within` factors are `factors`, as a factored set.
+    ///
+    /// The factors are stars, so their product (computed in ISL) is a monoid.
+    pub fn from_star_factors(factors: &[SemilinearSet<T>]) -> Self {
+        // Too many linear sets: finish the product of the factors in ISL instead
+        eprintln!(
+            "Warning: star exceeds the semilinear component budget, continuing with Presburger sets"
+        );
+        let product = factors
+            .iter()
+            .map(PresburgerSet::from_semilinear_set)
+            .reduce(|acc, f| acc.times(f))
+            .expect("try_star returns at least one factor");
+        SPresburgerSet::Factored(vec![FactoredTerm {
+            set: SemilinearSet::one(),
+            monoid: Some(product),
+        }])
+    }
+
+    /// Kleene star with `budget` linear sets for each semilinear star (see `star_within`)
+    fn star_within_budget(mut self, budget: usize) -> Self {
+        if let SPresburgerSet::Factored(terms) = self {
+            return star_factored(terms, budget);
+        }
         // Star operation requires semilinear representation
         self.ensure_semilinear();
         match self {
-            SPresburgerSet::Semilinear(sset) => SPresburgerSet::Semilinear(sset.star()),
-            SPresburgerSet::Presburger(_) => unreachable!(),
+            SPresburgerSet::Semilinear(sset) => star_within(sset, budget),
+            _ => unreachable!(),
+        }
+    }
+}
+
+/// Star of a semilinear set, falling back to a factored set once `budget` is exceeded
+/// (see `SPresburgerSet::from_star_factors`)
+fn star_within<T>(sset: SemilinearSet<T>, budget: usize) -> SPresburgerSet<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    match sset.try_star_within(budget) {
+        Ok(result) => SPresburgerSet::Semilinear(result),
+        Err(factors) => SPresburgerSet::from_star_factors(&factors),
+    }
+}
+
+/// Star of the union of `terms`, without expanding them.
+///
+/// Vector addition is commutative, so `(X ∪ Y)* = X* Y*`, and `(X + M)* = {0} ∪ X X* M`
+/// for any set `X` and monoid `M`. The terms without a monoid are starred together as a
+/// semilinear set; a term `S + M` contributes the factor `{0} ∪ b(b, P)* + M` for each
+/// linear set `bP*` of `S`. Each factor is a monoid, and so is their product.
+fn star_factored<T>(terms: Vec<FactoredTerm<T>>, budget: usize) -> SPresburgerSet<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    let mut plain = SemilinearSet::zero();
+    let mut with_monoid = vec![];
+    for term in terms {
+        match term.monoid {
+            None => plain = plain.plus(term.set),
+            Some(monoid) => with_monoid.push((term.set, monoid)),
+        }
+    }
+
+    let (base, mut monoid) = match star_within(plain, budget) {
+        SPresburgerSet::Semilinear(sset) => (sset, None),
+        SPresburgerSet::Factored(mut terms) => {
+            let term = terms.pop().expect("star_within returns one term");
+            (term.set, term.monoid)
+        }
+        SPresburgerSet::Presburger(pset) => (SemilinearSet::one(), Some(pset)),
+    };
+    for (set, m) in with_monoid {
+        for component in set.components {
+            let mut periods = vec![component.base.clone()];
+            periods.extend(component.periods);
+            let linear = SemilinearSet {
+                components: vec![LinearSet {
+                    base: component.base,
+                    periods,
+                }],
+            };
+            let factor = PresburgerSet::one()
+                .union(&PresburgerSet::from_semilinear_set(&linear).times(m.clone()));
+            monoid = Some(match monoid {
+                Some(monoid) => monoid.times(factor),
+                None => factor,
+            });
+        }
+    }
+
+    match monoid {
+        Some(monoid) => SPresburgerSet::Factored(vec![FactoredTerm {
+            set: base,
+            monoid: Some(monoid),
+        }]),
+        None => SPresburgerSet::Semilinear(base),
+    }
+}
+
+/// A deferred `SPresburgerSet` computation.
+///
+/// The target set of a reachability query is built by a chain of operations (complement,
+/// rename, product with a universe, domain expansion) whose intermediate sets are each used
+/// once. Built as an expression and evaluated at the end, every node can pick its
+/// representation knowing what its parent does with it:
+///
+/// - universes that end up in ISL are built there, not converted from semilinear sets,
+/// - renames are pushed to the leaves,
+/// - the product of a universe with a set over other atoms, followed by a domain expansion,
+///   is one `PresburgerSet::embed` instead of a Minkowski sum and two harmonizations.
+///
+/// With `--without-lazy-sets`, each operation is evaluated as it is built, exactly like
+/// the same operation on `SPresburgerSet`.
+pub enum SPresburgerExpr<T: Clone + Ord + Debug + ToString + Eq + Hash> {
+    Set(SPresburgerSet<T>),
+    /// All non-negative vectors over the atoms
+    Universe(Vec<T>),
+    Difference(Box<SPresburgerExpr<T>>, Box<SPresburgerExpr<T>>),
+    Times(Box<SPresburgerExpr<T>>, Box<SPresburgerExpr<T>>),
+    /// The set over the atoms of the domain, see `SPresburgerSet::expand_domain`
+    ExpandDomain(Box<SPresburgerExpr<T>>, Vec<T>),
+}
+
+impl<T> SPresburgerExpr<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash,
+{
+    fn deferred(expr: Self) -> Self {
+        if LAZY_EVALUATION.load(Ordering::Relaxed) {
+            expr
+        } else {
+            SPresburgerExpr::Set(expr.evaluate())
+        }
+    }
+
+    pub fn universe(atoms: Vec<T>) -> Self {
+        Self::deferred(SPresburgerExpr::Universe(atoms))
+    }
+
+    pub fn difference(self, other: Self) -> Self {
+        Self::deferred(SPresburgerExpr::Difference(Box::new(self), Box::new(other)))
+    }
+
+    pub fn times(self, other: Self) -> Self {
+        Self::deferred(SPresburgerExpr::Times(Box::new(self), Box::new(other)))
+    }
+
+    pub fn expand_domain(self, domain: Vec<T>) -> Self {
+        Self::deferred(SPresburgerExpr::ExpandDomain(Box::new(self), domain))
+    }
+
+    /// Rename all atoms, see `SPresburgerSet::rename`
+    pub fn rename<U, F>(self, f: F) -> SPresburgerExpr<U>
+    where
+        U: Clone + Ord + Debug + ToString + Eq + Hash,
+        F: Fn(T) -> U,
+    {
+        self.rename_with(&f)
+    }
+
+    fn rename_with<U, F>(self, f: &F) -> SPresburgerExpr<U>
+    where
+        U: Clone + Ord + Debug + ToString + Eq + Hash,
+        F: Fn(T) -> U,
+    {
+        match self {
+            SPresburgerExpr::Set(set) => SPresburgerExpr::Set(set.rename(f)),
+            SPresburgerExpr::Universe(atoms) => {
+                SPresburgerExpr::Universe(atoms.into_iter().map(f).collect())
+            }
+            SPresburgerExpr::Difference(a, b) => {
+                SPresburgerExpr::Difference(Box::new(a.rename_with(f)), Box::new(b.rename_with(f)))
+            }
+            SPresburgerExpr::Times(a, b) => {
+                SPresburgerExpr::Times(Box::new(a.rename_with(f)), Box::new(b.rename_with(f)))
+            }
+            SPresburgerExpr::ExpandDomain(a, domain) => SPresburgerExpr::ExpandDomain(
+                Box::new(a.rename_with(f)),
+                domain.into_iter().map(f).collect(),
+            ),
+        }
+    }
+
+    /// The set this expression stands for
+    pub fn evaluate(self) -> SPresburgerSet<T> {
+        match self {
+            SPresburgerExpr::Set(set) => set,
+            SPresburgerExpr::Universe(atoms) => SPresburgerSet::universe(atoms),
+            SPresburgerExpr::Difference(a, b) => {
+                SPresburgerSet::Presburger(a.presburger().difference(&b.presburger()))
+            }
+            SPresburgerExpr::Times(a, b) => match Self::split_product(*a, *b) {
+                // The universe only adds dimensions to a Presburger set
+                Ok((free, SPresburgerSet::Presburger(set))) => {
+                    SPresburgerSet::Presburger(set.embed(&free, &[]))
+                }
+                Ok((free, set)) => SPresburgerSet::universe(free).times(set),
+                Err((a, b)) => a.evaluate().times(b.evaluate()),
+            },
+            SPresburgerExpr::ExpandDomain(inner, domain) => match *inner {
+                SPresburgerExpr::Times(a, b) => match Self::split_product(*a, *b) {
+                    Ok((free, set)) => SPresburgerSet::Presburger(
+                        SPresburgerExpr::Set(set).presburger().embed(&free, &domain),
+                    ),
+                    Err((a, b)) => a.evaluate().times(b.evaluate()).expand_domain(domain),
+                },
+                inner => inner.evaluate().expand_domain(domain),
+            },
+        }
+    }
+
+    /// `evaluate` for a parent that needs the set in ISL
+    fn presburger(self) -> PresburgerSet<T> {
+        match self {
+            SPresburgerExpr::Universe(atoms) => PresburgerSet::universe(atoms),
+            expr => expr.evaluate().into_presburger(),
+        }
+    }
+
+    /// Split the product `a * b` into the atoms of a universe factor and the other factor
+    /// (evaluated), if that factor does not mention them
+    fn split_product(a: Self, b: Self) -> Result<(Vec<T>, SPresburgerSet<T>), (Self, Self)> {
+        let (free, other) = match (a, b) {
+            (SPresburgerExpr::Universe(free), other) | (other, SPresburgerExpr::Universe(free)) => {
+                (free, other)
+            }
+            (a, b) => return Err((a, b)),
+        };
+        let set = other.evaluate();
+        let mut keys = HashSet::default();
+        set.for_each_key(|key| {
+            keys.insert(key);
+        });
+        if free.iter().any(|atom| keys.contains(atom)) {
+            return Err((SPresburgerExpr::Universe(free), SPresburgerExpr::Set(set)));
+        }
+        Ok((free, set))
+    }
+}
+
+impl<T> Display for SPresburgerExpr<T>
+where
+    T: Clone + Ord + Debug + ToString + Eq + Hash + Display,
+{
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        match self {
+            SPresburgerExpr::Set(set) => write!(f, "{}", set),
+            SPresburgerExpr::Universe(atoms) => {
+                let atoms: Vec<String> = atoms.iter().map(|atom| atom.to_string()).collect();
+                write!(f, "Universe({})", atoms.join(", "))
+            }
+            SPresburgerExpr::Difference(a, b) => write!(f, "({} - {})", a, b),
+            SPresburgerExpr::Times(a, b) => write!(f, "({} * {})", a, b),
+            SPresburgerExpr::ExpandDomain(a, domain) => {
+                let atoms: Vec<String> = domain.iter().map(|atom| atom.to_string()).collect();
+                write!(f, "ExpandDomain({}, [{}])", a, atoms.join(", "))
+            }
         }
     }
 }
@@ -359,6 +794,16 @@ where
             SPresburgerSet::Presburger(pset) => {
                 write!(f, "Presburger({})", pset)
             }
+            SPresburgerSet::Factored(terms) => {
+                let terms: Vec<String> = terms
+                    .iter()
+                    .map(|term| match &term.monoid {
+                        Some(monoid) => format!("{} + {}", term.set, monoid),
+                        None => term.set.to_string(),
+                    })
+                    .collect();
+                write!(f, "Factored({})", terms.join(" ∪ "))
+            }
         }
     }
 }
@@ -409,6 +854,28 @@ mod tests {
         // Should succeed without panic
     }
 
+    #[test]
+    fn test_union_all() {
+        let atoms: Vec<SPresburgerSet<char>> = "cab".chars().map(SPresburgerSet::atom).collect();
+
+        // All semilinear stays semilinear
+        let semilinear_union = SPresburgerSet::union_all(atoms.clone());
+        assert!(matches!(semilinear_union, SPresburgerSet::Semilinear(_)));
+
+        // Mixed operands go through the batched Presburger union
+        let mut mixed = atoms.clone();
+        mixed[1].ensure_presburger();
+        let mixed_union = SPresburgerSet::union_all(mixed);
+        assert!(matches!(mixed_union, SPresburgerSet::Presburger(_)));
+
+        let pairwise = atoms
+            .into_iter()
+            .reduce(|acc, set| acc.union(set))
+            .unwrap();
+        assert_eq!(mixed_union, pairwise);
+        assert_eq!(semilinear_union, pairwise);
+    }
+
     #[test]
     fn test_union_same_types() {
         // Test union of two semilinear sets
@@ -467,6 +934,39 @@ mod tests {
         // Note: We can't easily test emptiness here without making is_empty take &mut self
     }
 
+    #[test]
+    fn test_lazy_expression_matches_eager_operations() {
+        use SPresburgerExpr::*;
+        let q = SPresburgerSet::atom('a').union(SPresburgerSet::atom('b'));
+        let domain = vec!['A', 'B', 'X', 'Z'];
+
+        let eager = SPresburgerSet::universe(vec!['X'])
+            .times(
+                SPresburgerSet::universe(vec!['a', 'b'])
+                    .difference(q.clone())
+                    .rename(|c| c.to_ascii_uppercase()),
+            )
+            .expand_domain(domain.clone());
+
+        // The product and the domain expansion are fused into one embedding
+        let complement = Difference(Box::new(Universe(vec!['a', 'b'])), Box::new(Set(q.clone())))
+            .rename(|c| c.to_ascii_uppercase());
+        let lazy = ExpandDomain(
+            Box::new(Times(Box::new(Universe(vec!['X'])), Box::new(complement))),
+            domain,
+        )
+        .evaluate();
+        assert!(matches!(lazy, SPresburgerSet::Presburger(_)));
+        assert_eq!(lazy, eager);
+
+        // A universe over atoms of the other factor is an ordinary product
+        let overlapping = Times(Box::new(Universe(vec!['a'])), Box::new(Set(q)));
+        assert!(matches!(
+            overlapping.evaluate(),
+            SPresburgerSet::Semilinear(_)
+        ));
+    }
+
     #[test]
     fn test_simple_case() {
         // Test a simple case that should work
@@ -668,6 +1168,47 @@ mod tests {
         assert_eq!(atom_a, times_with_one);
     }
 
+    #[test]
+    fn test_star_falls_back_to_presburger() {
+        // (ab* + bc* + ca*)* with a budget too small for the semilinear result
+        let set = SemilinearSet::atom(1)
+            .times(SemilinearSet::atom(2).star())
+            .plus(SemilinearSet::atom(2).times(SemilinearSet::atom(3).star()))
+            .plus(SemilinearSet::atom(3).times(SemilinearSet::atom(1).star()));
+
+        let expected = star_within(set.clone(), usize::MAX);
+        let fallback = star_within(set, 1);
+        assert!(matches!(expected, SPresburgerSet::Semilinear(_)));
+        assert!(matches!(fallback, SPresburgerSet::Factored(_)));
+        assert_eq!(expected, fallback);
+    }
+
+    #[test]
+    fn test_nested_star_over_factored_operand() {
+        // ((ab* + bc* + ca*)* d + e)* with the inner star over the budget
+        let lin = |x, y| {
+            SPresburgerSet::atom(x).times(SPresburgerSet::atom(y).star_within_budget(usize::MAX))
+        };
+        let inner = lin(1, 2).union(lin(2, 3)).union(lin(3, 1));
+        let nested = |budget| {
+            inner
+                .clone()
+                .star_within_budget(budget)
+                .times(SPresburgerSet::atom(4))
+                .union(SPresburgerSet::atom(5))
+                .star_within_budget(budget)
+        };
+
+        let expected = nested(usize::MAX);
+        let fallback = nested(1);
+        assert!(matches!(expected, SPresburgerSet::Semilinear(_)));
+        assert!(matches!(fallback, SPresburgerSet::Factored(_)));
+        assert_eq!(expected, fallback);
+
+        // A star of a factored set is a monoid, so starring it again changes nothing
+        assert_eq!(fallback.clone().star_within_budget(1), fallback);
+    }
+
     #[test]
     fn test_comprehensive_equality_star_operations() {
         // Test 7: Star operations (only available for semilinear)
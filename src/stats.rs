@@ -1,8 +1,10 @@
 use serde::{Deserialize, Serialize};
+use std::collections::BTreeMap;
 use std::fs::OpenOptions;
 use std::io::Write;
-use std::sync::Mutex;
-use std::time::Instant;
+use std::cell::RefCell;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
 use chrono::{DateTime, Utc};
 use crate::reachability::BIDIRECTIONAL_PRUNING_ENABLED;
 use crate::semilinear::{GENERATE_LESS, REMOVE_REDUNDANT};
@@ -11,7 +13,16 @@ use std::sync::atomic::Ordering;
 
 lazy_static::lazy_static! {
     pub static ref STATS_COLLECTOR: Mutex<StatsCollector> = Mutex::new(StatsCollector::new());
-    pub static ref CURRENT_DISJUNCT_STATS: Mutex<DisjunctStatsCollector> = Mutex::new(DisjunctStatsCollector::new());
+}
+
+// Disjunct stats are tracked per thread so that disjuncts can be checked in parallel
+thread_local! {
+    /// Collector of the analysis running on this thread, if it is not the global one
+    /// (see `collect_analysis_stats`)
+    static ANALYSIS_COLLECTOR: RefCell<Option<Arc<Mutex<StatsCollector>>>> = const { RefCell::new(None) };
+    static CURRENT_DISJUNCT_STATS: RefCell<DisjunctStatsCollector> = RefCell::new(DisjunctStatsCollector::new());
+    /// Finished disjunct stats held back by `collect_disjunct_stats`
+    static PENDING_DISJUNCT_STATS: RefCell<Option<Vec<DisjunctStats>>> = const { RefCell::new(None) };
 }
 
 pub struct DisjunctStatsCollector {
@@ -19,6 +30,7 @@ pub struct DisjunctStatsCollector {
     initial_places: usize,
     initial_transitions: usize,
     pruning_iterations: usize,
+    shared_pruning: bool,
     final_places: Option<usize>,
     final_transitions: Option<usize>,
 }
@@ -30,6 +42,7 @@ impl DisjunctStatsCollector {
             initial_places: 0,
             initial_transitions: 0,
             pruning_iterations: 0,
+            shared_pruning: false,
             final_places: None,
             final_transitions: None,
         }
@@ -40,6 +53,7 @@ impl DisjunctStatsCollector {
         self.initial_places = places;
         self.initial_transitions = transitions;
         self.pruning_iterations = 0;
+        self.shared_pruning = false;
         self.final_places = None;
         self.final_transitions = None;
     }
@@ -47,6 +61,10 @@ impl DisjunctStatsCollector {
     pub fn record_pruning_iteration(&mut self) {
         self.pruning_iterations += 1;
     }
+
+    pub fn set_shared_pruning(&mut self) {
+        self.shared_pruning = true;
+    }
     
     pub fn set_final_sizes(&mut self, places: usize, transitions: usize) {
         self.final_places = Some(places);
@@ -62,6 +80,7 @@ impl DisjunctStatsCollector {
             places_after: final_places,
             transitions_after: final_transitions,
             pruning_iterations: self.pruning_iterations,
+            shared_pruning: self.shared_pruning,
             removed_places: self.initial_places.saturating_sub(final_places),
             removed_transitions: self.initial_transitions.saturating_sub(final_transitions),
         }
@@ -78,10 +97,33 @@ pub struct SerializabilityStats {
     pub certificate_checking_time_ms: Option<u64>,
     pub num_disjuncts: usize,
     pub semilinear_set: SemilinearSetStats,
+    pub kleene_elimination: KleeneEliminationStats,
     pub petri_net: PetriNetStats,
     pub total_time_ms: u64,
     pub smpt_calls: usize,
     pub smpt_timeouts: usize,
+    // Queries `precheck::refute` looked at, and those each tier refuted before SMPT
+    #[serde(default)]
+    pub precheck_queries: usize,
+    #[serde(default)]
+    pub precheck_invariant_refuted: usize,
+    #[serde(default)]
+    pub precheck_state_equation_refuted: usize,
+    // Requests whose NS fragment, and Kleene results, `--incremental` took from earlier runs
+    #[serde(default)]
+    pub incremental_fragments_reused: usize,
+    #[serde(default)]
+    pub incremental_semilinear_reused: usize,
+    // Totals of the `--trace` spans by phase (see trace.rs); empty without `--trace`
+    #[serde(default, skip_serializing_if = "BTreeMap::is_empty")]
+    pub phases: BTreeMap<String, PhaseStats>,
+}
+
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct PhaseStats {
+    pub spans: usize,
+    pub time_ms: f64,
+    pub isl_operations: u64,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
@@ -90,13 +132,21 @@ pub struct OptimizationOptions {
     pub remove_redundant: bool,
     pub generate_less: bool,
     pub smart_kleene_order: bool,
+    pub kleene_order: String,
     pub timeout: u64,
+    pub isl_max_operations: u64,
+    pub log_level: String,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct SemilinearSetStats {
     pub num_components: usize,
     pub components: Vec<SemilinearComponent>,
+    // How the period membership queries were answered (see semilinear::is_nonnegative_combination)
+    pub membership_trivial: usize,
+    pub membership_cached: usize,
+    pub membership_dp: usize,
+    pub membership_isl: usize,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
@@ -104,11 +154,36 @@ pub struct SemilinearComponent {
     pub periods: usize,
 }
 
+/// State elimination of `kleene::nfa_to_kleene` for the serialized automaton
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct KleeneEliminationStats {
+    pub order: String,
+    pub steps: Vec<EliminationStep>,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct EliminationStep {
+    // Number of the state in order of first appearance in the automaton
+    pub state: usize,
+    pub incoming: usize,
+    pub outgoing: usize,
+    pub self_loop: bool,
+    // Edges left after the step, and total `Kleene::weight` of the shortcuts it added
+    pub edges: usize,
+    pub weight: usize,
+}
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct PetriNetStats {
     pub places_before: usize,
     pub transitions_before: usize,
     pub disjuncts: Vec<DisjunctStats>,
+    // Disjuncts of the reachability queries before and after normalization
+    // (see presburger::PresburgerSet::normalize_disjuncts)
+    #[serde(default)]
+    pub disjuncts_before_normalization: usize,
+    #[serde(default)]
+    pub disjuncts_after_normalization: usize,
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
@@ -117,6 +192,10 @@ pub struct DisjunctStats {
     pub places_after: usize,
     pub transitions_after: usize,
     pub pruning_iterations: usize,
+    // Pruned together with the other disjuncts of an `--smpt-multi` run; the iterations
+    // of that run are counted on the first of them only
+    #[serde(default)]
+    pub shared_pruning: bool,
     pub removed_places: usize,
     pub removed_transitions: usize,
 }
@@ -127,6 +206,9 @@ pub struct StatsCollector {
     certificate_creation_start: Option<Instant>,
     certificate_checking_start: Option<Instant>,
     was_saved: bool,
+    /// Keep the finalized record in `finished` instead of appending it to the stats file
+    keep_finished: bool,
+    finished: Option<SerializabilityStats>,
 }
 
 impl StatsCollector {
@@ -137,6 +219,8 @@ impl StatsCollector {
             certificate_creation_start: None,
             certificate_checking_start: None,
             was_saved: false,
+            keep_finished: false,
+            finished: None,
         }
     }
 
@@ -151,7 +235,10 @@ impl StatsCollector {
                 remove_redundant: REMOVE_REDUNDANT.load(Ordering::Relaxed),
                 generate_less: GENERATE_LESS.load(Ordering::Relaxed),
                 smart_kleene_order: SMART_ORDER.load(Ordering::Relaxed),
+                kleene_order: crate::kleene::elimination_order().name().to_string(),
                 timeout: crate::smpt::get_smpt_timeout(),
+                isl_max_operations: crate::isl::max_operations(),
+                log_level: crate::debug_report::log_level().name().to_string(),
             },
             result: "unknown".to_string(),
             certificate_creation_time_ms: None,
@@ -160,15 +247,28 @@ impl StatsCollector {
             semilinear_set: SemilinearSetStats {
                 num_components: 0,
                 components: vec![],
+                membership_trivial: 0,
+                membership_cached: 0,
+                membership_dp: 0,
+                membership_isl: 0,
             },
+            kleene_elimination: KleeneEliminationStats::default(),
             petri_net: PetriNetStats {
                 places_before: 0,
                 transitions_before: 0,
                 disjuncts: vec![],
+                disjuncts_before_normalization: 0,
+                disjuncts_after_normalization: 0,
             },
             total_time_ms: 0,
             smpt_calls: 0,
             smpt_timeouts: 0,
+            precheck_queries: 0,
+            precheck_invariant_refuted: 0,
+            precheck_state_equation_refuted: 0,
+            incremental_fragments_reused: 0,
+            incremental_semilinear_reused: 0,
+            phases: BTreeMap::new(),
         });
     }
 
@@ -222,6 +322,55 @@ impl StatsCollector {
         }
     }
 
+    pub fn set_kleene_elimination_stats(&mut self, elimination: KleeneEliminationStats) {
+        if let Some(stats) = &mut self.current_stats {
+            stats.kleene_elimination = elimination;
+        }
+    }
+
+    pub fn record_disjunct_normalization(&mut self, before: usize, after: usize) {
+        if let Some(stats) = &mut self.current_stats {
+            stats.petri_net.disjuncts_before_normalization += before;
+            stats.petri_net.disjuncts_after_normalization += after;
+        }
+    }
+
+    pub fn record_precheck_query(&mut self) {
+        if let Some(stats) = &mut self.current_stats {
+            stats.precheck_queries += 1;
+        }
+    }
+
+    pub fn record_precheck_refutation(&mut self, tier: crate::precheck::Tier) {
+        if let Some(stats) = &mut self.current_stats {
+            match tier {
+                crate::precheck::Tier::PInvariants => stats.precheck_invariant_refuted += 1,
+                crate::precheck::Tier::StateEquation => stats.precheck_state_equation_refuted += 1,
+            }
+        }
+    }
+
+    pub fn record_incremental_fragments(&mut self, reused: usize) {
+        if let Some(stats) = &mut self.current_stats {
+            stats.incremental_fragments_reused += reused;
+        }
+    }
+
+    pub fn record_incremental_semilinear_reused(&mut self) {
+        if let Some(stats) = &mut self.current_stats {
+            stats.incremental_semilinear_reused += 1;
+        }
+    }
+
+    pub fn record_phase(&mut self, name: &str, duration: Duration, isl_operations: u64) {
+        if let Some(stats) = &mut self.current_stats {
+            let phase = stats.phases.entry(name.to_string()).or_default();
+            phase.spans += 1;
+            phase.time_ms += duration.as_secs_f64() * 1000.0;
+            phase.isl_operations += isl_operations;
+        }
+    }
+
     pub fn increment_smpt_calls(&mut self) {
         if let Some(stats) = &mut self.current_stats {
             stats.smpt_calls += 1;
@@ -242,7 +391,12 @@ impl StatsCollector {
 
         if let (Some(start), Some(mut stats)) = (self.start_time.take(), self.current_stats.take()) {
             stats.total_time_ms = start.elapsed().as_millis() as u64;
-            
+
+            if self.keep_finished {
+                self.finished = Some(stats);
+                return;
+            }
+
             // Save to JSONL file
             if let Err(e) = append_stats_to_file(&stats) {
                 eprintln!("Failed to save statistics: {}", e);
@@ -251,39 +405,90 @@ impl StatsCollector {
     }
 }
 
-fn append_stats_to_file(stats: &SerializabilityStats) -> std::io::Result<()> {
+pub const STATS_FILE: &str = "out/serializability_stats.jsonl";
+
+/// Open the JSONL stats file for appending
+pub fn open_stats_file() -> std::io::Result<std::fs::File> {
     // Ensure out directory exists
     std::fs::create_dir_all("out")?;
-    
-    let mut file = OpenOptions::new()
-        .create(true)
-        .append(true)
-        .open("out/serializability_stats.jsonl")?;
-    
+
+    OpenOptions::new().create(true).append(true).open(STATS_FILE)
+}
+
+/// Write one record as a line of the JSONL stats file
+pub fn write_stats_line(out: &mut impl Write, stats: &SerializabilityStats) -> std::io::Result<()> {
     let json = serde_json::to_string(stats)?;
-    writeln!(file, "{}", json)?;
-    
-    Ok(())
+    writeln!(out, "{}", json)
+}
+
+fn append_stats_to_file(stats: &SerializabilityStats) -> std::io::Result<()> {
+    let mut file = open_stats_file()?;
+    write_stats_line(&mut file, stats)
+}
+
+/// Run `f` on the collector of the analysis on this thread, or the global one
+fn with_collector(f: impl FnOnce(&mut StatsCollector)) {
+    match ANALYSIS_COLLECTOR.with(|slot| slot.borrow().clone()) {
+        Some(collector) => {
+            if let Ok(mut collector) = collector.lock() {
+                f(&mut collector);
+            }
+        }
+        None => {
+            if let Ok(mut collector) = STATS_COLLECTOR.lock() {
+                f(&mut collector);
+            }
+        }
+    }
+}
+
+/// Run `f` with its stats going to a collector of its own instead of the global one.
+///
+/// Returns the record `f` finalized, if any, instead of appending it to the stats file.
+/// Used by the batch mode, which analyses several files at once and writes their
+/// records itself.
+pub fn collect_analysis_stats<F, R>(f: F) -> (R, Option<SerializabilityStats>)
+where
+    F: FnOnce() -> R,
+{
+    let mut collector = StatsCollector::new();
+    collector.keep_finished = true;
+    let collector = Arc::new(Mutex::new(collector));
+    let result = with_analysis_collector(Some(collector.clone()), f);
+    let finished = collector.lock().unwrap().finished.take();
+    (result, finished)
+}
+
+/// The collector installed by `collect_analysis_stats` on this thread, if any
+pub fn analysis_collector() -> Option<Arc<Mutex<StatsCollector>>> {
+    ANALYSIS_COLLECTOR.with(|slot| slot.borrow().clone())
+}
+
+/// Run `f` with `collector` as this thread's collector; worker threads use this to
+/// report to the analysis that started them
+pub fn with_analysis_collector<F, R>(collector: Option<Arc<Mutex<StatsCollector>>>, f: F) -> R
+where
+    F: FnOnce() -> R,
+{
+    let previous = ANALYSIS_COLLECTOR.with(|slot| slot.replace(collector));
+    let result = f();
+    ANALYSIS_COLLECTOR.with(|slot| *slot.borrow_mut() = previous);
+    result
 }
 
 // Helper functions to be called from various parts of the codebase
 pub fn start_analysis(example: String) {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.start_new_analysis(example);
-    }
+    with_collector(|collector| collector.start_new_analysis(example));
 }
 
 pub fn record_certificate_creation_time<F, R>(f: F) -> R 
 where 
     F: FnOnce() -> R
 {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.start_certificate_creation();
-    }
+    let _span = crate::trace::span("certificate_creation");
+    with_collector(|collector| collector.start_certificate_creation());
     let result = f();
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.end_certificate_creation();
-    }
+    with_collector(|collector| collector.end_certificate_creation());
     result
 }
 
@@ -291,79 +496,116 @@ pub fn record_certificate_checking_time<F, R>(f: F) -> R
 where 
     F: FnOnce() -> R
 {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.start_certificate_checking();
-    }
+    let _span = crate::trace::span("certificate_checking");
+    with_collector(|collector| collector.start_certificate_checking());
     let result = f();
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.end_certificate_checking();
-    }
+    with_collector(|collector| collector.end_certificate_checking());
     result
 }
 
 pub fn set_analysis_result(result: &str) {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.set_result(result);
-    }
+    with_collector(|collector| collector.set_result(result));
 }
 
 pub fn set_petri_net_sizes(places: usize, transitions: usize) {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.set_petri_net_sizes(places, transitions);
-    }
+    with_collector(|collector| collector.set_petri_net_sizes(places, transitions));
 }
 
 pub fn add_disjunct_stats(stats: DisjunctStats) {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.add_disjunct_stats(stats);
-    }
+    with_collector(|collector| collector.add_disjunct_stats(stats));
 }
 
 pub fn set_semilinear_stats(stats: SemilinearSetStats) {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.set_semilinear_stats(stats);
-    }
+    with_collector(|collector| collector.set_semilinear_stats(stats));
+}
+
+pub fn set_kleene_elimination_stats(stats: KleeneEliminationStats) {
+    with_collector(|collector| collector.set_kleene_elimination_stats(stats));
+}
+
+pub fn record_disjunct_normalization(before: usize, after: usize) {
+    with_collector(|collector| collector.record_disjunct_normalization(before, after));
+}
+
+pub fn record_precheck_query() {
+    with_collector(|collector| collector.record_precheck_query());
+}
+
+pub fn record_precheck_refutation(tier: crate::precheck::Tier) {
+    with_collector(|collector| collector.record_precheck_refutation(tier));
+}
+
+pub fn record_incremental_fragments(reused: usize) {
+    with_collector(|collector| collector.record_incremental_fragments(reused));
+}
+
+pub fn record_incremental_semilinear_reused() {
+    with_collector(|collector| collector.record_incremental_semilinear_reused());
+}
+
+pub fn record_phase(name: &str, duration: Duration, isl_operations: u64) {
+    with_collector(|collector| collector.record_phase(name, duration, isl_operations));
 }
 
 pub fn increment_smpt_calls() {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.increment_smpt_calls();
-    }
+    with_collector(|collector| collector.increment_smpt_calls());
 }
 
 pub fn increment_smpt_timeouts() {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.increment_smpt_timeouts();
-    }
+    with_collector(|collector| collector.increment_smpt_timeouts());
 }
 
 pub fn finalize_stats() {
-    if let Ok(mut collector) = STATS_COLLECTOR.lock() {
-        collector.finalize_and_save();
-    }
+    with_collector(|collector| collector.finalize_and_save());
 }
 
 // Disjunct-specific helper functions
 pub fn start_disjunct_analysis(id: usize, places: usize, transitions: usize) {
-    if let Ok(mut collector) = CURRENT_DISJUNCT_STATS.lock() {
-        collector.start_disjunct(id, places, transitions);
-    }
+    CURRENT_DISJUNCT_STATS.with(|collector| {
+        collector
+            .borrow_mut()
+            .start_disjunct(id, places, transitions);
+    });
 }
 
 pub fn record_pruning_iteration() {
-    if let Ok(mut collector) = CURRENT_DISJUNCT_STATS.lock() {
-        collector.record_pruning_iteration();
-    }
+    CURRENT_DISJUNCT_STATS.with(|collector| collector.borrow_mut().record_pruning_iteration());
+}
+
+pub fn set_shared_pruning() {
+    CURRENT_DISJUNCT_STATS.with(|collector| collector.borrow_mut().set_shared_pruning());
 }
 
 pub fn finalize_disjunct(final_places: usize, final_transitions: usize) {
-    if let Ok(mut disjunct_collector) = CURRENT_DISJUNCT_STATS.lock() {
+    let stats = CURRENT_DISJUNCT_STATS.with(|collector| {
+        let mut disjunct_collector = collector.borrow_mut();
         disjunct_collector.set_final_sizes(final_places, final_transitions);
-        let stats = disjunct_collector.to_disjunct_stats();
-        
-        // Add to main stats collector
-        if let Ok(mut main_collector) = STATS_COLLECTOR.lock() {
-            main_collector.add_disjunct_stats(stats);
+        disjunct_collector.to_disjunct_stats()
+    });
+
+    // Hold the stats back if the caller collects them, otherwise add to main stats collector
+    let stats = PENDING_DISJUNCT_STATS.with(|pending| match pending.borrow_mut().as_mut() {
+        Some(buffer) => {
+            buffer.push(stats);
+            None
         }
+        None => Some(stats),
+    });
+    if let Some(stats) = stats {
+        add_disjunct_stats(stats);
     }
-}
\ No newline at end of file
+}
+
+/// Run `f`, returning the disjunct stats it finalized instead of publishing them.
+///
+/// Parallel disjunct checks use this so that only the disjuncts a sequential run
+/// would have checked end up in the stats, in disjunct order.
+pub fn collect_disjunct_stats<F, R>(f: F) -> (R, Vec<DisjunctStats>)
+where
+    F: FnOnce() -> R,
+{
+    let previous = PENDING_DISJUNCT_STATS.with(|pending| pending.replace(Some(Vec::new())));
+    let result = f();
+    let collected = PENDING_DISJUNCT_STATS.with(|pending| pending.replace(previous));
+    (result, collected.unwrap_or_default())
+}
@@ -0,0 +1,319 @@
+//! Phase tracing (`--trace <file>`): where the time of an analysis goes.
+//!
+//! `span("phase")` returns a guard that times the phase until it is dropped. Spans nest
+//! by scope, per thread, and are written as Chrome trace events (`"ph": "X"`), which
+//! chrome://tracing, Perfetto and speedscope show as a flame graph per thread. Finished
+//! spans are flushed to the file whenever the outermost span of a thread ends (such as
+//! the analysis of one file of a batch), and `export` completes the file. Every event
+//! also carries the number of ISL set operations (`PresburgerSet` unions, intersections,
+//! emptiness checks, ...) issued inside it; ISL does not expose its own operation
+//! counter.
+//!
+//! The duration and ISL operations of each span are also added to the `phases` totals
+//! of the current stats record, keyed by phase name. A phase that is re-entered on the
+//! same thread (like the recursive pruning) counts once, for its outermost span. Spans
+//! of parallel disjuncts add up across threads, so totals can exceed the wall time.
+//!
+//! Without `--trace`, `span` is one atomic load and returns an empty guard.
+
+use crate::deterministic_map::HashMap;
+use serde::Serialize;
+use std::cell::{Cell, RefCell};
+use std::fs::File;
+use std::io::{BufWriter, Write};
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Mutex, OnceLock};
+use std::time::{Duration, Instant};
+
+static TRACE: AtomicBool = AtomicBool::new(false);
+
+/// The trace file, until `export` has completed it
+static OUTPUT: Mutex<Option<TraceFile>> = Mutex::new(None);
+
+/// Finished spans of all threads not yet flushed to `OUTPUT`, in the order they ended
+static EVENTS: Mutex<Vec<Event>> = Mutex::new(Vec::new());
+
+/// Timestamps are relative to the first span
+static EPOCH: OnceLock<Instant> = OnceLock::new();
+
+static NEXT_THREAD_ID: AtomicU64 = AtomicU64::new(1);
+
+thread_local! {
+    static THREAD_ID: u64 = NEXT_THREAD_ID.fetch_add(1, Ordering::Relaxed);
+    /// ISL operations issued on this thread so far
+    static ISL_OPERATIONS: Cell<u64> = const { Cell::new(0) };
+    /// Number of open spans on this thread, by name
+    static OPEN: RefCell<HashMap<&'static str, usize>> = RefCell::new(HashMap::default());
+}
+
+/// Trace the rest of the run and write it to `path` on `export`
+pub fn set_trace_output(path: PathBuf) {
+    *OUTPUT.lock().unwrap() = Some(TraceFile {
+        path,
+        out: None,
+        events: 0,
+    });
+    TRACE.store(true, Ordering::SeqCst);
+}
+
+#[inline]
+pub fn trace_enabled() -> bool {
+    TRACE.load(Ordering::Relaxed)
+}
+
+/// One Chrome trace event of a finished span
+#[derive(Debug, Serialize)]
+struct Event {
+    name: &'static str,
+    cat: &'static str,
+    ph: &'static str,
+    // Microseconds since `EPOCH`
+    ts: f64,
+    dur: f64,
+    pid: u32,
+    tid: u64,
+    args: EventArgs,
+}
+
+#[derive(Debug, Serialize)]
+struct EventArgs {
+    #[serde(skip_serializing_if = "Option::is_none")]
+    detail: Option<String>,
+    isl_operations: u64,
+}
+
+/// A Chrome trace file, `{"traceEvents":[...],"displayTimeUnit":"ms"}`, written in parts
+struct TraceFile {
+    path: PathBuf,
+    // Opened by the first `write`
+    out: Option<BufWriter<File>>,
+    events: usize,
+}
+
+impl TraceFile {
+    fn write(&mut self, events: &[Event]) -> std::io::Result<()> {
+        if self.out.is_none() {
+            if let Some(dir) = self.path.parent().filter(|dir| !dir.as_os_str().is_empty()) {
+                std::fs::create_dir_all(dir)?;
+            }
+            let mut out = BufWriter::new(File::create(&self.path)?);
+            out.write_all(br#"{"traceEvents":["#)?;
+            self.out = Some(out);
+        }
+        let out = self.out.as_mut().expect("opened above");
+        for event in events {
+            if self.events > 0 {
+                out.write_all(b",")?;
+            }
+            serde_json::to_writer(&mut *out, event)?;
+            self.events += 1;
+        }
+        Ok(())
+    }
+
+    /// Write the last `events` and close the file, returning the number of events in it
+    fn finish(mut self, events: &[Event]) -> std::io::Result<usize> {
+        self.write(events)?;
+        let mut out = self.out.take().expect("opened by write");
+        out.write_all(br#"],"displayTimeUnit":"ms"}"#)?;
+        out.flush()?;
+        Ok(self.events)
+    }
+}
+
+/// Guard of an open span; see `span`
+#[must_use = "the span ends when this guard is dropped"]
+pub struct Span(Option<OpenSpan>);
+
+struct OpenSpan {
+    name: &'static str,
+    detail: Option<String>,
+    start: Instant,
+    isl_operations: u64,
+    // Whether a span of the same name was already open on this thread
+    reentered: bool,
+}
+
+/// Time the current scope as phase `name`
+#[inline]
+pub fn span(name: &'static str) -> Span {
+    if !trace_enabled() {
+        return Span(None);
+    }
+    Span(Some(OpenSpan::new(name, None)))
+}
+
+/// Like `span`, with a detail (such as the disjunct or file) shown with the event.
+///
+/// `detail` is only called when tracing.
+#[inline]
+pub fn span_with(name: &'static str, detail: impl FnOnce() -> String) -> Span {
+    if !trace_enabled() {
+        return Span(None);
+    }
+    Span(Some(OpenSpan::new(name, Some(detail()))))
+}
+
+/// Count one ISL set operation towards the open spans of this thread
+#[inline]
+pub fn count_isl_operation() {
+    if trace_enabled() {
+        ISL_OPERATIONS.with(|count| count.set(count.get() + 1));
+    }
+}
+
+impl OpenSpan {
+    fn new(name: &'static str, detail: Option<String>) -> Self {
+        let reentered = OPEN.with(|open| {
+            let mut open = open.borrow_mut();
+            let depth = open.entry(name).or_insert(0);
+            *depth += 1;
+            *depth > 1
+        });
+        let start = Instant::now();
+        EPOCH.get_or_init(|| start);
+        OpenSpan {
+            name,
+            detail,
+            start,
+            isl_operations: ISL_OPERATIONS.with(Cell::get),
+            reentered,
+        }
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        let Some(span) = self.0.take() else {
+            return;
+        };
+        let duration = span.start.elapsed();
+        let isl_operations = ISL_OPERATIONS.with(Cell::get) - span.isl_operations;
+        let outermost = OPEN.with(|open| {
+            let mut open = open.borrow_mut();
+            if let Some(depth) = open.get_mut(span.name) {
+                *depth -= 1;
+                if *depth == 0 {
+                    open.remove(span.name);
+                }
+            }
+            open.is_empty()
+        });
+
+        if !span.reentered {
+            crate::stats::record_phase(span.name, duration, isl_operations);
+        }
+
+        let epoch = *EPOCH.get_or_init(|| span.start);
+        let event = Event {
+            name: span.name,
+            cat: "ser",
+            ph: "X",
+            ts: micros(span.start.saturating_duration_since(epoch)),
+            dur: micros(duration),
+            pid: 1,
+            tid: THREAD_ID.with(|id| *id),
+            args: EventArgs {
+                detail: span.detail,
+                isl_operations,
+            },
+        };
+        if let Ok(mut events) = EVENTS.lock() {
+            events.push(event);
+        }
+        if outermost {
+            flush();
+        }
+    }
+}
+
+/// Write the finished spans to the trace file, so that a long run does not keep them all
+/// in memory. Spans that end after `export` are dropped.
+fn flush() {
+    let events = match EVENTS.lock() {
+        Ok(mut events) => std::mem::take(&mut *events),
+        Err(_) => return,
+    };
+    let Ok(mut output) = OUTPUT.lock() else {
+        return;
+    };
+    if let Some(file) = output.as_mut() {
+        if let Err(e) = file.write(&events) {
+            eprintln!("Failed to write trace to {}: {}", file.path.display(), e);
+            *output = None;
+        }
+    }
+}
+
+fn micros(duration: Duration) -> f64 {
+    duration.as_nanos() as f64 / 1000.0
+}
+
+/// Write the spans recorded so far to the `--trace` file and complete it.
+///
+/// Only the first call writes anything, so it is safe to call both on early exits and
+/// at the end of `main`.
+pub fn export() {
+    let Some(file) = OUTPUT.lock().unwrap().take() else {
+        return;
+    };
+    let events = std::mem::take(&mut *EVENTS.lock().unwrap());
+    let path = file.path.clone();
+    match file.finish(&events) {
+        Ok(events) => println!("Trace of {} spans written to {}", events, path.display()),
+        Err(e) => eprintln!("Failed to write trace to {}: {}", path.display(), e),
+    }
+}
+
+/// Calls `export` when dropped, so that returning from `main` writes the trace
+pub struct ExportOnDrop;
+
+impl Drop for ExportOnDrop {
+    fn drop(&mut self) {
+        export();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_disabled_span_is_empty() {
+        // Tests don't set a trace output, so nothing is traced
+        let span = span_with("disabled", || panic!("detail of a disabled span"));
+        assert!(span.0.is_none());
+    }
+
+    #[test]
+    fn test_chrome_trace_format() {
+        let event = |tid| Event {
+            name: "smpt",
+            cat: "ser",
+            ph: "X",
+            ts: 1.5,
+            dur: 20.0,
+            pid: 1,
+            tid,
+            args: EventArgs {
+                detail: None,
+                isl_operations: 3,
+            },
+        };
+        let dir = tempfile::tempdir().unwrap();
+        let mut file = TraceFile {
+            path: dir.path().join("trace.json"),
+            out: None,
+            events: 0,
+        };
+
+        // Flushed in two parts
+        file.write(&[event(2)]).unwrap();
+        assert_eq!(file.finish(&[event(3)]).unwrap(), 2);
+        assert_eq!(
+            std::fs::read_to_string(dir.path().join("trace.json")).unwrap(),
+            r#"{"traceEvents":[{"name":"smpt","cat":"ser","ph":"X","ts":1.5,"dur":20.0,"pid":1,"tid":2,"args":{"isl_operations":3}},{"name":"smpt","cat":"ser","ph":"X","ts":1.5,"dur":20.0,"pid":1,"tid":3,"args":{"isl_operations":3}}],"displayTimeUnit":"ms"}"#
+        );
+    }
+}